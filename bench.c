@@ -0,0 +1,248 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5.  The full HDF5 copyright notice, including     *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the root of the source code       *
+ * distribution tree, or in https://support.hdfgroup.org/ftp/HDF5/releases.  *
+ * If you do not have access to either file, you may request a copy from     *
+ * help@hdfgroup.org.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*
+ *  Benchmark driver comparing the native connector with the Hermes VOL.
+ *
+ *  Every case creates a dataset, fills it, then times a series of hyperslab
+ *  reads and writes and finally the close of dataset and file. Cases sweep
+ *  rank, dataset size, element type, access pattern, read/write mix and the
+ *  connector configuration. Results are printed as one JSON document.
+ *
+ *  usage: bench [-s dataset_mib] [-n ops] [-d dir] [-c connector] [-o out.json]
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/hermes_vol.h"
+#include "hermes_vol_placement.h"
+#include "hdf5.h"
+
+#define NSLABS 64
+
+typedef enum { PATTERN_SEQUENTIAL, PATTERN_STRIDED, PATTERN_RANDOM } Pattern;
+typedef enum { CONNECTOR_NATIVE, CONNECTOR_HERMES, CONNECTOR_ASYNC, CONNECTOR_PREFETCH,
+               CONNECTOR_LRU, CONNECTOR_ARC } Connector;
+
+static const char *pattern_names[]={"sequential","strided","random"};
+static const char *connector_names[]={"native","hermes","hermes-async","hermes-prefetch","hermes-lru","hermes-arc"};
+static const int ranks[]={1,2,3};
+static const int write_percents[]={0,50,100};
+
+typedef struct Case {
+    Connector connector;
+    int rank;
+    size_t bytes;
+    hid_t type;
+    const char *type_name;
+    Pattern pattern;
+    int write_percent;
+} Case;
+
+static double now(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return (double)t.tv_sec+(double)t.tv_nsec*1e-9;
+}
+static int compare_double(const void *a, const void *b){
+    double x=*(const double *)a,y=*(const double *)b;
+    return x<y?-1:x>y;
+}
+/* Returns a negative id when the connector could not be set up. */
+static hid_t make_fapl(Connector connector){
+    hid_t fapl=H5Pcreate(H5P_FILE_ACCESS);
+    herr_t status=0;
+    if(fapl<0 || connector==CONNECTOR_NATIVE) return fapl;
+    if(H5Pset_fapl_hermes_vol(fapl)<0) status=-1;
+    switch(connector){
+        case CONNECTOR_ASYNC:
+            if(status>=0) status=H5Pset_hermes_vol_async(fapl,true,0);
+            break;
+        case CONNECTOR_PREFETCH:
+            if(status>=0) status=H5Pset_hermes_vol_prefetch(fapl,2,0);
+            break;
+        case CONNECTOR_LRU:
+            if(status>=0) status=H5Pset_hermes_vol_placement(fapl,HERMES_PLACEMENT_LRU,64*1024*1024,0,NULL,0);
+            break;
+        case CONNECTOR_ARC:
+            if(status>=0) status=H5Pset_hermes_vol_placement(fapl,HERMES_PLACEMENT_ARC,64*1024*1024,0,NULL,0);
+            break;
+        default:
+            break;
+    }
+    if(status<0){
+        H5Pclose(fapl);
+        return -1;
+    }
+    return fapl;
+}
+/* Splits the dataset into NSLABS slabs along the slowest dimension. */
+static void make_dims(const Case *c, hsize_t *dims, hsize_t *slab){
+    size_t elems=c->bytes/H5Tget_size(c->type);
+    hsize_t side=1;
+    int i;
+    if(c->rank>1){
+        /* Inner dimensions of equal extent, leaving the slowest one NSLABS slabs at least. */
+        double inner=(double)elems/NSLABS,p;
+        for(;;){
+            for(p=1,i=1;i<c->rank;i++) p*=(double)(side+1);
+            if(p>inner) break;
+            side++;
+        }
+    }
+    for(i=1;i<c->rank;i++) dims[i]=slab[i]=side;
+    dims[0]=elems;
+    for(i=1;i<c->rank;i++) dims[0]/=side;
+    dims[0]-=dims[0]%NSLABS;
+    if(dims[0]<NSLABS) dims[0]=NSLABS;
+    slab[0]=dims[0]/NSLABS;
+}
+static hsize_t next_slab(Pattern pattern, int op){
+    switch(pattern){
+        case PATTERN_SEQUENTIAL: return (hsize_t)(op%NSLABS);
+        case PATTERN_STRIDED: return (hsize_t)((op*7)%NSLABS);
+        default: return (hsize_t)(rand()%NSLABS);
+    }
+}
+static int run_case(FILE *out, const Case *c, int ops, const char *dir, bool first){
+    hsize_t dims[H5S_MAX_RANK],slab[H5S_MAX_RANK],start[H5S_MAX_RANK];
+    size_t slab_bytes=H5Tget_size(c->type),moved=0;
+    double *latency,begin,elapsed,closing;
+    char path[1024];
+    void *buf,*all;
+    hid_t fapl,file_id=-1,space_id=-1,dataset_id=-1,mem_space_id=-1;
+    int i,op,output=0;
+    make_dims(c,dims,slab);
+    for(i=0;i<c->rank;i++){
+        slab_bytes*=slab[i];
+        start[i]=0;
+    }
+    latency=(double *)malloc(sizeof(double)*ops);
+    buf=calloc(1,slab_bytes);
+    all=calloc(NSLABS,slab_bytes);
+    if(latency==NULL || buf==NULL || all==NULL){
+        free(latency);
+        free(buf);
+        free(all);
+        return -1;
+    }
+    snprintf(path,sizeof(path),"%s/bench-%s.h5",dir,connector_names[c->connector]);
+    fapl=make_fapl(c->connector);
+    /* A failed call would otherwise be timed as a very fast one. */
+    if(fapl<0) output=-1;
+    if(output==0) file_id=H5Fcreate(path,H5F_ACC_TRUNC,H5P_DEFAULT,fapl);
+    if(output==0 && file_id<0) output=-1;
+    if(output==0) space_id=H5Screate_simple(c->rank,dims,NULL);
+    if(output==0 && space_id<0) output=-1;
+    if(output==0) dataset_id=H5Dcreate2(file_id,"/dset",c->type,space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    if(output==0 && dataset_id<0) output=-1;
+    if(output==0) mem_space_id=H5Screate_simple(c->rank,slab,NULL);
+    if(output==0 && mem_space_id<0) output=-1;
+    if(output==0 && H5Dwrite(dataset_id,c->type,H5S_ALL,H5S_ALL,H5P_DEFAULT,all)<0) output=-1;
+    srand(1);
+    begin=now();
+    for(op=0;output==0 && op<ops;op++){
+        double t=now();
+        herr_t status;
+        start[0]=next_slab(c->pattern,op)*slab[0];
+        if(H5Sselect_hyperslab(space_id,H5S_SELECT_SET,start,NULL,slab,NULL)<0){
+            output=-1;
+            break;
+        }
+        if(rand()%100<c->write_percent) status=H5Dwrite(dataset_id,c->type,mem_space_id,space_id,H5P_DEFAULT,buf);
+        else status=H5Dread(dataset_id,c->type,mem_space_id,space_id,H5P_DEFAULT,buf);
+        latency[op]=now()-t;
+        if(status<0) output=-1;
+        moved+=slab_bytes;
+    }
+    elapsed=now()-begin;
+    closing=now();
+    if(dataset_id>=0 && H5Dclose(dataset_id)<0) output=-1;
+    if(file_id>=0 && H5Fclose(file_id)<0) output=-1;
+    closing=now()-closing;
+    if(mem_space_id>=0) H5Sclose(mem_space_id);
+    if(space_id>=0) H5Sclose(space_id);
+    if(fapl>=0) H5Pclose(fapl);
+    if(output==0){
+        qsort(latency,ops,sizeof(double),compare_double);
+        fprintf(out,"%s    {\"connector\":\"%s\",\"rank\":%d,\"dims\":[",first?"":",\n",
+                connector_names[c->connector],c->rank);
+        for(i=0;i<c->rank;i++) fprintf(out,"%s%llu",i?",":"",(unsigned long long)dims[i]);
+        fprintf(out,"],\"type\":\"%s\",\"pattern\":\"%s\",\"write_percent\":%d,\"ops\":%d,\"bytes\":%zu,"
+                    "\"seconds\":%.6f,\"throughput_mib_s\":%.3f,\"p50_us\":%.3f,\"p99_us\":%.3f,\"close_ms\":%.3f}",
+                c->type_name,pattern_names[c->pattern],c->write_percent,ops,moved,elapsed,
+                elapsed>0?(double)moved/elapsed/(1024.0*1024.0):0.0,latency[ops/2]*1e6,
+                latency[(size_t)((ops-1)*0.99)]*1e6,closing*1e3);
+    }
+    free(latency);
+    free(buf);
+    free(all);
+    remove(path);
+    return output;
+}
+
+int main(int argc, char **argv) {
+    size_t sizes[2]={4*1024*1024,64*1024*1024};
+    hid_t types[2]={H5T_NATIVE_INT,H5T_NATIVE_DOUBLE};
+    const char *type_names[2]={"int32","float64"};
+    const char *dir=".",*only=NULL;
+    FILE *out=stdout;
+    int ops=256,opt,connector,r,s,t,p,m,failed=0;
+    bool first=true;
+    while((opt=getopt(argc,argv,"s:n:d:c:o:"))!=-1){
+        switch(opt){
+            case 's': sizes[1]=(size_t)atol(optarg)*1024*1024; break;
+            case 'n': ops=atoi(optarg); break;
+            case 'd': dir=optarg; break;
+            case 'c': only=optarg; break;
+            case 'o':
+                out=fopen(optarg,"w");
+                if(out==NULL){
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            default:
+                fprintf(stderr,"usage: %s [-s dataset_mib] [-n ops] [-d dir] [-c connector] [-o out.json]\n",argv[0]);
+                return 1;
+        }
+    }
+    if(ops<1) ops=1;
+    fprintf(out,"{\n  \"ops_per_case\":%d,\n  \"cases\":[\n",ops);
+    for(connector=CONNECTOR_NATIVE;connector<=CONNECTOR_ARC;connector++){
+        if(only && strcmp(only,connector_names[connector])!=0) continue;
+        for(r=0;r<3;r++) for(s=0;s<2;s++) for(t=0;t<2;t++) for(p=0;p<3;p++) for(m=0;m<3;m++){
+            Case c;
+            c.connector=(Connector)connector;
+            c.rank=ranks[r];
+            c.bytes=sizes[s];
+            c.type=types[t];
+            c.type_name=type_names[t];
+            c.pattern=(Pattern)p;
+            c.write_percent=write_percents[m];
+            if(run_case(out,&c,ops,dir,first)<0){
+                fprintf(stderr,"case failed: %s rank %d\n",connector_names[connector],c.rank);
+                failed++;
+                continue;
+            }
+            first=false;
+            fflush(out);
+        }
+    }
+    fprintf(out,"\n  ]\n}\n");
+    if(out!=stdout) fclose(out);
+    return failed?1:0;
+}
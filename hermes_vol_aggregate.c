@@ -0,0 +1,292 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_aggregate.c
+*
+* Purpose:Implements write aggregation. A run is a box held densely; a
+*         write joins a run when the two differ along one dimension only,
+*         every dimension before it is a single index, and they touch or
+*         overlap along it. The run is then a stack of slabs along that
+*         dimension and grows by copying slabs in. Pending runs never
+*         overlap, and a write overlapping runs it cannot join sends them
+*         down first, so the buffer layer sees writes in their order.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hermes_vol_aggregate.h"
+#include "hermes_vol_stats.h"
+
+/* Runs pending per dataset; a write needing another one sends down the least recently written. */
+#define HERMES_AGGREGATE_RUNS 64
+
+typedef struct HermesPendingRun {
+    hsize_t start[H5S_MAX_RANK];
+    hsize_t end[H5S_MAX_RANK];
+    char *data;
+    size_t bytes;
+    size_t size;            /* allocated */
+    uint64_t used;          /* tick of the last write */
+} HermesPendingRun;
+
+struct HermesAggregator {
+    pthread_mutex_t lock;   /* writes may come from the worker pool */
+    int rank;
+    size_t elem_size;
+    size_t flush_bytes;
+    uint64_t tick;
+    unsigned nruns;
+    HermesPendingRun *runs[HERMES_AGGREGATE_RUNS];
+};
+
+static bool hermes_run_overlaps(const HermesAggregator *agg, const HermesPendingRun *r, const hsize_t *start,
+                                const hsize_t *end){
+    int i;
+    for(i=0;i<agg->rank;i++) if(r->start[i]>end[i] || start[i]>r->end[i]) return false;
+    return true;
+}
+/**
+ * This method finds the dimension along which a box joins a run.
+ *
+ * @return the dimension, or -1 if the box cannot join the run
+ */
+static int hermes_run_axis(const HermesAggregator *agg, const HermesPendingRun *r, const hsize_t *start,
+                           const hsize_t *end){
+    int i,axis=-1;
+    for(i=0;i<agg->rank;i++){
+        if(r->start[i]==start[i] && r->end[i]==end[i]) continue;
+        if(axis>=0) return -1;
+        axis=i;
+    }
+    /* The same box simply replaces the run's data. */
+    if(axis<0) return 0;
+    for(i=0;i<axis;i++) if(r->start[i]!=r->end[i]) return -1;
+    if(start[axis]>r->end[axis]+1 || r->start[axis]>end[axis]+1) return -1;
+    return axis;
+}
+static void hermes_run_drop(HermesAggregator *agg, unsigned k){
+    free(agg->runs[k]->data);
+    free(agg->runs[k]);
+    agg->runs[k]=agg->runs[--agg->nruns];
+}
+/**
+ * This method sends a run down as one box and drops it.
+ *
+ * @return non-negative on success; a run that failed stays pending
+ */
+static herr_t hermes_run_flush(HermesAggregator *agg, unsigned k, HermesSelectionOp write, void *write_data){
+    HermesPendingRun *r=agg->runs[k];
+    hsize_t start[H5S_MAX_RANK],end[H5S_MAX_RANK],count[H5S_MAX_RANK],zero[H5S_MAX_RANK];
+    herr_t output;
+    int i;
+    for(i=0;i<agg->rank;i++){
+        start[i]=r->start[i];
+        end[i]=r->end[i];
+        count[i]=end[i]-start[i]+1;
+        zero[i]=0;
+    }
+    output=write(write_data,start,end,zero,count,r->data);
+    if(output<0) return output;
+    H5VL_hermes_stats_event(HERMES_EVENT_AGGREGATE_FLUSH);
+    hermes_run_drop(agg,k);
+    return output;
+}
+/**
+ * This method copies a box into a run it joins along axis, growing the run
+ * to cover it.
+ */
+static herr_t hermes_run_join(HermesAggregator *agg, HermesPendingRun *r, int axis, const hsize_t *file_start,
+                              const hsize_t *file_end, hsize_t *memory_start, hsize_t *memory_dim, void *buf){
+    hsize_t count[H5S_MAX_RANK],run_count[H5S_MAX_RANK],offset[H5S_MAX_RANK];
+    hsize_t lo=file_start[axis]<r->start[axis]?file_start[axis]:r->start[axis];
+    hsize_t hi=file_end[axis]>r->end[axis]?file_end[axis]:r->end[axis];
+    size_t slab=agg->elem_size,bytes;
+    int i;
+    for(i=axis+1;i<agg->rank;i++) slab*=(size_t)(r->end[i]-r->start[i]+1);
+    bytes=(size_t)(hi-lo+1)*slab;
+    if(bytes>r->size){
+        size_t size=r->size*2>bytes?r->size*2:bytes;
+        char *data=(char *)realloc(r->data,size);
+        if(data==NULL) return -1;
+        r->data=data;
+        r->size=size;
+    }
+    if(lo<r->start[axis]) memmove(r->data+(size_t)(r->start[axis]-lo)*slab,r->data,r->bytes);
+    r->start[axis]=lo;
+    r->end[axis]=hi;
+    r->bytes=bytes;
+    for(i=0;i<agg->rank;i++){
+        count[i]=file_end[i]-file_start[i]+1;
+        run_count[i]=r->end[i]-r->start[i]+1;
+        offset[i]=file_start[i]-r->start[i];
+    }
+    H5VL_hermes_box_copy(agg->rank,agg->elem_size,count,buf,memory_dim,memory_start,r->data,run_count,offset);
+    r->used=++agg->tick;
+    return 0;
+}
+static int hermes_run_compare(const void *a, const void *b){
+    const HermesPendingRun *x=*(HermesPendingRun *const *)a,*y=*(HermesPendingRun *const *)b;
+    int i;
+    for(i=0;i<H5S_MAX_RANK;i++) if(x->start[i]!=y->start[i]) return x->start[i]<y->start[i]?-1:1;
+    return 0;
+}
+
+/**
+ * This method creates the aggregator of a dataset.
+ *
+ * @param rank
+ * @param elem_size size of the elements written, i.e. of the native type
+ * @param flush_bytes size at which a run goes down; writes this large
+ *        are not held at all
+ * @return aggregator, or NULL
+ */
+HermesAggregator *H5VL_hermes_aggregate_create(int rank, size_t elem_size, size_t flush_bytes){
+    HermesAggregator *agg;
+    if(rank<1 || rank>H5S_MAX_RANK || flush_bytes==0) return NULL;
+    agg=(HermesAggregator *)calloc(1,sizeof(HermesAggregator));
+    if(agg==NULL) return NULL;
+    pthread_mutex_init(&agg->lock,NULL);
+    agg->rank=rank;
+    agg->elem_size=elem_size;
+    agg->flush_bytes=flush_bytes;
+    return agg;
+}
+/**
+ * This method frees an aggregator, dropping whatever it still holds; flush
+ * it first.
+ *
+ * @param agg
+ */
+void H5VL_hermes_aggregate_free(HermesAggregator *agg){
+    if(agg==NULL) return;
+    while(agg->nruns) hermes_run_drop(agg,agg->nruns-1);
+    pthread_mutex_destroy(&agg->lock);
+    free(agg);
+}
+/**
+ * This method writes a box through the aggregator. It is a selection
+ * callback with write and write_data bound, and never reads anything, so it
+ * may run on the worker pool.
+ *
+ * @param agg
+ * @param file_start first corner of the box
+ * @param file_end last corner of the box
+ * @param memory_start where the box lives in buf
+ * @param memory_dim extent of the memory array
+ * @param buf memory array
+ * @param write takes the runs and the writes too large to hold
+ * @param write_data passed through to write
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_aggregate_write(HermesAggregator *agg, hsize_t *file_start, hsize_t *file_end,
+                                   hsize_t *memory_start, hsize_t *memory_dim, void *buf,
+                                   HermesSelectionOp write, void *write_data){
+    HermesPendingRun *join=NULL;
+    size_t bytes=agg->elem_size;
+    herr_t output=0;
+    unsigned k;
+    int i,axis=-1;
+    for(i=0;i<agg->rank;i++) bytes*=(size_t)(file_end[i]-file_start[i]+1);
+    pthread_mutex_lock(&agg->lock);
+    if(bytes<agg->flush_bytes){
+        for(k=0;k<agg->nruns && join==NULL;k++){
+            axis=hermes_run_axis(agg,agg->runs[k],file_start,file_end);
+            if(axis>=0) join=agg->runs[k];
+        }
+    }
+    /* Older data the write overlaps goes down before it. */
+    for(k=0;k<agg->nruns && output>=0;){
+        if(agg->runs[k]!=join && hermes_run_overlaps(agg,agg->runs[k],file_start,file_end))
+            output=hermes_run_flush(agg,k,write,write_data);
+        else k++;
+    }
+    if(output<0){
+        /* nothing written */
+    }else if(join){
+        output=hermes_run_join(agg,join,axis,file_start,file_end,memory_start,memory_dim,buf);
+        if(output>=0) H5VL_hermes_stats_event(HERMES_EVENT_AGGREGATE_MERGE);
+        if(output>=0 && join->bytes>=agg->flush_bytes){
+            for(k=0;agg->runs[k]!=join;k++);
+            output=hermes_run_flush(agg,k,write,write_data);
+        }
+    }else if(bytes>=agg->flush_bytes){
+        output=write(write_data,file_start,file_end,memory_start,memory_dim,buf);
+    }else{
+        HermesPendingRun *r;
+        if(agg->nruns==HERMES_AGGREGATE_RUNS){
+            unsigned oldest=0;
+            for(k=1;k<agg->nruns;k++) if(agg->runs[k]->used<agg->runs[oldest]->used) oldest=k;
+            output=hermes_run_flush(agg,oldest,write,write_data);
+        }
+        r=output>=0?(HermesPendingRun *)calloc(1,sizeof(HermesPendingRun)):NULL;
+        if(r) r->data=(char *)malloc(bytes);
+        if(r && r->data){
+            /* A new run is a join of the box onto an empty run at the same place. */
+            for(i=0;i<agg->rank;i++){
+                r->start[i]=file_start[i];
+                r->end[i]=file_end[i];
+            }
+            r->size=bytes;
+            agg->runs[agg->nruns++]=r;
+            output=hermes_run_join(agg,r,0,file_start,file_end,memory_start,memory_dim,buf);
+        }else if(output>=0){
+            free(r);
+            /* Out of memory: the write goes straight down. */
+            output=write(write_data,file_start,file_end,memory_start,memory_dim,buf);
+        }
+    }
+    pthread_mutex_unlock(&agg->lock);
+    return output;
+}
+/**
+ * This method sends pending runs down, in file order. Reads flush the runs
+ * they overlap, so they never see the buffer layer behind the aggregator.
+ *
+ * @param agg
+ * @param start first corner of the box whose runs are flushed, NULL for
+ *        every run
+ * @param end last corner of the box
+ * @param write takes the runs
+ * @param write_data passed through to write
+ * @return non-negative on success; runs that failed stay pending
+ */
+herr_t H5VL_hermes_aggregate_flush(HermesAggregator *agg, const hsize_t *start, const hsize_t *end,
+                                   HermesSelectionOp write, void *write_data){
+    herr_t output=0;
+    unsigned k;
+    if(agg==NULL) return 0;
+    pthread_mutex_lock(&agg->lock);
+    qsort(agg->runs,agg->nruns,sizeof(HermesPendingRun *),hermes_run_compare);
+    for(k=0;k<agg->nruns && output>=0;){
+        if(start==NULL || hermes_run_overlaps(agg,agg->runs[k],start,end)){
+            HermesPendingRun *r=agg->runs[k];
+            /* Keep the rest in file order rather than letting the drop swap the last run in. */
+            memmove(&agg->runs[k],&agg->runs[k+1],(agg->nruns-k-1)*sizeof(HermesPendingRun *));
+            agg->runs[agg->nruns-1]=r;
+            output=hermes_run_flush(agg,agg->nruns-1,write,write_data);
+        }else{
+            k++;
+        }
+    }
+    pthread_mutex_unlock(&agg->lock);
+    return output;
+}
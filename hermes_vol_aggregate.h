@@ -0,0 +1,46 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_aggregate.h
+*
+* Purpose:Defines write aggregation for datasets written a few elements or
+*         rows at a time. Small writes that touch or overlap are merged in
+*         memory into runs, which reach the buffer layer as one box each
+*         once they are large enough, read, or flushed.
+*
+*-------------------------------------------------------------------------
+*/
+
+#ifndef HERMES_PROJECT_HERMES_VOL_AGGREGATE_H
+#define HERMES_PROJECT_HERMES_VOL_AGGREGATE_H
+#include <hdf5.h>
+#include <stddef.h>
+#include "hermes_vol_selection.h"
+
+/* Size at which a run goes down when H5Pset_hermes_vol_write_aggregation is not given one. */
+#define HERMES_AGGREGATE_DEFAULT_FLUSH_BYTES (4*1024*1024)
+
+typedef struct HermesAggregator HermesAggregator;
+
+HermesAggregator *H5VL_hermes_aggregate_create(int rank, size_t elem_size, size_t flush_bytes);
+void H5VL_hermes_aggregate_free(HermesAggregator *agg);
+herr_t H5VL_hermes_aggregate_write(HermesAggregator *agg, hsize_t *file_start, hsize_t *file_end,
+                                   hsize_t *memory_start, hsize_t *memory_dim, void *buf,
+                                   HermesSelectionOp write, void *write_data);
+herr_t H5VL_hermes_aggregate_flush(HermesAggregator *agg, const hsize_t *start, const hsize_t *end,
+                                   HermesSelectionOp write, void *write_data);
+#endif //HERMES_PROJECT_HERMES_VOL_AGGREGATE_H
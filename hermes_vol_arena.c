@@ -0,0 +1,104 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_arena.c
+*
+* Purpose:Implements the staging arenas. Each thread bumps through a block
+*         of its own; buffers are given back in the reverse order they were
+*         taken, as scratch buffers of nested calls are. A block too small
+*         for what a call needed is replaced by a big enough one the next
+*         time the thread's arena is empty.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include "hermes_vol_arena.h"
+
+#define HERMES_ARENA_ALIGN 64
+
+typedef struct HermesArena {
+    char *base;
+    size_t size;
+    size_t used;
+    size_t peak;            /* most the thread asked for at once */
+} HermesArena;
+
+static pthread_key_t hermes_arena_key;
+static pthread_once_t hermes_arena_once=PTHREAD_ONCE_INIT;
+static __thread HermesArena *hermes_arena=NULL;
+
+static void hermes_arena_destroy(void *arg){
+    HermesArena *arena=(HermesArena *)arg;
+    free(arena->base);
+    free(arena);
+}
+static void hermes_arena_key_create(void){
+    pthread_key_create(&hermes_arena_key,hermes_arena_destroy);
+}
+static HermesArena *hermes_arena_get(void){
+    if(hermes_arena==NULL){
+        HermesArena *arena;
+        pthread_once(&hermes_arena_once,hermes_arena_key_create);
+        arena=(HermesArena *)calloc(1,sizeof(HermesArena));
+        if(arena==NULL) return NULL;
+        /* The key frees the arena when the thread exits. */
+        pthread_setspecific(hermes_arena_key,arena);
+        hermes_arena=arena;
+    }
+    return hermes_arena;
+}
+
+/**
+ * This method takes a scratch buffer from the calling thread's arena.
+ *
+ * @param bytes
+ * @return buffer to give back with H5VL_hermes_arena_pop on the same
+ *         thread, after every buffer taken later; NULL if out of memory
+ */
+void *H5VL_hermes_arena_push(size_t bytes){
+    HermesArena *arena=hermes_arena_get();
+    size_t need=(bytes+HERMES_ARENA_ALIGN-1)&~(size_t)(HERMES_ARENA_ALIGN-1);
+    void *buf;
+    if(need==0) need=HERMES_ARENA_ALIGN;
+    if(arena==NULL) return malloc(need);
+    if(arena->used+need>arena->peak) arena->peak=arena->used+need;
+    if(arena->used==0 && arena->peak>arena->size && arena->peak<=HERMES_ARENA_MAX_BYTES){
+        if(posix_memalign(&buf,HERMES_ARENA_ALIGN,arena->peak)==0){
+            free(arena->base);
+            arena->base=(char *)buf;
+            arena->size=arena->peak;
+        }
+    }
+    if(arena->size-arena->used<need) return malloc(need);
+    buf=arena->base+arena->used;
+    arena->used+=need;
+    return buf;
+}
+/**
+ * This method gives back a buffer from H5VL_hermes_arena_push, and with it
+ * every buffer taken after it.
+ *
+ * @param buf
+ */
+void H5VL_hermes_arena_pop(void *buf){
+    HermesArena *arena=hermes_arena;
+    char *p=(char *)buf;
+    if(arena && arena->base && p>=arena->base && p<arena->base+arena->size) arena->used=(size_t)(p-arena->base);
+    else free(buf);
+}
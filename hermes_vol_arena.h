@@ -0,0 +1,36 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_arena.h
+*
+* Purpose:Defines per-thread staging arenas for the scratch buffers of a
+*         single call, so that threads moving data at once neither share an
+*         allocator lock nor map and unmap large buffers on every box.
+*
+*-------------------------------------------------------------------------
+*/
+
+#ifndef HERMES_PROJECT_HERMES_VOL_ARENA_H
+#define HERMES_PROJECT_HERMES_VOL_ARENA_H
+#include <stddef.h>
+
+/* Largest arena a thread keeps; bigger buffers come from malloc. */
+#define HERMES_ARENA_MAX_BYTES (64*1024*1024)
+
+void *H5VL_hermes_arena_push(size_t bytes);
+void H5VL_hermes_arena_pop(void *buf);
+#endif //HERMES_PROJECT_HERMES_VOL_ARENA_H
@@ -0,0 +1,379 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_async.c
+*
+* Purpose:Implements the background worker pool and request tokens behind
+*         the asynchronous mode of the Hermes VOL Plugin.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include "hermes_vol_async.h"
+
+#define HERMES_ASYNC_MAX_WORKERS 64
+
+typedef enum HermesRequestState {
+    HERMES_REQUEST_QUEUED,
+    HERMES_REQUEST_RUNNING,
+    HERMES_REQUEST_DONE
+} HermesRequestState;
+
+struct HermesRequest {
+    HermesAsyncFn fn;
+    void *arg;
+    HermesAsyncFree release;
+    HermesRequestState state;
+    H5ES_status_t status;
+    bool token;             /* a caller holds this request through the VOL req argument */
+    int refs;
+    HermesRequest *next;
+};
+struct HermesAsyncGroup {
+    HermesRequest *head;
+    HermesRequest *tail;
+    unsigned pending;       /* queued or running requests                     */
+    bool scheduled;         /* on the ready list or being run by a worker     */
+    herr_t error;           /* first failure of a request nobody waits on     */
+    bool released;          /* owner is gone; freed once pending drops to 0   */
+    HermesAsyncGroup *next;
+};
+
+/* Protects every request, group and the ready list. */
+static pthread_mutex_t hermes_async_lock=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t hermes_async_work=PTHREAD_COND_INITIALIZER;
+static pthread_cond_t hermes_async_done=PTHREAD_COND_INITIALIZER;
+/* Serializes calls into the buffer layer, which is not thread-safe. */
+static pthread_mutex_t hermes_buffer_mutex=PTHREAD_MUTEX_INITIALIZER;
+static HermesAsyncGroup *hermes_ready_head=NULL,*hermes_ready_tail=NULL;
+static pthread_t hermes_workers[HERMES_ASYNC_MAX_WORKERS];
+static unsigned hermes_nworkers=0;
+static bool hermes_async_stopping=false;
+
+/**
+ * Loop shared by the caller of H5VL_hermes_async_parallel and its helpers.
+ * Helpers hold references, since they may start after the caller returned.
+ */
+typedef struct HermesParallel {
+    HermesAsyncEach fn;
+    void *arg;
+    size_t count;
+    size_t next;            /* first index nobody has claimed */
+    size_t done;
+    herr_t error;
+    int refs;               /* atomic: workers release requests under the lock */
+} HermesParallel;
+
+static void hermes_request_put(HermesRequest *request){
+    if(--request->refs==0) free(request);
+}
+static void hermes_ready_push(HermesAsyncGroup *group){
+    group->next=NULL;
+    if(hermes_ready_tail) hermes_ready_tail->next=group;
+    else hermes_ready_head=group;
+    hermes_ready_tail=group;
+}
+static void *hermes_async_worker(void *unused){
+    (void)unused;
+    pthread_mutex_lock(&hermes_async_lock);
+    for(;;){
+        HermesAsyncGroup *group;
+        HermesRequest *request;
+        while(hermes_ready_head==NULL && !hermes_async_stopping)
+            pthread_cond_wait(&hermes_async_work,&hermes_async_lock);
+        if(hermes_ready_head==NULL) break;
+        group=hermes_ready_head;
+        hermes_ready_head=group->next;
+        if(hermes_ready_head==NULL) hermes_ready_tail=NULL;
+        request=group->head;
+        group->head=request->next;
+        if(group->head==NULL) group->tail=NULL;
+        /* A cancelled request is already DONE and only needs retiring. */
+        if(request->state==HERMES_REQUEST_QUEUED){
+            herr_t result;
+            request->state=HERMES_REQUEST_RUNNING;
+            pthread_mutex_unlock(&hermes_async_lock);
+            result=request->fn(request->arg);
+            pthread_mutex_lock(&hermes_async_lock);
+            request->status=result<0?H5ES_STATUS_FAIL:H5ES_STATUS_SUCCEED;
+            if(result<0 && !request->token && group->error>=0) group->error=result;
+            request->state=HERMES_REQUEST_DONE;
+        }
+        if(request->release) request->release(request->arg);
+        group->pending--;
+        if(group->head) hermes_ready_push(group);
+        else group->scheduled=false;
+        pthread_cond_broadcast(&hermes_async_done);
+        hermes_request_put(request);
+        if(group->released && group->pending==0) free(group);
+    }
+    pthread_mutex_unlock(&hermes_async_lock);
+    return NULL;
+}
+static void hermes_async_start(unsigned workers){
+    unsigned i;
+    if(workers==0) workers=HERMES_ASYNC_DEFAULT_WORKERS;
+    if(workers>HERMES_ASYNC_MAX_WORKERS) workers=HERMES_ASYNC_MAX_WORKERS;
+    for(i=0;i<workers;i++){
+        if(pthread_create(&hermes_workers[hermes_nworkers],NULL,hermes_async_worker,NULL)!=0) break;
+        hermes_nworkers++;
+    }
+}
+
+HermesAsyncGroup *H5VL_hermes_async_group_create(void){
+    return (HermesAsyncGroup *)calloc(1,sizeof(HermesAsyncGroup));
+}
+/**
+ * This method blocks until every request submitted to the group has run.
+ *
+ * @param group
+ * @return the first error of a request that had no token, or 0
+ */
+herr_t H5VL_hermes_async_group_drain(HermesAsyncGroup *group){
+    herr_t error;
+    if(group==NULL) return 0;
+    pthread_mutex_lock(&hermes_async_lock);
+    while(group->pending)
+        pthread_cond_wait(&hermes_async_done,&hermes_async_lock);
+    error=group->error;
+    group->error=0;
+    pthread_mutex_unlock(&hermes_async_lock);
+    return error;
+}
+herr_t H5VL_hermes_async_group_free(HermesAsyncGroup *group){
+    herr_t error=H5VL_hermes_async_group_drain(group);
+    free(group);
+    return error;
+}
+/**
+ * This method gives up a group without waiting for it. Requests still queued
+ * run as usual and the last one to finish frees the group. Used for work the
+ * caller must not block on, such as prefetches that may wait on HDF5.
+ *
+ * @param group
+ */
+void H5VL_hermes_async_group_release(HermesAsyncGroup *group){
+    if(group==NULL) return;
+    pthread_mutex_lock(&hermes_async_lock);
+    if(group->pending==0) free(group);
+    else group->released=true;
+    pthread_mutex_unlock(&hermes_async_lock);
+}
+/**
+ * This method queues fn(arg) behind the requests already in group, starting
+ * the worker pool on first use. If no worker can be started the operation
+ * runs on the calling thread.
+ *
+ * @param group queue the request is ordered in
+ * @param workers size of the pool if it has to be started
+ * @param fn operation to run
+ * @param arg argument of fn, owned by the request
+ * @param release frees arg once fn has run or the request was cancelled
+ * @param token receives the request token, NULL when nobody will wait on it
+ * @return non-negative once the request is queued, or the result of fn when
+ *         it ran on the calling thread
+ */
+herr_t H5VL_hermes_async_submit(HermesAsyncGroup *group, unsigned workers, HermesAsyncFn fn, void *arg,
+                                HermesAsyncFree release, HermesRequest **token){
+    HermesRequest *request=(HermesRequest *)calloc(1,sizeof(HermesRequest));
+    herr_t result=0;
+    if(request==NULL){
+        if(release) release(arg);
+        return -1;
+    }
+    request->fn=fn;
+    request->arg=arg;
+    request->release=release;
+    request->state=HERMES_REQUEST_QUEUED;
+    request->status=H5ES_STATUS_IN_PROGRESS;
+    request->token=token!=NULL;
+    request->refs=token?2:1;
+    if(token) *token=request;
+    pthread_mutex_lock(&hermes_async_lock);
+    if(hermes_nworkers==0) hermes_async_start(workers);
+    if(hermes_nworkers==0 || hermes_async_stopping){
+        pthread_mutex_unlock(&hermes_async_lock);
+        result=fn(arg);
+        if(release) release(arg);
+        pthread_mutex_lock(&hermes_async_lock);
+        request->state=HERMES_REQUEST_DONE;
+        request->status=result<0?H5ES_STATUS_FAIL:H5ES_STATUS_SUCCEED;
+        hermes_request_put(request);
+        pthread_mutex_unlock(&hermes_async_lock);
+        return result;
+    }
+    group->pending++;
+    if(group->tail) group->tail->next=request;
+    else group->head=request;
+    group->tail=request;
+    if(!group->scheduled){
+        group->scheduled=true;
+        hermes_ready_push(group);
+        pthread_cond_signal(&hermes_async_work);
+    }
+    pthread_mutex_unlock(&hermes_async_lock);
+    return result;
+}
+/**
+ * This method returns a token for an operation which already finished on
+ * the calling thread.
+ *
+ * @param result outcome of the operation
+ * @return request token
+ */
+HermesRequest *H5VL_hermes_async_completed(herr_t result){
+    HermesRequest *request=(HermesRequest *)calloc(1,sizeof(HermesRequest));
+    if(request==NULL) return NULL;
+    request->state=HERMES_REQUEST_DONE;
+    request->status=result<0?H5ES_STATUS_FAIL:H5ES_STATUS_SUCCEED;
+    request->token=true;
+    request->refs=1;
+    return request;
+}
+/**
+ * This method claims and runs indices of a parallel loop until none is left.
+ */
+static herr_t hermes_parallel_run(void *arg){
+    HermesParallel *loop=(HermesParallel *)arg;
+    pthread_mutex_lock(&hermes_async_lock);
+    while(loop->next<loop->count){
+        size_t index=loop->next++;
+        herr_t result;
+        pthread_mutex_unlock(&hermes_async_lock);
+        result=loop->fn(loop->arg,index);
+        pthread_mutex_lock(&hermes_async_lock);
+        if(result<0 && loop->error>=0) loop->error=result;
+        if(++loop->done==loop->count) pthread_cond_broadcast(&hermes_async_done);
+    }
+    pthread_mutex_unlock(&hermes_async_lock);
+    return 0;
+}
+static void hermes_parallel_put(void *arg){
+    HermesParallel *loop=(HermesParallel *)arg;
+    if(__atomic_sub_fetch(&loop->refs,1,__ATOMIC_ACQ_REL)==0) free(loop);
+}
+/**
+ * This method runs fn(arg,index) for every index below count, on the calling
+ * thread and on whichever workers pick up a share. The caller works through
+ * the indices itself rather than waiting for busy workers, so it may hold
+ * locks the queued requests need.
+ *
+ * @param workers size of the pool if it has to be started
+ * @param count number of indices
+ * @param fn called once per index, from any thread
+ * @param arg passed through to fn
+ * @return the first error of fn, or 0
+ */
+herr_t H5VL_hermes_async_parallel(unsigned workers, size_t count, HermesAsyncEach fn, void *arg){
+    HermesParallel *loop;
+    herr_t error;
+    size_t i,helpers;
+    if(count==0) return 0;
+    loop=(HermesParallel *)calloc(1,sizeof(HermesParallel));
+    if(loop==NULL) return -1;
+    loop->fn=fn;
+    loop->arg=arg;
+    loop->count=count;
+    loop->refs=1;
+    pthread_mutex_lock(&hermes_async_lock);
+    if(hermes_nworkers==0 && count>1) hermes_async_start(workers);
+    helpers=count-1<hermes_nworkers?count-1:hermes_nworkers;
+    if(hermes_async_stopping) helpers=0;
+    pthread_mutex_unlock(&hermes_async_lock);
+    for(i=0;i<helpers;i++){
+        /* A group of its own, so helpers do not queue behind one another. */
+        HermesAsyncGroup *group=H5VL_hermes_async_group_create();
+        if(group==NULL) break;
+        __atomic_add_fetch(&loop->refs,1,__ATOMIC_RELAXED);
+        H5VL_hermes_async_submit(group,workers,hermes_parallel_run,loop,hermes_parallel_put,NULL);
+        H5VL_hermes_async_group_release(group);
+    }
+    hermes_parallel_run(loop);
+    pthread_mutex_lock(&hermes_async_lock);
+    while(loop->done<loop->count)
+        pthread_cond_wait(&hermes_async_done,&hermes_async_lock);
+    error=loop->error;
+    pthread_mutex_unlock(&hermes_async_lock);
+    hermes_parallel_put(loop);
+    return error;
+}
+/**
+ * This method lets the workers finish every queued request and joins them.
+ */
+void H5VL_hermes_async_stop(void){
+    unsigned i,nworkers;
+    pthread_mutex_lock(&hermes_async_lock);
+    nworkers=hermes_nworkers;
+    hermes_async_stopping=true;
+    pthread_cond_broadcast(&hermes_async_work);
+    pthread_mutex_unlock(&hermes_async_lock);
+    for(i=0;i<nworkers;i++)
+        pthread_join(hermes_workers[i],NULL);
+    pthread_mutex_lock(&hermes_async_lock);
+    hermes_nworkers=0;
+    hermes_async_stopping=false;
+    pthread_mutex_unlock(&hermes_async_lock);
+}
+
+/**
+ * Request class callbacks. A token is released once it has reported a final
+ * status.
+ */
+herr_t H5VL_hermes_request_wait(HermesRequest *request, H5ES_status_t *status){
+    pthread_mutex_lock(&hermes_async_lock);
+    while(request->state!=HERMES_REQUEST_DONE)
+        pthread_cond_wait(&hermes_async_done,&hermes_async_lock);
+    *status=request->status;
+    hermes_request_put(request);
+    pthread_mutex_unlock(&hermes_async_lock);
+    return 0;
+}
+herr_t H5VL_hermes_request_test(HermesRequest *request, H5ES_status_t *status){
+    pthread_mutex_lock(&hermes_async_lock);
+    if(request->state==HERMES_REQUEST_DONE){
+        *status=request->status;
+        hermes_request_put(request);
+    }else{
+        *status=H5ES_STATUS_IN_PROGRESS;
+    }
+    pthread_mutex_unlock(&hermes_async_lock);
+    return 0;
+}
+herr_t H5VL_hermes_request_cancel(HermesRequest *request, H5ES_status_t *status){
+    pthread_mutex_lock(&hermes_async_lock);
+    if(request->state==HERMES_REQUEST_QUEUED){
+        request->state=HERMES_REQUEST_DONE;
+        request->status=H5ES_STATUS_CANCEL;
+    }
+    if(request->state==HERMES_REQUEST_DONE){
+        *status=request->status;
+        hermes_request_put(request);
+    }else{
+        *status=H5ES_STATUS_IN_PROGRESS;
+    }
+    pthread_mutex_unlock(&hermes_async_lock);
+    return 0;
+}
+
+void H5VL_hermes_buffer_lock(void){
+    pthread_mutex_lock(&hermes_buffer_mutex);
+}
+void H5VL_hermes_buffer_unlock(void){
+    pthread_mutex_unlock(&hermes_buffer_mutex);
+}
@@ -0,0 +1,66 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_async.h
+*
+* Purpose:Defines the background worker pool and request tokens behind the
+*         asynchronous mode of the Hermes VOL Plugin.
+*
+*-------------------------------------------------------------------------
+*/
+
+#ifndef HERMES_PROJECT_HERMES_VOL_ASYNC_H
+#define HERMES_PROJECT_HERMES_VOL_ASYNC_H
+#include <hdf5.h>
+#include <H5VLpublic.h>
+#include <stdbool.h>
+
+/* Workers started when H5Pset_hermes_vol_async is not given a count. */
+#define HERMES_ASYNC_DEFAULT_WORKERS 2
+
+typedef herr_t (*HermesAsyncFn)(void *arg);
+typedef void (*HermesAsyncFree)(void *arg);
+typedef herr_t (*HermesAsyncEach)(void *arg, size_t index);
+
+/**
+ * Token for one queued operation. It is handed to HDF5 through the VOL req
+ * argument and completed through the request class callbacks.
+ */
+typedef struct HermesRequest HermesRequest;
+/**
+ * Ordered queue of the operations issued on one object. Operations in a
+ * group run one at a time and in submission order; groups run in parallel.
+ */
+typedef struct HermesAsyncGroup HermesAsyncGroup;
+
+HermesAsyncGroup *H5VL_hermes_async_group_create(void);
+herr_t H5VL_hermes_async_group_drain(HermesAsyncGroup *group);
+herr_t H5VL_hermes_async_group_free(HermesAsyncGroup *group);
+void H5VL_hermes_async_group_release(HermesAsyncGroup *group);
+herr_t H5VL_hermes_async_submit(HermesAsyncGroup *group, unsigned workers, HermesAsyncFn fn, void *arg,
+                                HermesAsyncFree release, HermesRequest **token);
+HermesRequest *H5VL_hermes_async_completed(herr_t result);
+herr_t H5VL_hermes_async_parallel(unsigned workers, size_t count, HermesAsyncEach fn, void *arg);
+void H5VL_hermes_async_stop(void);
+
+herr_t H5VL_hermes_request_wait(HermesRequest *request, H5ES_status_t *status);
+herr_t H5VL_hermes_request_test(HermesRequest *request, H5ES_status_t *status);
+herr_t H5VL_hermes_request_cancel(HermesRequest *request, H5ES_status_t *status);
+
+void H5VL_hermes_buffer_lock(void);
+void H5VL_hermes_buffer_unlock(void);
+#endif //HERMES_PROJECT_HERMES_VOL_ASYNC_H
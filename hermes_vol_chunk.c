@@ -0,0 +1,521 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_chunk.c
+*
+* Purpose:Implements chunk staging. A written box is cut along the chunk
+*         grid: the whole chunks in its middle go down as one box, whole
+*         chunks at its edges one by one, and pieces of chunks are copied
+*         into a staged chunk with a bitmap of the elements written. A
+*         staged chunk always holds newer data than the buffer layer for
+*         the elements it has.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hermes_vol_arena.h"
+#include "hermes_vol_chunk.h"
+#include "hermes_vol_stats.h"
+
+#define HERMES_CHUNK_BUCKETS 256
+
+typedef struct HermesChunk {
+    size_t index;                   /* row-major number of the chunk in the grid */
+    hsize_t start[H5S_MAX_RANK];
+    hsize_t count[H5S_MAX_RANK];    /* clipped to the dataset */
+    size_t elements;
+    size_t covered;                 /* elements written so far */
+    char *data;
+    unsigned char *written;         /* one bit per element */
+    struct HermesChunk *next;
+} HermesChunk;
+
+struct HermesChunkStage {
+    pthread_mutex_t lock;   /* writes may come from the worker pool */
+    int rank;
+    hsize_t dims[H5S_MAX_RANK];
+    hsize_t max_dims[H5S_MAX_RANK];
+    hsize_t chunk[H5S_MAX_RANK];
+    hsize_t grid[H5S_MAX_RANK];     /* chunks per dimension */
+    size_t elem_size;
+    size_t capacity;
+    size_t staged;                  /* bytes of staged chunks */
+    size_t nchunks;
+    HermesChunk *buckets[HERMES_CHUNK_BUCKETS];
+};
+
+static size_t hermes_chunk_index(const HermesChunkStage *stage, const hsize_t *coord){
+    size_t index=0;
+    int i;
+    for(i=0;i<stage->rank;i++) index=index*(size_t)stage->grid[i]+(size_t)coord[i];
+    return index;
+}
+static HermesChunk **hermes_chunk_slot(HermesChunkStage *stage, size_t index){
+    HermesChunk **slot=&stage->buckets[index%HERMES_CHUNK_BUCKETS];
+    while(*slot && (*slot)->index!=index) slot=&(*slot)->next;
+    return slot;
+}
+/* A chunk the edge clips is only whole if the dataset cannot grow past that edge. */
+static bool hermes_chunk_final(const HermesChunkStage *stage, const hsize_t *count){
+    int i;
+    for(i=0;i<stage->rank;i++) if(count[i]<stage->chunk[i] && stage->dims[i]<stage->max_dims[i]) return false;
+    return true;
+}
+static void hermes_chunk_drop(HermesChunkStage *stage, HermesChunk **slot){
+    HermesChunk *c=*slot;
+    *slot=c->next;
+    stage->staged-=c->elements*stage->elem_size;
+    stage->nchunks--;
+    free(c->data);
+    free(c->written);
+    free(c);
+}
+/**
+ * This method marks a piece of a staged chunk as written.
+ *
+ * @param c
+ * @param rank
+ * @param offset first corner of the piece within the chunk
+ * @param count extent of the piece
+ */
+static void hermes_chunk_mark(HermesChunk *c, int rank, const hsize_t *offset, const hsize_t *count){
+    hsize_t pos[H5S_MAX_RANK];
+    int i;
+    for(i=0;i<rank;i++) pos[i]=0;
+    for(;;){
+        size_t first=0,k;
+        for(i=0;i<rank;i++) first=first*(size_t)c->count[i]+(size_t)(offset[i]+pos[i]);
+        for(k=first;k<first+(size_t)count[rank-1];k++){
+            unsigned char bit=(unsigned char)(1u<<(k&7));
+            if(!(c->written[k>>3]&bit)){
+                c->written[k>>3]|=bit;
+                c->covered++;
+            }
+        }
+        for(i=rank-2;i>=0;i--){
+            if(++pos[i]<count[i]) break;
+            pos[i]=0;
+        }
+        if(i<0) break;
+    }
+}
+/**
+ * This method drops staged chunks a write replaces altogether.
+ *
+ * @param lo first chunk coordinates of the block of chunks
+ * @param hi past the last chunk coordinates
+ */
+static void hermes_chunk_discard(HermesChunkStage *stage, const hsize_t *lo, const hsize_t *hi){
+    size_t b;
+    int i;
+    for(b=0;b<HERMES_CHUNK_BUCKETS && stage->nchunks;b++){
+        HermesChunk **slot=&stage->buckets[b];
+        while(*slot){
+            bool inside=true;
+            for(i=0;i<stage->rank && inside;i++){
+                hsize_t coord=(*slot)->start[i]/stage->chunk[i];
+                inside=coord>=lo[i] && coord<hi[i];
+            }
+            if(inside) hermes_chunk_drop(stage,slot);
+            else slot=&(*slot)->next;
+        }
+    }
+}
+/**
+ * This method copies a piece of a chunk into its staged copy. A chunk the
+ * piece completes goes down whole and leaves the stage.
+ */
+static herr_t hermes_chunk_put(HermesChunkStage *stage, HermesChunk **slot, size_t index, const hsize_t *start,
+                               const hsize_t *count, const hsize_t *offset, const hsize_t *piece_count,
+                               hsize_t *memory_start, hsize_t *memory_dim, void *buf,
+                               HermesSelectionOp write, void *write_data){
+    HermesChunk *c=*slot;
+    hsize_t chunk_start[H5S_MAX_RANK],chunk_end[H5S_MAX_RANK],chunk_count[H5S_MAX_RANK],zero[H5S_MAX_RANK];
+    herr_t output;
+    int i;
+    if(c==NULL){
+        c=(HermesChunk *)calloc(1,sizeof(HermesChunk));
+        if(c==NULL) return -1;
+        c->index=index;
+        c->elements=1;
+        for(i=0;i<stage->rank;i++){
+            c->start[i]=start[i];
+            c->count[i]=count[i];
+            c->elements*=(size_t)count[i];
+        }
+        c->data=(char *)malloc(c->elements*stage->elem_size);
+        c->written=(unsigned char *)calloc((c->elements+7)/8,1);
+        if(c->data==NULL || c->written==NULL){
+            free(c->data);
+            free(c->written);
+            free(c);
+            return -1;
+        }
+        *slot=c;
+        stage->staged+=c->elements*stage->elem_size;
+        stage->nchunks++;
+    }
+    H5VL_hermes_box_copy(stage->rank,stage->elem_size,piece_count,buf,memory_dim,memory_start,c->data,c->count,
+                         offset);
+    hermes_chunk_mark(c,stage->rank,offset,piece_count);
+    if(c->covered<c->elements || !hermes_chunk_final(stage,c->count)) return 0;
+    for(i=0;i<stage->rank;i++){
+        chunk_start[i]=c->start[i];
+        chunk_end[i]=c->start[i]+c->count[i]-1;
+        chunk_count[i]=c->count[i];
+        zero[i]=0;
+    }
+    H5VL_hermes_stats_event(HERMES_EVENT_CHUNK_COMPLETE);
+    output=write(write_data,chunk_start,chunk_end,zero,chunk_count,c->data);
+    hermes_chunk_drop(stage,slot);
+    return output;
+}
+/**
+ * This method writes a staged chunk out whole, completing it from the buffer
+ * layer, and drops it. The stage lock is held.
+ *
+ * @return non-negative on success; a chunk that failed stays staged
+ */
+static herr_t hermes_chunk_merge(HermesChunkStage *stage, HermesChunk *c, HermesSelectionOp read,
+                                 HermesSelectionOp write, void *op_data){
+    hsize_t chunk_start[H5S_MAX_RANK],chunk_end[H5S_MAX_RANK],chunk_count[H5S_MAX_RANK],zero[H5S_MAX_RANK];
+    char *merged=(char *)H5VL_hermes_arena_push(c->elements*stage->elem_size);
+    herr_t output;
+    size_t e;
+    int i;
+    if(merged==NULL) return -1;
+    for(i=0;i<stage->rank;i++){
+        chunk_start[i]=c->start[i];
+        chunk_end[i]=c->start[i]+c->count[i]-1;
+        chunk_count[i]=c->count[i];
+        zero[i]=0;
+    }
+    output=read(op_data,chunk_start,chunk_end,zero,chunk_count,merged);
+    if(output>=0){
+        for(e=0;e<c->elements;e++)
+            if(c->written[e>>3]&(1u<<(e&7)))
+                memcpy(merged+e*stage->elem_size,c->data+e*stage->elem_size,stage->elem_size);
+        H5VL_hermes_stats_event(HERMES_EVENT_CHUNK_MERGE);
+        output=write(op_data,chunk_start,chunk_end,zero,chunk_count,merged);
+    }
+    H5VL_hermes_arena_pop(merged);
+    if(output>=0) hermes_chunk_drop(stage,hermes_chunk_slot(stage,c->index));
+    return output;
+}
+/**
+ * This method lays a staged chunk out in the larger shape a grown edge
+ * clips it to, keeping what was written. The stage lock is held.
+ *
+ * @return non-negative on success; on failure the chunk is unchanged
+ */
+static herr_t hermes_chunk_reshape(HermesChunkStage *stage, HermesChunk *c, const hsize_t *count){
+    hsize_t zero[H5S_MAX_RANK];
+    size_t elements=1,e,k;
+    char *data;
+    unsigned char *written;
+    int i;
+    for(i=0;i<stage->rank;i++){
+        elements*=(size_t)count[i];
+        zero[i]=0;
+    }
+    data=(char *)malloc(elements*stage->elem_size);
+    written=(unsigned char *)calloc((elements+7)/8,1);
+    if(data==NULL || written==NULL){
+        free(data);
+        free(written);
+        return -1;
+    }
+    H5VL_hermes_box_copy(stage->rank,stage->elem_size,c->count,c->data,c->count,zero,data,count,zero);
+    for(e=0;e<c->elements;e++){
+        size_t rest=e,stride=1;
+        if(!(c->written[e>>3]&(1u<<(e&7)))) continue;
+        for(k=0,i=stage->rank-1;i>=0;i--){
+            k+=(rest%(size_t)c->count[i])*stride;
+            rest/=(size_t)c->count[i];
+            stride*=(size_t)count[i];
+        }
+        written[k>>3]|=(unsigned char)(1u<<(k&7));
+    }
+    stage->staged+=(elements-c->elements)*stage->elem_size;
+    free(c->data);
+    free(c->written);
+    c->data=data;
+    c->written=written;
+    c->elements=elements;
+    for(i=0;i<stage->rank;i++) c->count[i]=count[i];
+    return 0;
+}
+static int hermes_chunk_compare(const void *a, const void *b){
+    size_t x=(*(HermesChunk *const *)a)->index,y=(*(HermesChunk *const *)b)->index;
+    return x<y?-1:x>y;
+}
+
+/**
+ * This method creates the stage of a chunked dataset.
+ *
+ * @param rank
+ * @param dims extent of the dataset
+ * @param max_dims maximum extent of the dataset
+ * @param chunk_dims from H5Pget_chunk
+ * @param elem_size size of the elements written, i.e. of the native type
+ * @param capacity bytes of partial chunks held before
+ *        H5VL_hermes_chunk_over asks for a flush
+ * @return stage, or NULL
+ */
+HermesChunkStage *H5VL_hermes_chunk_create(int rank, const hsize_t *dims, const hsize_t *max_dims,
+                                           const hsize_t *chunk_dims, size_t elem_size, size_t capacity){
+    HermesChunkStage *stage;
+    int i;
+    if(rank<1 || rank>H5S_MAX_RANK || capacity==0) return NULL;
+    for(i=0;i<rank;i++) if(chunk_dims[i]==0) return NULL;
+    stage=(HermesChunkStage *)calloc(1,sizeof(HermesChunkStage));
+    if(stage==NULL) return NULL;
+    pthread_mutex_init(&stage->lock,NULL);
+    stage->rank=rank;
+    for(i=0;i<rank;i++){
+        stage->dims[i]=dims[i];
+        stage->max_dims[i]=max_dims[i];
+        stage->chunk[i]=chunk_dims[i];
+        stage->grid[i]=(dims[i]+chunk_dims[i]-1)/chunk_dims[i];
+    }
+    stage->elem_size=elem_size;
+    stage->capacity=capacity;
+    return stage;
+}
+/**
+ * This method frees a stage, dropping whatever it still holds; flush it
+ * first.
+ *
+ * @param stage
+ */
+void H5VL_hermes_chunk_free(HermesChunkStage *stage){
+    size_t b;
+    if(stage==NULL) return;
+    for(b=0;b<HERMES_CHUNK_BUCKETS;b++)
+        while(stage->buckets[b]) hermes_chunk_drop(stage,&stage->buckets[b]);
+    pthread_mutex_destroy(&stage->lock);
+    free(stage);
+}
+/**
+ * This method writes a box through the stage. It is a selection callback
+ * with write and write_data bound, and never reads anything, so it may run
+ * on the worker pool.
+ *
+ * @param stage
+ * @param file_start first corner of the box
+ * @param file_end last corner of the box
+ * @param memory_start where the box lives in buf
+ * @param memory_dim extent of the memory array
+ * @param buf memory array
+ * @param write takes boxes of whole chunks
+ * @param write_data passed through to write
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_chunk_write(HermesChunkStage *stage, hsize_t *file_start, hsize_t *file_end,
+                               hsize_t *memory_start, hsize_t *memory_dim, void *buf,
+                               HermesSelectionOp write, void *write_data){
+    hsize_t lo[H5S_MAX_RANK],hi[H5S_MAX_RANK],core_lo[H5S_MAX_RANK],core_hi[H5S_MAX_RANK],coord[H5S_MAX_RANK];
+    hsize_t start[H5S_MAX_RANK],count[H5S_MAX_RANK],piece_start[H5S_MAX_RANK],piece_end[H5S_MAX_RANK];
+    hsize_t piece_count[H5S_MAX_RANK],mem_start[H5S_MAX_RANK],offset[H5S_MAX_RANK];
+    herr_t output=0;
+    bool core=true;
+    int i,rank=stage->rank;
+    pthread_mutex_lock(&stage->lock);
+    for(i=0;i<rank;i++){
+        lo[i]=file_start[i]/stage->chunk[i];
+        hi[i]=file_end[i]/stage->chunk[i];
+        core_lo[i]=(file_start[i]+stage->chunk[i]-1)/stage->chunk[i];
+        core_hi[i]=file_end[i]+1==stage->dims[i] && stage->dims[i]>=stage->max_dims[i]?hi[i]+1:
+                   (file_end[i]+1)/stage->chunk[i];
+        if(core_lo[i]>=core_hi[i]) core=false;
+    }
+    if(core){
+        /* The whole chunks in the middle go down as one box. */
+        for(i=0;i<rank;i++){
+            piece_start[i]=core_lo[i]*stage->chunk[i];
+            piece_end[i]=core_hi[i]*stage->chunk[i];
+            if(piece_end[i]>stage->dims[i]) piece_end[i]=stage->dims[i];
+            piece_end[i]--;
+            mem_start[i]=memory_start[i]+piece_start[i]-file_start[i];
+        }
+        hermes_chunk_discard(stage,core_lo,core_hi);
+        output=write(write_data,piece_start,piece_end,mem_start,memory_dim,buf);
+    }
+    for(i=0;i<rank;i++) coord[i]=lo[i];
+    while(output>=0){
+        bool inside=core,whole=true;
+        for(i=0;i<rank && inside;i++) inside=coord[i]>=core_lo[i] && coord[i]<core_hi[i];
+        if(!inside){
+            size_t index=hermes_chunk_index(stage,coord);
+            HermesChunk **slot=hermes_chunk_slot(stage,index);
+            for(i=0;i<rank;i++){
+                start[i]=coord[i]*stage->chunk[i];
+                count[i]=stage->dims[i]-start[i]<stage->chunk[i]?stage->dims[i]-start[i]:stage->chunk[i];
+                piece_start[i]=file_start[i]>start[i]?file_start[i]:start[i];
+                piece_end[i]=file_end[i]<start[i]+count[i]-1?file_end[i]:start[i]+count[i]-1;
+                piece_count[i]=piece_end[i]-piece_start[i]+1;
+                mem_start[i]=memory_start[i]+piece_start[i]-file_start[i];
+                offset[i]=piece_start[i]-start[i];
+                if(piece_count[i]!=count[i]) whole=false;
+            }
+            if(whole && !hermes_chunk_final(stage,count)) whole=false;
+            if(whole){
+                if(*slot) hermes_chunk_drop(stage,slot);
+                output=write(write_data,piece_start,piece_end,mem_start,memory_dim,buf);
+            }else{
+                output=hermes_chunk_put(stage,slot,index,start,count,offset,piece_count,mem_start,memory_dim,buf,
+                                        write,write_data);
+            }
+        }
+        for(i=rank-1;i>=0;i--){
+            if(++coord[i]<=hi[i]) break;
+            coord[i]=lo[i];
+        }
+        if(i<0) break;
+    }
+    pthread_mutex_unlock(&stage->lock);
+    return output;
+}
+/**
+ * This method writes staged chunks out whole, in chunk order, completing
+ * each from the buffer layer. Reads flush the chunks they overlap, so they
+ * never see the buffer layer behind the stage.
+ *
+ * @param stage
+ * @param start first corner of the box whose chunks are flushed, NULL for
+ *        every chunk
+ * @param end last corner of the box
+ * @param read reads the elements a chunk lacks, in the staged type
+ * @param write takes the completed chunks
+ * @param op_data passed through to read and write
+ * @return non-negative on success; chunks that failed stay staged
+ */
+herr_t H5VL_hermes_chunk_flush(HermesChunkStage *stage, const hsize_t *start, const hsize_t *end,
+                               HermesSelectionOp read, HermesSelectionOp write, void *op_data){
+    HermesChunk **chunks;
+    herr_t output=0;
+    size_t b,n=0,k;
+    int i;
+    if(stage==NULL) return 0;
+    pthread_mutex_lock(&stage->lock);
+    if(stage->nchunks==0){
+        pthread_mutex_unlock(&stage->lock);
+        return 0;
+    }
+    chunks=(HermesChunk **)malloc(stage->nchunks*sizeof(HermesChunk *));
+    if(chunks==NULL){
+        pthread_mutex_unlock(&stage->lock);
+        return -1;
+    }
+    for(b=0;b<HERMES_CHUNK_BUCKETS;b++){
+        HermesChunk *c;
+        for(c=stage->buckets[b];c;c=c->next){
+            bool overlaps=true;
+            for(i=0;start && i<stage->rank && overlaps;i++)
+                overlaps=c->start[i]<=end[i] && start[i]<=c->start[i]+c->count[i]-1;
+            if(overlaps) chunks[n++]=c;
+        }
+    }
+    qsort(chunks,n,sizeof(HermesChunk *),hermes_chunk_compare);
+    for(k=0;k<n && output>=0;k++) output=hermes_chunk_merge(stage,chunks[k],read,write,op_data);
+    free(chunks);
+    pthread_mutex_unlock(&stage->lock);
+    return output;
+}
+/**
+ * This method follows a change of the dataset's extent. Staged chunks the
+ * new edge cuts are written out first, while the dataset still has the old
+ * extent; chunks the old edge cut and the new one no longer does are laid
+ * out in their larger shape, so appends keep filling them. All stay staged
+ * under their new number in the grid.
+ *
+ * @param stage
+ * @param dims new extent of the dataset
+ * @param read reads the elements a chunk lacks, in the staged type
+ * @param write takes the completed chunks
+ * @param op_data passed through to read and write
+ * @return non-negative on success; on failure the stage keeps the old extent
+ */
+herr_t H5VL_hermes_chunk_resize(HermesChunkStage *stage, const hsize_t *dims, HermesSelectionOp read,
+                                HermesSelectionOp write, void *op_data){
+    HermesChunk *list=NULL,*c;
+    hsize_t coord[H5S_MAX_RANK],count[H5S_MAX_RANK];
+    herr_t output=0;
+    size_t b;
+    int i;
+    if(stage==NULL) return 0;
+    pthread_mutex_lock(&stage->lock);
+    for(b=0;b<HERMES_CHUNK_BUCKETS && output>=0;b++){
+        HermesChunk *next;
+        for(c=stage->buckets[b];c && output>=0;c=next){
+            bool cut=false,grown=false;
+            next=c->next;
+            for(i=0;i<stage->rank && !cut;i++){
+                count[i]=dims[i]>c->start[i]?dims[i]-c->start[i]:0;
+                if(count[i]>stage->chunk[i]) count[i]=stage->chunk[i];
+                cut=count[i]<c->count[i];
+                if(count[i]>c->count[i]) grown=true;
+            }
+            if(!cut && grown) cut=hermes_chunk_reshape(stage,c,count)<0;
+            if(cut) output=hermes_chunk_merge(stage,c,read,write,op_data);
+        }
+    }
+    if(output<0){
+        pthread_mutex_unlock(&stage->lock);
+        return output;
+    }
+    for(b=0;b<HERMES_CHUNK_BUCKETS;b++){
+        while((c=stage->buckets[b])){
+            stage->buckets[b]=c->next;
+            c->next=list;
+            list=c;
+        }
+    }
+    for(i=0;i<stage->rank;i++){
+        stage->dims[i]=dims[i];
+        stage->grid[i]=(dims[i]+stage->chunk[i]-1)/stage->chunk[i];
+    }
+    while((c=list)){
+        HermesChunk **slot;
+        list=c->next;
+        for(i=0;i<stage->rank;i++) coord[i]=c->start[i]/stage->chunk[i];
+        c->index=hermes_chunk_index(stage,coord);
+        slot=&stage->buckets[c->index%HERMES_CHUNK_BUCKETS];
+        c->next=*slot;
+        *slot=c;
+    }
+    pthread_mutex_unlock(&stage->lock);
+    return 0;
+}
+/**
+ * This method tells whether a stage holds more than its capacity, in which
+ * case the application thread should flush it.
+ *
+ * @param stage
+ * @return true if over capacity
+ */
+bool H5VL_hermes_chunk_over(HermesChunkStage *stage){
+    bool over;
+    if(stage==NULL) return false;
+    pthread_mutex_lock(&stage->lock);
+    over=stage->staged>stage->capacity;
+    pthread_mutex_unlock(&stage->lock);
+    return over;
+}
@@ -0,0 +1,52 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_chunk.h
+*
+* Purpose:Defines chunk staging for chunked datasets. Writes reach the
+*         buffer layer as boxes of whole native chunks only, so that its
+*         sync writes complete chunks and HDF5 never has to read, modify
+*         and re-filter a partially written one. Pieces of chunks are held
+*         here until the chunk is complete or has to be flushed.
+*
+*-------------------------------------------------------------------------
+*/
+
+#ifndef HERMES_PROJECT_HERMES_VOL_CHUNK_H
+#define HERMES_PROJECT_HERMES_VOL_CHUNK_H
+#include <hdf5.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hermes_vol_selection.h"
+
+/* Partial chunks held per dataset when H5Pset_hermes_vol_chunk_staging is not called. */
+#define HERMES_CHUNK_DEFAULT_STAGE_BYTES (64*1024*1024)
+
+typedef struct HermesChunkStage HermesChunkStage;
+
+HermesChunkStage *H5VL_hermes_chunk_create(int rank, const hsize_t *dims, const hsize_t *max_dims,
+                                           const hsize_t *chunk_dims, size_t elem_size, size_t capacity);
+void H5VL_hermes_chunk_free(HermesChunkStage *stage);
+herr_t H5VL_hermes_chunk_write(HermesChunkStage *stage, hsize_t *file_start, hsize_t *file_end,
+                               hsize_t *memory_start, hsize_t *memory_dim, void *buf,
+                               HermesSelectionOp write, void *write_data);
+herr_t H5VL_hermes_chunk_flush(HermesChunkStage *stage, const hsize_t *start, const hsize_t *end,
+                               HermesSelectionOp read, HermesSelectionOp write, void *op_data);
+herr_t H5VL_hermes_chunk_resize(HermesChunkStage *stage, const hsize_t *dims, HermesSelectionOp read,
+                                HermesSelectionOp write, void *op_data);
+bool H5VL_hermes_chunk_over(HermesChunkStage *stage);
+#endif //HERMES_PROJECT_HERMES_VOL_CHUNK_H
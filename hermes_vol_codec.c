@@ -0,0 +1,353 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_codec.c
+*
+* Purpose:Implements the block codec. A coded extent is a table of 32-bit
+*         little-endian block sizes followed by the blocks; a block whose
+*         size equals its raw length did not compress and is stored as is.
+*         Within a block the coder writes LZ4-style sequences: a token of
+*         literal and match length nibbles, the literals, a 16-bit offset
+*         and the rest of the match length. The last sequence has no match.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hermes_vol_arena.h"
+#include "hermes_vol_async.h"
+#include "hermes_vol_codec.h"
+
+#define HERMES_LZ_HASH_BITS 12
+#define HERMES_LZ_MIN_MATCH 4
+
+/* One coding job, split over the worker pool a block at a time. */
+typedef struct HermesCodecJob {
+    const uint8_t *src;
+    uint8_t *dst;
+    size_t bytes;
+    size_t elem_size;
+    bool shuffle;
+    size_t nblocks;
+    uint32_t *sizes;
+    size_t *offsets;        /* of each coded block within dst */
+} HermesCodecJob;
+
+static uint32_t hermes_read32(const uint8_t *p){
+    uint32_t v;
+    memcpy(&v,p,sizeof(v));
+    return v;
+}
+static size_t hermes_block_bytes(const HermesCodecJob *job, size_t index){
+    size_t start=index*HERMES_CODEC_BLOCK;
+    return job->bytes-start<HERMES_CODEC_BLOCK?job->bytes-start:HERMES_CODEC_BLOCK;
+}
+/**
+ * This method gathers byte b of every element into plane b, so that the
+ * slowly changing exponent and high mantissa bytes of floating point data
+ * end up next to each other. Bytes past the last whole element stay put.
+ */
+static void hermes_shuffle(const uint8_t *src, uint8_t *dst, size_t bytes, size_t elem_size){
+    size_t n=bytes/elem_size,i,b;
+    for(b=0;b<elem_size;b++)
+        for(i=0;i<n;i++) dst[b*n+i]=src[i*elem_size+b];
+    memcpy(dst+n*elem_size,src+n*elem_size,bytes-n*elem_size);
+}
+static void hermes_unshuffle(const uint8_t *src, uint8_t *dst, size_t bytes, size_t elem_size){
+    size_t n=bytes/elem_size,i,b;
+    for(b=0;b<elem_size;b++)
+        for(i=0;i<n;i++) dst[i*elem_size+b]=src[b*n+i];
+    memcpy(dst+n*elem_size,src+n*elem_size,bytes-n*elem_size);
+}
+static uint8_t *hermes_lz_length(uint8_t *p, size_t rest){
+    while(rest>=255){
+        *p++=255;
+        rest-=255;
+    }
+    *p++=(uint8_t)rest;
+    return p;
+}
+/**
+ * This method writes one sequence.
+ *
+ * @param match length of the match, 0 for the last sequence
+ * @return false if it does not fit before end
+ */
+static bool hermes_lz_emit(uint8_t **out, const uint8_t *end, const uint8_t *literals, size_t nliterals,
+                           size_t offset, size_t match){
+    uint8_t *p=*out,*token;
+    size_t need=1+nliterals+nliterals/255+1+(match?2+match/255+1:0);
+    if((size_t)(end-p)<need) return false;
+    token=p++;
+    if(nliterals>=15){
+        *token=15<<4;
+        p=hermes_lz_length(p,nliterals-15);
+    }else *token=(uint8_t)(nliterals<<4);
+    memcpy(p,literals,nliterals);
+    p+=nliterals;
+    if(match){
+        match-=HERMES_LZ_MIN_MATCH;
+        *p++=(uint8_t)(offset&255);
+        *p++=(uint8_t)(offset>>8);
+        if(match>=15){
+            *token|=15;
+            p=hermes_lz_length(p,match-15);
+        }else *token|=(uint8_t)match;
+    }
+    *out=p;
+    return true;
+}
+/**
+ * This method codes one block of at most 64 KiB greedily, with a single
+ * candidate per hash bucket.
+ *
+ * @return coded size, 0 if it would take capacity bytes or more
+ */
+static size_t hermes_lz_compress(const uint8_t *src, size_t n, uint8_t *dst, size_t capacity){
+    int32_t table[1<<HERMES_LZ_HASH_BITS];
+    const uint8_t *end=dst+capacity;
+    uint8_t *op=dst;
+    size_t i=0,anchor=0;
+    memset(table,0xff,sizeof(table));
+    while(i+HERMES_LZ_MIN_MATCH<=n){
+        uint32_t v=hermes_read32(src+i);
+        uint32_t h=(v*2654435761u)>>(32-HERMES_LZ_HASH_BITS);
+        int32_t candidate=table[h];
+        size_t match;
+        table[h]=(int32_t)i;
+        if(candidate<0 || i-(size_t)candidate>0xffff || hermes_read32(src+candidate)!=v){
+            i++;
+            continue;
+        }
+        match=HERMES_LZ_MIN_MATCH;
+        while(i+match+sizeof(uint64_t)<=n){
+            uint64_t a,b;
+            memcpy(&a,src+candidate+match,sizeof(a));
+            memcpy(&b,src+i+match,sizeof(b));
+            if(a!=b){
+                match+=(size_t)__builtin_ctzll(a^b)/8;
+                break;
+            }
+            match+=sizeof(uint64_t);
+        }
+        if(i+match+sizeof(uint64_t)>n)
+            while(i+match<n && src[candidate+match]==src[i+match]) match++;
+        if(!hermes_lz_emit(&op,end,src+anchor,i-anchor,i-(size_t)candidate,match)) return 0;
+        i+=match;
+        anchor=i;
+    }
+    if(!hermes_lz_emit(&op,end,src+anchor,n-anchor,0,0) || op==end) return 0;
+    return (size_t)(op-dst);
+}
+static bool hermes_lz_length_read(const uint8_t *src, size_t n, size_t *ip, size_t *length){
+    uint8_t b;
+    do{
+        if(*ip>=n) return false;
+        b=src[(*ip)++];
+        *length+=b;
+    }while(b==255);
+    return true;
+}
+/**
+ * This method decodes one block, checking every length against both buffers.
+ *
+ * @return non-negative if the block decoded to exactly out_n bytes
+ */
+static herr_t hermes_lz_decompress(const uint8_t *src, size_t n, uint8_t *dst, size_t out_n){
+    size_t ip=0,op=0;
+    while(ip<n){
+        uint8_t token=src[ip++];
+        size_t literals=token>>4,match=(token&15)+HERMES_LZ_MIN_MATCH,offset;
+        if(literals==15 && !hermes_lz_length_read(src,n,&ip,&literals)) return -1;
+        if(literals>n-ip || literals>out_n-op) return -1;
+        memcpy(dst+op,src+ip,literals);
+        ip+=literals;
+        op+=literals;
+        if(ip==n) break;
+        if(n-ip<2) return -1;
+        offset=(size_t)src[ip]|((size_t)src[ip+1]<<8);
+        ip+=2;
+        if((token&15)==15 && !hermes_lz_length_read(src,n,&ip,&match)) return -1;
+        if(offset==0 || offset>op || match>out_n-op) return -1;
+        if(offset>=match) memcpy(dst+op,dst+op-offset,match);
+        else{
+            size_t k;
+            for(k=0;k<match;k++) dst[op+k]=dst[op-offset+k];
+        }
+        op+=match;
+    }
+    return op==out_n?0:-1;
+}
+static herr_t hermes_compress_block(void *arg, size_t index){
+    HermesCodecJob *job=(HermesCodecJob *)arg;
+    size_t length=hermes_block_bytes(job,index);
+    const uint8_t *src=job->src+index*HERMES_CODEC_BLOCK;
+    uint8_t *dst=job->dst+index*HERMES_CODEC_BLOCK;
+    uint8_t *shuffled=NULL;
+    size_t coded=0;
+    if(job->shuffle && job->elem_size>1){
+        shuffled=(uint8_t *)H5VL_hermes_arena_push(length);
+        if(shuffled) hermes_shuffle(src,shuffled,length,job->elem_size);
+    }
+    /* Without a shuffle buffer the block is simply stored. */
+    if(shuffled || !job->shuffle || job->elem_size<=1) coded=hermes_lz_compress(shuffled?shuffled:src,length,dst,length);
+    if(coded==0){
+        memcpy(dst,src,length);
+        coded=length;
+    }
+    job->sizes[index]=(uint32_t)coded;
+    H5VL_hermes_arena_pop(shuffled);
+    return 0;
+}
+static herr_t hermes_decompress_block(void *arg, size_t index){
+    HermesCodecJob *job=(HermesCodecJob *)arg;
+    size_t length=hermes_block_bytes(job,index);
+    const uint8_t *src=job->src+job->offsets[index];
+    uint8_t *dst=job->dst+index*HERMES_CODEC_BLOCK;
+    uint8_t *shuffled;
+    herr_t output;
+    if(job->sizes[index]==length){
+        memcpy(dst,src,length);
+        return 0;
+    }
+    if(!job->shuffle || job->elem_size<=1) return hermes_lz_decompress(src,job->sizes[index],dst,length);
+    shuffled=(uint8_t *)H5VL_hermes_arena_push(length);
+    if(shuffled==NULL) return -1;
+    output=hermes_lz_decompress(src,job->sizes[index],shuffled,length);
+    if(output>=0) hermes_unshuffle(shuffled,dst,length,job->elem_size);
+    H5VL_hermes_arena_pop(shuffled);
+    return output;
+}
+
+/**
+ * This method bounds the coded size of an extent.
+ *
+ * @param bytes
+ * @return bytes the destination of H5VL_hermes_codec_compress must hold
+ */
+size_t H5VL_hermes_codec_bound(size_t bytes){
+    size_t nblocks=(bytes+HERMES_CODEC_BLOCK-1)/HERMES_CODEC_BLOCK;
+    return nblocks*sizeof(uint32_t)+bytes;
+}
+/**
+ * This method runs fn over the blocks of job, on the caller alone when
+ * there is no pool to share them with.
+ *
+ * @param job
+ * @param workers size of the pool, 0 when async is not enabled
+ * @param fn hermes_compress_block or hermes_decompress_block
+ * @return the first error of fn, or 0
+ */
+static herr_t hermes_codec_run(HermesCodecJob *job, unsigned workers, HermesAsyncEach fn){
+    size_t i;
+    if(workers) return H5VL_hermes_async_parallel(workers,job->nblocks,fn,job);
+    for(i=0;i<job->nblocks;i++)
+        if(fn(job,i)<0) return -1;
+    return 0;
+}
+/**
+ * This method codes an extent, its blocks in parallel on the worker pool
+ * when async is enabled.
+ *
+ * @param src
+ * @param bytes size of src
+ * @param elem_size size of an element for the shuffle
+ * @param shuffle whether to shuffle bytes before coding, which pays off
+ *        for floating point and wide integers
+ * @param workers size of the pool, 0 to code on the caller
+ * @param dst H5VL_hermes_codec_bound(bytes) bytes
+ * @return coded size, 0 on failure
+ */
+size_t H5VL_hermes_codec_compress(const void *src, size_t bytes, size_t elem_size, bool shuffle, unsigned workers,
+                                  void *dst){
+    HermesCodecJob job;
+    uint8_t *out=(uint8_t *)dst;
+    size_t i,stored;
+    if(bytes==0) return 0;
+    memset(&job,0,sizeof(job));
+    job.src=(const uint8_t *)src;
+    job.bytes=bytes;
+    job.elem_size=elem_size;
+    job.shuffle=shuffle;
+    job.nblocks=(bytes+HERMES_CODEC_BLOCK-1)/HERMES_CODEC_BLOCK;
+    job.sizes=(uint32_t *)malloc(job.nblocks*sizeof(uint32_t));
+    job.dst=(uint8_t *)malloc(bytes);
+    if(job.sizes==NULL || job.dst==NULL ||
+       hermes_codec_run(&job,workers,hermes_compress_block)<0){
+        free(job.sizes);
+        free(job.dst);
+        return 0;
+    }
+    stored=job.nblocks*sizeof(uint32_t);
+    for(i=0;i<job.nblocks;i++){
+        uint32_t size=job.sizes[i];
+        out[i*4]=(uint8_t)size;
+        out[i*4+1]=(uint8_t)(size>>8);
+        out[i*4+2]=(uint8_t)(size>>16);
+        out[i*4+3]=(uint8_t)(size>>24);
+        memcpy(out+stored,job.dst+i*HERMES_CODEC_BLOCK,size);
+        stored+=size;
+    }
+    free(job.sizes);
+    free(job.dst);
+    return stored;
+}
+/**
+ * This method decodes an extent coded by H5VL_hermes_codec_compress with the
+ * same elem_size and shuffle.
+ *
+ * @param src
+ * @param stored coded size
+ * @param elem_size
+ * @param shuffle
+ * @param workers size of the pool, 0 to decode on the caller
+ * @param dst
+ * @param bytes size of the extent
+ * @return non-negative on success, negative if src is corrupt
+ */
+herr_t H5VL_hermes_codec_decompress(const void *src, size_t stored, size_t elem_size, bool shuffle, unsigned workers,
+                                    void *dst, size_t bytes){
+    HermesCodecJob job;
+    const uint8_t *in=(const uint8_t *)src;
+    herr_t output=-1;
+    size_t i,offset;
+    memset(&job,0,sizeof(job));
+    job.src=in;
+    job.dst=(uint8_t *)dst;
+    job.bytes=bytes;
+    job.elem_size=elem_size;
+    job.shuffle=shuffle;
+    job.nblocks=(bytes+HERMES_CODEC_BLOCK-1)/HERMES_CODEC_BLOCK;
+    offset=job.nblocks*sizeof(uint32_t);
+    if(stored<offset) return -1;
+    job.sizes=(uint32_t *)malloc(job.nblocks*sizeof(uint32_t));
+    job.offsets=(size_t *)malloc(job.nblocks*sizeof(size_t));
+    if(job.sizes && job.offsets){
+        for(i=0;i<job.nblocks;i++){
+            job.sizes[i]=(uint32_t)in[i*4]|(uint32_t)in[i*4+1]<<8|(uint32_t)in[i*4+2]<<16|(uint32_t)in[i*4+3]<<24;
+            job.offsets[i]=offset;
+            if(job.sizes[i]>hermes_block_bytes(&job,i) || job.sizes[i]>stored-offset) break;
+            offset+=job.sizes[i];
+        }
+        if(i==job.nblocks) output=hermes_codec_run(&job,workers,hermes_decompress_block);
+    }
+    free(job.sizes);
+    free(job.offsets);
+    return output;
+}
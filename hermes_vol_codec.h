@@ -0,0 +1,41 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_codec.h
+*
+* Purpose:Defines the block codec used by the demotion tier: a byte shuffle
+*         by element size followed by a fast LZ77 coder, run on independent
+*         blocks so that they can be coded in parallel.
+*
+*-------------------------------------------------------------------------
+*/
+
+#ifndef HERMES_PROJECT_HERMES_VOL_CODEC_H
+#define HERMES_PROJECT_HERMES_VOL_CODEC_H
+#include <hdf5.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Blocks are coded independently; offsets within a block fit 16 bits. */
+#define HERMES_CODEC_BLOCK (64*1024)
+
+size_t H5VL_hermes_codec_bound(size_t bytes);
+size_t H5VL_hermes_codec_compress(const void *src, size_t bytes, size_t elem_size, bool shuffle, unsigned workers,
+                                  void *dst);
+herr_t H5VL_hermes_codec_decompress(const void *src, size_t stored, size_t elem_size, bool shuffle, unsigned workers,
+                                    void *dst, size_t bytes);
+#endif //HERMES_PROJECT_HERMES_VOL_CODEC_H
@@ -0,0 +1,401 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_config.c
+*
+* Purpose:Implements the config file and the calibration of the demotion
+*         tier. A config file is a list of "key = value" lines; "#" starts
+*         a comment, and lines after "[pattern]" only apply on hosts whose
+*         name matches the glob pattern, so that one file serves several
+*         node types:
+*
+*             policy = arc
+*             ram = 2G
+*             [gpu*]
+*             demote_dir = /mnt/nvme
+*             demote = 200G
+*
+*         Calibration writes, syncs and reads back a scratch file on the
+*         device and times random 4 KiB reads with the page cache dropped.
+*         Results are cached per device, in the process and in a file in
+*         the measured directory, so a node measures once a week.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "hermes_vol_config.h"
+
+#define HERMES_CALIBRATE_BYTES (16*1024*1024)
+#define HERMES_CALIBRATE_BLOCK (1024*1024)
+#define HERMES_CALIBRATE_PROBES 64
+#define HERMES_CALIBRATE_PROBE_BYTES 4096
+#define HERMES_CALIBRATE_CACHE ".hermes-vol-calibration"
+#define HERMES_CALIBRATE_VERSION 1
+#define HERMES_CALIBRATE_MAX_AGE (7*24*3600)
+#define HERMES_CALIBRATE_DEVICES 8
+/* Extents span this many bandwidth-latency products, so a promotion is not
+ * dominated by its first access. */
+#define HERMES_CONFIG_EXTENT_LATENCIES 16
+#define HERMES_CONFIG_EXTENT_MIN (256*1024)
+#define HERMES_CONFIG_EXTENT_MAX (64*1024*1024)
+/* Devices answering faster than this are read in place through a mapping. */
+#define HERMES_CONFIG_MAP_LATENCY 100e-6
+/* Devices writing slower than this take coded extents. */
+#define HERMES_CONFIG_COMPRESS_BW 1e9
+
+typedef struct HermesDeviceProfile {
+    dev_t dev;
+    HermesTierProfile profile;
+} HermesDeviceProfile;
+
+static pthread_mutex_t hermes_calibrate_lock=PTHREAD_MUTEX_INITIALIZER;
+static HermesDeviceProfile hermes_devices[HERMES_CALIBRATE_DEVICES];
+static unsigned hermes_ndevices=0;
+
+static char *hermes_config_trim(char *s){
+    char *end;
+    while(*s==' ' || *s=='\t') s++;
+    end=s+strlen(s);
+    while(end>s && (end[-1]==' ' || end[-1]=='\t' || end[-1]=='\n' || end[-1]=='\r')) end--;
+    *end='\0';
+    return s;
+}
+/* Sizes take a binary K, M, G or T suffix, optionally followed by B or iB. */
+static bool hermes_config_size(const char *value, size_t *size){
+    char *end;
+    unsigned long long n;
+    errno=0;
+    n=strtoull(value,&end,10);
+    if(end==value || errno) return false;
+    switch(*end){
+        case 'k': case 'K': n<<=10; end++; break;
+        case 'm': case 'M': n<<=20; end++; break;
+        case 'g': case 'G': n<<=30; end++; break;
+        case 't': case 'T': n<<=40; end++; break;
+        default: break;
+    }
+    if(*end=='i') end++;
+    if(*end=='B' || *end=='b') end++;
+    if(*end) return false;
+    *size=(size_t)n;
+    return true;
+}
+/**
+ * This method reads an on/off setting.
+ *
+ * @return 1, 0, HERMES_CONFIG_AUTO, or -2 if value is none of them
+ */
+static int hermes_config_switch(const char *value){
+    if(!strcasecmp(value,"yes") || !strcasecmp(value,"on") || !strcasecmp(value,"true") || !strcmp(value,"1"))
+        return 1;
+    if(!strcasecmp(value,"no") || !strcasecmp(value,"off") || !strcasecmp(value,"false") || !strcmp(value,"0"))
+        return 0;
+    if(!strcasecmp(value,"auto")) return HERMES_CONFIG_AUTO;
+    return -2;
+}
+static bool hermes_config_path(const char *value, char *path){
+    if(strlen(value)>=HERMES_CONFIG_PATH_MAX) return false;
+    strcpy(path,value);
+    return true;
+}
+/**
+ * This method applies one setting.
+ *
+ * @return false if the key is unknown or the value does not fit it
+ */
+static bool hermes_config_set(HermesTierConfig *config, const char *key, const char *value){
+    int on;
+    size_t size;
+    if(!strcmp(key,"policy")){
+        if(!strcasecmp(value,"none")) config->policy=HERMES_PLACEMENT_NONE;
+        else if(!strcasecmp(value,"lru")) config->policy=HERMES_PLACEMENT_LRU;
+        else if(!strcasecmp(value,"lfu")) config->policy=HERMES_PLACEMENT_LFU;
+        else if(!strcasecmp(value,"arc")) config->policy=HERMES_PLACEMENT_ARC;
+        else return false;
+        return true;
+    }
+    if(!strcmp(key,"ram")) return hermes_config_size(value,&config->ram_bytes);
+    if(!strcmp(key,"extent")){
+        if(!strcasecmp(value,"auto")){
+            config->extent_bytes=HERMES_CONFIG_AUTO;
+            return true;
+        }
+        if(!hermes_config_size(value,&size)) return false;
+        config->extent_bytes=(long long)size;
+        return true;
+    }
+    if(!strcmp(key,"demote_dir")) return hermes_config_path(value,config->demote_dir);
+    if(!strcmp(key,"demote")) return hermes_config_size(value,&config->demote_bytes);
+    if(!strcmp(key,"persistent")) return hermes_config_path(value,config->persist_path);
+    on=hermes_config_switch(value);
+    if(on==-2) return false;
+    if(!strcmp(key,"mapped")) config->mapped=on;
+    else if(!strcmp(key,"compress")) config->compress=on;
+    else if(!strcmp(key,"shuffle") && on!=HERMES_CONFIG_AUTO) config->shuffle=on;
+    else if(!strcmp(key,"calibrate") && on!=HERMES_CONFIG_AUTO) config->calibrate=on;
+    else return false;
+    return true;
+}
+
+/**
+ * This method sets what a config file that says nothing gives: no
+ * placement, and calibration deciding extent size, mapping and coding once
+ * a demotion tier is described.
+ */
+static void hermes_config_defaults(HermesTierConfig *config){
+    memset(config,0,sizeof(HermesTierConfig));
+    config->policy=HERMES_PLACEMENT_NONE;
+    config->extent_bytes=HERMES_CONFIG_AUTO;
+    config->mapped=HERMES_CONFIG_AUTO;
+    config->compress=HERMES_CONFIG_AUTO;
+}
+/**
+ * This method reads a config file over config. Bad lines are reported on
+ * stderr and skipped.
+ */
+static herr_t hermes_config_load(const char *path, HermesTierConfig *config){
+    char host[256]="",line[HERMES_CONFIG_PATH_MAX+64];
+    unsigned number=0;
+    bool applies=true;
+    herr_t output=0;
+    FILE *file=fopen(path,"r");
+    if(file==NULL){
+        fprintf(stderr,"hermes_vol: cannot read config %s: %s\n",path,strerror(errno));
+        return -1;
+    }
+    gethostname(host,sizeof(host)-1);
+    while(fgets(line,sizeof(line),file)){
+        char *s=line,*hash=strchr(line,'#'),*equals;
+        number++;
+        if(hash) *hash='\0';
+        s=hermes_config_trim(s);
+        if(*s=='\0') continue;
+        if(*s=='['){
+            char *close=strchr(s,']');
+            if(close && close[1]=='\0'){
+                *close='\0';
+                applies=fnmatch(hermes_config_trim(s+1),host,0)==0;
+                continue;
+            }
+        }
+        equals=strchr(s,'=');
+        if(equals){
+            *equals='\0';
+            if(!applies) continue;
+            if(hermes_config_set(config,hermes_config_trim(s),hermes_config_trim(equals+1))) continue;
+        }
+        fprintf(stderr,"hermes_vol: %s:%u: bad setting\n",path,number);
+        output=-1;
+    }
+    fclose(file);
+    return output;
+}
+
+static double hermes_calibrate_now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (double)ts.tv_sec+(double)ts.tv_nsec*1e-9;
+}
+static herr_t hermes_calibrate_io(int fd, char *buf, size_t bytes, off_t offset, bool is_write){
+    size_t done=0;
+    while(done<bytes){
+        ssize_t n=is_write?pwrite(fd,buf+done,bytes-done,offset+(off_t)done)
+                          :pread(fd,buf+done,bytes-done,offset+(off_t)done);
+        if(n<0 && errno==EINTR) continue;
+        if(n<=0) return -1;
+        done+=(size_t)n;
+    }
+    return 0;
+}
+/**
+ * This method measures the device dir lives on with a scratch file that is
+ * unlinked as soon as it is created.
+ */
+static herr_t hermes_calibrate_measure(const char *dir, HermesTierProfile *profile){
+    char *path=(char *)malloc(strlen(dir)+64),*buf=(char *)malloc(HERMES_CALIBRATE_BLOCK);
+    uint64_t seed=88172645463325252ull;
+    double begin,elapsed;
+    herr_t output=-1;
+    size_t i;
+    int fd=-1;
+    if(path && buf){
+        sprintf(path,"%s/.hermes-vol-calibrate-%ld",dir,(long)getpid());
+        fd=open(path,O_RDWR|O_CREAT|O_TRUNC,0600);
+        if(fd>=0) unlink(path);
+    }
+    if(fd>=0){
+        /* Not zeros, which a file system may keep sparse or compress. */
+        for(i=0;i<HERMES_CALIBRATE_BLOCK;i++) buf[i]=(char)(i*2654435761u>>13);
+        output=0;
+        begin=hermes_calibrate_now();
+        for(i=0;i<HERMES_CALIBRATE_BYTES/HERMES_CALIBRATE_BLOCK && output>=0;i++)
+            output=hermes_calibrate_io(fd,buf,HERMES_CALIBRATE_BLOCK,(off_t)(i*HERMES_CALIBRATE_BLOCK),true);
+        if(output>=0 && fdatasync(fd)<0) output=-1;
+        elapsed=hermes_calibrate_now()-begin;
+        profile->write_bw=HERMES_CALIBRATE_BYTES/(elapsed>1e-9?elapsed:1e-9);
+        posix_fadvise(fd,0,0,POSIX_FADV_DONTNEED);
+        begin=hermes_calibrate_now();
+        for(i=0;i<HERMES_CALIBRATE_BYTES/HERMES_CALIBRATE_BLOCK && output>=0;i++)
+            output=hermes_calibrate_io(fd,buf,HERMES_CALIBRATE_BLOCK,(off_t)(i*HERMES_CALIBRATE_BLOCK),false);
+        elapsed=hermes_calibrate_now()-begin;
+        profile->read_bw=HERMES_CALIBRATE_BYTES/(elapsed>1e-9?elapsed:1e-9);
+        posix_fadvise(fd,0,0,POSIX_FADV_DONTNEED);
+        begin=hermes_calibrate_now();
+        for(i=0;i<HERMES_CALIBRATE_PROBES && output>=0;i++){
+            off_t offset;
+            seed^=seed<<13;
+            seed^=seed>>7;
+            seed^=seed<<17;
+            offset=(off_t)(seed%(HERMES_CALIBRATE_BYTES/HERMES_CALIBRATE_PROBE_BYTES))*HERMES_CALIBRATE_PROBE_BYTES;
+            output=hermes_calibrate_io(fd,buf,HERMES_CALIBRATE_PROBE_BYTES,offset,false);
+        }
+        profile->latency=(hermes_calibrate_now()-begin)/HERMES_CALIBRATE_PROBES;
+        close(fd);
+    }
+    free(path);
+    free(buf);
+    return output;
+}
+static char *hermes_calibrate_cache_path(const char *dir, const char *suffix){
+    char *path=(char *)malloc(strlen(dir)+strlen(HERMES_CALIBRATE_CACHE)+strlen(suffix)+2);
+    if(path) sprintf(path,"%s/%s%s",dir,HERMES_CALIBRATE_CACHE,suffix);
+    return path;
+}
+static bool hermes_calibrate_cache_read(const char *dir, dev_t dev, HermesTierProfile *profile){
+    char *path=hermes_calibrate_cache_path(dir,"");
+    FILE *file=path?fopen(path,"r"):NULL;
+    unsigned long long cached_dev=0;
+    long long stamp=0;
+    int version=0;
+    bool output=false;
+    if(file){
+        output=fscanf(file,"hermes-vol-calibration %d %llu %lld %lf %lf %lf",&version,&cached_dev,&stamp,
+                      &profile->read_bw,&profile->write_bw,&profile->latency)==6 &&
+               version==HERMES_CALIBRATE_VERSION && cached_dev==(unsigned long long)dev &&
+               time(NULL)-stamp<HERMES_CALIBRATE_MAX_AGE &&
+               profile->read_bw>0 && profile->write_bw>0 && profile->latency>0;
+        fclose(file);
+    }
+    free(path);
+    return output;
+}
+static void hermes_calibrate_cache_write(const char *dir, dev_t dev, const HermesTierProfile *profile){
+    char *tmp=hermes_calibrate_cache_path(dir,".tmp"),*path=hermes_calibrate_cache_path(dir,"");
+    FILE *file=tmp&&path?fopen(tmp,"w"):NULL;
+    if(file){
+        bool written=fprintf(file,"hermes-vol-calibration %d %llu %lld %.6e %.6e %.6e\n",HERMES_CALIBRATE_VERSION,
+                             (unsigned long long)dev,(long long)time(NULL),profile->read_bw,profile->write_bw,
+                             profile->latency)>0;
+        if(fclose(file)!=0) written=false;
+        /* Another node type sharing dir measures its own device; only the device id is trusted. */
+        if(!written || rename(tmp,path)<0) unlink(tmp);
+    }
+    free(tmp);
+    free(path);
+}
+
+/**
+ * This method settles what config leaves to calibration. Extents are sized
+ * to the device's bandwidth-latency product, a device with low latency is
+ * mapped, and a slow one takes coded extents. Without a profile, the
+ * defaults stand: default extents, no mapping, no coding.
+ */
+static void hermes_config_resolve(HermesTierConfig *config, const HermesTierProfile *profile){
+    if(config->extent_bytes==HERMES_CONFIG_AUTO){
+        config->extent_bytes=0;
+        if(profile){
+            double product=profile->latency*profile->read_bw*HERMES_CONFIG_EXTENT_LATENCIES;
+            long long bytes=HERMES_CONFIG_EXTENT_MIN;
+            while(bytes<product && bytes<HERMES_CONFIG_EXTENT_MAX) bytes*=2;
+            config->extent_bytes=bytes;
+        }
+    }
+    if(config->mapped==HERMES_CONFIG_AUTO)
+        config->mapped=profile && config->compress!=1 && profile->latency<HERMES_CONFIG_MAP_LATENCY;
+    if(config->compress==HERMES_CONFIG_AUTO)
+        config->compress=profile && !config->mapped && profile->write_bw<HERMES_CONFIG_COMPRESS_BW;
+}
+
+/**
+ * This method finds the performance of the device dir lives on, measuring
+ * it if neither this process nor a recent run on this node has.
+ *
+ * @param dir directory on the device
+ * @param profile filled on success
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_calibrate(const char *dir, HermesTierProfile *profile){
+    struct stat st;
+    unsigned i;
+    if(dir==NULL || stat(dir,&st)<0 || !S_ISDIR(st.st_mode)) return -1;
+    /* Held while measuring, so that threads setting up fapls measure once. */
+    pthread_mutex_lock(&hermes_calibrate_lock);
+    for(i=0;i<hermes_ndevices;i++){
+        if(hermes_devices[i].dev==st.st_dev){
+            *profile=hermes_devices[i].profile;
+            pthread_mutex_unlock(&hermes_calibrate_lock);
+            return 0;
+        }
+    }
+    if(!hermes_calibrate_cache_read(dir,st.st_dev,profile)){
+        if(hermes_calibrate_measure(dir,profile)<0){
+            pthread_mutex_unlock(&hermes_calibrate_lock);
+            return -1;
+        }
+        hermes_calibrate_cache_write(dir,st.st_dev,profile);
+    }
+    if(hermes_ndevices<HERMES_CALIBRATE_DEVICES){
+        hermes_devices[hermes_ndevices].dev=st.st_dev;
+        hermes_devices[hermes_ndevices].profile=*profile;
+        hermes_ndevices++;
+    }
+    pthread_mutex_unlock(&hermes_calibrate_lock);
+    return 0;
+}
+/**
+ * This method reads a config file and settles what it leaves to "auto",
+ * measuring the demotion tier's device if needed.
+ *
+ * @param path config file
+ * @param config filled; usable even on failure, from the good lines
+ * @return non-negative if the file was read without a bad line
+ */
+herr_t H5VL_hermes_config_read(const char *path, HermesTierConfig *config){
+    HermesTierProfile profile;
+    bool measured=false;
+    herr_t output;
+    hermes_config_defaults(config);
+    output=hermes_config_load(path,config);
+    if(config->demote_dir[0] && config->demote_bytes &&
+       (config->calibrate || config->extent_bytes==HERMES_CONFIG_AUTO || config->mapped==HERMES_CONFIG_AUTO ||
+        config->compress==HERMES_CONFIG_AUTO))
+        measured=H5VL_hermes_calibrate(config->demote_dir,&profile)>=0;
+    hermes_config_resolve(config,measured?&profile:NULL);
+    return output;
+}
@@ -0,0 +1,69 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_config.h
+*
+* Purpose:Defines the runtime configuration of the tiers the VOL manages:
+*         a config file, picked by the environment or per fapl, describing
+*         the RAM and demotion tiers, and the calibration that measures the
+*         demotion tier's device to settle what the file leaves to "auto".
+*
+*-------------------------------------------------------------------------
+*/
+
+#ifndef HERMES_PROJECT_HERMES_VOL_CONFIG_H
+#define HERMES_PROJECT_HERMES_VOL_CONFIG_H
+#include <hdf5.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hermes_vol_placement.h"
+
+/* Names the config file applied to every fapl set up by H5Pset_fapl_hermes_vol. */
+#define HERMES_CONFIG_ENV "HERMES_VOL_CONFIG"
+#define HERMES_CONFIG_PATH_MAX 4096
+/* Settings a config file may leave to calibration. */
+#define HERMES_CONFIG_AUTO (-1)
+
+/**
+ * Tiers as described by a config file. Paths are empty when not given.
+ */
+typedef struct HermesTierConfig {
+    HermesPlacementKind policy;
+    size_t ram_bytes;
+    long long extent_bytes;     /* HERMES_CONFIG_AUTO, or 0 for the default */
+    char demote_dir[HERMES_CONFIG_PATH_MAX];
+    size_t demote_bytes;
+    int mapped;                 /* 0, 1 or HERMES_CONFIG_AUTO */
+    int compress;               /* 0, 1 or HERMES_CONFIG_AUTO */
+    bool shuffle;
+    char persist_path[HERMES_CONFIG_PATH_MAX];
+    bool calibrate;             /* measure the device even if nothing is auto */
+} HermesTierConfig;
+
+/**
+ * Measured performance of the device a directory lives on.
+ */
+typedef struct HermesTierProfile {
+    double read_bw;             /* bytes per second, uncached sequential reads */
+    double write_bw;            /* bytes per second, synced sequential writes */
+    double latency;             /* seconds per uncached 4 KiB random read */
+} HermesTierProfile;
+
+herr_t H5VL_hermes_calibrate(const char *dir, HermesTierProfile *profile);
+herr_t H5VL_hermes_config_read(const char *path, HermesTierConfig *config);
+#endif //HERMES_PROJECT_HERMES_VOL_CONFIG_H
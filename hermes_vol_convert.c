@@ -0,0 +1,298 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_convert.c
+*
+* Purpose:Implements the conversion kernels. Byte swaps use SSSE3 or AVX2
+*         shuffles when compiled for them. Numeric conversions go through
+*         fixed-size blocks on the stack, so that they are safe in place and
+*         the inner loops have a constant trip count and no aliasing, which
+*         the compiler vectorizes even at -O2; out of range values saturate
+*         and NaN becomes 0 like the HDF5 hard conversions.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <float.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+#include "hermes_vol_convert.h"
+
+/* Elements converted per block of a numeric kernel. */
+#define HERMES_CONVERT_BLOCK 256
+
+/* name, C type, kind, lowest value, highest value */
+#define HERMES_NUMBERS(X, ...) \
+    X(I8,int8_t,SI,INT8_MIN,INT8_MAX,__VA_ARGS__) \
+    X(U8,uint8_t,UI,0,UINT8_MAX,__VA_ARGS__) \
+    X(I16,int16_t,SI,INT16_MIN,INT16_MAX,__VA_ARGS__) \
+    X(U16,uint16_t,UI,0,UINT16_MAX,__VA_ARGS__) \
+    X(I32,int32_t,SI,INT32_MIN,INT32_MAX,__VA_ARGS__) \
+    X(U32,uint32_t,UI,0,UINT32_MAX,__VA_ARGS__) \
+    X(I64,int64_t,SI,INT64_MIN,INT64_MAX,__VA_ARGS__) \
+    X(U64,uint64_t,UI,0,UINT64_MAX,__VA_ARGS__) \
+    X(F32,float,FL,-FLT_MAX,FLT_MAX,__VA_ARGS__) \
+    X(F64,double,FL,-DBL_MAX,DBL_MAX,__VA_ARGS__)
+#define HERMES_NUMBERS_INNER(X, ...) \
+    X(I8,int8_t,SI,INT8_MIN,INT8_MAX,__VA_ARGS__) \
+    X(U8,uint8_t,UI,0,UINT8_MAX,__VA_ARGS__) \
+    X(I16,int16_t,SI,INT16_MIN,INT16_MAX,__VA_ARGS__) \
+    X(U16,uint16_t,UI,0,UINT16_MAX,__VA_ARGS__) \
+    X(I32,int32_t,SI,INT32_MIN,INT32_MAX,__VA_ARGS__) \
+    X(U32,uint32_t,UI,0,UINT32_MAX,__VA_ARGS__) \
+    X(I64,int64_t,SI,INT64_MIN,INT64_MAX,__VA_ARGS__) \
+    X(U64,uint64_t,UI,0,UINT64_MAX,__VA_ARGS__) \
+    X(F32,float,FL,-FLT_MAX,FLT_MAX,__VA_ARGS__) \
+    X(F64,double,FL,-DBL_MAX,DBL_MAX,__VA_ARGS__)
+
+#define HERMES_NUMBER_ENUM(N, T, K, LO, HI, ...) HERMES_NUMBER_##N,
+typedef enum HermesNumber {
+    HERMES_NUMBERS(HERMES_NUMBER_ENUM,_)
+    HERMES_NUMBER_COUNT
+} HermesNumber;
+
+/* One value v of the source kind into the destination type D of range LO..HI. */
+#define HERMES_CVT_SI_SI(v, D, LO, HI) ((v)<(LO)?(D)(LO):(v)>(HI)?(D)(HI):(D)(v))
+#define HERMES_CVT_SI_UI(v, D, LO, HI) ((v)<0?(D)0:(uint64_t)(v)>(uint64_t)(HI)?(D)(HI):(D)(v))
+#define HERMES_CVT_UI_SI(v, D, LO, HI) ((uint64_t)(v)>(uint64_t)(HI)?(D)(HI):(D)(v))
+#define HERMES_CVT_UI_UI(v, D, LO, HI) ((v)>(HI)?(D)(HI):(D)(v))
+#define HERMES_CVT_SI_FL(v, D, LO, HI) ((D)(v))
+#define HERMES_CVT_UI_FL(v, D, LO, HI) ((D)(v))
+#define HERMES_CVT_FL_FL(v, D, LO, HI) ((D)(v))
+#define HERMES_CVT_FL_SI(v, D, LO, HI) ((v)!=(v)?(D)0:(v)<=(LO)?(D)(LO):(v)>=(HI)?(D)(HI):(D)(v))
+#define HERMES_CVT_FL_UI(v, D, LO, HI) ((v)!=(v)?(D)0:(v)<=0?(D)0:(v)>=(HI)?(D)(HI):(D)(v))
+
+/*
+ * A widening kernel walks the buffer from the end and a narrowing one from
+ * the start, so no block overwrites source elements not yet converted.
+ */
+#define HERMES_KERNEL(DN, DT, DK, DLO, DHI, SN, ST, SK, SLO, SHI) \
+static void hermes_convert_##SN##_##DN(void *buf, size_t n){ \
+    ST src[HERMES_CONVERT_BLOCK]; \
+    DT dst[HERMES_CONVERT_BLOCK]; \
+    size_t done,first,m,k; \
+    for(done=0;done<n;done+=m){ \
+        m=n-done<HERMES_CONVERT_BLOCK?n-done:HERMES_CONVERT_BLOCK; \
+        first=sizeof(DT)>sizeof(ST)?n-done-m:done; \
+        memcpy(src,(char *)buf+first*sizeof(ST),m*sizeof(ST)); \
+        if(m<HERMES_CONVERT_BLOCK) memset(src+m,0,(HERMES_CONVERT_BLOCK-m)*sizeof(ST)); \
+        for(k=0;k<HERMES_CONVERT_BLOCK;k++) dst[k]=HERMES_CVT_##SK##_##DK(src[k],DT,DLO,DHI); \
+        memcpy((char *)buf+first*sizeof(DT),dst,m*sizeof(DT)); \
+    } \
+}
+#define HERMES_KERNELS_FROM(SN, ST, SK, SLO, SHI, ...) HERMES_NUMBERS_INNER(HERMES_KERNEL,SN,ST,SK,SLO,SHI)
+HERMES_NUMBERS(HERMES_KERNELS_FROM,_)
+
+#define HERMES_KERNEL_ENTRY(DN, DT, DK, DLO, DHI, SN) \
+    [HERMES_NUMBER_##SN][HERMES_NUMBER_##DN]=hermes_convert_##SN##_##DN,
+#define HERMES_KERNEL_ROW(SN, ST, SK, SLO, SHI, ...) HERMES_NUMBERS_INNER(HERMES_KERNEL_ENTRY,SN)
+static const HermesConvertKernel hermes_kernels[HERMES_NUMBER_COUNT][HERMES_NUMBER_COUNT]={
+    HERMES_NUMBERS(HERMES_KERNEL_ROW,_)
+};
+
+static void hermes_swap2(void *buf, size_t n){
+    uint8_t *p=(uint8_t *)buf;
+    size_t i=0;
+#if defined(__AVX2__)
+    const __m256i order=_mm256_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14,
+                                         1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+    for(;i+16<=n;i+=16){
+        __m256i v=_mm256_loadu_si256((const __m256i *)(p+i*2));
+        _mm256_storeu_si256((__m256i *)(p+i*2),_mm256_shuffle_epi8(v,order));
+    }
+#elif defined(__SSSE3__)
+    const __m128i order=_mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+    for(;i+8<=n;i+=8){
+        __m128i v=_mm_loadu_si128((const __m128i *)(p+i*2));
+        _mm_storeu_si128((__m128i *)(p+i*2),_mm_shuffle_epi8(v,order));
+    }
+#endif
+    for(;i<n;i++){
+        uint16_t v;
+        memcpy(&v,p+i*2,2);
+        v=__builtin_bswap16(v);
+        memcpy(p+i*2,&v,2);
+    }
+}
+static void hermes_swap4(void *buf, size_t n){
+    uint8_t *p=(uint8_t *)buf;
+    size_t i=0;
+#if defined(__AVX2__)
+    const __m256i order=_mm256_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,
+                                         3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12);
+    for(;i+8<=n;i+=8){
+        __m256i v=_mm256_loadu_si256((const __m256i *)(p+i*4));
+        _mm256_storeu_si256((__m256i *)(p+i*4),_mm256_shuffle_epi8(v,order));
+    }
+#elif defined(__SSSE3__)
+    const __m128i order=_mm_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12);
+    for(;i+4<=n;i+=4){
+        __m128i v=_mm_loadu_si128((const __m128i *)(p+i*4));
+        _mm_storeu_si128((__m128i *)(p+i*4),_mm_shuffle_epi8(v,order));
+    }
+#endif
+    for(;i<n;i++){
+        uint32_t v;
+        memcpy(&v,p+i*4,4);
+        v=__builtin_bswap32(v);
+        memcpy(p+i*4,&v,4);
+    }
+}
+static void hermes_swap8(void *buf, size_t n){
+    uint8_t *p=(uint8_t *)buf;
+    size_t i=0;
+#if defined(__AVX2__)
+    const __m256i order=_mm256_setr_epi8(7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8,
+                                         7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
+    for(;i+4<=n;i+=4){
+        __m256i v=_mm256_loadu_si256((const __m256i *)(p+i*8));
+        _mm256_storeu_si256((__m256i *)(p+i*8),_mm256_shuffle_epi8(v,order));
+    }
+#elif defined(__SSSE3__)
+    const __m128i order=_mm_setr_epi8(7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
+    for(;i+2<=n;i+=2){
+        __m128i v=_mm_loadu_si128((const __m128i *)(p+i*8));
+        _mm_storeu_si128((__m128i *)(p+i*8),_mm_shuffle_epi8(v,order));
+    }
+#endif
+    for(;i<n;i++){
+        uint64_t v;
+        memcpy(&v,p+i*8,8);
+        v=__builtin_bswap64(v);
+        memcpy(p+i*8,&v,8);
+    }
+}
+
+/**
+ * This method finds the native number a type is, if any.
+ *
+ * @return HERMES_NUMBER_COUNT when the type is none of them
+ */
+static HermesNumber hermes_number(hid_t type_id){
+    hid_t natives[HERMES_NUMBER_COUNT];
+    int i;
+    H5T_class_t type_class=H5Tget_class(type_id);
+    if(type_class!=H5T_INTEGER && type_class!=H5T_FLOAT) return HERMES_NUMBER_COUNT;
+    natives[HERMES_NUMBER_I8]=H5T_NATIVE_INT8;
+    natives[HERMES_NUMBER_U8]=H5T_NATIVE_UINT8;
+    natives[HERMES_NUMBER_I16]=H5T_NATIVE_INT16;
+    natives[HERMES_NUMBER_U16]=H5T_NATIVE_UINT16;
+    natives[HERMES_NUMBER_I32]=H5T_NATIVE_INT32;
+    natives[HERMES_NUMBER_U32]=H5T_NATIVE_UINT32;
+    natives[HERMES_NUMBER_I64]=H5T_NATIVE_INT64;
+    natives[HERMES_NUMBER_U64]=H5T_NATIVE_UINT64;
+    natives[HERMES_NUMBER_F32]=H5T_NATIVE_FLOAT;
+    natives[HERMES_NUMBER_F64]=H5T_NATIVE_DOUBLE;
+    for(i=0;i<HERMES_NUMBER_COUNT;i++) if(H5Tequal(type_id,natives[i])>0) return (HermesNumber)i;
+    return HERMES_NUMBER_COUNT;
+}
+/**
+ * This method tells whether dst is src with its bytes reversed.
+ */
+static HermesConvertKernel hermes_swap_kernel(hid_t src_type_id, hid_t dst_type_id, size_t size){
+    H5T_class_t type_class=H5Tget_class(src_type_id);
+    H5T_order_t src_order=H5Tget_order(src_type_id),dst_order=H5Tget_order(dst_type_id);
+    HermesConvertKernel kernel=NULL;
+    hid_t swapped;
+    if(type_class!=H5T_INTEGER && type_class!=H5T_FLOAT) return NULL;
+    if(H5Tget_class(dst_type_id)!=type_class || H5Tget_size(dst_type_id)!=size) return NULL;
+    if(src_order==dst_order || (src_order!=H5T_ORDER_LE && src_order!=H5T_ORDER_BE) ||
+       (dst_order!=H5T_ORDER_LE && dst_order!=H5T_ORDER_BE))
+        return NULL;
+    swapped=H5Tcopy(src_type_id);
+    if(swapped<0) return NULL;
+    if(H5Tset_order(swapped,dst_order)>=0 && H5Tequal(swapped,dst_type_id)>0){
+        switch(size){
+            case 2: kernel=hermes_swap2; break;
+            case 4: kernel=hermes_swap4; break;
+            case 8: kernel=hermes_swap8; break;
+            default: break;
+        }
+    }
+    H5Tclose(swapped);
+    return kernel;
+}
+
+/**
+ * This method works out how to convert elements of src_type_id into
+ * dst_type_id, preferring a kernel of this file over H5Tconvert.
+ *
+ * @param src_type_id
+ * @param dst_type_id
+ * @param conv filled in
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_convert_plan(hid_t src_type_id, hid_t dst_type_id, HermesConversion *conv){
+    HermesNumber src,dst;
+    conv->kind=HERMES_CONVERT_NONE;
+    conv->kernel=NULL;
+    conv->src_type_id=src_type_id;
+    conv->dst_type_id=dst_type_id;
+    conv->src_size=H5Tget_size(src_type_id);
+    conv->dst_size=H5Tget_size(dst_type_id);
+    if(conv->src_size==0 || conv->dst_size==0) return -1;
+    if(src_type_id==dst_type_id || H5Tequal(src_type_id,dst_type_id)>0) return 0;
+    conv->kernel=hermes_swap_kernel(src_type_id,dst_type_id,conv->src_size);
+    if(conv->kernel){
+        conv->kind=HERMES_CONVERT_SWAP;
+        return 0;
+    }
+    src=hermes_number(src_type_id);
+    dst=hermes_number(dst_type_id);
+    if(src<HERMES_NUMBER_COUNT && dst<HERMES_NUMBER_COUNT){
+        conv->kind=HERMES_CONVERT_NUMERIC;
+        conv->kernel=hermes_kernels[src][dst];
+        return 0;
+    }
+    conv->kind=HERMES_CONVERT_GENERIC;
+    return 0;
+}
+/**
+ * This method converts n elements in place.
+ *
+ * @param conv
+ * @param buf holds n source elements and room for n destination ones
+ * @param n
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_convert(const HermesConversion *conv, void *buf, size_t n){
+    void *bkg=NULL;
+    herr_t output;
+    if(conv->kind==HERMES_CONVERT_NONE || n==0) return 0;
+    if(conv->kernel){
+        conv->kernel(buf,n);
+        return 0;
+    }
+    /* Compound members missing from the source are left zero. */
+    if(H5Tget_class(conv->dst_type_id)==H5T_COMPOUND){
+        bkg=calloc(n,conv->dst_size);
+        if(bkg==NULL) return -1;
+    }
+    output=H5Tconvert(conv->src_type_id,conv->dst_type_id,n,buf,bkg,H5P_DEFAULT);
+    free(bkg);
+    return output;
+}
+/**
+ * This method sizes a buffer for converting n elements in place.
+ */
+size_t H5VL_hermes_convert_bytes(const HermesConversion *conv, size_t n){
+    return n*(conv->src_size>conv->dst_size?conv->src_size:conv->dst_size);
+}
@@ -0,0 +1,60 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_convert.h
+*
+* Purpose:Defines the datatype conversions run at the edges of the VOL:
+*         between the memory type of a read or write and the native type
+*         cached by the tiers, and between that and the file type held by
+*         the buffer layer.
+*
+*-------------------------------------------------------------------------
+*/
+
+#ifndef HERMES_PROJECT_HERMES_VOL_CONVERT_H
+#define HERMES_PROJECT_HERMES_VOL_CONVERT_H
+#include <hdf5.h>
+#include <stddef.h>
+
+typedef enum HermesConvertKind {
+    HERMES_CONVERT_NONE,        /* the types are the same                          */
+    HERMES_CONVERT_SWAP,        /* the same number in the other byte order         */
+    HERMES_CONVERT_NUMERIC,     /* between native integers and floating point      */
+    HERMES_CONVERT_GENERIC      /* anything else, left to H5Tconvert               */
+} HermesConvertKind;
+
+/* Converts n elements in place; buf holds n of the larger of the two types. */
+typedef void (*HermesConvertKernel)(void *buf, size_t n);
+
+/**
+ * How to convert elements of one type into another. Kernels of _SWAP and
+ * _NUMERIC make no HDF5 calls, so they may run on the worker pool; _GENERIC
+ * must stay on the application thread.
+ */
+typedef struct HermesConversion {
+    HermesConvertKind kind;
+    HermesConvertKernel kernel;
+    hid_t src_type_id;      /* not owned; must outlive the conversion */
+    hid_t dst_type_id;
+    size_t src_size;
+    size_t dst_size;
+} HermesConversion;
+
+herr_t H5VL_hermes_convert_plan(hid_t src_type_id, hid_t dst_type_id, HermesConversion *conv);
+herr_t H5VL_hermes_convert(const HermesConversion *conv, void *buf, size_t n);
+size_t H5VL_hermes_convert_bytes(const HermesConversion *conv, size_t n);
+#endif //HERMES_PROJECT_HERMES_VOL_CONVERT_H
@@ -0,0 +1,331 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_flusher.c
+*
+* Purpose:Implements the write-behind flusher. Flushes go through HDF5, which
+*         may not be entered from a second thread while the application is
+*         inside the library, so they are run at the flush points the VOL
+*         callbacks offer rather than from a thread of their own.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hermes_vol_flusher.h"
+#include "hermes_vol_stats.h"
+
+static pthread_mutex_t hermes_flusher_lock=PTHREAD_MUTEX_INITIALIZER;
+/* Signalled when a flush of a dataset returns. */
+static pthread_cond_t hermes_flusher_done=PTHREAD_COND_INITIALIZER;
+static HermesDirtyState *hermes_flusher_head=NULL;
+/* Token bucket shared by all size-triggered flushes. */
+static double hermes_flusher_budget=0;
+static double hermes_flusher_refill=0;
+/* Set while a flush runs, so a flush point reached from inside it is a no-op. */
+static bool hermes_flusher_busy=false;
+
+double H5VL_hermes_now(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return (double)now.tv_sec+(double)now.tv_nsec*1e-9;
+}
+/**
+ * This method adds an open dataset to the flusher.
+ *
+ * @param state dirty bookkeeping embedded in the dataset
+ * @param policy thresholds the dataset is flushed at
+ * @param flush drains the dataset; called with owner
+ * @param owner the dataset
+ * @param file name of the dataset's file, kept until unregistered
+ */
+void H5VL_hermes_flusher_register(HermesDirtyState *state, const HermesFlushPolicy *policy,
+                                  HermesFlushFn flush, void *owner, const char *file){
+    state->policy=*policy;
+    state->flush=flush;
+    state->owner=owner;
+    state->file=file;
+    memset(&state->map,0,sizeof(state->map));
+    state->dirty_bytes=0;
+    state->dirty_since=0;
+    state->flushing=0;
+    pthread_mutex_lock(&hermes_flusher_lock);
+    state->prev=NULL;
+    state->next=hermes_flusher_head;
+    if(hermes_flusher_head) hermes_flusher_head->prev=state;
+    hermes_flusher_head=state;
+    state->registered=true;
+    pthread_mutex_unlock(&hermes_flusher_lock);
+}
+/**
+ * This method takes a dataset out of the flusher. Once unlinked no flush
+ * picks it; one another thread already started is waited for, since the
+ * dataset is freed after this returns.
+ *
+ * @param state
+ */
+void H5VL_hermes_flusher_unregister(HermesDirtyState *state){
+    pthread_mutex_lock(&hermes_flusher_lock);
+    if(state->registered){
+        if(state->prev) state->prev->next=state->next;
+        else hermes_flusher_head=state->next;
+        if(state->next) state->next->prev=state->prev;
+        state->registered=false;
+    }
+    while(state->flushing) pthread_cond_wait(&hermes_flusher_done,&hermes_flusher_lock);
+    pthread_mutex_unlock(&hermes_flusher_lock);
+}
+/* Ends a flush of state started under the lock. */
+static void hermes_flusher_done_with(HermesDirtyState *state){
+    pthread_mutex_lock(&hermes_flusher_lock);
+    if(--state->flushing==0) pthread_cond_broadcast(&hermes_flusher_done);
+    pthread_mutex_unlock(&hermes_flusher_lock);
+}
+/**
+ * This method frees the dirty map, once the final drain after
+ * H5VL_hermes_flusher_unregister has run.
+ *
+ * @param state
+ */
+void H5VL_hermes_flusher_untrack(HermesDirtyState *state){
+    free(state->map.bits);
+    memset(&state->map,0,sizeof(state->map));
+}
+static void hermes_dirty_set(HermesDirtyMap *map, size_t slab){
+    uint64_t bit=(uint64_t)1<<(slab%64);
+    if(map->bits[slab/64]&bit) return;
+    map->bits[slab/64]|=bit;
+    map->ndirty++;
+}
+/**
+ * This method sizes the dirty map of a dataset to its extent, in slabs of
+ * about HERMES_DIRTY_SLAB bytes made of a multiple of align rows, so that a
+ * chunked dataset is flushed in whole rows of chunks. Slabs already dirty
+ * stay dirty as long as the slab shape does not change; otherwise the whole
+ * dataset counts as dirty.
+ *
+ * @param state
+ * @param rank
+ * @param dims current extent
+ * @param elem_size
+ * @param align rows a slab must be a multiple of, 0 or 1 for any
+ */
+void H5VL_hermes_flusher_track(HermesDirtyState *state, int rank, const hsize_t *dims, size_t elem_size,
+                               hsize_t align){
+    size_t row_bytes=elem_size,nslabs=0,words,slab;
+    hsize_t rows=0;
+    uint64_t *bits=NULL;
+    int i;
+    if(rank>0){
+        for(i=1;i<rank;i++) row_bytes*=(size_t)dims[i];
+        rows=row_bytes?(hsize_t)(HERMES_DIRTY_SLAB/row_bytes):0;
+        if(rows==0) rows=1;
+        if(align>1) rows=(rows+align-1)/align*align;
+        nslabs=(size_t)((dims[0]+rows-1)/rows);
+        words=(nslabs+63)/64;
+        bits=(uint64_t *)calloc(words?words:1,sizeof(uint64_t));
+        if(bits==NULL) rows=nslabs=0;
+    }
+    pthread_mutex_lock(&hermes_flusher_lock);
+    HermesDirtyMap *map=&state->map;
+    uint64_t *old=map->bits;
+    size_t old_slabs=map->nslabs;
+    bool reshaped=rows==0 || rows!=map->rows;
+    map->all=map->all || (reshaped && (map->ndirty || state->dirty_bytes));
+    map->bits=bits;
+    map->nslabs=nslabs;
+    map->rows=rows;
+    map->ndirty=0;
+    /* Slabs past a new, smaller extent can only be clean: shrinks are flushed first. */
+    for(slab=0;!reshaped && slab<old_slabs && slab<nslabs;slab++)
+        if(old[slab/64]&((uint64_t)1<<(slab%64))) hermes_dirty_set(map,slab);
+    pthread_mutex_unlock(&hermes_flusher_lock);
+    free(old);
+}
+/**
+ * This method records a write.
+ *
+ * @param state
+ * @param first first row written along the slowest dimension
+ * @param last last row written
+ * @param bytes bytes written
+ */
+void H5VL_hermes_flusher_dirty(HermesDirtyState *state, hsize_t first, hsize_t last, size_t bytes){
+    HermesDirtyMap *map=&state->map;
+    size_t slab;
+    pthread_mutex_lock(&hermes_flusher_lock);
+    if(state->dirty_bytes==0) state->dirty_since=H5VL_hermes_now();
+    state->dirty_bytes+=bytes;
+    if(map->rows==0 || last/map->rows>=map->nslabs) map->all=true;
+    else for(slab=(size_t)(first/map->rows);slab<=(size_t)(last/map->rows);slab++) hermes_dirty_set(map,slab);
+    pthread_mutex_unlock(&hermes_flusher_lock);
+}
+/**
+ * This method tells whether a dataset was written since its last flush.
+ *
+ * @param state
+ * @return true if a flush would write anything
+ */
+bool H5VL_hermes_flusher_pending(const HermesDirtyState *state){
+    return state->dirty_bytes || state->map.ndirty || state->map.all;
+}
+/**
+ * This method hands what was written since the last flush to the flush
+ * about to run, leaving the dataset clean.
+ *
+ * @param state
+ * @param taken set to the dirty map, whose bits the caller frees
+ */
+void H5VL_hermes_flusher_take(HermesDirtyState *state, HermesDirtyMap *taken){
+    HermesDirtyMap *map=&state->map;
+    size_t words=(map->nslabs+63)/64;
+    uint64_t *bits=map->rows?(uint64_t *)calloc(words?words:1,sizeof(uint64_t)):NULL;
+    pthread_mutex_lock(&hermes_flusher_lock);
+    *taken=*map;
+    if(bits==NULL && map->rows){
+        /* Without a fresh map the dataset goes on being tracked as a whole. */
+        map->rows=0;
+        map->nslabs=0;
+    }
+    map->bits=bits;
+    map->ndirty=0;
+    map->all=false;
+    state->dirty_bytes=0;
+    state->dirty_since=0;
+    pthread_mutex_unlock(&hermes_flusher_lock);
+}
+/**
+ * This method gives back what a failed flush took, so that the next one
+ * writes it again.
+ *
+ * @param state
+ * @param taken from H5VL_hermes_flusher_take
+ */
+void H5VL_hermes_flusher_merge(HermesDirtyState *state, HermesDirtyMap *taken){
+    HermesDirtyMap *map=&state->map;
+    size_t slab;
+    pthread_mutex_lock(&hermes_flusher_lock);
+    if(taken->all || taken->rows!=map->rows) map->all=map->all || taken->all || taken->ndirty;
+    else for(slab=0;slab<taken->nslabs && slab<map->nslabs;slab++)
+        if(taken->bits[slab/64]&((uint64_t)1<<(slab%64))) hermes_dirty_set(map,slab);
+    pthread_mutex_unlock(&hermes_flusher_lock);
+}
+/**
+ * This method is a flush point. It drains at most one dataset: the one whose
+ * dirty data is oldest past its age bound, or else the one furthest past its
+ * dirty-byte watermark if the bandwidth budget allows. Age-bound flushes are
+ * never throttled, which is what bounds staleness.
+ *
+ * @return result of the flush, or 0 when nothing was due
+ */
+herr_t H5VL_hermes_flusher_poll(void){
+    HermesDirtyState *state,*due=NULL;
+    double now=H5VL_hermes_now(),overdue=0,excess=0;
+    herr_t output;
+    pthread_mutex_lock(&hermes_flusher_lock);
+    if(hermes_flusher_busy || hermes_flusher_head==NULL){
+        pthread_mutex_unlock(&hermes_flusher_lock);
+        return 0;
+    }
+    for(state=hermes_flusher_head;state;state=state->next){
+        if(state->dirty_bytes==0 || state->policy.max_age<=0) continue;
+        if(now-state->dirty_since-state->policy.max_age>overdue){
+            overdue=now-state->dirty_since-state->policy.max_age;
+            due=state;
+        }
+    }
+    if(due==NULL){
+        for(state=hermes_flusher_head;state;state=state->next){
+            if(state->policy.dirty_bytes==0 || state->dirty_bytes<state->policy.dirty_bytes) continue;
+            if((double)state->dirty_bytes/(double)state->policy.dirty_bytes>excess){
+                excess=(double)state->dirty_bytes/(double)state->policy.dirty_bytes;
+                due=state;
+            }
+        }
+        if(due && due->policy.bytes_per_sec){
+            double rate=(double)due->policy.bytes_per_sec;
+            if(hermes_flusher_refill>0) hermes_flusher_budget+=(now-hermes_flusher_refill)*rate;
+            else hermes_flusher_budget=rate;
+            if(hermes_flusher_budget>rate) hermes_flusher_budget=rate;
+            hermes_flusher_refill=now;
+            /* Past twice the watermark the budget may go into debt. */
+            if(hermes_flusher_budget<=0 && excess<2){
+                pthread_mutex_unlock(&hermes_flusher_lock);
+                return 0;
+            }
+            hermes_flusher_budget-=(double)due->dirty_bytes;
+        }
+    }
+    if(due==NULL){
+        pthread_mutex_unlock(&hermes_flusher_lock);
+        return 0;
+    }
+    hermes_flusher_busy=true;
+    due->flushing++;
+    pthread_mutex_unlock(&hermes_flusher_lock);
+    H5VL_hermes_stats_event(HERMES_EVENT_FLUSH);
+    output=due->flush(due->owner);
+    hermes_flusher_done_with(due);
+    pthread_mutex_lock(&hermes_flusher_lock);
+    hermes_flusher_busy=false;
+    pthread_mutex_unlock(&hermes_flusher_lock);
+    return output;
+}
+/**
+ * This method drains every dataset of a file that holds dirty data, for
+ * H5Fflush and checkpoints.
+ *
+ * @param file name of the file
+ * @return non-negative if every flush succeeded
+ */
+herr_t H5VL_hermes_flusher_flush(const char *file){
+    HermesDirtyState *state,**due=NULL;
+    size_t count=0,i;
+    herr_t output=0;
+    if(file==NULL) return 0;
+    pthread_mutex_lock(&hermes_flusher_lock);
+    for(state=hermes_flusher_head;state;state=state->next)
+        if(state->file && !strcmp(state->file,file)) count++;
+    if(count){
+        due=(HermesDirtyState **)malloc(count*sizeof(HermesDirtyState *));
+        if(due==NULL){
+            pthread_mutex_unlock(&hermes_flusher_lock);
+            return -1;
+        }
+    }
+    count=0;
+    for(state=hermes_flusher_head;due && state;state=state->next)
+        if(state->file && !strcmp(state->file,file) && H5VL_hermes_flusher_pending(state)){
+            state->flushing++;
+            due[count++]=state;
+        }
+    bool busy=hermes_flusher_busy;
+    hermes_flusher_busy=true;
+    pthread_mutex_unlock(&hermes_flusher_lock);
+    for(i=0;i<count;i++){
+        if(due[i]->flush(due[i]->owner)<0) output=-1;
+        hermes_flusher_done_with(due[i]);
+    }
+    pthread_mutex_lock(&hermes_flusher_lock);
+    hermes_flusher_busy=busy;
+    pthread_mutex_unlock(&hermes_flusher_lock);
+    free(due);
+    return output;
+}
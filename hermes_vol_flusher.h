@@ -0,0 +1,91 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_flusher.h
+*
+* Purpose:Defines the write-behind flusher which drains dirty data from the
+*         buffer layer to the native file while a dataset is still open.
+*
+*-------------------------------------------------------------------------
+*/
+
+#ifndef HERMES_PROJECT_HERMES_VOL_FLUSHER_H
+#define HERMES_PROJECT_HERMES_VOL_FLUSHER_H
+#include <hdf5.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * When a dataset's dirty data is drained before close. A zero field turns
+ * the corresponding trigger off; the all-zero policy flushes at close only.
+ */
+typedef struct HermesFlushPolicy {
+    size_t dirty_bytes;     /* flush once this many bytes are dirty          */
+    double max_age;         /* seconds the oldest dirty byte may wait        */
+    size_t bytes_per_sec;   /* budget for flushes triggered by dirty_bytes   */
+} HermesFlushPolicy;
+
+/* Target size of the slabs of rows whose dirtiness is tracked. */
+#define HERMES_DIRTY_SLAB (1024*1024)
+/* Most dirty bytes a flush stages at a time on their way to the native file. */
+#define HERMES_FLUSH_RUN (8*1024*1024)
+
+typedef herr_t (*HermesFlushFn)(void *owner);
+
+/**
+ * Which slabs of whole rows along the slowest dimension of a dataset were
+ * written since its last flush.
+ */
+typedef struct HermesDirtyMap {
+    uint64_t *bits;         /* one per slab                                    */
+    size_t nslabs;
+    size_t ndirty;
+    hsize_t rows;           /* rows per slab, 0 when not tracked               */
+    bool all;               /* written where the bits cannot tell              */
+} HermesDirtyMap;
+
+/**
+ * Dirty bookkeeping of one open dataset, linked into the flusher's list.
+ */
+typedef struct HermesDirtyState {
+    HermesFlushPolicy policy;
+    HermesFlushFn flush;
+    void *owner;
+    const char *file;       /* file_name of the owner, what file flushes match */
+    HermesDirtyMap map;
+    size_t dirty_bytes;
+    double dirty_since;     /* time of the oldest unflushed write, 0 when clean */
+    bool registered;
+    unsigned flushing;      /* flushes of the owner running; unregister waits for them */
+    struct HermesDirtyState *prev;
+    struct HermesDirtyState *next;
+} HermesDirtyState;
+
+double H5VL_hermes_now(void);
+void H5VL_hermes_flusher_register(HermesDirtyState *state, const HermesFlushPolicy *policy,
+                                  HermesFlushFn flush, void *owner, const char *file);
+void H5VL_hermes_flusher_unregister(HermesDirtyState *state);
+void H5VL_hermes_flusher_untrack(HermesDirtyState *state);
+void H5VL_hermes_flusher_track(HermesDirtyState *state, int rank, const hsize_t *dims, size_t elem_size,
+                               hsize_t align);
+void H5VL_hermes_flusher_dirty(HermesDirtyState *state, hsize_t first, hsize_t last, size_t bytes);
+bool H5VL_hermes_flusher_pending(const HermesDirtyState *state);
+void H5VL_hermes_flusher_take(HermesDirtyState *state, HermesDirtyMap *taken);
+void H5VL_hermes_flusher_merge(HermesDirtyState *state, HermesDirtyMap *taken);
+herr_t H5VL_hermes_flusher_poll(void);
+herr_t H5VL_hermes_flusher_flush(const char *file);
+#endif //HERMES_PROJECT_HERMES_VOL_FLUSHER_H
@@ -0,0 +1,569 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_metadata.c
+*
+* Purpose:Implements the attribute cache. The first time an object's
+*         attributes are touched their names are listed from the native
+*         file once; from then on creates, existence checks, reads and writes
+*         of small attributes are answered from memory. An object with dirty
+*         attributes holds a reference on its native identifier so the batch
+*         can be written after the application closed it. Only the
+*         application thread calls into the cache.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "hermes_vol_metadata.h"
+#include "hermes_vol_stats.h"
+
+typedef struct HermesAttrEntry {
+    char *name;
+    uint64_t hash;
+    hid_t type_id;          /* stored type, -1 until loaded */
+    hid_t space_id;
+    hid_t acpl_id;
+    void *data;
+    size_t bytes;
+    bool loaded;
+    bool native;            /* exists in the native file */
+    bool dirty;
+    struct HermesAttrEntry *chain;
+    struct HermesAttrEntry *prev;   /* creation order, which the batch preserves */
+    struct HermesAttrEntry *next;
+} HermesAttrEntry;
+
+typedef struct HermesMetaObject {
+    haddr_t addr;
+    hid_t loc_id;           /* held while attributes are dirty, -1 otherwise */
+    bool listed;            /* every native attribute has an entry */
+    HermesAttrEntry **buckets;
+    size_t nbuckets;
+    size_t count;
+    HermesAttrEntry *head;
+    HermesAttrEntry *tail;
+    struct HermesMetaObject *chain;
+} HermesMetaObject;
+
+struct HermesMetaCache {
+    unsigned refs;
+    HermesMetaPolicy policy;
+    HermesMetaObject **buckets;
+    size_t nbuckets;
+    size_t count;
+    size_t bytes;           /* attribute data loaded */
+};
+
+static uint64_t hermes_name_hash(const char *name){
+    uint64_t hash=14695981039346656037ull;
+    for(;*name;name++) hash=(hash^(unsigned char)*name)*1099511628211ull;
+    return hash;
+}
+static size_t hermes_addr_bucket(haddr_t addr, size_t nbuckets){
+    return (size_t)(((uint64_t)addr*11400714819323198485ull)>>17)%nbuckets;
+}
+static size_t hermes_meta_bytes(hid_t type_id, hid_t space_id){
+    hssize_t npoints=H5Sget_simple_extent_npoints(space_id);
+    size_t size=H5Tget_size(type_id);
+    if(npoints<0 || size==0) return (size_t)-1;
+    return (size_t)npoints*size;
+}
+
+static void hermes_meta_unload(HermesAttrEntry *e){
+    if(e->type_id>=0) H5Tclose(e->type_id);
+    if(e->space_id>=0) H5Sclose(e->space_id);
+    if(e->acpl_id>=0) H5Pclose(e->acpl_id);
+    free(e->data);
+    e->type_id=e->space_id=e->acpl_id=-1;
+    e->data=NULL;
+    e->loaded=false;
+}
+static HermesAttrEntry *hermes_meta_find(const HermesMetaObject *obj, const char *name){
+    uint64_t hash=hermes_name_hash(name);
+    HermesAttrEntry *e;
+    if(obj->nbuckets==0) return NULL;
+    for(e=obj->buckets[hash%obj->nbuckets];e;e=e->chain)
+        if(e->hash==hash && strcmp(e->name,name)==0) return e;
+    return NULL;
+}
+static HermesAttrEntry *hermes_meta_insert(HermesMetaObject *obj, const char *name){
+    HermesAttrEntry *e;
+    size_t i;
+    if(obj->count>=obj->nbuckets){
+        size_t nbuckets=obj->nbuckets?obj->nbuckets*2:16;
+        HermesAttrEntry **buckets=(HermesAttrEntry **)calloc(nbuckets,sizeof(HermesAttrEntry *));
+        if(buckets==NULL) return NULL;
+        for(i=0;i<obj->nbuckets;i++){
+            while(obj->buckets[i]){
+                e=obj->buckets[i];
+                obj->buckets[i]=e->chain;
+                e->chain=buckets[e->hash%nbuckets];
+                buckets[e->hash%nbuckets]=e;
+            }
+        }
+        free(obj->buckets);
+        obj->buckets=buckets;
+        obj->nbuckets=nbuckets;
+    }
+    e=(HermesAttrEntry *)calloc(1,sizeof(HermesAttrEntry));
+    if(e==NULL) return NULL;
+    e->name=strdup(name);
+    if(e->name==NULL){
+        free(e);
+        return NULL;
+    }
+    e->hash=hermes_name_hash(name);
+    e->type_id=e->space_id=e->acpl_id=-1;
+    e->chain=obj->buckets[e->hash%obj->nbuckets];
+    obj->buckets[e->hash%obj->nbuckets]=e;
+    e->prev=obj->tail;
+    if(obj->tail) obj->tail->next=e;
+    else obj->head=e;
+    obj->tail=e;
+    obj->count++;
+    return e;
+}
+static void hermes_meta_remove(HermesMetaObject *obj, HermesAttrEntry *e){
+    HermesAttrEntry **link=&obj->buckets[e->hash%obj->nbuckets];
+    while(*link!=e) link=&(*link)->chain;
+    *link=e->chain;
+    if(e->prev) e->prev->next=e->next;
+    else obj->head=e->next;
+    if(e->next) e->next->prev=e->prev;
+    else obj->tail=e->prev;
+    obj->count--;
+    hermes_meta_unload(e);
+    free(e->name);
+    free(e);
+}
+static void hermes_meta_object_free(HermesMetaCache *cache, HermesMetaObject *obj){
+    while(obj->head){
+        if(obj->head->loaded) cache->bytes-=obj->head->bytes;
+        hermes_meta_remove(obj,obj->head);
+    }
+    if(obj->loc_id>=0) H5Idec_ref(obj->loc_id);
+    free(obj->buckets);
+    free(obj);
+}
+static HermesMetaObject *hermes_meta_object(HermesMetaCache *cache, haddr_t addr, bool create){
+    HermesMetaObject *obj;
+    size_t i,b;
+    if(cache->nbuckets){
+        for(obj=cache->buckets[hermes_addr_bucket(addr,cache->nbuckets)];obj;obj=obj->chain)
+            if(obj->addr==addr) return obj;
+    }
+    if(!create) return NULL;
+    if(cache->count>=cache->nbuckets){
+        size_t nbuckets=cache->nbuckets?cache->nbuckets*2:64;
+        HermesMetaObject **buckets=(HermesMetaObject **)calloc(nbuckets,sizeof(HermesMetaObject *));
+        if(buckets==NULL) return NULL;
+        for(i=0;i<cache->nbuckets;i++){
+            while(cache->buckets[i]){
+                obj=cache->buckets[i];
+                cache->buckets[i]=obj->chain;
+                b=hermes_addr_bucket(obj->addr,nbuckets);
+                obj->chain=buckets[b];
+                buckets[b]=obj;
+            }
+        }
+        free(cache->buckets);
+        cache->buckets=buckets;
+        cache->nbuckets=nbuckets;
+    }
+    obj=(HermesMetaObject *)calloc(1,sizeof(HermesMetaObject));
+    if(obj==NULL) return NULL;
+    obj->addr=addr;
+    obj->loc_id=-1;
+    b=hermes_addr_bucket(addr,cache->nbuckets);
+    obj->chain=cache->buckets[b];
+    cache->buckets[b]=obj;
+    cache->count++;
+    return obj;
+}
+
+static herr_t hermes_meta_list_op(hid_t loc_id, const char *name, const H5A_info_t *info, void *op_data){
+    HermesMetaObject *obj=(HermesMetaObject *)op_data;
+    HermesAttrEntry *e=hermes_meta_find(obj,name);
+    (void)loc_id;
+    (void)info;
+    if(e==NULL){
+        e=hermes_meta_insert(obj,name);
+        if(e==NULL) return -1;
+    }
+    e->native=true;
+    return 0;
+}
+/**
+ * This method finds the object at addr, listing its native attributes on
+ * first use.
+ *
+ * @param cache
+ * @param addr address of the object
+ * @param loc_id native identifier of the object
+ * @return object, or NULL on error
+ */
+static HermesMetaObject *hermes_meta_listed(HermesMetaCache *cache, haddr_t addr, hid_t loc_id){
+    HermesMetaObject *obj=hermes_meta_object(cache,addr,true);
+    hsize_t idx=0;
+    if(obj==NULL || obj->listed) return obj;
+    if(H5Aiterate2(loc_id,H5_INDEX_NAME,H5_ITER_NATIVE,&idx,hermes_meta_list_op,obj)<0) return NULL;
+    obj->listed=true;
+    return obj;
+}
+/**
+ * This method reads an attribute from the native file into its entry.
+ *
+ * @return 1 when loaded, 0 when the attribute is not cacheable, -1 on error
+ */
+static int hermes_meta_load(HermesMetaCache *cache, HermesAttrEntry *e, hid_t loc_id){
+    hid_t attr_id;
+    if(e->loaded){
+        H5VL_hermes_stats_event(HERMES_EVENT_ATTR_HIT);
+        return 1;
+    }
+    attr_id=H5Aopen(loc_id,e->name,H5P_DEFAULT);
+    if(attr_id<0) return -1;
+    e->type_id=H5Aget_type(attr_id);
+    e->space_id=H5Aget_space(attr_id);
+    e->acpl_id=H5Aget_create_plist(attr_id);
+    if(e->type_id<0 || e->space_id<0 || e->acpl_id<0 ||
+       !H5VL_hermes_meta_cacheable(cache,e->type_id,e->space_id)){
+        int output=e->type_id<0 || e->space_id<0 || e->acpl_id<0?-1:0;
+        H5Aclose(attr_id);
+        hermes_meta_unload(e);
+        return output;
+    }
+    e->bytes=hermes_meta_bytes(e->type_id,e->space_id);
+    e->data=malloc(e->bytes?e->bytes:1);
+    if(e->data==NULL || H5Aread(attr_id,e->type_id,e->data)<0){
+        H5Aclose(attr_id);
+        hermes_meta_unload(e);
+        return -1;
+    }
+    H5Aclose(attr_id);
+    e->loaded=true;
+    cache->bytes+=e->bytes;
+    H5VL_hermes_stats_event(HERMES_EVENT_ATTR_LOAD);
+    return 1;
+}
+/* Finds a cacheable attribute and makes sure its data is in memory. */
+static HermesAttrEntry *hermes_meta_entry(HermesMetaCache *cache, haddr_t addr, hid_t loc_id, const char *name,
+                                          HermesMetaObject **object){
+    HermesMetaObject *obj;
+    HermesAttrEntry *e;
+    if(cache==NULL) return NULL;
+    obj=hermes_meta_listed(cache,addr,loc_id);
+    if(obj==NULL) return NULL;
+    e=hermes_meta_find(obj,name);
+    if(e==NULL || hermes_meta_load(cache,e,loc_id)<=0) return NULL;
+    if(object) *object=obj;
+    return e;
+}
+static herr_t hermes_meta_hold(HermesMetaObject *obj, hid_t loc_id){
+    if(obj->loc_id>=0) return 0;
+    if(H5Iinc_ref(loc_id)<0) return -1;
+    obj->loc_id=loc_id;
+    return 0;
+}
+/* Converts every element of space_id from src_type_id to dst_type_id. */
+static herr_t hermes_meta_convert(hid_t src_type_id, hid_t dst_type_id, hid_t space_id, const void *in, void *out){
+    hssize_t npoints=H5Sget_simple_extent_npoints(space_id);
+    size_t src_size=H5Tget_size(src_type_id),dst_size=H5Tget_size(dst_type_id),n;
+    void *tmp,*bkg=NULL;
+    herr_t output;
+    if(npoints<=0) return npoints<0?-1:0;
+    n=(size_t)npoints;
+    if(H5Tequal(src_type_id,dst_type_id)>0){
+        memcpy(out,in,n*src_size);
+        return 0;
+    }
+    tmp=malloc(n*(src_size>dst_size?src_size:dst_size));
+    if(tmp==NULL) return -1;
+    memcpy(tmp,in,n*src_size);
+    /* Compound members missing from the source keep the destination's values. */
+    if(H5Tget_class(dst_type_id)==H5T_COMPOUND){
+        bkg=malloc(n*dst_size);
+        if(bkg) memcpy(bkg,out,n*dst_size);
+    }
+    output=H5Tconvert(src_type_id,dst_type_id,n,tmp,bkg,H5P_DEFAULT);
+    if(output>=0) memcpy(out,tmp,n*dst_size);
+    free(bkg);
+    free(tmp);
+    return output;
+}
+/* Writes the dirty attributes of an object in creation order and lets go of it. */
+static herr_t hermes_meta_flush_object(HermesMetaObject *obj){
+    HermesAttrEntry *e;
+    herr_t output=0;
+    if(obj->loc_id<0) return 0;
+    for(e=obj->head;e;e=e->next){
+        hid_t attr_id;
+        if(!e->dirty) continue;
+        attr_id=e->native?H5Aopen(obj->loc_id,e->name,H5P_DEFAULT)
+                         :H5Acreate2(obj->loc_id,e->name,e->type_id,e->space_id,e->acpl_id,H5P_DEFAULT);
+        if(attr_id<0){
+            output=-1;
+            continue;
+        }
+        if(H5Awrite(attr_id,e->type_id,e->data)<0) output=-1;
+        else e->dirty=false;
+        e->native=true;
+        H5Aclose(attr_id);
+    }
+    if(output>=0){
+        H5Idec_ref(obj->loc_id);
+        obj->loc_id=-1;
+    }
+    return output;
+}
+/* Whether an object holds attributes the native file does not have yet. */
+static bool hermes_meta_object_dirty(const HermesMetaObject *obj){
+    const HermesAttrEntry *e;
+    for(e=obj->head;e;e=e->next) if(e->dirty) return true;
+    return false;
+}
+/* Forgets the objects of the cache; unless all is set, those a failed flush left dirty stay. */
+static void hermes_meta_drop(HermesMetaCache *cache, bool all){
+    HermesMetaObject **link;
+    size_t i;
+    for(i=0;i<cache->nbuckets;i++){
+        link=&cache->buckets[i];
+        while(*link){
+            HermesMetaObject *obj=*link;
+            if(!all && hermes_meta_object_dirty(obj)){
+                link=&obj->chain;
+                continue;
+            }
+            *link=obj->chain;
+            cache->count--;
+            hermes_meta_object_free(cache,obj);
+        }
+    }
+}
+/* Writes out and drops everything once the cache holds more than allowed. */
+static herr_t hermes_meta_trim(HermesMetaCache *cache){
+    if(cache->bytes<=cache->policy.cache_bytes) return 0;
+    return H5VL_hermes_meta_invalidate(cache);
+}
+
+/**
+ * This method creates the attribute cache of a file.
+ *
+ * @param policy
+ * @return cache, or NULL when the policy turns it off
+ */
+HermesMetaCache *H5VL_hermes_meta_create(const HermesMetaPolicy *policy){
+    HermesMetaCache *cache;
+    if(policy==NULL || policy->attr_bytes==0) return NULL;
+    cache=(HermesMetaCache *)calloc(1,sizeof(HermesMetaCache));
+    if(cache==NULL) return NULL;
+    cache->refs=1;
+    cache->policy=*policy;
+    if(cache->policy.cache_bytes==0) cache->policy.cache_bytes=HERMES_META_DEFAULT_CACHE_BYTES;
+    return cache;
+}
+HermesMetaCache *H5VL_hermes_meta_ref(HermesMetaCache *cache){
+    if(cache) cache->refs++;
+    return cache;
+}
+/**
+ * This method drops a reference; the last one writes out the dirty
+ * attributes and frees the cache.
+ *
+ * @param cache
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_meta_release(HermesMetaCache *cache){
+    herr_t output;
+    if(cache==NULL || --cache->refs>0) return 0;
+    output=H5VL_hermes_meta_invalidate(cache);
+    /* Nobody is left to retry what failed. */
+    hermes_meta_drop(cache,true);
+    free(cache->buckets);
+    free(cache);
+    return output;
+}
+/**
+ * This method tells whether an attribute of this type and space is kept in
+ * memory: fixed-size types only, no larger than the policy's attr_bytes.
+ */
+bool H5VL_hermes_meta_cacheable(const HermesMetaCache *cache, hid_t type_id, hid_t space_id){
+    H5S_class_t space_class;
+    if(cache==NULL) return false;
+    if(H5Tdetect_class(type_id,H5T_VLEN)!=0 || H5Tdetect_class(type_id,H5T_REFERENCE)!=0 ||
+       H5Tis_variable_str(type_id)!=0)
+        return false;
+    space_class=H5Sget_simple_extent_type(space_id);
+    if(space_class!=H5S_SCALAR && space_class!=H5S_SIMPLE && space_class!=H5S_NULL) return false;
+    return hermes_meta_bytes(type_id,space_id)<=cache->policy.attr_bytes;
+}
+/**
+ * This method records an object created through the VOL, which has no
+ * attributes to list.
+ *
+ * @param cache
+ * @param addr address of the object
+ */
+void H5VL_hermes_meta_fresh(HermesMetaCache *cache, haddr_t addr){
+    HermesMetaObject *obj;
+    if(cache==NULL) return;
+    obj=hermes_meta_object(cache,addr,true);
+    if(obj) obj->listed=true;
+}
+
+/**
+ * This method creates an attribute in memory. It reaches the native file
+ * with the next flush.
+ *
+ * @param cache
+ * @param addr address of the object
+ * @param loc_id native identifier of the object
+ * @param name
+ * @param type_id
+ * @param space_id
+ * @param acpl_id
+ * @return non-negative on success, negative if the attribute exists
+ */
+herr_t H5VL_hermes_meta_attr_create(HermesMetaCache *cache, haddr_t addr, hid_t loc_id, const char *name,
+                                    hid_t type_id, hid_t space_id, hid_t acpl_id){
+    HermesMetaObject *obj=hermes_meta_listed(cache,addr,loc_id);
+    HermesAttrEntry *e;
+    if(obj==NULL || hermes_meta_find(obj,name)) return -1;
+    e=hermes_meta_insert(obj,name);
+    if(e==NULL) return -1;
+    e->type_id=H5Tcopy(type_id);
+    e->space_id=H5Scopy(space_id);
+    e->acpl_id=acpl_id==H5P_DEFAULT?H5Pcreate(H5P_ATTRIBUTE_CREATE):H5Pcopy(acpl_id);
+    e->bytes=hermes_meta_bytes(type_id,space_id);
+    e->data=calloc(1,e->bytes?e->bytes:1);
+    if(e->type_id<0 || e->space_id<0 || e->acpl_id<0 || e->data==NULL || hermes_meta_hold(obj,loc_id)<0){
+        hermes_meta_remove(obj,e);
+        return -1;
+    }
+    e->loaded=true;
+    e->dirty=true;
+    cache->bytes+=e->bytes;
+    return hermes_meta_trim(cache);
+}
+/**
+ * This method opens an attribute from the cache, loading it on first use.
+ *
+ * @return 1 when served from the cache, 0 when it must be opened natively,
+ *         -1 if it does not exist
+ */
+int H5VL_hermes_meta_attr_open(HermesMetaCache *cache, haddr_t addr, hid_t loc_id, const char *name){
+    HermesMetaObject *obj=hermes_meta_listed(cache,addr,loc_id);
+    HermesAttrEntry *e;
+    int output;
+    if(obj==NULL || (e=hermes_meta_find(obj,name))==NULL) return -1;
+    output=hermes_meta_load(cache,e,loc_id);
+    if(output>0 && hermes_meta_trim(cache)<0) return -1;
+    return output;
+}
+herr_t H5VL_hermes_meta_attr_read(HermesMetaCache *cache, haddr_t addr, hid_t loc_id, const char *name,
+                                  hid_t mem_type_id, void *buf){
+    HermesAttrEntry *e=hermes_meta_entry(cache,addr,loc_id,name,NULL);
+    if(e==NULL) return -1;
+    return hermes_meta_convert(e->type_id,mem_type_id,e->space_id,e->data,buf);
+}
+herr_t H5VL_hermes_meta_attr_write(HermesMetaCache *cache, haddr_t addr, hid_t loc_id, const char *name,
+                                   hid_t mem_type_id, const void *buf){
+    HermesMetaObject *obj;
+    HermesAttrEntry *e=hermes_meta_entry(cache,addr,loc_id,name,&obj);
+    if(e==NULL || hermes_meta_hold(obj,loc_id)<0) return -1;
+    if(hermes_meta_convert(mem_type_id,e->type_id,e->space_id,buf,e->data)<0) return -1;
+    e->dirty=true;
+    return 0;
+}
+/**
+ * This method describes a cached attribute. Identifiers returned are copies
+ * the caller closes; any out parameter may be NULL.
+ */
+herr_t H5VL_hermes_meta_attr_info(HermesMetaCache *cache, haddr_t addr, hid_t loc_id, const char *name,
+                                  hid_t *type_id, hid_t *space_id, hid_t *acpl_id, hsize_t *bytes){
+    HermesAttrEntry *e=hermes_meta_entry(cache,addr,loc_id,name,NULL);
+    if(e==NULL) return -1;
+    if(type_id) *type_id=H5Tcopy(e->type_id);
+    if(space_id) *space_id=H5Scopy(e->space_id);
+    if(acpl_id) *acpl_id=H5Pcopy(e->acpl_id);
+    if(bytes) *bytes=e->bytes;
+    return 0;
+}
+htri_t H5VL_hermes_meta_attr_exists(HermesMetaCache *cache, haddr_t addr, hid_t loc_id, const char *name){
+    HermesMetaObject *obj=hermes_meta_listed(cache,addr,loc_id);
+    if(obj==NULL) return -1;
+    return hermes_meta_find(obj,name)!=NULL;
+}
+
+/**
+ * This method writes every dirty attribute to the native file, object by
+ * object. Entries stay cached and clean.
+ *
+ * @param cache
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_meta_flush(HermesMetaCache *cache){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesMetaObject *obj;
+    herr_t output=0;
+    size_t i;
+    if(cache==NULL) return 0;
+    for(i=0;i<cache->nbuckets;i++)
+        for(obj=cache->buckets[i];obj;obj=obj->chain)
+            if(hermes_meta_flush_object(obj)<0) output=-1;
+    H5VL_hermes_stats_end(HERMES_OP_META_FLUSH,begin);
+    return output;
+}
+/**
+ * This method writes out and forgets the attributes of one object, before
+ * the native connector operates on them directly. If they cannot be written
+ * they stay cached.
+ *
+ * @param cache
+ * @param addr address of the object
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_meta_evict(HermesMetaCache *cache, haddr_t addr){
+    HermesMetaObject *obj,**link;
+    herr_t output;
+    if(cache==NULL || cache->nbuckets==0) return 0;
+    link=&cache->buckets[hermes_addr_bucket(addr,cache->nbuckets)];
+    while(*link && (*link)->addr!=addr) link=&(*link)->chain;
+    if(*link==NULL) return 0;
+    obj=*link;
+    output=hermes_meta_flush_object(obj);
+    if(output<0) return output;
+    *link=obj->chain;
+    cache->count--;
+    hermes_meta_object_free(cache,obj);
+    return output;
+}
+/**
+ * This method writes out and forgets every attribute, before operations
+ * that may reach objects the cache cannot name, such as by-name access or
+ * link deletion. Objects whose attributes cannot be written stay cached.
+ *
+ * @param cache
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_meta_invalidate(HermesMetaCache *cache){
+    herr_t output=H5VL_hermes_meta_flush(cache);
+    if(cache) hermes_meta_drop(cache,false);
+    return output;
+}
@@ -0,0 +1,67 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_metadata.h
+*
+* Purpose:Defines the write-back cache of small attributes. Attributes are
+*         keyed by the address of the object holding them and their name;
+*         creates and writes stay in memory and reach the native file in one
+*         batch per file flush or close.
+*
+*-------------------------------------------------------------------------
+*/
+
+#ifndef HERMES_PROJECT_HERMES_VOL_METADATA_H
+#define HERMES_PROJECT_HERMES_VOL_METADATA_H
+#include <hdf5.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define HERMES_META_DEFAULT_ATTR_BYTES (64*1024)
+#define HERMES_META_DEFAULT_CACHE_BYTES (16*1024*1024)
+
+/**
+ * Sizing of the attribute cache; attr_bytes of 0 turns it off.
+ */
+typedef struct HermesMetaPolicy {
+    size_t attr_bytes;      /* larger attributes go straight to the native file */
+    size_t cache_bytes;     /* attribute data held before the cache is written out and dropped */
+} HermesMetaPolicy;
+
+typedef struct HermesMetaCache HermesMetaCache;
+
+HermesMetaCache *H5VL_hermes_meta_create(const HermesMetaPolicy *policy);
+HermesMetaCache *H5VL_hermes_meta_ref(HermesMetaCache *cache);
+herr_t H5VL_hermes_meta_release(HermesMetaCache *cache);
+bool H5VL_hermes_meta_cacheable(const HermesMetaCache *cache, hid_t type_id, hid_t space_id);
+void H5VL_hermes_meta_fresh(HermesMetaCache *cache, haddr_t addr);
+
+herr_t H5VL_hermes_meta_attr_create(HermesMetaCache *cache, haddr_t addr, hid_t loc_id, const char *name,
+                                    hid_t type_id, hid_t space_id, hid_t acpl_id);
+int H5VL_hermes_meta_attr_open(HermesMetaCache *cache, haddr_t addr, hid_t loc_id, const char *name);
+herr_t H5VL_hermes_meta_attr_read(HermesMetaCache *cache, haddr_t addr, hid_t loc_id, const char *name,
+                                  hid_t mem_type_id, void *buf);
+herr_t H5VL_hermes_meta_attr_write(HermesMetaCache *cache, haddr_t addr, hid_t loc_id, const char *name,
+                                   hid_t mem_type_id, const void *buf);
+herr_t H5VL_hermes_meta_attr_info(HermesMetaCache *cache, haddr_t addr, hid_t loc_id, const char *name,
+                                  hid_t *type_id, hid_t *space_id, hid_t *acpl_id, hsize_t *bytes);
+htri_t H5VL_hermes_meta_attr_exists(HermesMetaCache *cache, haddr_t addr, hid_t loc_id, const char *name);
+
+herr_t H5VL_hermes_meta_flush(HermesMetaCache *cache);
+herr_t H5VL_hermes_meta_evict(HermesMetaCache *cache, haddr_t addr);
+herr_t H5VL_hermes_meta_invalidate(HermesMetaCache *cache);
+#endif //HERMES_PROJECT_HERMES_VOL_METADATA_H
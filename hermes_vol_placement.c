@@ -0,0 +1,1470 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_placement.c
+*
+* Purpose:Implements the placement engine. Writes go through to the buffer
+*         layer, so every tier here only ever holds clean copies: an extent
+*         leaving RAM is demoted if the demotion tier has room and dropped
+*         otherwise, and a promoted extent leaves the demotion tier. A mapped
+*         demotion tier is read in place instead and never promotes. An
+*         unmapped tier may hold extents coded by hermes_vol_codec.
+*
+*         The engine lock only covers lookups and bookkeeping: hits are
+*         copied out unlocked, the extent pinned by a reader count, so
+*         threads reading different extents do not wait on each other.
+*
+*         A kept tier outlives the process. Closed datasets park their
+*         extents in it, and an index of the parked sets, each stamped with
+*         the size, mtime and inode of its native file, is written next to
+*         it when the engine goes away, for the next run to pick up.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "hermes_vol_codec.h"
+#include "hermes_vol_placement.h"
+#include "hermes_vol_pool.h"
+#include "hermes_vol_stats.h"
+
+/* Demotion slots are powers of two of at least 4 KiB. */
+#define HERMES_DEMOTE_MIN_SHIFT 12
+#define HERMES_DEMOTE_CLASSES 48
+/* Index of a persistent tier, kept next to it as <tier>.index. */
+#define HERMES_INDEX_MAGIC 0x5844494c5648ull  /* "HVLIDX" */
+#define HERMES_INDEX_VERSION 1
+
+/* Extents of every engine; sets come and go with datasets, and extents with them. */
+static HermesPool hermes_extent_pool=HERMES_POOL_INIT("extent",HermesExtent);
+
+typedef struct HermesSlotList {
+    off_t *offsets;
+    size_t count;
+    size_t capacity;
+} HermesSlotList;
+
+struct HermesPlacement {
+    pthread_mutex_t lock;   /* protects the engine and every extent set using it */
+    int refs;
+    const HermesPlacementClass *cls;
+    void *policy;
+    size_t extent_bytes;
+    size_t ram_capacity;
+    size_t ram_used;
+    /* demotion tier: an unlinked file carved into power-of-two slots */
+    int demote_fd;
+    size_t demote_capacity;
+    size_t demote_used;
+    off_t demote_end;
+    char *demote_map;       /* the whole tier mapped, NULL when it is read with pread */
+    bool compress;          /* code extents on demotion; never with a mapping */
+    bool shuffle;
+    HermesSlotList free_slots[HERMES_DEMOTE_CLASSES];
+    HermesExtent *demote_head;  /* most recently demoted */
+    HermesExtent *demote_tail;
+    char *persist_path;     /* tier kept across runs, NULL when it dies with the process */
+    HermesExtentSet *parked;    /* closed datasets whose extents stay in a kept tier */
+    HermesPlacementStats stats;
+};
+/**
+ * What a native file looked like when the extents of its datasets were
+ * last known to match it.
+ */
+typedef struct HermesStamp {
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t ino;
+} HermesStamp;
+struct HermesExtentSet {
+    HermesPlacement *engine;
+    int rank;
+    hsize_t dims[H5S_MAX_RANK];
+    size_t elem_size;
+    unsigned workers;       /* pool the extents are coded on, 0 for the caller */
+    hsize_t rows;           /* rows of the slowest dimension per extent */
+    size_t nextents;
+    size_t capacity;        /* of extents */
+    HermesExtent **extents; /* by index, NULL when no tier knows the extent */
+    uint64_t writes;        /* bumped by every write; a load started before one is not kept */
+    size_t queued;          /* written boxes the buffer layer does not have yet */
+    /* set by H5VL_hermes_extent_set_persist */
+    char *path;             /* canonical path of the native file */
+    char *name;             /* of the dataset */
+    bool stamped;           /* parked and stamp is valid */
+    HermesStamp stamp;
+    uint64_t ordinal;       /* while the index is written */
+    HermesExtentSet *parked_prev;
+    HermesExtentSet *parked_next;
+};
+
+static unsigned hermes_demote_class(size_t bytes){
+    unsigned shift=HERMES_DEMOTE_MIN_SHIFT;
+    while(((size_t)1<<shift)<bytes) shift++;
+    return shift-HERMES_DEMOTE_MIN_SHIFT;
+}
+static size_t hermes_demote_class_bytes(unsigned demote_class){
+    return (size_t)1<<(demote_class+HERMES_DEMOTE_MIN_SHIFT);
+}
+static herr_t hermes_full_io(int fd, void *buf, size_t bytes, off_t offset, bool is_write){
+    size_t done=0;
+    while(done<bytes){
+        ssize_t n=is_write?pwrite(fd,(char *)buf+done,bytes-done,offset+(off_t)done)
+                          :pread(fd,(char *)buf+done,bytes-done,offset+(off_t)done);
+        if(n<0 && errno==EINTR) continue;
+        if(n<=0) return -1;
+        done+=(size_t)n;
+    }
+    return 0;
+}
+static herr_t hermes_demote_io(HermesPlacement *engine, void *buf, size_t bytes, off_t offset, bool is_write){
+    if(engine->demote_map==NULL) return hermes_full_io(engine->demote_fd,buf,bytes,offset,is_write);
+    if(is_write) memcpy(engine->demote_map+offset,buf,bytes);
+    else memcpy(buf,engine->demote_map+offset,bytes);
+    return 0;
+}
+static void hermes_demote_unlink(HermesPlacement *engine, HermesExtent *e){
+    if(e->demote_prev) e->demote_prev->demote_next=e->demote_next;
+    else engine->demote_head=e->demote_next;
+    if(e->demote_next) e->demote_next->demote_prev=e->demote_prev;
+    else engine->demote_tail=e->demote_prev;
+    e->demote_prev=e->demote_next=NULL;
+}
+static void hermes_demote_touch(HermesPlacement *engine, HermesExtent *e){
+    hermes_demote_unlink(engine,e);
+    e->demote_next=engine->demote_head;
+    if(engine->demote_head) engine->demote_head->demote_prev=e;
+    else engine->demote_tail=e;
+    engine->demote_head=e;
+}
+static void hermes_slot_free(HermesPlacement *engine, unsigned demote_class, off_t offset){
+    HermesSlotList *list=&engine->free_slots[demote_class];
+    if(list->count==list->capacity){
+        size_t capacity=list->capacity?list->capacity*2:16;
+        off_t *offsets=(off_t *)realloc(list->offsets,capacity*sizeof(off_t));
+        if(offsets){
+            list->offsets=offsets;
+            list->capacity=capacity;
+        }
+    }
+    /* A slot that cannot be recorded is leaked inside the tier file. */
+    if(list->count<list->capacity) list->offsets[list->count++]=offset;
+}
+/**
+ * This method gives an extent's demotion slot back. The extent itself is
+ * left to the caller.
+ */
+static void hermes_demote_drop(HermesPlacement *engine, HermesExtent *e){
+    if(!e->demoted) return;
+    hermes_demote_unlink(engine,e);
+    hermes_slot_free(engine,e->demote_class,e->demote_offset);
+    engine->demote_used-=hermes_demote_class_bytes(e->demote_class);
+    e->demoted=false;
+}
+/**
+ * This method copies an extent leaving RAM into the demotion tier, pushing
+ * out the least recently demoted extents to make room. Extents with views
+ * on them stay.
+ *
+ * @return true if the extent was demoted
+ */
+static bool hermes_demote(HermesPlacement *engine, HermesExtent *e){
+    unsigned demote_class;
+    size_t bytes,stored=e->bytes;
+    HermesSlotList *list;
+    HermesExtent *cold=engine->demote_tail;
+    void *coded=NULL,*src=e->data;
+    off_t offset;
+    if(engine->demote_fd<0) return false;
+    if(engine->compress){
+        coded=malloc(H5VL_hermes_codec_bound(e->bytes));
+        if(coded) stored=H5VL_hermes_codec_compress(e->data,e->bytes,e->set->elem_size,engine->shuffle,
+                                                     e->set->workers,coded);
+        /* An extent that does not shrink is stored as is; the sizes tell them apart. */
+        if(stored==0 || stored>=e->bytes) stored=e->bytes;
+        else src=coded;
+    }
+    demote_class=hermes_demote_class(stored);
+    bytes=hermes_demote_class_bytes(demote_class);
+    list=&engine->free_slots[demote_class];
+    if(demote_class>=HERMES_DEMOTE_CLASSES || bytes>engine->demote_capacity){
+        free(coded);
+        return false;
+    }
+    while(engine->demote_used+bytes>engine->demote_capacity && cold){
+        HermesExtent *prev=cold->demote_prev;
+        if(cold->pins==0){
+            hermes_demote_drop(engine,cold);
+            engine->stats.evictions++;
+            H5VL_hermes_stats_event(HERMES_EVENT_EVICTION);
+            H5VL_hermes_extent_release(cold);
+        }
+        cold=prev;
+    }
+    if(engine->demote_used+bytes>engine->demote_capacity){
+        free(coded);
+        return false;
+    }
+    if(list->count) offset=list->offsets[--list->count];
+    else{
+        /* The mapping cannot grow; a fragmented tier declines instead. */
+        if(engine->demote_map && engine->demote_end+(off_t)bytes>(off_t)engine->demote_capacity) return false;
+        offset=engine->demote_end;
+        engine->demote_end+=(off_t)bytes;
+    }
+    if(hermes_demote_io(engine,src,stored,offset,true)<0){
+        if(offset+(off_t)bytes==engine->demote_end) engine->demote_end=offset;
+        else if(list->count<list->capacity) list->offsets[list->count++]=offset;
+        free(coded);
+        return false;
+    }
+    free(coded);
+    if(engine->compress){
+        engine->stats.coded_bytes+=e->bytes;
+        engine->stats.coded_stored+=stored;
+    }
+    e->demoted=true;
+    e->demote_offset=offset;
+    e->demote_class=demote_class;
+    e->demote_stored=stored;
+    e->demote_prev=NULL;
+    e->demote_next=engine->demote_head;
+    if(engine->demote_head) engine->demote_head->demote_prev=e;
+    else engine->demote_tail=e;
+    engine->demote_head=e;
+    engine->demote_used+=bytes;
+    engine->stats.demotions++;
+    H5VL_hermes_stats_event(HERMES_EVENT_DEMOTION);
+    H5VL_hermes_stats_bytes(HERMES_TIER_DEMOTE,true,stored);
+    return true;
+}
+/**
+ * This method reads a demoted extent back from an unmapped tier. It runs
+ * without the engine lock, so the caller passes what it read of the extent
+ * under it.
+ *
+ * @param offset of the slot
+ * @param stored bytes in the slot
+ * @param bytes of the extent
+ * @param set the extent belongs to
+ * @param data bytes bytes
+ * @return non-negative on success
+ */
+static herr_t hermes_demote_load(HermesPlacement *engine, off_t offset, size_t stored, size_t bytes,
+                                 const HermesExtentSet *set, void *data){
+    void *coded;
+    herr_t output;
+    if(stored==bytes) return hermes_full_io(engine->demote_fd,data,bytes,offset,false);
+    coded=malloc(stored);
+    if(coded==NULL) return -1;
+    output=hermes_full_io(engine->demote_fd,coded,stored,offset,false);
+    if(output>=0) output=H5VL_hermes_codec_decompress(coded,stored,set->elem_size,engine->shuffle,set->workers,data,
+                                                              bytes);
+    free(coded);
+    return output;
+}
+/**
+ * This method drops the RAM copy of an extent. A copy readers are still
+ * copying from is freed by the last of them; until then the extent is not
+ * taken back into RAM.
+ */
+static void hermes_extent_drop_data(HermesExtent *e){
+    if(e->readers) e->retired=e->data;
+    else free(e->data);
+    e->data=NULL;
+}
+static void hermes_extent_unread(HermesExtent *e){
+    if(--e->readers) return;
+    free(e->retired);
+    e->retired=NULL;
+    H5VL_hermes_extent_release(e);
+}
+/**
+ * This method takes an extent out of RAM on the policy's behalf.
+ */
+static void hermes_evict(HermesPlacement *engine, HermesExtent *e){
+    engine->cls->evict(engine->policy,e);
+    if(!hermes_demote(engine,e)){
+        engine->stats.evictions++;
+        H5VL_hermes_stats_event(HERMES_EVENT_EVICTION);
+    }
+    hermes_extent_drop_data(e);
+    engine->ram_used-=e->bytes;
+    H5VL_hermes_extent_release(e);
+}
+/**
+ * This method makes a loaded extent resident and lets the policy push out
+ * whatever no longer fits. The caller copies out of e before calling, since
+ * e itself may be the one pushed out.
+ */
+static void hermes_admit(HermesPlacement *engine, HermesExtent *e){
+    engine->ram_used+=e->bytes;
+    engine->cls->admit(engine->policy,e);
+    while(engine->ram_used>engine->ram_capacity){
+        HermesExtent *victim=engine->cls->victim(engine->policy);
+        if(victim==NULL) break;
+        hermes_evict(engine,victim);
+    }
+}
+static size_t hermes_extent_bytes(const HermesExtentSet *set, size_t index){
+    hsize_t rows=set->dims[0]-(hsize_t)index*set->rows;
+    size_t bytes=set->elem_size*(size_t)(rows<set->rows?rows:set->rows);
+    int i;
+    for(i=1;i<set->rank;i++) bytes*=set->dims[i];
+    return bytes;
+}
+static uint64_t hermes_box_bytes(const HermesExtentSet *set, const hsize_t *count){
+    uint64_t bytes=set->elem_size;
+    int i;
+    for(i=0;i<set->rank;i++) bytes*=count[i];
+    return bytes;
+}
+static HermesExtent *hermes_extent_get(HermesExtentSet *set, size_t index, bool create){
+    HermesExtent *e;
+    if(set->extents==NULL){
+        if(!create) return NULL;
+        set->extents=(HermesExtent **)calloc(set->nextents,sizeof(HermesExtent *));
+        if(set->extents==NULL) return NULL;
+        set->capacity=set->nextents;
+    }
+    e=set->extents[index];
+    if(e || !create) return e;
+    e=(HermesExtent *)H5VL_hermes_pool_get(&hermes_extent_pool);
+    if(e==NULL) return NULL;
+    e->set=set;
+    e->index=index;
+    e->bytes=hermes_extent_bytes(set,index);
+    set->extents[index]=e;
+    return e;
+}
+/**
+ * This method sizes extents in rows of the slowest dimension. It does not
+ * depend on that dimension, so appending never changes it.
+ */
+static hsize_t hermes_extent_rows(const HermesPlacement *engine, int rank, const hsize_t *dims, size_t elem_size){
+    size_t row_bytes=elem_size;
+    hsize_t rows;
+    int i;
+    for(i=1;i<rank;i++) row_bytes*=dims[i];
+    rows=row_bytes?engine->extent_bytes/row_bytes:0;
+    return rows?rows:1;
+}
+/**
+ * This method forgets an extent in every tier and frees it. The engine lock
+ * is held.
+ */
+static void hermes_extent_forget(HermesPlacement *engine, HermesExtent *e){
+    engine->cls->forget(engine->policy,e);
+    if(e->data){
+        engine->ram_used-=e->bytes;
+        free(e->data);
+    }
+    free(e->retired);
+    hermes_demote_drop(engine,e);
+    H5VL_hermes_pool_put(&hermes_extent_pool,e);
+}
+/**
+ * This method computes the box of extent index and the part of the request
+ * box lying in it.
+ */
+static void hermes_extent_box(const HermesExtentSet *set, size_t index, const hsize_t *file_start,
+                              const hsize_t *file_end, const hsize_t *memory_start, hsize_t *extent_start,
+                              hsize_t *extent_dims, hsize_t *count, hsize_t *src_start, hsize_t *dst_start){
+    hsize_t first=(hsize_t)index*set->rows,lo,hi;
+    int i;
+    extent_dims[0]=set->dims[0]-first<set->rows?set->dims[0]-first:set->rows;
+    extent_start[0]=first;
+    lo=file_start[0]>first?file_start[0]:first;
+    hi=file_end[0]<first+extent_dims[0]-1?file_end[0]:first+extent_dims[0]-1;
+    count[0]=hi-lo+1;
+    src_start[0]=lo-first;
+    dst_start[0]=memory_start[0]+(lo-file_start[0]);
+    for(i=1;i<set->rank;i++){
+        extent_dims[i]=set->dims[i];
+        extent_start[i]=0;
+        count[i]=file_end[i]-file_start[i]+1;
+        src_start[i]=file_start[i];
+        dst_start[i]=memory_start[i];
+    }
+}
+
+/**
+ * This method frees a set and every extent it still has. The engine lock is
+ * held.
+ */
+static void hermes_extent_set_drop(HermesPlacement *engine, HermesExtentSet *set){
+    size_t i;
+    for(i=0;set->extents && i<set->nextents;i++)
+        if(set->extents[i]) hermes_extent_forget(engine,set->extents[i]);
+    free(set->extents);
+    free(set->path);
+    free(set->name);
+    free(set);
+}
+static void hermes_park(HermesPlacement *engine, HermesExtentSet *set){
+    set->parked_prev=NULL;
+    set->parked_next=engine->parked;
+    if(engine->parked) engine->parked->parked_prev=set;
+    engine->parked=set;
+}
+static void hermes_unpark(HermesPlacement *engine, HermesExtentSet *set){
+    if(set->parked_prev) set->parked_prev->parked_next=set->parked_next;
+    else engine->parked=set->parked_next;
+    if(set->parked_next) set->parked_next->parked_prev=set->parked_prev;
+    set->parked_prev=set->parked_next=NULL;
+}
+/**
+ * This method keeps the extents of a closed dataset in the demotion tier for
+ * its next open, in this run or a later one. RAM copies are demoted; what
+ * the tier cannot take is dropped. The engine lock is held.
+ */
+static void hermes_extent_set_park(HermesPlacement *engine, HermesExtentSet *set){
+    size_t i;
+    for(i=0;set->extents && i<set->nextents;i++){
+        HermesExtent *e=set->extents[i];
+        if(e==NULL) continue;
+        engine->cls->forget(engine->policy,e);
+        if(e->data){
+            if(!e->demoted) hermes_demote(engine,e);
+            hermes_extent_drop_data(e);
+            engine->ram_used-=e->bytes;
+        }
+        free(e->retired);
+        e->retired=NULL;
+        if(!e->demoted){
+            set->extents[i]=NULL;
+            H5VL_hermes_pool_put(&hermes_extent_pool,e);
+        }
+    }
+    set->stamped=false;
+    hermes_park(engine,set);
+}
+static char *hermes_canonical_path(const char *path){
+    char *canonical=realpath(path,NULL);
+    if(canonical==NULL){
+        canonical=(char *)malloc(strlen(path)+1);
+        if(canonical) strcpy(canonical,path);
+    }
+    return canonical;
+}
+static bool hermes_stamp_take(const char *path, HermesStamp *stamp){
+    struct stat st;
+    if(stat(path,&st)<0) return false;
+    memset(stamp,0,sizeof(HermesStamp));
+    stamp->size=(uint64_t)st.st_size;
+    stamp->mtime_sec=(int64_t)st.st_mtim.tv_sec;
+    stamp->mtime_nsec=(int64_t)st.st_mtim.tv_nsec;
+    stamp->ino=(uint64_t)st.st_ino;
+    return true;
+}
+
+/* The index is built and parsed in memory; a short read fails the whole blob. */
+typedef struct HermesBlob {
+    char *data;
+    size_t size;
+    size_t capacity;
+    size_t at;
+    bool failed;
+} HermesBlob;
+
+static void hermes_blob_put(HermesBlob *blob, const void *src, size_t bytes){
+    if(blob->failed) return;
+    if(blob->size+bytes>blob->capacity){
+        size_t capacity=blob->capacity?blob->capacity:4096;
+        char *data;
+        while(capacity<blob->size+bytes) capacity*=2;
+        data=(char *)realloc(blob->data,capacity);
+        if(data==NULL){
+            blob->failed=true;
+            return;
+        }
+        blob->data=data;
+        blob->capacity=capacity;
+    }
+    memcpy(blob->data+blob->size,src,bytes);
+    blob->size+=bytes;
+}
+static void hermes_blob_u64(HermesBlob *blob, uint64_t value){
+    hermes_blob_put(blob,&value,sizeof(uint64_t));
+}
+static void hermes_blob_string(HermesBlob *blob, const char *s){
+    hermes_blob_u64(blob,strlen(s));
+    hermes_blob_put(blob,s,strlen(s));
+}
+static bool hermes_blob_get(HermesBlob *blob, void *dst, size_t bytes){
+    if(blob->failed || blob->size-blob->at<bytes){
+        blob->failed=true;
+        return false;
+    }
+    memcpy(dst,blob->data+blob->at,bytes);
+    blob->at+=bytes;
+    return true;
+}
+static uint64_t hermes_blob_get_u64(HermesBlob *blob){
+    uint64_t value=0;
+    hermes_blob_get(blob,&value,sizeof(uint64_t));
+    return value;
+}
+static char *hermes_blob_get_string(HermesBlob *blob){
+    uint64_t length=hermes_blob_get_u64(blob);
+    char *s;
+    if(blob->failed || length>blob->size-blob->at) return NULL;
+    s=(char *)malloc((size_t)length+1);
+    if(s==NULL) return NULL;
+    hermes_blob_get(blob,s,(size_t)length);
+    s[length]='\0';
+    return s;
+}
+/* FNV-1a */
+static uint64_t hermes_blob_checksum(const char *data, size_t bytes){
+    uint64_t hash=14695981039346656037ull;
+    size_t i;
+    for(i=0;i<bytes;i++) hash=(hash^(unsigned char)data[i])*1099511628211ull;
+    return hash;
+}
+static char *hermes_index_path(const HermesPlacement *engine, const char *suffix){
+    char *path=(char *)malloc(strlen(engine->persist_path)+strlen(suffix)+1);
+    if(path) sprintf(path,"%s%s",engine->persist_path,suffix);
+    return path;
+}
+/**
+ * This method writes the index of a kept tier: every parked set with the
+ * stamp of its file, their extents from the most to the least recently
+ * demoted, and the free slots. Sets whose file is gone are dropped. The
+ * tier reaches the device before the index, which replaces the old one by
+ * a rename. Called by the last reference, so without the lock.
+ */
+static void hermes_index_save(HermesPlacement *engine){
+    HermesBlob blob={0};
+    HermesExtentSet *set,*next;
+    HermesExtent *e;
+    uint64_t nsets=0,nextents=0;
+    char *tmp=hermes_index_path(engine,".index.tmp"),*path=hermes_index_path(engine,".index");
+    unsigned i;
+    size_t j;
+    int d,fd;
+    for(set=engine->parked;set;set=next){
+        bool empty=true;
+        next=set->parked_next;
+        for(j=0;set->extents && j<set->nextents && empty;j++) empty=set->extents[j]==NULL;
+        if(!set->stamped && !empty) set->stamped=hermes_stamp_take(set->path,&set->stamp);
+        if(set->stamped && !empty) set->ordinal=nsets++;
+        else{
+            hermes_unpark(engine,set);
+            hermes_extent_set_drop(engine,set);
+        }
+    }
+    for(e=engine->demote_head;e;e=e->demote_next) nextents++;
+    hermes_blob_u64(&blob,HERMES_INDEX_MAGIC);
+    hermes_blob_u64(&blob,HERMES_INDEX_VERSION);
+    hermes_blob_u64(&blob,engine->extent_bytes);
+    hermes_blob_u64(&blob,engine->compress);
+    hermes_blob_u64(&blob,engine->shuffle);
+    hermes_blob_u64(&blob,(uint64_t)engine->demote_end);
+    hermes_blob_u64(&blob,nsets);
+    for(set=engine->parked;set;set=set->parked_next){
+        hermes_blob_string(&blob,set->path);
+        hermes_blob_string(&blob,set->name);
+        hermes_blob_put(&blob,&set->stamp,sizeof(HermesStamp));
+        hermes_blob_u64(&blob,(uint64_t)set->rank);
+        hermes_blob_u64(&blob,set->elem_size);
+        for(d=0;d<set->rank;d++) hermes_blob_u64(&blob,set->dims[d]);
+    }
+    hermes_blob_u64(&blob,nextents);
+    for(e=engine->demote_head;e;e=e->demote_next){
+        hermes_blob_u64(&blob,e->set->ordinal);
+        hermes_blob_u64(&blob,e->index);
+        hermes_blob_u64(&blob,(uint64_t)e->demote_offset);
+        hermes_blob_u64(&blob,e->demote_class);
+        hermes_blob_u64(&blob,e->demote_stored);
+    }
+    for(i=0;i<HERMES_DEMOTE_CLASSES;i++){
+        hermes_blob_u64(&blob,engine->free_slots[i].count);
+        for(j=0;j<engine->free_slots[i].count;j++) hermes_blob_u64(&blob,(uint64_t)engine->free_slots[i].offsets[j]);
+    }
+    hermes_blob_u64(&blob,hermes_blob_checksum(blob.data,blob.size));
+    if(engine->demote_map) msync(engine->demote_map,engine->demote_capacity,MS_SYNC);
+    if(!blob.failed && tmp && path && fdatasync(engine->demote_fd)==0){
+        fd=open(tmp,O_WRONLY|O_CREAT|O_TRUNC,0600);
+        if(fd>=0){
+            bool written=hermes_full_io(fd,blob.data,blob.size,0,true)>=0 && fsync(fd)==0;
+            close(fd);
+            if(!written || rename(tmp,path)<0) unlink(tmp);
+        }
+    }
+    free(blob.data);
+    free(tmp);
+    free(path);
+}
+/**
+ * This method parses the index of a kept tier into parked sets. An extent
+ * the index gives that is not where the engine could have put it, or that
+ * the tier no longer has room for, gives its slot back instead.
+ *
+ * @return false if the index is missing or does not fit the engine
+ */
+static bool hermes_index_parse(HermesPlacement *engine, HermesBlob *blob){
+    HermesExtentSet **sets;
+    uint64_t nsets,nextents,i,j,count,checksum;
+    off_t demote_end;
+    bool output=true;
+    int d;
+    if(blob->size<sizeof(uint64_t)) return false;
+    blob->size-=sizeof(uint64_t);
+    memcpy(&checksum,blob->data+blob->size,sizeof(uint64_t));
+    if(checksum!=hermes_blob_checksum(blob->data,blob->size)) return false;
+    if(hermes_blob_get_u64(blob)!=HERMES_INDEX_MAGIC || hermes_blob_get_u64(blob)!=HERMES_INDEX_VERSION ||
+       hermes_blob_get_u64(blob)!=engine->extent_bytes || hermes_blob_get_u64(blob)!=engine->compress ||
+       hermes_blob_get_u64(blob)!=engine->shuffle)
+        return false;
+    demote_end=(off_t)hermes_blob_get_u64(blob);
+    nsets=hermes_blob_get_u64(blob);
+    if(blob->failed || demote_end<0 || nsets>blob->size ||
+       (engine->demote_map && demote_end>(off_t)engine->demote_capacity))
+        return false;
+    sets=(HermesExtentSet **)calloc(nsets?nsets:1,sizeof(HermesExtentSet *));
+    if(sets==NULL) return false;
+    for(i=0;i<nsets && output;i++){
+        HermesExtentSet *set=(HermesExtentSet *)calloc(1,sizeof(HermesExtentSet));
+        if(set==NULL){
+            output=false;
+            break;
+        }
+        set->engine=engine;
+        hermes_park(engine,set);
+        set->path=hermes_blob_get_string(blob);
+        set->name=hermes_blob_get_string(blob);
+        hermes_blob_get(blob,&set->stamp,sizeof(HermesStamp));
+        set->stamped=true;
+        set->rank=(int)hermes_blob_get_u64(blob);
+        set->elem_size=(size_t)hermes_blob_get_u64(blob);
+        if(set->path==NULL || set->name==NULL || set->rank<1 || set->rank>H5S_MAX_RANK || set->elem_size==0){
+            output=false;
+            break;
+        }
+        for(d=0;d<set->rank;d++) set->dims[d]=hermes_blob_get_u64(blob);
+        set->rows=hermes_extent_rows(engine,set->rank,set->dims,set->elem_size);
+        set->nextents=(size_t)((set->dims[0]+set->rows-1)/set->rows);
+        sets[i]=set;
+    }
+    nextents=output?hermes_blob_get_u64(blob):0;
+    for(i=0;i<nextents && output && !blob->failed;i++){
+        uint64_t ordinal=hermes_blob_get_u64(blob),index=hermes_blob_get_u64(blob);
+        off_t offset=(off_t)hermes_blob_get_u64(blob);
+        uint64_t demote_class=hermes_blob_get_u64(blob),stored=hermes_blob_get_u64(blob);
+        HermesExtentSet *set=ordinal<nsets?sets[ordinal]:NULL;
+        HermesExtent *e=NULL;
+        size_t bytes;
+        if(blob->failed || demote_class>=HERMES_DEMOTE_CLASSES || offset<0){
+            output=false;
+            break;
+        }
+        bytes=hermes_demote_class_bytes((unsigned)demote_class);
+        if(offset+(off_t)bytes>demote_end) continue;
+        if(set && index<set->nextents && stored>0 && stored<=bytes &&
+           stored<=hermes_extent_bytes(set,(size_t)index) && (engine->compress || stored==hermes_extent_bytes(set,(size_t)index)) &&
+           engine->demote_used+bytes<=engine->demote_capacity)
+            e=hermes_extent_get(set,(size_t)index,true);
+        if(e==NULL || e->demoted){
+            hermes_slot_free(engine,(unsigned)demote_class,offset);
+            continue;
+        }
+        e->demoted=true;
+        e->demote_offset=offset;
+        e->demote_class=(unsigned)demote_class;
+        e->demote_stored=(size_t)stored;
+        e->demote_next=NULL;
+        e->demote_prev=engine->demote_tail;
+        if(engine->demote_tail) engine->demote_tail->demote_next=e;
+        else engine->demote_head=e;
+        engine->demote_tail=e;
+        engine->demote_used+=bytes;
+    }
+    for(i=0;i<HERMES_DEMOTE_CLASSES && output && !blob->failed;i++){
+        count=hermes_blob_get_u64(blob);
+        for(j=0;j<count && !blob->failed;j++){
+            off_t offset=(off_t)hermes_blob_get_u64(blob);
+            if(!blob->failed && offset>=0 && offset+(off_t)hermes_demote_class_bytes((unsigned)i)<=demote_end)
+                hermes_slot_free(engine,(unsigned)i,offset);
+        }
+    }
+    free(sets);
+    if(!output || blob->failed) return false;
+    engine->demote_end=demote_end;
+    return true;
+}
+/**
+ * This method takes over the index a previous run left next to a kept tier
+ * and removes it, so that a crash of this run cannot have the next one trust
+ * slots this run has reused. Without a usable index the tier starts empty.
+ * The engine lock is held.
+ */
+static void hermes_index_load(HermesPlacement *engine){
+    HermesBlob blob={0};
+    char *path=hermes_index_path(engine,".index");
+    struct stat st;
+    unsigned i;
+    int fd=path?open(path,O_RDONLY):-1;
+    if(fd>=0){
+        if(fstat(fd,&st)==0 && st.st_size>0){
+            blob.data=(char *)malloc((size_t)st.st_size);
+            if(blob.data && hermes_full_io(fd,blob.data,(size_t)st.st_size,0,false)>=0) blob.size=(size_t)st.st_size;
+        }
+        close(fd);
+        unlink(path);
+    }
+    free(path);
+    if(!hermes_index_parse(engine,&blob)){
+        while(engine->parked){
+            HermesExtentSet *set=engine->parked;
+            hermes_unpark(engine,set);
+            hermes_extent_set_drop(engine,set);
+        }
+        for(i=0;i<HERMES_DEMOTE_CLASSES;i++) engine->free_slots[i].count=0;
+        engine->demote_used=0;
+        /* Stale slots are harmless; truncating only gives their space back. */
+        if(engine->demote_map || ftruncate(engine->demote_fd,0)==0) engine->demote_end=0;
+    }
+    free(blob.data);
+}
+
+const HermesPlacementClass *H5VL_hermes_placement_class(HermesPlacementKind kind){
+    switch(kind){
+        case HERMES_PLACEMENT_LRU: return &H5VL_hermes_lru_g;
+        case HERMES_PLACEMENT_LFU: return &H5VL_hermes_lfu_g;
+        case HERMES_PLACEMENT_ARC: return &H5VL_hermes_arc_g;
+        default: return NULL;
+    }
+}
+/**
+ * This method creates a placement engine.
+ *
+ * @param cls replacement policy of the RAM tier
+ * @param ram_bytes capacity of the RAM tier
+ * @param extent_bytes target size of an extent, 0 for the default
+ * @param demote_dir directory of the demotion tier, e.g. on a burst buffer or
+ *        NVMe device; NULL for none
+ * @param demote_bytes capacity of the demotion tier
+ * @return engine holding one reference, or NULL
+ */
+HermesPlacement *H5VL_hermes_placement_create(const HermesPlacementClass *cls, size_t ram_bytes,
+                                              size_t extent_bytes, const char *demote_dir, size_t demote_bytes){
+    static unsigned long serial=0;
+    HermesPlacement *engine;
+    if(cls==NULL || ram_bytes==0) return NULL;
+    engine=(HermesPlacement *)calloc(1,sizeof(HermesPlacement));
+    if(engine==NULL) return NULL;
+    engine->policy=cls->create(ram_bytes);
+    if(engine->policy==NULL){
+        free(engine);
+        return NULL;
+    }
+    pthread_mutex_init(&engine->lock,NULL);
+    engine->refs=1;
+    engine->cls=cls;
+    engine->ram_capacity=ram_bytes;
+    engine->extent_bytes=extent_bytes?extent_bytes:HERMES_PLACEMENT_DEFAULT_EXTENT;
+    engine->demote_fd=-1;
+    if(demote_dir && demote_bytes){
+        char *path=(char *)malloc(strlen(demote_dir)+64);
+        if(path){
+            sprintf(path,"%s/hermes-vol-%ld-%lu.tier",demote_dir,(long)getpid(),
+                    __sync_fetch_and_add(&serial,1));
+            engine->demote_fd=open(path,O_RDWR|O_CREAT|O_TRUNC,0600);
+            /* Nothing in the tier outlives the process. */
+            if(engine->demote_fd>=0) unlink(path);
+            free(path);
+        }
+        if(engine->demote_fd>=0) engine->demote_capacity=demote_bytes;
+    }
+    return engine;
+}
+HermesPlacement *H5VL_hermes_placement_ref(HermesPlacement *engine){
+    if(engine==NULL) return NULL;
+    pthread_mutex_lock(&engine->lock);
+    engine->refs++;
+    pthread_mutex_unlock(&engine->lock);
+    return engine;
+}
+/**
+ * This method drops a reference to an engine. Every extent set using it must
+ * be freed first.
+ *
+ * @param engine
+ */
+void H5VL_hermes_placement_release(HermesPlacement *engine){
+    unsigned i;
+    if(engine==NULL) return;
+    pthread_mutex_lock(&engine->lock);
+    if(--engine->refs>0){
+        pthread_mutex_unlock(&engine->lock);
+        return;
+    }
+    pthread_mutex_unlock(&engine->lock);
+    if(engine->persist_path) hermes_index_save(engine);
+    while(engine->parked){
+        HermesExtentSet *set=engine->parked;
+        hermes_unpark(engine,set);
+        hermes_extent_set_drop(engine,set);
+    }
+    free(engine->persist_path);
+    engine->cls->destroy(engine->policy);
+    for(i=0;i<HERMES_DEMOTE_CLASSES;i++) free(engine->free_slots[i].offsets);
+    if(engine->demote_map) munmap(engine->demote_map,engine->demote_capacity);
+    if(engine->demote_fd>=0) close(engine->demote_fd);
+    pthread_mutex_destroy(&engine->lock);
+    free(engine);
+}
+/**
+ * This method maps the whole demotion tier into memory, which suits a local
+ * SSD or NVMe device: demoted extents are then copied straight from the
+ * mapping into the reader's buffer, or handed out in place by
+ * H5VL_hermes_placement_view, and stay in the tier when read. Writes update
+ * them in place. Only possible before anything has been demoted.
+ *
+ * @param engine engine with a demotion tier
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_placement_map(HermesPlacement *engine){
+    herr_t output=0;
+    void *map;
+    if(engine==NULL) return -1;
+    pthread_mutex_lock(&engine->lock);
+    if(engine->demote_map==NULL){
+        if(engine->demote_fd<0 || engine->demote_end>0 || engine->compress ||
+           ftruncate(engine->demote_fd,(off_t)engine->demote_capacity)<0){
+            output=-1;
+        }else{
+            /* The file stays sparse; only slots in use take space on the device. */
+            map=mmap(NULL,engine->demote_capacity,PROT_READ|PROT_WRITE,MAP_SHARED,engine->demote_fd,0);
+            if(map==MAP_FAILED) output=-1;
+            else engine->demote_map=(char *)map;
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return output;
+}
+/**
+ * This method makes the demotion tier code the extents it takes, trading
+ * some CPU on demotion and promotion for capacity and device bandwidth.
+ * Blocks of an extent are coded in parallel on the worker pool. Only for a
+ * tier that is not mapped, and only before anything has been demoted.
+ *
+ * @param engine engine with a demotion tier
+ * @param shuffle whether to shuffle bytes by element size first
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_placement_compress(HermesPlacement *engine, bool shuffle){
+    herr_t output=0;
+    if(engine==NULL) return -1;
+    pthread_mutex_lock(&engine->lock);
+    if(engine->demote_fd<0 || engine->demote_map || engine->demote_end>0) output=-1;
+    else{
+        engine->compress=true;
+        engine->shuffle=shuffle;
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return output;
+}
+/**
+ * This method moves the demotion tier to path and keeps it there across
+ * runs: closed datasets leave their extents in it, and the index written
+ * next to it when the engine goes away lets the next engine persisting to
+ * the same path find them. Only one process at a time owns a kept tier.
+ * Only before anything has been demoted; a mapped tier is mapped anew.
+ *
+ * @param engine engine with a demotion tier
+ * @param path tier file, on the same device as the directory given to
+ *        H5VL_hermes_placement_create
+ * @return non-negative on success; fails, changing nothing, if another
+ *         process owns path
+ */
+herr_t H5VL_hermes_placement_persist(HermesPlacement *engine, const char *path){
+    herr_t output=0;
+    void *map=NULL;
+    int fd=-1;
+    if(engine==NULL || path==NULL) return -1;
+    pthread_mutex_lock(&engine->lock);
+    if(engine->demote_fd<0 || engine->demote_end>0 || engine->persist_path) output=-1;
+    if(output>=0){
+        fd=open(path,O_RDWR|O_CREAT,0600);
+        if(fd<0 || flock(fd,LOCK_EX|LOCK_NB)<0) output=-1;
+    }
+    if(output>=0 && engine->demote_map){
+        if(ftruncate(fd,(off_t)engine->demote_capacity)<0) output=-1;
+        else map=mmap(NULL,engine->demote_capacity,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+        if(map==MAP_FAILED) output=-1;
+    }
+    if(output>=0) engine->persist_path=(char *)malloc(strlen(path)+1);
+    if(engine->persist_path==NULL) output=-1;
+    if(output<0){
+        if(map && map!=MAP_FAILED) munmap(map,engine->demote_capacity);
+        if(fd>=0) close(fd);
+        pthread_mutex_unlock(&engine->lock);
+        return -1;
+    }
+    strcpy(engine->persist_path,path);
+    if(engine->demote_map){
+        munmap(engine->demote_map,engine->demote_capacity);
+        engine->demote_map=(char *)map;
+    }
+    close(engine->demote_fd);
+    engine->demote_fd=fd;
+    hermes_index_load(engine);
+    pthread_mutex_unlock(&engine->lock);
+    return output;
+}
+/**
+ * This method checks what a kept tier holds of a file against the file as
+ * it is now, before it is opened, and drops the extents of datasets in it
+ * when it changed since it was last closed.
+ *
+ * @param engine
+ * @param file path of the native file
+ * @param truncated the file is being created anew, so nothing held is valid
+ */
+void H5VL_hermes_placement_validate(HermesPlacement *engine, const char *file, bool truncated){
+    HermesExtentSet *set,*next;
+    HermesStamp stamp;
+    char *path;
+    bool exists;
+    if(engine==NULL || engine->persist_path==NULL) return;
+    path=hermes_canonical_path(file);
+    if(path==NULL) return;
+    exists=hermes_stamp_take(path,&stamp);
+    pthread_mutex_lock(&engine->lock);
+    for(set=engine->parked;set;set=next){
+        next=set->parked_next;
+        if(strcmp(set->path,path)) continue;
+        if(truncated || (set->stamped && (!exists || memcmp(&stamp,&set->stamp,sizeof(HermesStamp))))){
+            hermes_unpark(engine,set);
+            hermes_extent_set_drop(engine,set);
+        }else{
+            /* Open again, the file may change before the next stamp. */
+            set->stamped=false;
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+    free(path);
+}
+/**
+ * This method records what a file looks like once closed, as the stamp
+ * the extents parked for its datasets are valid against.
+ *
+ * @param engine
+ * @param file path of the native file
+ */
+void H5VL_hermes_placement_stamp(HermesPlacement *engine, const char *file){
+    HermesExtentSet *set;
+    HermesStamp stamp;
+    char *path;
+    if(engine==NULL || engine->persist_path==NULL) return;
+    path=hermes_canonical_path(file);
+    if(path==NULL) return;
+    if(hermes_stamp_take(path,&stamp)){
+        pthread_mutex_lock(&engine->lock);
+        for(set=engine->parked;set;set=set->parked_next){
+            if(strcmp(set->path,path)) continue;
+            set->stamp=stamp;
+            set->stamped=true;
+        }
+        pthread_mutex_unlock(&engine->lock);
+    }
+    free(path);
+}
+void H5VL_hermes_placement_stats(HermesPlacement *engine, HermesPlacementStats *stats){
+    if(engine==NULL){
+        memset(stats,0,sizeof(HermesPlacementStats));
+        return;
+    }
+    pthread_mutex_lock(&engine->lock);
+    *stats=engine->stats;
+    stats->ram_bytes=engine->ram_used;
+    stats->demote_bytes=engine->demote_used;
+    pthread_mutex_unlock(&engine->lock);
+}
+/**
+ * This method frees an extent no tier and no policy holds any more. Called
+ * with the engine lock held, also by policies dropping a ghost.
+ *
+ * @param e
+ */
+void H5VL_hermes_extent_release(HermesExtent *e){
+    if(e->data || e->demoted || e->ghost || e->pins || e->readers) return;
+    e->set->extents[e->index]=NULL;
+    H5VL_hermes_pool_put(&hermes_extent_pool,e);
+}
+
+/**
+ * This method divides a dataset into extents managed by engine.
+ *
+ * @param engine
+ * @param rank rank of the dataset, at least 1
+ * @param dims extent of the dataset
+ * @param elem_size size of the dataset type
+ * @param workers size of the async pool, 0 to code extents on the caller
+ * @return extent set, or NULL
+ */
+HermesExtentSet *H5VL_hermes_extent_set_create(HermesPlacement *engine, int rank, const hsize_t *dims,
+                                               size_t elem_size, unsigned workers){
+    HermesExtentSet *set;
+    if(engine==NULL || rank<1 || elem_size==0) return NULL;
+    set=(HermesExtentSet *)calloc(1,sizeof(HermesExtentSet));
+    if(set==NULL) return NULL;
+    set->engine=engine;
+    set->rank=rank;
+    memcpy(set->dims,dims,sizeof(hsize_t)*rank);
+    set->elem_size=elem_size;
+    set->workers=workers;
+    set->rows=hermes_extent_rows(engine,rank,dims,elem_size);
+    set->nextents=(size_t)((dims[0]+set->rows-1)/set->rows);
+    return set;
+}
+/**
+ * This method frees an extent set. Views on it must have been given back.
+ * The extents of a set kept by H5VL_hermes_extent_set_persist stay in the
+ * demotion tier instead.
+ *
+ * @param set
+ */
+void H5VL_hermes_extent_set_free(HermesExtentSet *set){
+    HermesPlacement *engine;
+    if(set==NULL) return;
+    engine=set->engine;
+    pthread_mutex_lock(&engine->lock);
+    if(set->path) hermes_extent_set_park(engine,set);
+    else hermes_extent_set_drop(engine,set);
+    pthread_mutex_unlock(&engine->lock);
+}
+/**
+ * This method keys a new extent set by file and dataset when its engine
+ * keeps its tier, so that its extents outlive the dataset's close. What the
+ * tier still holds of an earlier open of the dataset with the same geometry
+ * is taken over, unless the dataset has just been created.
+ *
+ * @param set freshly created
+ * @param file path of the native file
+ * @param name full path of the dataset in the file
+ * @param created whether the dataset is new, so nothing held of it is valid
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_extent_set_persist(HermesExtentSet *set, const char *file, const char *name, bool created){
+    HermesPlacement *engine;
+    HermesExtentSet *parked;
+    char *path,*key;
+    size_t i;
+    if(set==NULL || set->engine->persist_path==NULL) return 0;
+    engine=set->engine;
+    path=hermes_canonical_path(file);
+    key=(char *)malloc(strlen(name)+1);
+    if(path==NULL || key==NULL){
+        free(path);
+        free(key);
+        return -1;
+    }
+    strcpy(key,name);
+    pthread_mutex_lock(&engine->lock);
+    for(parked=engine->parked;parked;parked=parked->parked_next)
+        if(!strcmp(parked->path,path) && !strcmp(parked->name,key)) break;
+    if(parked){
+        hermes_unpark(engine,parked);
+        if(!created && set->extents==NULL && parked->rank==set->rank && parked->elem_size==set->elem_size &&
+           parked->rows==set->rows && !memcmp(parked->dims,set->dims,sizeof(hsize_t)*set->rank)){
+            set->extents=parked->extents;
+            set->capacity=parked->capacity;
+            parked->extents=NULL;
+            for(i=0;set->extents && i<set->nextents;i++)
+                if(set->extents[i]) set->extents[i]->set=set;
+        }
+        hermes_extent_set_drop(engine,parked);
+    }
+    free(set->path);
+    free(set->name);
+    set->path=path;
+    set->name=key;
+    pthread_mutex_unlock(&engine->lock);
+    return 0;
+}
+/**
+ * This method follows a change of the dataset's extent. Extents lying
+ * wholly inside both the old and the new extent keep their copies in every
+ * tier and the others are forgotten, so growing the slowest dimension, as
+ * appends do, only forgets the old last extent if it was partial. The index
+ * grows by doubling.
+ *
+ * @param set
+ * @param dims new extent of the dataset
+ * @return non-negative on success; fails, changing nothing, while a view or
+ *         a copy is out of an extent that would be forgotten
+ */
+herr_t H5VL_hermes_extent_set_resize(HermesExtentSet *set, const hsize_t *dims){
+    HermesPlacement *engine;
+    hsize_t rows,shorter;
+    size_t keep,nextents,i;
+    bool reshape=false;
+    int d;
+    if(set==NULL) return 0;
+    engine=set->engine;
+    for(d=1;d<set->rank;d++) if(dims[d]!=set->dims[d]) reshape=true;
+    rows=reshape?hermes_extent_rows(engine,set->rank,dims,set->elem_size):set->rows;
+    nextents=(size_t)((dims[0]+rows-1)/rows);
+    shorter=dims[0]<set->dims[0]?dims[0]:set->dims[0];
+    keep=reshape?0:(size_t)(shorter/rows);
+    pthread_mutex_lock(&engine->lock);
+    for(i=keep;set->extents && i<set->nextents;i++){
+        HermesExtent *e=set->extents[i];
+        if(e && (e->pins || e->readers)){
+            pthread_mutex_unlock(&engine->lock);
+            return -1;
+        }
+    }
+    if(set->extents && nextents>set->capacity){
+        size_t capacity=set->capacity*2>nextents?set->capacity*2:nextents;
+        HermesExtent **extents=(HermesExtent **)realloc(set->extents,capacity*sizeof(HermesExtent *));
+        if(extents==NULL){
+            pthread_mutex_unlock(&engine->lock);
+            return -1;
+        }
+        memset(extents+set->capacity,0,(capacity-set->capacity)*sizeof(HermesExtent *));
+        set->extents=extents;
+        set->capacity=capacity;
+    }
+    for(i=keep;set->extents && i<set->nextents;i++){
+        if(set->extents[i]) hermes_extent_forget(engine,set->extents[i]);
+        set->extents[i]=NULL;
+    }
+    memcpy(set->dims,dims,sizeof(hsize_t)*set->rank);
+    set->rows=rows;
+    set->nextents=nextents;
+    pthread_mutex_unlock(&engine->lock);
+    return 0;
+}
+/**
+ * This method serves one box of a read from the tiers, loading every extent
+ * the box touches that no tier holds through load.
+ *
+ * @param set extents of the dataset
+ * @param file_start first corner of the box
+ * @param file_end last corner of the box
+ * @param memory_start where the box lives in buf
+ * @param memory_dim extent of the memory array
+ * @param buf memory array
+ * @param load reads an extent from the buffer layer
+ * @param load_data passed through to load
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_placement_read(HermesExtentSet *set, hsize_t *file_start, hsize_t *file_end,
+                                  hsize_t *memory_start, hsize_t *memory_dim, void *buf,
+                                  HermesSelectionOp load, void *load_data){
+    HermesPlacement *engine=set->engine;
+    hsize_t extent_start[H5S_MAX_RANK],extent_end[H5S_MAX_RANK],extent_dims[H5S_MAX_RANK];
+    hsize_t count[H5S_MAX_RANK],src_start[H5S_MAX_RANK],dst_start[H5S_MAX_RANK],zero[H5S_MAX_RANK];
+    size_t index;
+    int i;
+    for(i=0;i<set->rank;i++) zero[i]=0;
+    for(index=(size_t)(file_start[0]/set->rows);index<=(size_t)(file_end[0]/set->rows);index++){
+        HermesExtent *e;
+        uint64_t writes;
+        void *data;
+        hermes_extent_box(set,index,file_start,file_end,memory_start,extent_start,extent_dims,count,src_start,
+                          dst_start);
+        pthread_mutex_lock(&engine->lock);
+        e=hermes_extent_get(set,index,false);
+        if(e && e->data){
+            engine->cls->hit(engine->policy,e);
+            engine->stats.ram_hits++;
+            H5VL_hermes_stats_event(HERMES_EVENT_RAM_HIT);
+            H5VL_hermes_stats_bytes(HERMES_TIER_RAM,false,hermes_box_bytes(set,count));
+            data=e->data;
+            e->readers++;
+            pthread_mutex_unlock(&engine->lock);
+            H5VL_hermes_box_copy(set->rank,set->elem_size,count,data,extent_dims,src_start,buf,memory_dim,
+                                 dst_start);
+            pthread_mutex_lock(&engine->lock);
+            hermes_extent_unread(e);
+            pthread_mutex_unlock(&engine->lock);
+            continue;
+        }
+        if(e && e->demoted && engine->demote_map){
+            hermes_demote_touch(engine,e);
+            engine->stats.demote_hits++;
+            H5VL_hermes_stats_event(HERMES_EVENT_DEMOTE_HIT);
+            H5VL_hermes_stats_bytes(HERMES_TIER_DEMOTE,false,hermes_box_bytes(set,count));
+            /* A pin keeps the slot from being handed to another extent meanwhile. */
+            e->pins++;
+            pthread_mutex_unlock(&engine->lock);
+            H5VL_hermes_box_copy(set->rank,set->elem_size,count,engine->demote_map+e->demote_offset,extent_dims,
+                                 src_start,buf,memory_dim,dst_start);
+            H5VL_hermes_placement_unview(e);
+            continue;
+        }
+        if(e && e->demoted){
+            /* The slot is read without the lock. The pin keeps it from being handed to another extent, except
+               when a write drops the copy, which the generation catches. */
+            off_t offset=e->demote_offset;
+            size_t stored=e->demote_stored,bytes=e->bytes;
+            herr_t loaded=-1;
+            writes=set->writes;
+            e->pins++;
+            pthread_mutex_unlock(&engine->lock);
+            data=malloc(bytes);
+            if(data) loaded=hermes_demote_load(engine,offset,stored,bytes,set,data);
+            pthread_mutex_lock(&engine->lock);
+            e->pins--;
+            if(loaded>=0 && set->writes==writes){
+                engine->stats.demote_hits++;
+                H5VL_hermes_stats_event(HERMES_EVENT_DEMOTE_HIT);
+                H5VL_hermes_stats_bytes(HERMES_TIER_DEMOTE,false,hermes_box_bytes(set,count));
+                H5VL_hermes_box_copy(set->rank,set->elem_size,count,data,extent_dims,src_start,buf,memory_dim,
+                                     dst_start);
+                /* Only the last reader of the slot frees it; another one may have taken the extent in already. */
+                if(e->demoted && !e->data && !e->retired && !e->pins){
+                    hermes_demote_drop(engine,e);
+                    e->data=data;
+                    hermes_admit(engine,e);
+                }else{
+                    free(data);
+                    H5VL_hermes_extent_release(e);
+                }
+                pthread_mutex_unlock(&engine->lock);
+                continue;
+            }
+            free(data);
+            H5VL_hermes_extent_release(e);
+        }
+        writes=set->writes;
+        pthread_mutex_unlock(&engine->lock);
+        /* The buffer layer is read without the engine lock; writers take them the other way round. */
+        for(i=0;i<set->rank;i++) extent_end[i]=extent_start[i]+extent_dims[i]-1;
+        data=malloc(hermes_extent_bytes(set,index));
+        if(data==NULL) return -1;
+        if(load(load_data,extent_start,extent_end,zero,extent_dims,data)<0){
+            free(data);
+            return -1;
+        }
+        H5VL_hermes_box_copy(set->rank,set->elem_size,count,data,extent_dims,src_start,buf,memory_dim,dst_start);
+        pthread_mutex_lock(&engine->lock);
+        e=hermes_extent_get(set,index,true);
+        engine->stats.misses++;
+        H5VL_hermes_stats_event(HERMES_EVENT_EXTENT_MISS);
+        /* A copy another reader got into a tier meanwhile is kept: writes update or drop those. A load that
+           raced a write, or that a queued box is newer than, may be stale and only serves this read. */
+        if(e && !e->data && !e->demoted && !e->retired && e->bytes<=engine->ram_capacity && set->writes==writes
+           && !set->queued){
+            e->data=data;
+            hermes_admit(engine,e);
+        }else{
+            free(data);
+            if(e) H5VL_hermes_extent_release(e);
+        }
+        pthread_mutex_unlock(&engine->lock);
+    }
+    return 0;
+}
+/**
+ * This method applies a written box to the tiers: RAM copies and mapped
+ * demoted copies are updated in place, other demoted copies dropped.
+ *
+ * @param set extents of the dataset
+ * @param file_start first corner of the box
+ * @param file_end last corner of the box
+ * @param memory_start where the box lives in buf
+ * @param memory_dim extent of the memory array
+ * @param buf memory array
+ */
+void H5VL_hermes_placement_update(HermesExtentSet *set, hsize_t *file_start, hsize_t *file_end,
+                                  hsize_t *memory_start, hsize_t *memory_dim, const void *buf){
+    HermesPlacement *engine=set->engine;
+    hsize_t extent_start[H5S_MAX_RANK],extent_dims[H5S_MAX_RANK];
+    hsize_t count[H5S_MAX_RANK],src_start[H5S_MAX_RANK],dst_start[H5S_MAX_RANK];
+    size_t index;
+    pthread_mutex_lock(&engine->lock);
+    set->writes++;
+    for(index=(size_t)(file_start[0]/set->rows);index<=(size_t)(file_end[0]/set->rows);index++){
+        HermesExtent *e=hermes_extent_get(set,index,false);
+        if(e==NULL) continue;
+        /* Same arithmetic as a read, with the copy going the other way. */
+        hermes_extent_box(set,index,file_start,file_end,memory_start,extent_start,extent_dims,count,
+                          dst_start,src_start);
+        if(e->data)
+            H5VL_hermes_box_copy(set->rank,set->elem_size,count,buf,memory_dim,src_start,e->data,extent_dims,
+                                 dst_start);
+        if(e->demoted && engine->demote_map){
+            H5VL_hermes_box_copy(set->rank,set->elem_size,count,buf,memory_dim,src_start,
+                                 engine->demote_map+e->demote_offset,extent_dims,dst_start);
+        }else if(e->demoted){
+            hermes_demote_drop(engine,e);
+            H5VL_hermes_extent_release(e);
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+}
+/**
+ * This method counts a written box whose tiers are updated but which the
+ * buffer layer does not have yet. Until none is left, nothing loaded from
+ * the buffer layer is kept.
+ *
+ * @param set extents of the dataset
+ * @param queued true when the box is queued, false once it is written or dropped
+ */
+void H5VL_hermes_placement_queue(HermesExtentSet *set, bool queued){
+    HermesPlacement *engine=set->engine;
+    pthread_mutex_lock(&engine->lock);
+    set->writes++;
+    if(queued) set->queued++;
+    else set->queued--;
+    pthread_mutex_unlock(&engine->lock);
+}
+/**
+ * This method moves an extent held in RAM by the caller into the mapped
+ * tier; resident says whether the RAM tier accounts for it.
+ *
+ * @return true if the extent is now in the mapped tier
+ */
+static bool hermes_map_extent(HermesPlacement *engine, HermesExtent *e, bool resident){
+    bool demoted;
+    if(resident){
+        engine->cls->evict(engine->policy,e);
+        engine->ram_used-=e->bytes;
+    }
+    demoted=hermes_demote(engine,e);
+    if(resident) hermes_extent_drop_data(e);
+    else{
+        free(e->data);
+        e->data=NULL;
+    }
+    return demoted;
+}
+/**
+ * This method hands out the mapped copy of a box of whole rows, or of a box
+ * otherwise contiguous in row-major order, lying in a single extent. The
+ * extent is moved into the mapped tier first if it is not there yet, and
+ * stays there until the view is given back; writes show through it.
+ *
+ * @param set extents of a dataset whose engine has a mapped tier
+ * @param file_start first corner of the box
+ * @param file_end last corner of the box
+ * @param load reads an extent from the buffer layer
+ * @param load_data passed through to load
+ * @param pinned set to the extent to give back with H5VL_hermes_placement_unview
+ * @return first element of the box, or NULL when it cannot be viewed
+ */
+const void *H5VL_hermes_placement_view(HermesExtentSet *set, const hsize_t *file_start, const hsize_t *file_end,
+                                       HermesSelectionOp load, void *load_data, HermesExtent **pinned){
+    HermesPlacement *engine=set->engine;
+    hsize_t extent_start[H5S_MAX_RANK],extent_end[H5S_MAX_RANK],extent_dims[H5S_MAX_RANK];
+    hsize_t count[H5S_MAX_RANK],src_start[H5S_MAX_RANK],dst_start[H5S_MAX_RANK],zero[H5S_MAX_RANK]={0};
+    size_t index=(size_t)(file_start[0]/set->rows),offset=0;
+    HermesExtent *e;
+    uint64_t writes;
+    const void *view=NULL;
+    void *data;
+    int i,k;
+    if(engine->demote_map==NULL || (size_t)(file_end[0]/set->rows)!=index) return NULL;
+    for(i=0;i<set->rank;i++)
+        if(file_start[i]>file_end[i] || file_end[i]>=set->dims[i]) return NULL;
+    hermes_extent_box(set,index,file_start,file_end,zero,extent_start,extent_dims,count,src_start,dst_start);
+    for(k=set->rank-1;k>0 && count[k]==extent_dims[k];k--);
+    for(i=0;i<k;i++) if(count[i]!=1) return NULL;
+    for(i=0;i<set->rank;i++) offset=offset*(size_t)extent_dims[i]+(size_t)src_start[i];
+    offset*=set->elem_size;
+    pthread_mutex_lock(&engine->lock);
+    e=hermes_extent_get(set,index,false);
+    if(e && !e->demoted && e->data){
+        if(!hermes_map_extent(engine,e,true)){
+            H5VL_hermes_extent_release(e);
+            e=NULL;
+        }
+    }else if(e && e->demoted){
+        engine->stats.demote_hits++;
+        H5VL_hermes_stats_event(HERMES_EVENT_DEMOTE_HIT);
+    }
+    if(e && e->demoted){
+        e->pins++;
+        hermes_demote_touch(engine,e);
+        view=engine->demote_map+e->demote_offset+offset;
+    }
+    writes=set->writes;
+    pthread_mutex_unlock(&engine->lock);
+    if(view){
+        H5VL_hermes_stats_bytes(HERMES_TIER_DEMOTE,false,hermes_box_bytes(set,count));
+        *pinned=e;
+        return view;
+    }
+    /* Loaded like a read miss, but admitted straight to the mapped tier. */
+    for(i=0;i<set->rank;i++) extent_end[i]=extent_start[i]+extent_dims[i]-1;
+    data=malloc(hermes_extent_bytes(set,index));
+    if(data==NULL) return NULL;
+    if(load(load_data,extent_start,extent_end,zero,extent_dims,data)<0){
+        free(data);
+        return NULL;
+    }
+    pthread_mutex_lock(&engine->lock);
+    e=hermes_extent_get(set,index,true);
+    engine->stats.misses++;
+    H5VL_hermes_stats_event(HERMES_EVENT_EXTENT_MISS);
+    if(e && (set->writes!=writes || set->queued)){
+        /* The load may be older than a write; a view of it would stay stale. */
+        H5VL_hermes_extent_release(e);
+        e=NULL;
+    }
+    if(e && e->data && !e->demoted && !hermes_map_extent(engine,e,true)){
+        /* Another reader got it into RAM meanwhile; that copy is the fresher one. */
+        H5VL_hermes_extent_release(e);
+        e=NULL;
+    }
+    if(e && !e->demoted){
+        e->data=data;
+        data=NULL;
+        if(!hermes_map_extent(engine,e,false)){
+            H5VL_hermes_extent_release(e);
+            e=NULL;
+        }
+    }
+    free(data);
+    if(e){
+        e->pins++;
+        hermes_demote_touch(engine,e);
+        view=engine->demote_map+e->demote_offset+offset;
+        *pinned=e;
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return view;
+}
+/**
+ * This method gives back a view handed out by H5VL_hermes_placement_view.
+ *
+ * @param e extent the view was pinned on
+ */
+void H5VL_hermes_placement_unview(HermesExtent *e){
+    HermesPlacement *engine;
+    if(e==NULL) return;
+    engine=e->set->engine;
+    pthread_mutex_lock(&engine->lock);
+    if(--e->pins==0) H5VL_hermes_extent_release(e);
+    pthread_mutex_unlock(&engine->lock);
+}
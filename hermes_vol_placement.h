@@ -0,0 +1,135 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_placement.h
+*
+* Purpose:Defines the placement engine which keeps hot dataset extents in a
+*         RAM tier, demotes cold ones to a file-backed tier and leaves the
+*         rest to the buffer layer. The replacement policy is pluggable.
+*
+*-------------------------------------------------------------------------
+*/
+
+#ifndef HERMES_PROJECT_HERMES_VOL_PLACEMENT_H
+#define HERMES_PROJECT_HERMES_VOL_PLACEMENT_H
+#include <hdf5.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "hermes_vol_selection.h"
+
+/* Extent size used when H5Pset_hermes_vol_placement is not given one. */
+#define HERMES_PLACEMENT_DEFAULT_EXTENT (1024*1024)
+
+typedef enum HermesPlacementKind {
+    HERMES_PLACEMENT_NONE,
+    HERMES_PLACEMENT_LRU,
+    HERMES_PLACEMENT_LFU,
+    HERMES_PLACEMENT_ARC
+} HermesPlacementKind;
+
+typedef struct HermesExtentSet HermesExtentSet;
+typedef struct HermesPlacement HermesPlacement;
+
+/**
+ * Unit of placement: a slab of whole rows along the slowest dimension of a
+ * dataset. The fields after ghost belong to the policy.
+ */
+typedef struct HermesExtent {
+    HermesExtentSet *set;
+    size_t index;           /* slab number within the dataset                 */
+    size_t bytes;
+    void *data;             /* RAM copy, NULL when not resident in RAM        */
+    bool demoted;           /* a copy is held by the demotion tier            */
+    off_t demote_offset;
+    unsigned demote_class;
+    size_t demote_stored;   /* bytes in the slot, fewer than bytes when coded  */
+    struct HermesExtent *demote_prev;
+    struct HermesExtent *demote_next;
+    unsigned pins;          /* views and copies out of the demoted copy       */
+    unsigned readers;       /* copies out of data made without the lock       */
+    void *retired;          /* data dropped while readers still copy from it  */
+    bool ghost;             /* remembered by the policy while not in RAM      */
+    int list;
+    struct HermesExtent *prev;
+    struct HermesExtent *next;
+    uint64_t freq;
+    uint64_t stamp;
+    size_t heap_index;
+} HermesExtent;
+
+/**
+ * A replacement policy for the RAM tier. Capacities are in bytes.
+ */
+typedef struct HermesPlacementClass {
+    const char *name;
+    void *(*create)(size_t capacity);
+    void (*destroy)(void *policy);
+    void (*hit)(void *policy, HermesExtent *e);         /* e was read from RAM         */
+    void (*admit)(void *policy, HermesExtent *e);       /* e has just entered RAM      */
+    HermesExtent *(*victim)(void *policy);              /* next extent to leave RAM    */
+    void (*evict)(void *policy, HermesExtent *e);       /* e leaves RAM, may stay ghost */
+    void (*forget)(void *policy, HermesExtent *e);      /* e is going away altogether  */
+} HermesPlacementClass;
+
+/**
+ * Counters of one engine.
+ */
+typedef struct HermesPlacementStats {
+    uint64_t ram_hits;
+    uint64_t demote_hits;   /* promotions back into RAM */
+    uint64_t misses;        /* extents loaded from the buffer layer */
+    uint64_t demotions;
+    uint64_t evictions;     /* extents dropped from every tier */
+    uint64_t coded_bytes;   /* demoted bytes that went through the codec */
+    uint64_t coded_stored;  /* what they took in the demotion tier */
+    size_t ram_bytes;
+    size_t demote_bytes;
+} HermesPlacementStats;
+
+extern const HermesPlacementClass H5VL_hermes_lru_g;
+extern const HermesPlacementClass H5VL_hermes_lfu_g;
+extern const HermesPlacementClass H5VL_hermes_arc_g;
+
+const HermesPlacementClass *H5VL_hermes_placement_class(HermesPlacementKind kind);
+HermesPlacement *H5VL_hermes_placement_create(const HermesPlacementClass *cls, size_t ram_bytes,
+                                              size_t extent_bytes, const char *demote_dir, size_t demote_bytes);
+HermesPlacement *H5VL_hermes_placement_ref(HermesPlacement *engine);
+void H5VL_hermes_placement_release(HermesPlacement *engine);
+herr_t H5VL_hermes_placement_map(HermesPlacement *engine);
+herr_t H5VL_hermes_placement_compress(HermesPlacement *engine, bool shuffle);
+herr_t H5VL_hermes_placement_persist(HermesPlacement *engine, const char *path);
+void H5VL_hermes_placement_validate(HermesPlacement *engine, const char *file, bool truncated);
+void H5VL_hermes_placement_stamp(HermesPlacement *engine, const char *file);
+void H5VL_hermes_placement_stats(HermesPlacement *engine, HermesPlacementStats *stats);
+void H5VL_hermes_extent_release(HermesExtent *e);
+
+HermesExtentSet *H5VL_hermes_extent_set_create(HermesPlacement *engine, int rank, const hsize_t *dims,
+                                               size_t elem_size, unsigned workers);
+void H5VL_hermes_extent_set_free(HermesExtentSet *set);
+herr_t H5VL_hermes_extent_set_persist(HermesExtentSet *set, const char *file, const char *name, bool created);
+herr_t H5VL_hermes_extent_set_resize(HermesExtentSet *set, const hsize_t *dims);
+herr_t H5VL_hermes_placement_read(HermesExtentSet *set, hsize_t *file_start, hsize_t *file_end,
+                                  hsize_t *memory_start, hsize_t *memory_dim, void *buf,
+                                  HermesSelectionOp load, void *load_data);
+void H5VL_hermes_placement_update(HermesExtentSet *set, hsize_t *file_start, hsize_t *file_end,
+                                  hsize_t *memory_start, hsize_t *memory_dim, const void *buf);
+void H5VL_hermes_placement_queue(HermesExtentSet *set, bool queued);
+const void *H5VL_hermes_placement_view(HermesExtentSet *set, const hsize_t *file_start, const hsize_t *file_end,
+                                       HermesSelectionOp load, void *load_data, HermesExtent **pinned);
+void H5VL_hermes_placement_unview(HermesExtent *e);
+#endif //HERMES_PROJECT_HERMES_VOL_PLACEMENT_H
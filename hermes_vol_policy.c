@@ -0,0 +1,274 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_policy.c
+*
+* Purpose:Implements the replacement policies shipped with the placement
+*         engine: LRU, LFU and ARC. Every callback runs with the engine lock
+*         held.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <stdlib.h>
+#include "hermes_vol_placement.h"
+
+/**
+ * Doubly linked list of extents, most recently used at the head.
+ */
+typedef struct HermesExtentList {
+    HermesExtent *head;
+    HermesExtent *tail;
+    size_t bytes;
+} HermesExtentList;
+
+static void hermes_list_push(HermesExtentList *list, HermesExtent *e){
+    e->prev=NULL;
+    e->next=list->head;
+    if(list->head) list->head->prev=e;
+    else list->tail=e;
+    list->head=e;
+    list->bytes+=e->bytes;
+}
+static void hermes_list_remove(HermesExtentList *list, HermesExtent *e){
+    if(e->prev) e->prev->next=e->next;
+    else list->head=e->next;
+    if(e->next) e->next->prev=e->prev;
+    else list->tail=e->prev;
+    e->prev=e->next=NULL;
+    list->bytes-=e->bytes;
+}
+
+/* LRU */
+static void *hermes_lru_create(size_t capacity){
+    (void)capacity;
+    return calloc(1,sizeof(HermesExtentList));
+}
+static void hermes_lru_destroy(void *policy){
+    free(policy);
+}
+static void hermes_lru_hit(void *policy, HermesExtent *e){
+    hermes_list_remove((HermesExtentList *)policy,e);
+    hermes_list_push((HermesExtentList *)policy,e);
+}
+static void hermes_lru_admit(void *policy, HermesExtent *e){
+    hermes_list_push((HermesExtentList *)policy,e);
+}
+static HermesExtent *hermes_lru_victim(void *policy){
+    return ((HermesExtentList *)policy)->tail;
+}
+static void hermes_lru_evict(void *policy, HermesExtent *e){
+    hermes_list_remove((HermesExtentList *)policy,e);
+}
+static void hermes_lru_forget(void *policy, HermesExtent *e){
+    if(e->data) hermes_list_remove((HermesExtentList *)policy,e);
+}
+const HermesPlacementClass H5VL_hermes_lru_g={
+    "lru",
+    hermes_lru_create,
+    hermes_lru_destroy,
+    hermes_lru_hit,
+    hermes_lru_admit,
+    hermes_lru_victim,
+    hermes_lru_evict,
+    hermes_lru_forget
+};
+
+/* LFU: a binary min-heap on (freq, stamp), so ties go to the least recent. */
+typedef struct HermesLfu {
+    HermesExtent **heap;
+    size_t count;
+    size_t capacity;
+    uint64_t clock;
+} HermesLfu;
+
+static bool hermes_lfu_less(const HermesExtent *a, const HermesExtent *b){
+    return a->freq<b->freq || (a->freq==b->freq && a->stamp<b->stamp);
+}
+static void hermes_lfu_place(HermesLfu *lfu, size_t i, HermesExtent *e){
+    lfu->heap[i]=e;
+    e->heap_index=i;
+}
+static void hermes_lfu_sift(HermesLfu *lfu, size_t i){
+    HermesExtent *e;
+    if(i>=lfu->count) return;
+    e=lfu->heap[i];
+    while(i>0 && hermes_lfu_less(e,lfu->heap[(i-1)/2])){
+        hermes_lfu_place(lfu,i,lfu->heap[(i-1)/2]);
+        i=(i-1)/2;
+    }
+    for(;;){
+        size_t child=2*i+1;
+        if(child>=lfu->count) break;
+        if(child+1<lfu->count && hermes_lfu_less(lfu->heap[child+1],lfu->heap[child])) child++;
+        if(!hermes_lfu_less(lfu->heap[child],e)) break;
+        hermes_lfu_place(lfu,i,lfu->heap[child]);
+        i=child;
+    }
+    hermes_lfu_place(lfu,i,e);
+}
+static void *hermes_lfu_create(size_t capacity){
+    (void)capacity;
+    return calloc(1,sizeof(HermesLfu));
+}
+static void hermes_lfu_destroy(void *policy){
+    free(((HermesLfu *)policy)->heap);
+    free(policy);
+}
+static void hermes_lfu_hit(void *policy, HermesExtent *e){
+    HermesLfu *lfu=(HermesLfu *)policy;
+    /* Not in the heap if admit could not grow it. */
+    if(e->heap_index>=lfu->count || lfu->heap[e->heap_index]!=e) return;
+    e->freq++;
+    e->stamp=++lfu->clock;
+    hermes_lfu_sift(lfu,e->heap_index);
+}
+static void hermes_lfu_admit(void *policy, HermesExtent *e){
+    HermesLfu *lfu=(HermesLfu *)policy;
+    if(lfu->count==lfu->capacity){
+        size_t capacity=lfu->capacity?lfu->capacity*2:64;
+        HermesExtent **heap=(HermesExtent **)realloc(lfu->heap,capacity*sizeof(HermesExtent *));
+        if(heap==NULL){
+            /* An untracked extent is never a victim and stays in RAM until its dataset closes. */
+            e->heap_index=(size_t)-1;
+            return;
+        }
+        lfu->heap=heap;
+        lfu->capacity=capacity;
+    }
+    /* Frequency survives demotion, so an extent coming back keeps its heat. */
+    e->freq++;
+    e->stamp=++lfu->clock;
+    hermes_lfu_place(lfu,lfu->count++,e);
+    hermes_lfu_sift(lfu,e->heap_index);
+}
+static HermesExtent *hermes_lfu_victim(void *policy){
+    HermesLfu *lfu=(HermesLfu *)policy;
+    return lfu->count?lfu->heap[0]:NULL;
+}
+static void hermes_lfu_evict(void *policy, HermesExtent *e){
+    HermesLfu *lfu=(HermesLfu *)policy;
+    size_t i=e->heap_index;
+    if(i>=lfu->count || lfu->heap[i]!=e) return;
+    lfu->count--;
+    if(i<lfu->count){
+        hermes_lfu_place(lfu,i,lfu->heap[lfu->count]);
+        hermes_lfu_sift(lfu,i);
+    }
+}
+static void hermes_lfu_forget(void *policy, HermesExtent *e){
+    if(e->data) hermes_lfu_evict(policy,e);
+}
+const HermesPlacementClass H5VL_hermes_lfu_g={
+    "lfu",
+    hermes_lfu_create,
+    hermes_lfu_destroy,
+    hermes_lfu_hit,
+    hermes_lfu_admit,
+    hermes_lfu_victim,
+    hermes_lfu_evict,
+    hermes_lfu_forget
+};
+
+/*
+ * ARC, sized in bytes. T1 holds extents seen once recently, T2 extents seen
+ * at least twice; B1 and B2 remember what was evicted from each. A miss that
+ * hits a ghost list moves the target size of T1 towards the list that would
+ * have kept the extent.
+ */
+enum {
+    HERMES_ARC_T1=1,
+    HERMES_ARC_T2,
+    HERMES_ARC_B1,
+    HERMES_ARC_B2
+};
+typedef struct HermesArc {
+    HermesExtentList lists[5];
+    size_t capacity;
+    size_t target;          /* target size of T1 */
+} HermesArc;
+
+static void hermes_arc_move(HermesArc *arc, HermesExtent *e, int list){
+    if(e->list) hermes_list_remove(&arc->lists[e->list],e);
+    e->list=list;
+    if(list) hermes_list_push(&arc->lists[list],e);
+    e->ghost=list==HERMES_ARC_B1 || list==HERMES_ARC_B2;
+}
+static void hermes_arc_trim(HermesArc *arc){
+    HermesExtentList *l=arc->lists;
+    while(l[HERMES_ARC_T1].bytes+l[HERMES_ARC_B1].bytes>arc->capacity && l[HERMES_ARC_B1].tail){
+        HermesExtent *e=l[HERMES_ARC_B1].tail;
+        hermes_arc_move(arc,e,0);
+        H5VL_hermes_extent_release(e);
+    }
+    while(l[1].bytes+l[2].bytes+l[3].bytes+l[4].bytes>2*arc->capacity && l[HERMES_ARC_B2].tail){
+        HermesExtent *e=l[HERMES_ARC_B2].tail;
+        hermes_arc_move(arc,e,0);
+        H5VL_hermes_extent_release(e);
+    }
+}
+static void *hermes_arc_create(size_t capacity){
+    HermesArc *arc=(HermesArc *)calloc(1,sizeof(HermesArc));
+    if(arc) arc->capacity=capacity;
+    return arc;
+}
+static void hermes_arc_destroy(void *policy){
+    free(policy);
+}
+static void hermes_arc_hit(void *policy, HermesExtent *e){
+    hermes_arc_move((HermesArc *)policy,e,HERMES_ARC_T2);
+}
+static void hermes_arc_admit(void *policy, HermesExtent *e){
+    HermesArc *arc=(HermesArc *)policy;
+    size_t b1=arc->lists[HERMES_ARC_B1].bytes,b2=arc->lists[HERMES_ARC_B2].bytes,step;
+    if(e->list==HERMES_ARC_B1){
+        step=b1 && b2>b1?e->bytes*(b2/b1):e->bytes;
+        arc->target=arc->target+step<arc->capacity?arc->target+step:arc->capacity;
+        hermes_arc_move(arc,e,HERMES_ARC_T2);
+    }else if(e->list==HERMES_ARC_B2){
+        step=b2 && b1>b2?e->bytes*(b1/b2):e->bytes;
+        arc->target=arc->target>step?arc->target-step:0;
+        hermes_arc_move(arc,e,HERMES_ARC_T2);
+    }else{
+        hermes_arc_move(arc,e,HERMES_ARC_T1);
+    }
+    hermes_arc_trim(arc);
+}
+static HermesExtent *hermes_arc_victim(void *policy){
+    HermesArc *arc=(HermesArc *)policy;
+    HermesExtentList *t1=&arc->lists[HERMES_ARC_T1],*t2=&arc->lists[HERMES_ARC_T2];
+    if(t1->tail && (t1->bytes>arc->target || t2->tail==NULL)) return t1->tail;
+    return t2->tail?t2->tail:t1->tail;
+}
+static void hermes_arc_evict(void *policy, HermesExtent *e){
+    HermesArc *arc=(HermesArc *)policy;
+    hermes_arc_move(arc,e,e->list==HERMES_ARC_T1?HERMES_ARC_B1:HERMES_ARC_B2);
+    hermes_arc_trim(arc);
+}
+static void hermes_arc_forget(void *policy, HermesExtent *e){
+    hermes_arc_move((HermesArc *)policy,e,0);
+}
+const HermesPlacementClass H5VL_hermes_arc_g={
+    "arc",
+    hermes_arc_create,
+    hermes_arc_destroy,
+    hermes_arc_hit,
+    hermes_arc_admit,
+    hermes_arc_victim,
+    hermes_arc_evict,
+    hermes_arc_forget
+};
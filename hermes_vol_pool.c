@@ -0,0 +1,264 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_pool.c
+*
+* Purpose:Implements the slab pools and the name table. A pool carves its
+*         slabs into objects chained through their first word while free.
+*         Names are interned with a reference count in front of the text,
+*         so a handle copying its parent's names only bumps counts; the
+*         table itself is only searched when a name is first given.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hermes_vol_pool.h"
+
+/* Room in front of a slab's objects for the chain of slabs, keeping them aligned. */
+#define HERMES_POOL_HEADER 16
+
+typedef struct HermesName {
+    struct HermesName *next;
+    size_t refs;
+    uint64_t hash;
+    size_t length;
+    char text[];
+} HermesName;
+
+static pthread_mutex_t hermes_pools_lock=PTHREAD_MUTEX_INITIALIZER;
+static HermesPool *hermes_pools=NULL;
+
+static pthread_mutex_t hermes_names_lock=PTHREAD_MUTEX_INITIALIZER;
+static HermesName **hermes_names=NULL;
+static size_t hermes_names_buckets=0;
+static size_t hermes_names_count=0;
+static size_t hermes_names_bytes=0;
+
+static size_t hermes_pool_stride(const HermesPool *pool){
+    size_t size=pool->object_size<sizeof(void *)?sizeof(void *):pool->object_size;
+    return (size+15)&~(size_t)15;
+}
+static void hermes_pool_list(HermesPool *pool){
+    pthread_mutex_lock(&hermes_pools_lock);
+    if(!pool->listed){
+        pool->next=hermes_pools;
+        hermes_pools=pool;
+        __atomic_store_n(&pool->listed,true,__ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&hermes_pools_lock);
+}
+/**
+ * This method takes a zeroed object from a pool, carving a new slab when
+ * the pool has none free.
+ *
+ * @param pool
+ * @return object, or NULL if out of memory
+ */
+void *H5VL_hermes_pool_get(HermesPool *pool){
+    size_t stride=hermes_pool_stride(pool),i;
+    void *object;
+    if(!__atomic_load_n(&pool->listed,__ATOMIC_ACQUIRE)) hermes_pool_list(pool);
+    pthread_mutex_lock(&pool->lock);
+    if(pool->free_list==NULL){
+        char *slab=(char *)malloc(HERMES_POOL_HEADER+stride*HERMES_POOL_SLAB_OBJECTS);
+        if(slab==NULL){
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        *(void **)slab=pool->slabs;
+        pool->slabs=slab;
+        pool->nslabs++;
+        for(i=HERMES_POOL_SLAB_OBJECTS;i>0;i--){
+            object=slab+HERMES_POOL_HEADER+(i-1)*stride;
+            *(void **)object=pool->free_list;
+            pool->free_list=object;
+        }
+        pool->idle+=HERMES_POOL_SLAB_OBJECTS;
+    }
+    object=pool->free_list;
+    pool->free_list=*(void **)object;
+    pool->idle--;
+    pool->live++;
+    pthread_mutex_unlock(&pool->lock);
+    memset(object,0,pool->object_size);
+    return object;
+}
+void H5VL_hermes_pool_put(HermesPool *pool, void *object){
+    if(object==NULL) return;
+    pthread_mutex_lock(&pool->lock);
+    *(void **)object=pool->free_list;
+    pool->free_list=object;
+    pool->idle++;
+    pool->live--;
+    pthread_mutex_unlock(&pool->lock);
+}
+/**
+ * This method gives the slabs of every pool with no object handed out back
+ * to the heap.
+ */
+void H5VL_hermes_pool_trim(void){
+    HermesPool *pool;
+    pthread_mutex_lock(&hermes_pools_lock);
+    for(pool=hermes_pools;pool;pool=pool->next){
+        pthread_mutex_lock(&pool->lock);
+        if(pool->live==0){
+            while(pool->slabs){
+                void *next=*(void **)pool->slabs;
+                free(pool->slabs);
+                pool->slabs=next;
+            }
+            pool->free_list=NULL;
+            pool->idle=0;
+            pool->nslabs=0;
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    pthread_mutex_unlock(&hermes_pools_lock);
+}
+/**
+ * This method reports the occupancy of the pools used so far.
+ *
+ * @param stats filled with up to max pools
+ * @param max
+ * @return number of pools, which may exceed max
+ */
+size_t H5VL_hermes_pool_stats(HermesPoolStats *stats, size_t max){
+    HermesPool *pool;
+    size_t count=0;
+    pthread_mutex_lock(&hermes_pools_lock);
+    for(pool=hermes_pools;pool;pool=pool->next,count++){
+        if(count>=max) continue;
+        pthread_mutex_lock(&pool->lock);
+        stats[count].name=pool->name;
+        stats[count].object_size=pool->object_size;
+        stats[count].live=pool->live;
+        stats[count].idle=pool->idle;
+        stats[count].nslabs=pool->nslabs;
+        pthread_mutex_unlock(&pool->lock);
+    }
+    pthread_mutex_unlock(&hermes_pools_lock);
+    return count;
+}
+
+static HermesName *hermes_name_of(char *text){
+    return (HermesName *)(text-offsetof(HermesName,text));
+}
+static uint64_t hermes_name_hash(const char *name, size_t length){
+    uint64_t hash=1469598103934665603ULL;
+    size_t i;
+    for(i=0;i<length;i++) hash=(hash^(unsigned char)name[i])*1099511628211ULL;
+    return hash;
+}
+/* Doubles the buckets once names outnumber them twice over; the table lock is held. */
+static void hermes_names_grow(void){
+    size_t buckets=hermes_names_buckets?hermes_names_buckets*2:64,i;
+    HermesName **table=(HermesName **)calloc(buckets,sizeof(HermesName *));
+    if(table==NULL) return;
+    for(i=0;i<hermes_names_buckets;i++){
+        while(hermes_names[i]){
+            HermesName *n=hermes_names[i];
+            hermes_names[i]=n->next;
+            n->next=table[n->hash%buckets];
+            table[n->hash%buckets]=n;
+        }
+    }
+    free(hermes_names);
+    hermes_names=table;
+    hermes_names_buckets=buckets;
+}
+/**
+ * This method finds or adds a name in the table and takes a reference on
+ * it. The text must not be changed, and is given back with
+ * H5VL_hermes_name_release.
+ *
+ * @param name
+ * @return interned copy of name, or NULL if name is NULL or out of memory
+ */
+char *H5VL_hermes_name_intern(const char *name){
+    HermesName *n;
+    size_t length;
+    uint64_t hash;
+    if(name==NULL) return NULL;
+    length=strlen(name);
+    hash=hermes_name_hash(name,length);
+    pthread_mutex_lock(&hermes_names_lock);
+    if(hermes_names_count>=hermes_names_buckets*2) hermes_names_grow();
+    if(hermes_names_buckets==0){
+        pthread_mutex_unlock(&hermes_names_lock);
+        return NULL;
+    }
+    for(n=hermes_names[hash%hermes_names_buckets];n;n=n->next)
+        if(n->hash==hash && n->length==length && memcmp(n->text,name,length)==0) break;
+    if(n) __atomic_add_fetch(&n->refs,1,__ATOMIC_RELAXED);
+    else if((n=(HermesName *)malloc(sizeof(HermesName)+length+1))){
+        n->refs=1;
+        n->hash=hash;
+        n->length=length;
+        memcpy(n->text,name,length+1);
+        n->next=hermes_names[hash%hermes_names_buckets];
+        hermes_names[hash%hermes_names_buckets]=n;
+        hermes_names_count++;
+        hermes_names_bytes+=length+1;
+    }
+    pthread_mutex_unlock(&hermes_names_lock);
+    return n?n->text:NULL;
+}
+/**
+ * This method takes another reference on an interned name, without
+ * searching the table.
+ *
+ * @param name from H5VL_hermes_name_intern, or NULL
+ * @return name
+ */
+char *H5VL_hermes_name_ref(char *name){
+    if(name) __atomic_add_fetch(&hermes_name_of(name)->refs,1,__ATOMIC_RELAXED);
+    return name;
+}
+void H5VL_hermes_name_release(char *name){
+    HermesName *n,**link;
+    size_t refs;
+    if(name==NULL) return;
+    n=hermes_name_of(name);
+    /* Only the last reference needs the table, which an intern may be reviving it from. */
+    refs=__atomic_load_n(&n->refs,__ATOMIC_RELAXED);
+    while(refs>1)
+        if(__atomic_compare_exchange_n(&n->refs,&refs,refs-1,false,__ATOMIC_ACQ_REL,__ATOMIC_RELAXED)) return;
+    pthread_mutex_lock(&hermes_names_lock);
+    if(__atomic_sub_fetch(&n->refs,1,__ATOMIC_ACQ_REL)==0){
+        for(link=&hermes_names[n->hash%hermes_names_buckets];*link!=n;link=&(*link)->next);
+        *link=n->next;
+        hermes_names_count--;
+        hermes_names_bytes-=n->length+1;
+        free(n);
+    }
+    pthread_mutex_unlock(&hermes_names_lock);
+}
+void H5VL_hermes_name_stats(HermesNameStats *stats){
+    HermesName *n;
+    size_t i;
+    pthread_mutex_lock(&hermes_names_lock);
+    stats->names=hermes_names_count;
+    stats->bytes=hermes_names_bytes;
+    stats->refs=0;
+    for(i=0;i<hermes_names_buckets;i++)
+        for(n=hermes_names[i];n;n=n->next) stats->refs+=__atomic_load_n(&n->refs,__ATOMIC_RELAXED);
+    pthread_mutex_unlock(&hermes_names_lock);
+}
@@ -0,0 +1,85 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_pool.h
+*
+* Purpose:Defines the slab pools VOL objects and extents are taken from,
+*         and the table names of files and datasets are interned in, so
+*         that opening and closing many datasets does not go through the
+*         allocator for every handle and every copy of its names.
+*
+*-------------------------------------------------------------------------
+*/
+
+#ifndef HERMES_PROJECT_HERMES_VOL_POOL_H
+#define HERMES_PROJECT_HERMES_VOL_POOL_H
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Objects carved out of each slab a pool allocates. */
+#define HERMES_POOL_SLAB_OBJECTS 64
+
+/**
+ * Pool of same-size objects. Slabs are kept until H5VL_hermes_pool_trim
+ * finds all of a pool's objects given back.
+ */
+typedef struct HermesPool {
+    const char *name;
+    size_t object_size;
+    pthread_mutex_t lock;
+    void *free_list;
+    void *slabs;
+    size_t live;            /* objects handed out */
+    size_t idle;            /* objects waiting in free_list */
+    size_t nslabs;
+    bool listed;            /* linked into the pools H5VL_hermes_pool_stats reports */
+    struct HermesPool *next;
+} HermesPool;
+#define HERMES_POOL_INIT(name,type) {name,sizeof(type),PTHREAD_MUTEX_INITIALIZER,NULL,NULL,0,0,0,false,NULL}
+
+/**
+ * Occupancy of one pool.
+ */
+typedef struct HermesPoolStats {
+    const char *name;
+    size_t object_size;
+    size_t live;
+    size_t idle;
+    size_t nslabs;
+} HermesPoolStats;
+
+/**
+ * Occupancy of the name table.
+ */
+typedef struct HermesNameStats {
+    size_t names;
+    size_t bytes;
+    size_t refs;            /* handles holding one of the names */
+} HermesNameStats;
+
+void *H5VL_hermes_pool_get(HermesPool *pool);
+void H5VL_hermes_pool_put(HermesPool *pool, void *object);
+void H5VL_hermes_pool_trim(void);
+size_t H5VL_hermes_pool_stats(HermesPoolStats *stats, size_t max);
+
+char *H5VL_hermes_name_intern(const char *name);
+char *H5VL_hermes_name_ref(char *name);
+void H5VL_hermes_name_release(char *name);
+void H5VL_hermes_name_stats(HermesNameStats *stats);
+#endif //HERMES_PROJECT_HERMES_VOL_POOL_H
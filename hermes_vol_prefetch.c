@@ -0,0 +1,469 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_prefetch.c
+*
+* Purpose:Implements read-ahead. Predicted slabs are read by the worker pool
+*         straight from the contiguous storage of the dataset in the native
+*         file, so a prefetch neither enters HDF5 nor holds the buffer layer
+*         while the application thread may be waiting on either.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "hermes_vol_async.h"
+#include "hermes_vol_prefetch.h"
+#include "hermes_vol_stats.h"
+
+typedef enum HermesSlotState {
+    HERMES_SLOT_EMPTY,
+    HERMES_SLOT_INFLIGHT,
+    HERMES_SLOT_READY
+} HermesSlotState;
+
+/**
+ * One staged slab, held densely in row-major order.
+ */
+typedef struct HermesPrefetchSlot {
+    HermesSlotState state;
+    hsize_t start[H5S_MAX_RANK];
+    hsize_t count[H5S_MAX_RANK];
+    void *data;
+    unsigned long stamp;    /* last time the slot was filled or served */
+} HermesPrefetchSlot;
+
+struct HermesPrefetcher {
+    pthread_mutex_t lock;   /* protects the slots, generation and refs */
+    int refs;               /* the dataset plus every queued prefetch  */
+    HermesPrefetchPolicy policy;
+    int fd;
+    haddr_t offset;         /* of the contiguous storage, HADDR_UNDEF until allocated */
+    int rank;
+    hsize_t dims[H5S_MAX_RANK];
+    size_t elem_size;
+    HermesConvertKernel convert;    /* into the native type, NULL when stored natively */
+    unsigned workers;
+    HermesAsyncGroup *group;
+    /* Bumped by every write; prefetches issued under an older one are dropped. */
+    unsigned long generation;
+    /* The native file lags the buffer layer until the next sync. */
+    bool stale;
+    /* detector */
+    bool have_last;
+    hsize_t last_start[H5S_MAX_RANK];
+    hsize_t last_end[H5S_MAX_RANK];
+    bool have_delta;
+    int64_t delta[H5S_MAX_RANK];
+    HermesAccessPattern pattern;
+    unsigned long clock;
+    unsigned nslots;
+    HermesPrefetchSlot slots[HERMES_PREFETCH_MAX_DEPTH+1];
+};
+
+/**
+ * A prefetch of one slab, run by the worker pool.
+ */
+typedef struct HermesPrefetchJob {
+    HermesPrefetcher *p;
+    unsigned slot;
+    unsigned long generation;
+    haddr_t offset;
+    hsize_t start[H5S_MAX_RANK];
+    hsize_t count[H5S_MAX_RANK];
+} HermesPrefetchJob;
+
+/**
+ * Serving a read out of a slot.
+ */
+typedef struct HermesSlotSource {
+    const HermesPrefetchSlot *slot;
+    int rank;
+    size_t elem_size;
+} HermesSlotSource;
+
+static void hermes_prefetch_put(HermesPrefetcher *p){
+    unsigned i;
+    pthread_mutex_lock(&p->lock);
+    if(--p->refs>0){
+        pthread_mutex_unlock(&p->lock);
+        return;
+    }
+    pthread_mutex_unlock(&p->lock);
+    for(i=0;i<p->nslots;i++)
+        free(p->slots[i].data);
+    close(p->fd);
+    pthread_mutex_destroy(&p->lock);
+    free(p);
+}
+static size_t hermes_slab_bytes(const HermesPrefetcher *p, const hsize_t *count){
+    size_t bytes=p->elem_size;
+    int i;
+    for(i=0;i<p->rank;i++) bytes*=count[i];
+    return bytes;
+}
+static bool hermes_slot_contains(const HermesPrefetchSlot *slot, int rank, const hsize_t *start, const hsize_t *end){
+    int i;
+    for(i=0;i<rank;i++)
+        if(start[i]<slot->start[i] || end[i]>=slot->start[i]+slot->count[i]) return false;
+    return true;
+}
+/**
+ * This method reads a slab from the contiguous storage with one pread per
+ * run of the slab that is contiguous in the file.
+ */
+static herr_t hermes_prefetch_load(const HermesPrefetcher *p, const HermesPrefetchJob *job, void *data){
+    hsize_t idx[H5S_MAX_RANK],stride[H5S_MAX_RANK],offset=0,run;
+    size_t bytes;
+    char *dst=(char *)data;
+    int i,k;
+    stride[p->rank-1]=1;
+    for(i=p->rank-2;i>=0;i--) stride[i]=stride[i+1]*p->dims[i+1];
+    k=p->rank-1;
+    run=job->count[k];
+    while(k>0 && job->count[k]==p->dims[k]){
+        k--;
+        run*=job->count[k];
+    }
+    for(i=0;i<p->rank;i++){
+        idx[i]=0;
+        offset+=job->start[i]*stride[i];
+    }
+    bytes=(size_t)run*p->elem_size;
+    for(;;){
+        size_t done=0;
+        while(done<bytes){
+            ssize_t n=pread(p->fd,dst+done,bytes-done,(off_t)(job->offset+offset*p->elem_size+done));
+            if(n<0 && errno==EINTR) continue;
+            if(n<=0) return -1;
+            done+=(size_t)n;
+        }
+        dst+=bytes;
+        for(i=k-1;i>=0;i--){
+            offset+=stride[i];
+            if(++idx[i]<job->count[i]) break;
+            offset-=job->count[i]*stride[i];
+            idx[i]=0;
+        }
+        if(i<0) break;
+    }
+    return 0;
+}
+static herr_t hermes_prefetch_run(void *arg){
+    HermesPrefetchJob *job=(HermesPrefetchJob *)arg;
+    HermesPrefetcher *p=job->p;
+    HermesPrefetchSlot *slot=&p->slots[job->slot];
+    void *data=malloc(hermes_slab_bytes(p,job->count));
+    herr_t status=data?hermes_prefetch_load(p,job,data):-1;
+    /* Slots hold the native type, as the tiers do. */
+    if(status>=0 && p->convert) p->convert(data,hermes_slab_bytes(p,job->count)/p->elem_size);
+    pthread_mutex_lock(&p->lock);
+    if(status>=0 && job->generation==p->generation){
+        slot->data=data;
+        slot->stamp=++p->clock;
+        slot->state=HERMES_SLOT_READY;
+        data=NULL;
+    }else{
+        slot->state=HERMES_SLOT_EMPTY;
+        if(status>=0) H5VL_hermes_stats_event(HERMES_EVENT_PREFETCH_DROPPED);
+    }
+    pthread_mutex_unlock(&p->lock);
+    free(data);
+    return status;
+}
+static void hermes_prefetch_job_free(void *arg){
+    HermesPrefetchJob *job=(HermesPrefetchJob *)arg;
+    hermes_prefetch_put(job->p);
+    free(job);
+}
+/**
+ * This method stages the slab start..end unless a slot already holds or is
+ * loading it, reusing the empty or least recently used ready slot. Called
+ * with the lock held.
+ */
+static void hermes_prefetch_issue(HermesPrefetcher *p, const hsize_t *start, const hsize_t *end){
+    HermesPrefetchSlot *victim=NULL;
+    HermesPrefetchJob *job;
+    unsigned i;
+    int d;
+    for(i=0;i<p->nslots;i++){
+        HermesPrefetchSlot *slot=&p->slots[i];
+        if(slot->state!=HERMES_SLOT_EMPTY && hermes_slot_contains(slot,p->rank,start,end)) return;
+        if(slot->state==HERMES_SLOT_EMPTY){
+            if(victim==NULL || victim->state!=HERMES_SLOT_EMPTY) victim=slot;
+        }else if(slot->state==HERMES_SLOT_READY){
+            if(victim==NULL || (victim->state==HERMES_SLOT_READY && slot->stamp<victim->stamp)) victim=slot;
+        }
+    }
+    if(victim==NULL) return;
+    job=(HermesPrefetchJob *)malloc(sizeof(HermesPrefetchJob));
+    if(job==NULL) return;
+    free(victim->data);
+    victim->data=NULL;
+    victim->state=HERMES_SLOT_INFLIGHT;
+    for(d=0;d<p->rank;d++){
+        victim->start[d]=start[d];
+        victim->count[d]=end[d]-start[d]+1;
+        job->start[d]=victim->start[d];
+        job->count[d]=victim->count[d];
+    }
+    job->p=p;
+    job->slot=(unsigned)(victim-p->slots);
+    job->generation=p->generation;
+    job->offset=p->offset;
+    p->refs++;
+    H5VL_hermes_stats_event(HERMES_EVENT_PREFETCH_ISSUED);
+    /* The job takes the lock itself when it runs inline. */
+    pthread_mutex_unlock(&p->lock);
+    H5VL_hermes_async_submit(p->group,p->workers,hermes_prefetch_run,job,hermes_prefetch_job_free,NULL);
+    pthread_mutex_lock(&p->lock);
+}
+static herr_t hermes_slot_read_op(void *op_data, hsize_t *file_start, hsize_t *file_end,
+                                  hsize_t *memory_start, hsize_t *memory_dim, void *buf){
+    HermesSlotSource *source=(HermesSlotSource *)op_data;
+    hsize_t count[H5S_MAX_RANK],src_start[H5S_MAX_RANK];
+    int i;
+    for(i=0;i<source->rank;i++){
+        count[i]=file_end[i]-file_start[i]+1;
+        src_start[i]=file_start[i]-source->slot->start[i];
+    }
+    H5VL_hermes_box_copy(source->rank,source->elem_size,count,source->slot->data,source->slot->count,src_start,
+                         buf,memory_dim,memory_start);
+    return 0;
+}
+
+/**
+ * This method sets up read-ahead for a dataset with contiguous storage in
+ * file_name.
+ *
+ * @param policy read-ahead depth and slab size bound
+ * @param file_name native file holding the dataset
+ * @param offset file address of the dataset's storage, HADDR_UNDEF if none yet
+ * @param rank
+ * @param dims
+ * @param elem_size size of the dataset type
+ * @param convert kernel converting the dataset type to its native
+ *        equivalent of the same size, NULL if they are the same
+ * @param workers size of the worker pool if it has to be started
+ * @return prefetcher, or NULL when read-ahead is off or unavailable
+ */
+HermesPrefetcher *H5VL_hermes_prefetch_create(const HermesPrefetchPolicy *policy, const char *file_name,
+                                              haddr_t offset, int rank, const hsize_t *dims, size_t elem_size,
+                                              HermesConvertKernel convert, unsigned workers){
+    HermesPrefetcher *p;
+    if(policy->depth==0 || rank<1 || elem_size==0) return NULL;
+    p=(HermesPrefetcher *)calloc(1,sizeof(HermesPrefetcher));
+    if(p==NULL) return NULL;
+    p->fd=open(file_name,O_RDONLY);
+    p->group=H5VL_hermes_async_group_create();
+    if(p->fd<0 || p->group==NULL){
+        if(p->fd>=0) close(p->fd);
+        free(p->group);
+        free(p);
+        return NULL;
+    }
+    pthread_mutex_init(&p->lock,NULL);
+    p->refs=1;
+    p->policy=*policy;
+    if(p->policy.depth>HERMES_PREFETCH_MAX_DEPTH) p->policy.depth=HERMES_PREFETCH_MAX_DEPTH;
+    if(p->policy.max_bytes==0) p->policy.max_bytes=HERMES_PREFETCH_DEFAULT_BYTES;
+    /* One slot for the slab being read plus one per slab ahead of it. */
+    p->nslots=p->policy.depth+1;
+    p->offset=offset;
+    p->rank=rank;
+    memcpy(p->dims,dims,sizeof(hsize_t)*rank);
+    p->elem_size=elem_size;
+    p->convert=convert;
+    p->workers=workers;
+    return p;
+}
+/**
+ * This method gives up the dataset's reference. Prefetches still queued run
+ * to completion and the last one frees the prefetcher.
+ *
+ * @param p
+ */
+void H5VL_hermes_prefetch_release(HermesPrefetcher *p){
+    if(p==NULL) return;
+    H5VL_hermes_async_group_release(p->group);
+    hermes_prefetch_put(p);
+}
+/**
+ * This method serves a read entirely from a ready slot.
+ *
+ * @param p
+ * @param file decoded file selection of the read
+ * @param mem_space_id memory selection of the read
+ * @param type_id memory type, the native equivalent of the dataset type
+ * @param buf user buffer
+ * @param status receives the result of the copy when served
+ * @return true if the read was served from a slot
+ */
+bool H5VL_hermes_prefetch_serve(HermesPrefetcher *p, const HermesSelection *file, hid_t mem_space_id,
+                                hid_t type_id, void *buf, herr_t *status){
+    hsize_t start[H5S_MAX_RANK],end[H5S_MAX_RANK];
+    HermesSlotSource source;
+    unsigned i;
+    if(p==NULL || file->type==HERMES_SELECTION_NONE) return false;
+    H5VL_hermes_selection_bounds(file,start,end);
+    source.slot=NULL;
+    source.rank=p->rank;
+    source.elem_size=p->elem_size;
+    pthread_mutex_lock(&p->lock);
+    for(i=0;i<p->nslots;i++){
+        if(p->slots[i].state==HERMES_SLOT_READY && hermes_slot_contains(&p->slots[i],p->rank,start,end)){
+            p->slots[i].stamp=++p->clock;
+            source.slot=&p->slots[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+    /* Only the application thread retires ready slots, so this one stays put. */
+    if(source.slot==NULL) return false;
+    *status=H5VL_hermes_selection_transfer(file,mem_space_id,type_id,p->elem_size,buf,false,hermes_slot_read_op,
+                                           &source);
+    H5VL_hermes_stats_event(HERMES_EVENT_PREFETCH_HIT);
+    H5VL_hermes_stats_bytes(HERMES_TIER_PREFETCH,false,file->npoints*p->elem_size);
+    return true;
+}
+/**
+ * This method feeds a read to the detector and stages the slabs it predicts.
+ * A shape read twice in a row at the same offset is a repeated slab; a shape
+ * advancing by the same offset twice is strided, or sequential when each
+ * slab abuts the previous one.
+ *
+ * @param p
+ * @param file decoded file selection of the read
+ */
+void H5VL_hermes_prefetch_observe(HermesPrefetcher *p, const HermesSelection *file){
+    hsize_t start[H5S_MAX_RANK],end[H5S_MAX_RANK],next_start[H5S_MAX_RANK],next_end[H5S_MAX_RANK];
+    int64_t delta[H5S_MAX_RANK];
+    bool same_shape=true,same_delta=true,still=true;
+    unsigned k;
+    int i,moved=0;
+    if(p==NULL) return;
+    pthread_mutex_lock(&p->lock);
+    if(file->type!=HERMES_SELECTION_REGULAR){
+        p->have_last=false;
+        p->have_delta=false;
+        p->pattern=HERMES_ACCESS_NONE;
+        pthread_mutex_unlock(&p->lock);
+        return;
+    }
+    H5VL_hermes_selection_bounds(file,start,end);
+    for(i=0;i<p->rank;i++){
+        delta[i]=(int64_t)start[i]-(int64_t)p->last_start[i];
+        if(end[i]-start[i]!=p->last_end[i]-p->last_start[i]) same_shape=false;
+        if(delta[i]!=0) still=false;
+        if(!p->have_delta || delta[i]!=p->delta[i]) same_delta=false;
+    }
+    if(!p->have_last || !same_shape){
+        p->have_delta=false;
+        p->pattern=HERMES_ACCESS_NONE;
+    }else if(still){
+        /* A re-read keeps the stride it interrupts. */
+        p->pattern=HERMES_ACCESS_REPEATED;
+    }else if(same_delta){
+        p->pattern=HERMES_ACCESS_STRIDED;
+        for(i=0;i<p->rank;i++){
+            if(delta[i]==0) continue;
+            moved++;
+            if((hsize_t)(delta[i]<0?-delta[i]:delta[i])!=end[i]-start[i]+1) moved=p->rank+1;
+        }
+        if(moved==1) p->pattern=HERMES_ACCESS_SEQUENTIAL;
+    }else{
+        memcpy(p->delta,delta,sizeof(int64_t)*p->rank);
+        p->have_delta=true;
+        p->pattern=HERMES_ACCESS_NONE;
+    }
+    memcpy(p->last_start,start,sizeof(hsize_t)*p->rank);
+    memcpy(p->last_end,end,sizeof(hsize_t)*p->rank);
+    p->have_last=true;
+    if(p->stale || p->offset==HADDR_UNDEF || p->pattern==HERMES_ACCESS_NONE){
+        pthread_mutex_unlock(&p->lock);
+        return;
+    }
+    for(i=0;i<p->rank;i++) next_start[i]=end[i]-start[i]+1;
+    if(hermes_slab_bytes(p,next_start)>p->policy.max_bytes){
+        pthread_mutex_unlock(&p->lock);
+        return;
+    }
+    if(p->pattern==HERMES_ACCESS_REPEATED){
+        hermes_prefetch_issue(p,start,end);
+        pthread_mutex_unlock(&p->lock);
+        return;
+    }
+    for(k=1;k<=p->policy.depth;k++){
+        for(i=0;i<p->rank;i++){
+            int64_t s=(int64_t)start[i]+(int64_t)k*p->delta[i];
+            if(s<0 || (hsize_t)s+end[i]-start[i]>=p->dims[i]) break;
+            next_start[i]=(hsize_t)s;
+            next_end[i]=(hsize_t)s+end[i]-start[i];
+        }
+        if(i<p->rank) break;
+        hermes_prefetch_issue(p,next_start,next_end);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+/**
+ * This method drops every staged slab after a write, and keeps new ones from
+ * being staged until the native file has caught up.
+ *
+ * @param p
+ */
+void H5VL_hermes_prefetch_invalidate(HermesPrefetcher *p){
+    unsigned i;
+    if(p==NULL) return;
+    pthread_mutex_lock(&p->lock);
+    p->generation++;
+    p->stale=true;
+    for(i=0;i<p->nslots;i++){
+        if(p->slots[i].state!=HERMES_SLOT_READY) continue;
+        free(p->slots[i].data);
+        p->slots[i].data=NULL;
+        p->slots[i].state=HERMES_SLOT_EMPTY;
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+/**
+ * This method records that the native file holds everything written so far.
+ *
+ * @param p
+ * @param offset file address of the dataset's storage, which a sync may have
+ *        just allocated
+ */
+void H5VL_hermes_prefetch_synced(HermesPrefetcher *p, haddr_t offset){
+    if(p==NULL) return;
+    pthread_mutex_lock(&p->lock);
+    p->stale=false;
+    p->offset=offset;
+    pthread_mutex_unlock(&p->lock);
+}
+HermesAccessPattern H5VL_hermes_prefetch_pattern(HermesPrefetcher *p){
+    HermesAccessPattern pattern;
+    if(p==NULL) return HERMES_ACCESS_NONE;
+    pthread_mutex_lock(&p->lock);
+    pattern=p->pattern;
+    pthread_mutex_unlock(&p->lock);
+    return pattern;
+}
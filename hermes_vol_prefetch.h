@@ -0,0 +1,65 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_prefetch.h
+*
+* Purpose:Defines the per-dataset access-pattern detector and the read-ahead
+*         slots it stages predicted hyperslabs into.
+*
+*-------------------------------------------------------------------------
+*/
+
+#ifndef HERMES_PROJECT_HERMES_VOL_PREFETCH_H
+#define HERMES_PROJECT_HERMES_VOL_PREFETCH_H
+#include <hdf5.h>
+#include <stdbool.h>
+#include "hermes_vol_convert.h"
+#include "hermes_vol_selection.h"
+
+/* Slabs staged ahead of the reader at most. */
+#define HERMES_PREFETCH_MAX_DEPTH 16
+/* Largest slab staged when the policy does not say. */
+#define HERMES_PREFETCH_DEFAULT_BYTES (64*1024*1024)
+
+typedef enum HermesAccessPattern {
+    HERMES_ACCESS_NONE,         /* nothing recognised yet                      */
+    HERMES_ACCESS_SEQUENTIAL,   /* each slab starts where the previous ended   */
+    HERMES_ACCESS_STRIDED,      /* slabs of one shape a fixed offset apart     */
+    HERMES_ACCESS_REPEATED      /* the same slab read again                    */
+} HermesAccessPattern;
+
+/**
+ * How far ahead a dataset is read. A depth of 0 turns read-ahead off.
+ */
+typedef struct HermesPrefetchPolicy {
+    unsigned depth;         /* predicted slabs staged ahead of the reader    */
+    size_t max_bytes;       /* larger slabs are not staged, 0 for the default */
+} HermesPrefetchPolicy;
+
+typedef struct HermesPrefetcher HermesPrefetcher;
+
+HermesPrefetcher *H5VL_hermes_prefetch_create(const HermesPrefetchPolicy *policy, const char *file_name,
+                                              haddr_t offset, int rank, const hsize_t *dims, size_t elem_size,
+                                              HermesConvertKernel convert, unsigned workers);
+void H5VL_hermes_prefetch_release(HermesPrefetcher *p);
+bool H5VL_hermes_prefetch_serve(HermesPrefetcher *p, const HermesSelection *file, hid_t mem_space_id,
+                                hid_t type_id, void *buf, herr_t *status);
+void H5VL_hermes_prefetch_observe(HermesPrefetcher *p, const HermesSelection *file);
+void H5VL_hermes_prefetch_invalidate(HermesPrefetcher *p);
+void H5VL_hermes_prefetch_synced(HermesPrefetcher *p, haddr_t offset);
+HermesAccessPattern H5VL_hermes_prefetch_pattern(HermesPrefetcher *p);
+#endif //HERMES_PROJECT_HERMES_VOL_PREFETCH_H
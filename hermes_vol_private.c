@@ -26,6 +26,7 @@
 
 #include <hdf5.h>
 #include <libgen.h>
+#include <unistd.h>
 #include "hermes_vol_private.h"
 /**
  * This method implements the setting of vol driver inside application's fapl.
@@ -44,174 +45,1661 @@ H5_DLL hid_t H5Pset_fapl_hermes_vol(hid_t fapl_id,LayerInfo* layers, uint16_t co
     H5_UpdateLayer(layers,count_);
     HermesVol layer;
     layer.file_name=NULL;
+    layer.file_key=NULL;
     layer.dataset_name=NULL;
     layer.sync=true;
+    layer.async=false;
+    layer.async_workers=0;
+    memset(&layer.flush_policy,0,sizeof(HermesFlushPolicy));
+    memset(&layer.prefetch_policy,0,sizeof(HermesPrefetchPolicy));
+    layer.placement=NULL;
+    layer.meta_policy.attr_bytes=HERMES_META_DEFAULT_ATTR_BYTES;
+    layer.meta_policy.cache_bytes=HERMES_META_DEFAULT_CACHE_BYTES;
+    layer.meta=NULL;
+    layer.chunk_stage_bytes=HERMES_CHUNK_DEFAULT_STAGE_BYTES;
+    layer.aggregate_bytes=0;
+    layer.shared_bytes=0;
+    layer.shared=NULL;
     layer.native_fapl=H5Pcopy(fapl_id);
     layer.native_driver_id=H5VLget_driver_id("native");
     layer.vol_id = H5VLregister(&H5VL_hermes_g);
+    /* Registration fails when H5VL_hermes_init rejects the config file. */
+    if(layer.vol_id<0){
+        H5Pclose(layer.native_fapl);
+        return layer.vol_id;
+    }
     H5Pset_vol(fapl_id, layer.vol_id, &layer);
+    if(getenv(HERMES_CONFIG_ENV)) hermes_vol_configure((HermesVol *)(H5Pget_vol_info(fapl_id)),NULL);
     return layer.vol_id;
 }
 #else
 H5_DLL hid_t H5Pset_fapl_hermes_vol(hid_t fapl_id){
     HermesVol layer;
     layer.file_name=NULL;
+    layer.file_key=NULL;
     layer.dataset_name=NULL;
     layer.sync=true;
+    layer.async=false;
+    layer.async_workers=0;
+    memset(&layer.flush_policy,0,sizeof(HermesFlushPolicy));
+    memset(&layer.prefetch_policy,0,sizeof(HermesPrefetchPolicy));
+    layer.placement=NULL;
+    layer.meta_policy.attr_bytes=HERMES_META_DEFAULT_ATTR_BYTES;
+    layer.meta_policy.cache_bytes=HERMES_META_DEFAULT_CACHE_BYTES;
+    layer.meta=NULL;
+    layer.chunk_stage_bytes=HERMES_CHUNK_DEFAULT_STAGE_BYTES;
+    layer.aggregate_bytes=0;
+    layer.shared_bytes=0;
+    layer.shared=NULL;
     layer.native_fapl=H5Pcopy(fapl_id);
     layer.native_driver_id=H5VLget_driver_id("native");
     layer.vol_id = H5VLregister(&H5VL_hermes_g);
+    /* Registration fails when H5VL_hermes_init rejects the config file. */
+    if(layer.vol_id<0){
+        H5Pclose(layer.native_fapl);
+        return layer.vol_id;
+    }
     H5Pset_vol(fapl_id, layer.vol_id, &layer);
+    if(getenv(HERMES_CONFIG_ENV)) hermes_vol_configure((HermesVol *)(H5Pget_vol_info(fapl_id)),NULL);
     return layer.vol_id;
 }
 #endif
+/**
+ * This method turns the asynchronous mode on or off for files opened with a
+ * fapl already set up by H5Pset_fapl_hermes_vol. In asynchronous mode a
+ * write returns once the user buffer is copied, and the copy is placed in
+ * the buffer layer by a background worker. Writes to one dataset complete in
+ * the order they were issued; reads and close wait for them.
+ *
+ * @param fapl_id
+ * @param async
+ * @param workers size of the worker pool, 0 for the default
+ * @return non-negative on success
+ */
+H5_DLL herr_t H5Pset_hermes_vol_async(hid_t fapl_id, bool async, uint16_t workers){
+    HermesVol *info=(HermesVol *)(H5Pget_vol_info(fapl_id));
+    if(info==NULL) return -1;
+    info->async=async;
+    info->async_workers=workers?workers:HERMES_ASYNC_DEFAULT_WORKERS;
+    return 0;
+}
+
+/**
+ * This method sets when dirty data of datasets opened with fapl_id is
+ * drained from the buffer layer to the native file. With sync off nothing is
+ * ever written back. With sync on, data is flushed at close and, in between,
+ * whenever a dataset holds dirty_bytes of dirty data (throttled to
+ * bytes_per_sec) or its oldest dirty data is max_age seconds old. The age
+ * bound gives a bounded-staleness mode: a crash loses at most max_age seconds
+ * of writes, provided the application keeps calling into the library.
+ *
+ * @param fapl_id
+ * @param sync
+ * @param dirty_bytes dirty-byte watermark, 0 for none
+ * @param max_age staleness bound in seconds, 0 for none
+ * @param bytes_per_sec flush bandwidth budget for watermark flushes, 0 for none
+ * @return non-negative on success
+ */
+H5_DLL herr_t H5Pset_hermes_vol_flush(hid_t fapl_id, bool sync, size_t dirty_bytes, double max_age,
+                                      size_t bytes_per_sec){
+    HermesVol *info=(HermesVol *)(H5Pget_vol_info(fapl_id));
+    if(info==NULL) return -1;
+    info->sync=sync;
+    info->flush_policy.dirty_bytes=dirty_bytes;
+    info->flush_policy.max_age=max_age;
+    info->flush_policy.bytes_per_sec=bytes_per_sec;
+    return 0;
+}
+
+/**
+ * This method turns read-ahead on for datasets opened with fapl_id. Reads of
+ * each dataset are watched for sequential, strided and repeated slabs, and
+ * the next depth slabs predicted are staged in memory by the worker pool so
+ * the reads that follow are served without touching the buffer layer.
+ * Only contiguous datasets of fixed-size types in files using the sec2
+ * driver are read ahead, and only while the native file is in sync with
+ * the buffer layer, i.e. until the first write after open or sync.
+ *
+ * @param fapl_id
+ * @param depth slabs staged ahead of the reader, 0 to turn read-ahead off
+ * @param max_bytes larger slabs are not staged, 0 for the default
+ * @return non-negative on success
+ */
+H5_DLL herr_t H5Pset_hermes_vol_prefetch(hid_t fapl_id, unsigned depth, size_t max_bytes){
+    HermesVol *info=(HermesVol *)(H5Pget_vol_info(fapl_id));
+    if(info==NULL) return -1;
+    info->prefetch_policy.depth=depth;
+    info->prefetch_policy.max_bytes=max_bytes;
+    return 0;
+}
+
+/**
+ * This method puts the datasets of files opened with fapl_id under a
+ * placement engine. Datasets are cut into extents of about extent_bytes
+ * along their slowest dimension. Extents read are kept in a RAM tier of
+ * ram_bytes managed by the chosen replacement policy; extents it pushes out
+ * are demoted to a tier of demote_bytes in demote_dir, typically a burst
+ * buffer or NVMe mount, and promoted back on their next read. Everything
+ * else is read from the buffer layer. Writes go through to the buffer layer
+ * and update the RAM tier in place.
+ *
+ * @param fapl_id
+ * @param policy HERMES_PLACEMENT_LRU, _LFU or _ARC; _NONE turns placement off
+ * @param ram_bytes capacity of the RAM tier
+ * @param extent_bytes target extent size, 0 for the default
+ * @param demote_dir directory of the demotion tier, NULL for none
+ * @param demote_bytes capacity of the demotion tier
+ * @return non-negative on success
+ */
+H5_DLL herr_t H5Pset_hermes_vol_placement(hid_t fapl_id, HermesPlacementKind policy, size_t ram_bytes,
+                                          size_t extent_bytes, const char *demote_dir, size_t demote_bytes){
+    HermesVol *info=(HermesVol *)(H5Pget_vol_info(fapl_id));
+    HermesPlacement *engine=NULL;
+    if(info==NULL) return -1;
+    if(policy!=HERMES_PLACEMENT_NONE){
+        engine=H5VL_hermes_placement_create(H5VL_hermes_placement_class(policy),ram_bytes,extent_bytes,demote_dir,
+                                            demote_bytes);
+        if(engine==NULL) return -1;
+    }
+    H5VL_hermes_placement_release(info->placement);
+    info->placement=engine;
+    return 0;
+}
+
+/**
+ * This method maps the demotion tier set up by H5Pset_hermes_vol_placement
+ * into memory, for a demote_dir on a node-local SSD or NVMe device. Reads of
+ * demoted extents then copy straight from the mapping into the user buffer
+ * rather than promoting them through RAM, and H5Dhermes_vol_view can hand
+ * the mapping out directly. Call it after H5Pset_hermes_vol_placement and
+ * before the fapl is used.
+ *
+ * @param fapl_id
+ * @return non-negative on success
+ */
+H5_DLL herr_t H5Pset_hermes_vol_mapped_tier(hid_t fapl_id){
+    HermesVol *info=(HermesVol *)(H5Pget_vol_info(fapl_id));
+    if(info==NULL) return -1;
+    return H5VL_hermes_placement_map(info->placement);
+}
+
+/**
+ * This method compresses extents demoted to the tier set up by
+ * H5Pset_hermes_vol_placement, so that a burst buffer or parallel file
+ * system tier holds more of them and moves fewer bytes. Extents are coded
+ * in 64 KiB blocks on the worker pool; blocks that do not shrink are
+ * stored as they are. Not for a mapped tier. Call it after
+ * H5Pset_hermes_vol_placement and before the fapl is used.
+ *
+ * @param fapl_id
+ * @param shuffle whether to shuffle bytes by element size before coding,
+ *        worth it for floating point data
+ * @return non-negative on success
+ */
+H5_DLL herr_t H5Pset_hermes_vol_compression(hid_t fapl_id, bool shuffle){
+    HermesVol *info=(HermesVol *)(H5Pget_vol_info(fapl_id));
+    if(info==NULL) return -1;
+    return H5VL_hermes_placement_compress(info->placement,shuffle);
+}
+
+/**
+ * This method keeps the demotion tier set up by H5Pset_hermes_vol_placement
+ * across runs, in the file path on the tier's device. Closed datasets leave
+ * their extents in the tier, and an index written to path.index when the
+ * fapl goes away lets a restarted job, or the next stage of a workflow on
+ * the same node, read them warm, as long as their file still has the size
+ * and modification time it had when last closed. Only datasets with sync
+ * on are kept, since the native file then matches the tier. A tier another
+ * process owns is not shared and the call fails. Call it after
+ * H5Pset_hermes_vol_placement, _mapped_tier and _compression, and before
+ * the fapl is used.
+ *
+ * @param fapl_id
+ * @param path tier file
+ * @return non-negative on success
+ */
+H5_DLL herr_t H5Pset_hermes_vol_persistent_tier(hid_t fapl_id, const char *path){
+    HermesVol *info=(HermesVol *)(H5Pget_vol_info(fapl_id));
+    if(info==NULL) return -1;
+    return H5VL_hermes_placement_persist(info->placement,path);
+}
+
+/**
+ * This method gives files opened read-only with fapl_id a read cache of
+ * bytes in POSIX shared memory, shared by every process on the node reading
+ * the same version of the file. Each extent is then read from the buffer
+ * layer by one process and copied in place by all the others, so that ranks
+ * of an ensemble reading the same data do not each fetch and hold their
+ * own copy. Datasets of types holding pointers (variable-length, references)
+ * are not shared.
+ *
+ * @param fapl_id
+ * @param bytes size of the segment of each file, 0 to turn the cache off
+ * @return non-negative on success
+ */
+H5_DLL herr_t H5Pset_hermes_vol_shared_cache(hid_t fapl_id, size_t bytes){
+    HermesVol *info=(HermesVol *)(H5Pget_vol_info(fapl_id));
+    if(info==NULL) return -1;
+    info->shared_bytes=bytes;
+    return 0;
+}
+
+/**
+ * This method sets up the tiers of files opened with fapl_id from a config
+ * file rather than by the calls above, so that the same binary adapts to
+ * each node type. What the file leaves to "auto" (extent size, mapping,
+ * coding of the demotion tier) is settled by measuring the tier's device,
+ * once per node and week. H5Pset_fapl_hermes_vol already applies the file
+ * named by HERMES_VOL_CONFIG; settings made afterwards override it.
+ *
+ * @param fapl_id
+ * @param path config file, NULL for the one named by HERMES_VOL_CONFIG
+ * @return non-negative on success
+ */
+H5_DLL herr_t H5Pset_hermes_vol_config(hid_t fapl_id, const char *path){
+    HermesVol *info=(HermesVol *)(H5Pget_vol_info(fapl_id));
+    if(info==NULL) return -1;
+    return hermes_vol_configure(info,path);
+}
+
+/**
+ * This method sizes the chunk stage of chunked datasets in files opened
+ * with fapl_id. Writes then reach the buffer layer as whole chunks only, so
+ * that syncing it never makes HDF5 read back, merge and re-filter a partly
+ * written chunk; pieces of chunks wait in the stage until they are complete
+ * or read.
+ *
+ * @param fapl_id
+ * @param stage_bytes partial chunk data held per dataset, 0 to turn staging off
+ * @return non-negative on success
+ */
+H5_DLL herr_t H5Pset_hermes_vol_chunk_staging(hid_t fapl_id, size_t stage_bytes){
+    HermesVol *info=(HermesVol *)(H5Pget_vol_info(fapl_id));
+    if(info==NULL) return -1;
+    info->chunk_stage_bytes=stage_bytes;
+    return 0;
+}
+
+/**
+ * This method turns write aggregation on or off for unchunked datasets in
+ * files opened with fapl_id. Writes smaller than flush_bytes that touch or
+ * overlap are merged in memory, and reach the buffer layer as one box once
+ * the run holding them is flush_bytes large, or when it is read or flushed.
+ * Codes writing a row or a few elements at a time then leave few large
+ * extents for the buffer layer to index and sync instead of one per write.
+ * Views from H5Dhermes_vol_view see held writes only once they went down.
+ *
+ * @param fapl_id
+ * @param aggregate
+ * @param flush_bytes size at which a run goes down, 0 for the default
+ * @return non-negative on success
+ */
+H5_DLL herr_t H5Pset_hermes_vol_write_aggregation(hid_t fapl_id, bool aggregate, size_t flush_bytes){
+    HermesVol *info=(HermesVol *)(H5Pget_vol_info(fapl_id));
+    if(info==NULL) return -1;
+    if(!aggregate) info->aggregate_bytes=0;
+    else info->aggregate_bytes=flush_bytes?flush_bytes:HERMES_AGGREGATE_DEFAULT_FLUSH_BYTES;
+    return 0;
+}
+
+/**
+ * This method sizes the attribute cache of files opened with fapl_id.
+ * Attributes of fixed-size types up to attr_bytes are created, read and
+ * written in memory and reach the file in one batch when it is flushed or
+ * closed; larger ones go straight to the native connector.
+ *
+ * @param fapl_id
+ * @param attr_bytes largest attribute cached, 0 to turn the cache off
+ * @param cache_bytes attribute data held before the cache is written out, 0 for the default
+ * @return non-negative on success
+ */
+H5_DLL herr_t H5Pset_hermes_vol_metadata(hid_t fapl_id, size_t attr_bytes, size_t cache_bytes){
+    HermesVol *info=(HermesVol *)(H5Pget_vol_info(fapl_id));
+    if(info==NULL) return -1;
+    info->meta_policy.attr_bytes=attr_bytes;
+    info->meta_policy.cache_bytes=cache_bytes;
+    return 0;
+}
+
+/* Hermes VOL Attribute callbacks */
+static void  *hermes_attr_create(void *obj, H5VL_loc_params_t loc_params, const char *attr_name, hid_t acpl_id, hid_t aapl_id, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)obj;
+    HermesVol *attr=NULL;
+    hid_t type_id,space_id;
+    H5Pget(acpl_id, H5VL_PROP_ATTR_TYPE_ID, &type_id);
+    H5Pget(acpl_id, H5VL_PROP_ATTR_SPACE_ID, &space_id);
+    if(hermes_loc_self(&loc_params) && H5VL_hermes_meta_cacheable(o->meta,type_id,space_id)){
+        haddr_t addr=hermes_object_addr(o);
+        if(addr!=HADDR_UNDEF &&
+           H5VL_hermes_meta_attr_create(o->meta,addr,o->object_id,attr_name,type_id,space_id,acpl_id)>=0)
+            attr=hermes_attr_cached(o,addr,attr_name);
+    }else if(hermes_loc_self(&loc_params)){
+        /* Cached attributes of the object go first, so creation order and name checks stay right. */
+        H5VL_hermes_meta_evict(o->meta,hermes_object_addr(o));
+        attr=hermes_object_wrap(o,H5Acreate2(o->object_id,attr_name,type_id,space_id,acpl_id,aapl_id));
+    }else{
+        H5VL_hermes_meta_invalidate(o->meta);
+        attr=hermes_object_wrap(o,H5Acreate_by_name(o->object_id,loc_params.loc_data.loc_by_name.name,attr_name,
+                                                    type_id,space_id,acpl_id,aapl_id,
+                                                    loc_params.loc_data.loc_by_name.lapl_id));
+    }
+    H5VL_hermes_stats_end(HERMES_OP_ATTR_CREATE,begin);
+    return (void *)attr;
+}
+static void  *hermes_attr_open(void *obj, H5VL_loc_params_t loc_params, const char *attr_name, hid_t aapl_id, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)obj;
+    HermesVol *attr=NULL;
+    hid_t attr_id=-1;
+    if(hermes_loc_self(&loc_params)){
+        haddr_t addr=hermes_object_addr(o);
+        int cached=addr==HADDR_UNDEF?0:H5VL_hermes_meta_attr_open(o->meta,addr,o->object_id,attr_name);
+        if(cached>0) attr=hermes_attr_cached(o,addr,attr_name);
+        else if(cached==0) attr_id=H5Aopen(o->object_id,attr_name,aapl_id);
+    }else if(loc_params.type==H5VL_OBJECT_BY_NAME){
+        H5VL_hermes_meta_invalidate(o->meta);
+        attr_id=H5Aopen_by_name(o->object_id,loc_params.loc_data.loc_by_name.name,attr_name,aapl_id,
+                                loc_params.loc_data.loc_by_name.lapl_id);
+    }else if(loc_params.type==H5VL_OBJECT_BY_IDX){
+        H5VL_hermes_meta_invalidate(o->meta);
+        attr_id=H5Aopen_by_idx(o->object_id,loc_params.loc_data.loc_by_idx.name,loc_params.loc_data.loc_by_idx.idx_type,
+                               loc_params.loc_data.loc_by_idx.order,loc_params.loc_data.loc_by_idx.n,aapl_id,
+                               loc_params.loc_data.loc_by_idx.lapl_id);
+    }
+    if(attr_id>=0) attr=hermes_object_wrap(o,attr_id);
+    H5VL_hermes_stats_end(HERMES_OP_ATTR_OPEN,begin);
+    return (void *)attr;
+}
+static herr_t hermes_attr_read(void *attr, hid_t mem_type_id, void *buf, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *a = (HermesVol *)attr;
+    herr_t output=a->attr_name
+                  ?H5VL_hermes_meta_attr_read(a->meta,a->meta_addr,a->object_id,a->attr_name,mem_type_id,buf)
+                  :H5Aread(a->object_id,mem_type_id,buf);
+    H5VL_hermes_stats_end(HERMES_OP_ATTR_READ,begin);
+    return output;
+}
+static herr_t hermes_attr_write(void *attr, hid_t mem_type_id, const void *buf, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *a = (HermesVol *)attr;
+    herr_t output=a->attr_name
+                  ?H5VL_hermes_meta_attr_write(a->meta,a->meta_addr,a->object_id,a->attr_name,mem_type_id,buf)
+                  :H5Awrite(a->object_id,mem_type_id,buf);
+    H5VL_hermes_stats_end(HERMES_OP_ATTR_WRITE,begin);
+    return output;
+}
+static herr_t hermes_attr_get(void *obj, H5VL_attr_get_t get_type, hid_t dxpl_id, void **req, va_list arguments){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)(obj);
+    herr_t output=0;
+    switch (get_type) {
+        /* H5Aget_space */
+        case H5VL_ATTR_GET_SPACE:
+        {
+            hid_t	*ret_id = va_arg(arguments, hid_t *);
+            if(o->attr_name) output=H5VL_hermes_meta_attr_info(o->meta,o->meta_addr,o->object_id,o->attr_name,NULL,ret_id,NULL,NULL);
+            else output=(*ret_id=H5Aget_space(o->object_id))<0?-1:0;
+            break;
+        }
+            /* H5Aget_type */
+        case H5VL_ATTR_GET_TYPE:
+        {
+            hid_t	*ret_id = va_arg(arguments, hid_t *);
+            if(o->attr_name) output=H5VL_hermes_meta_attr_info(o->meta,o->meta_addr,o->object_id,o->attr_name,ret_id,NULL,NULL,NULL);
+            else output=(*ret_id=H5Aget_type(o->object_id))<0?-1:0;
+            break;
+        }
+            /* H5Aget_create_plist */
+        case H5VL_ATTR_GET_ACPL:
+        {
+            hid_t	*ret_id = va_arg(arguments, hid_t *);
+            if(o->attr_name) output=H5VL_hermes_meta_attr_info(o->meta,o->meta_addr,o->object_id,o->attr_name,NULL,NULL,ret_id,NULL);
+            else output=(*ret_id=H5Aget_create_plist(o->object_id))<0?-1:0;
+            break;
+        }
+            /* H5Aget_storage_size */
+        case H5VL_ATTR_GET_STORAGE_SIZE:
+        {
+            hsize_t *ret = va_arg(arguments, hsize_t *);
+            if(o->attr_name) output=H5VL_hermes_meta_attr_info(o->meta,o->meta_addr,o->object_id,o->attr_name,NULL,NULL,NULL,ret);
+            else *ret=H5Aget_storage_size(o->object_id);
+            break;
+        }
+            /* H5Aget_name, H5Aget_name_by_idx */
+        case H5VL_ATTR_GET_NAME:
+        {
+            H5VL_loc_params_t loc_params = va_arg(arguments, H5VL_loc_params_t);
+            size_t buf_size = va_arg(arguments, size_t);
+            char *buf = va_arg(arguments, char *);
+            ssize_t *ret_val = va_arg(arguments, ssize_t *);
+            if(loc_params.type==H5VL_OBJECT_BY_SELF && o->attr_name){
+                size_t length=strlen(o->attr_name);
+                if(buf && buf_size){
+                    size_t copied=length<buf_size-1?length:buf_size-1;
+                    memcpy(buf,o->attr_name,copied);
+                    buf[copied]='\0';
+                }
+                *ret_val=(ssize_t)length;
+            }else if(loc_params.type==H5VL_OBJECT_BY_SELF){
+                *ret_val=H5Aget_name(o->object_id,buf_size,buf);
+            }else{
+                H5VL_hermes_meta_invalidate(o->meta);
+                *ret_val=H5Aget_name_by_idx(o->object_id,loc_params.loc_data.loc_by_idx.name,
+                                            loc_params.loc_data.loc_by_idx.idx_type,loc_params.loc_data.loc_by_idx.order,
+                                            loc_params.loc_data.loc_by_idx.n,buf,buf_size,
+                                            loc_params.loc_data.loc_by_idx.lapl_id);
+            }
+            output=*ret_val<0?-1:0;
+            break;
+        }
+            /* H5Aget_info, H5Aget_info_by_name, H5Aget_info_by_idx */
+        case H5VL_ATTR_GET_INFO:
+        {
+            H5VL_loc_params_t loc_params = va_arg(arguments, H5VL_loc_params_t);
+            H5A_info_t *ainfo = va_arg(arguments, H5A_info_t *);
+            if(loc_params.type==H5VL_OBJECT_BY_SELF && o->attr_name){
+                /* Creation order and character set belong to the native file; write the attribute there first. */
+                H5VL_hermes_meta_evict(o->meta,o->meta_addr);
+                output=H5Aget_info_by_name(o->object_id,".",o->attr_name,ainfo,H5P_DEFAULT);
+            }else if(loc_params.type==H5VL_OBJECT_BY_SELF){
+                output=H5Aget_info(o->object_id,ainfo);
+            }else if(loc_params.type==H5VL_OBJECT_BY_NAME){
+                const char *attr_name = va_arg(arguments, const char *);
+                H5VL_hermes_meta_invalidate(o->meta);
+                output=H5Aget_info_by_name(o->object_id,loc_params.loc_data.loc_by_name.name,attr_name,ainfo,
+                                           loc_params.loc_data.loc_by_name.lapl_id);
+            }else{
+                H5VL_hermes_meta_invalidate(o->meta);
+                output=H5Aget_info_by_idx(o->object_id,loc_params.loc_data.loc_by_idx.name,
+                                          loc_params.loc_data.loc_by_idx.idx_type,loc_params.loc_data.loc_by_idx.order,
+                                          loc_params.loc_data.loc_by_idx.n,ainfo,loc_params.loc_data.loc_by_idx.lapl_id);
+            }
+            break;
+        }
+        default:
+            output=-1;
+    }
+    H5VL_hermes_stats_end(HERMES_OP_ATTR_GET,begin);
+    return output;
+}
+static herr_t hermes_attr_specific(void *obj, H5VL_loc_params_t loc_params, H5VL_attr_specific_t specific_type, hid_t dxpl_id, void **req, va_list arguments){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)(obj);
+    bool self=hermes_loc_self(&loc_params);
+    const char *name=loc_params.type==H5VL_OBJECT_BY_NAME?loc_params.loc_data.loc_by_name.name:".";
+    hid_t lapl_id=loc_params.type==H5VL_OBJECT_BY_NAME?loc_params.loc_data.loc_by_name.lapl_id:H5P_DEFAULT;
+    herr_t output=-1;
+    /* Everything but a lookup on the object itself is left to the native connector. */
+    if(self && specific_type!=H5VL_ATTR_EXISTS) H5VL_hermes_meta_evict(o->meta,hermes_object_addr(o));
+    else if(!self) H5VL_hermes_meta_invalidate(o->meta);
+    switch (specific_type) {
+        /* H5Adelete, H5Adelete_by_name, H5Adelete_by_idx */
+        case H5VL_ATTR_DELETE:
+        {
+            const char *attr_name = va_arg(arguments, const char *);
+            if(loc_params.type==H5VL_OBJECT_BY_IDX)
+                output=H5Adelete_by_idx(o->object_id,loc_params.loc_data.loc_by_idx.name,
+                                        loc_params.loc_data.loc_by_idx.idx_type,loc_params.loc_data.loc_by_idx.order,
+                                        loc_params.loc_data.loc_by_idx.n,loc_params.loc_data.loc_by_idx.lapl_id);
+            else
+                output=H5Adelete_by_name(o->object_id,name,attr_name,lapl_id);
+            break;
+        }
+            /* H5Aexists, H5Aexists_by_name */
+        case H5VL_ATTR_EXISTS:
+        {
+            const char *attr_name = va_arg(arguments, const char *);
+            htri_t *ret = va_arg(arguments, htri_t *);
+            haddr_t addr=self?hermes_object_addr(o):HADDR_UNDEF;
+            *ret=addr!=HADDR_UNDEF?H5VL_hermes_meta_attr_exists(o->meta,addr,o->object_id,attr_name)
+                                  :H5Aexists_by_name(o->object_id,name,attr_name,lapl_id);
+            output=*ret<0?-1:0;
+            break;
+        }
+            /* H5Aiterate2, H5Aiterate_by_name */
+        case H5VL_ATTR_ITER:
+        {
+            H5_index_t idx_type = (H5_index_t)va_arg(arguments, int);
+            H5_iter_order_t order = (H5_iter_order_t)va_arg(arguments, int);
+            hsize_t *idx = va_arg(arguments, hsize_t *);
+            H5A_operator2_t op = va_arg(arguments, H5A_operator2_t);
+            void *op_data = va_arg(arguments, void *);
+            output=H5Aiterate_by_name(o->object_id,name,idx_type,order,idx,op,op_data,lapl_id);
+            break;
+        }
+            /* H5Arename, H5Arename_by_name */
+        case H5VL_ATTR_RENAME:
+        {
+            const char *old_name = va_arg(arguments, const char *);
+            const char *new_name = va_arg(arguments, const char *);
+            output=H5Arename_by_name(o->object_id,name,old_name,new_name,lapl_id);
+            break;
+        }
+        default:
+            break;
+    }
+    H5VL_hermes_stats_end(HERMES_OP_ATTR_SPECIFIC,begin);
+    return output;
+}
+static herr_t hermes_attr_close(void *attr, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *a = (HermesVol *)(attr);
+    herr_t output=a->attr_name?(H5Idec_ref(a->object_id)<0?-1:0):H5Aclose(a->object_id);
+    hermes_object_free(a);
+    H5VL_hermes_stats_end(HERMES_OP_ATTR_CLOSE,begin);
+    return output;
+}
+/**
+ * This method makes the handle of an attribute served from the cache. It
+ * holds a reference on the native object the attribute belongs to.
+ *
+ * @param loc object holding the attribute
+ * @param addr address of loc
+ * @param name
+ * @return attribute, or NULL
+ */
+static HermesVol *hermes_attr_cached(HermesVol *loc, haddr_t addr, const char *name){
+    HermesVol *attr;
+    if(H5Iinc_ref(loc->object_id)<0) return NULL;
+    attr=hermes_object_wrap(loc,loc->object_id);
+    if(attr==NULL) return NULL;
+    attr->meta_addr=addr;
+    attr->attr_name=(char*)malloc(strlen(name)+1);
+    if(attr->attr_name==NULL){
+        H5Idec_ref(attr->object_id);
+        hermes_object_free(attr);
+        return NULL;
+    }
+    strcpy(attr->attr_name,name);
+    return attr;
+}
 
 /* Hermes VOL Dataset callbacks */
+/**
+ * This method caches the geometry and type of a freshly created or opened
+ * dataset in its HermesVol, so the read/write path needs no HDF5 metadata
+ * calls.
+ *
+ * @param dset dataset object
+ * @param space_id dataspace of the dataset
+ * @param type_id type of the dataset, copied
+ * @return non-negative on success
+ */
+static herr_t hermes_dataset_describe(HermesVol *dset, hid_t space_id, hid_t type_id){
+    dset->rank=H5Sget_simple_extent_dims(space_id,dset->dims,dset->max_dims);
+    if(dset->rank<0) return -1;
+    dset->type.type_id=H5Tcopy(type_id);
+    dset->type.size=H5Tget_size(type_id);
+    dset->type.type_class=H5Tget_class(type_id);
+    dset->type.order=H5Tget_order(type_id);
+    /* Variable-length data is left as the buffer layer has it. */
+    if(dset->type.type_class==H5T_VLEN || dset->type.type_class==H5T_REFERENCE || H5Tis_variable_str(type_id)>0)
+        dset->type.native_type_id=-1;
+    else
+        dset->type.native_type_id=H5Tget_native_type(type_id,H5T_DIR_DEFAULT);
+    if(dset->type.native_type_id<0) dset->type.native_type_id=H5Tcopy(type_id);
+    dset->type.native_size=H5Tget_size(dset->type.native_type_id);
+    if(H5VL_hermes_convert_plan(dset->type.type_id,dset->type.native_type_id,&dset->type.to_native)<0 ||
+       H5VL_hermes_convert_plan(dset->type.native_type_id,dset->type.type_id,&dset->type.to_file)<0 ||
+       H5VL_hermes_convert_plan(dset->type.native_type_id,dset->type.native_type_id,&dset->type.to_memory)<0)
+        return -1;
+    dset->type.read_type_id=dset->type.write_type_id=dset->type.native_type_id;
+    dset->type.from_memory=dset->type.to_memory;
+    return dset->type.type_id<0?-1:0;
+}
+/**
+ * This method plans the conversion between a memory type and the native
+ * type of a dataset. The dataset's own type and the memory type of its last
+ * read or write are answered from the plans kept in o->type.
+ *
+ * @param o dataset
+ * @param mem_type_id
+ * @param write true for memory to native, false for native to memory
+ * @param conv set to the plan
+ * @return non-negative on success
+ */
+static herr_t hermes_dataset_plan(HermesVol *o, hid_t mem_type_id, bool write, HermesConversion *conv){
+    HermesTypeInfo *type=&o->type;
+    hid_t *last=write?&type->write_type_id:&type->read_type_id;
+    HermesConversion *plan=write?&type->from_memory:&type->to_memory;
+    if(mem_type_id==type->type_id){
+        *conv=write?type->to_native:type->to_file;
+        return 0;
+    }
+    if(mem_type_id!=*last){
+        herr_t output=write?H5VL_hermes_convert_plan(mem_type_id,type->native_type_id,plan)
+                           :H5VL_hermes_convert_plan(type->native_type_id,mem_type_id,plan);
+        if(output<0){
+            *last=-1;
+            return -1;
+        }
+        *last=mem_type_id;
+    }
+    *conv=*plan;
+    return 0;
+}
+/**
+ * This method sets up read-ahead for a dataset whose raw data can be read
+ * straight from the native file: contiguous storage, a fixed-size type
+ * stored natively or byte-swapped, and the sec2 driver.
+ *
+ * @param dset described dataset object
+ * @param dcpl_id creation properties of the dataset
+ * @return prefetcher, or NULL
+ */
+static HermesPrefetcher *hermes_dataset_prefetcher(HermesVol *dset, hid_t dcpl_id){
+    if(dset->prefetch_policy.depth==0 || dset->rank<1) return NULL;
+    if(H5Pget_layout(dcpl_id)!=H5D_CONTIGUOUS || H5Pget_driver(dset->native_fapl)!=H5FD_SEC2) return NULL;
+    if(dset->type.type_class==H5T_VLEN || dset->type.type_class==H5T_REFERENCE ||
+       H5Tis_variable_str(dset->type.type_id)>0)
+        return NULL;
+    if(dset->type.to_native.kind!=HERMES_CONVERT_NONE && dset->type.to_native.kind!=HERMES_CONVERT_SWAP) return NULL;
+    return H5VL_hermes_prefetch_create(&dset->prefetch_policy,dset->file_name,H5Dget_offset(dset->object_id),
+                                       dset->rank,dset->dims,dset->type.size,dset->type.to_native.kernel,
+                                       dset->async_workers);
+}
+/**
+ * This method sets up chunk staging for a chunked dataset of a fixed-size
+ * type. Variable-length elements hold pointers into user memory, which must
+ * not outlive the write.
+ *
+ * @param dset described dataset object
+ * @param dcpl_id creation properties of the dataset
+ * @return stage, or NULL
+ */
+static HermesChunkStage *hermes_dataset_chunks(HermesVol *dset, hid_t dcpl_id){
+    hsize_t chunk_dims[H5S_MAX_RANK];
+    if(dset->chunk_stage_bytes==0 || dset->rank<1 || H5Pget_layout(dcpl_id)!=H5D_CHUNKED) return NULL;
+    if(dset->type.type_class==H5T_VLEN || dset->type.type_class==H5T_REFERENCE ||
+       H5Tis_variable_str(dset->type.type_id)>0)
+        return NULL;
+    if(H5Pget_chunk(dcpl_id,dset->rank,chunk_dims)!=dset->rank) return NULL;
+    return H5VL_hermes_chunk_create(dset->rank,dset->dims,dset->max_dims,chunk_dims,dset->type.native_size,
+                                    dset->chunk_stage_bytes);
+}
+/**
+ * This method sets up write aggregation for a dataset of a fixed-size type
+ * without a chunk stage, which already gathers the writes of chunked ones.
+ *
+ * @param dset described dataset object
+ * @return aggregator, or NULL
+ */
+static HermesAggregator *hermes_dataset_aggregator(HermesVol *dset){
+    if(dset->aggregate_bytes==0 || dset->chunks || dset->rank<1) return NULL;
+    if(dset->type.type_class==H5T_VLEN || dset->type.type_class==H5T_REFERENCE ||
+       H5Tis_variable_str(dset->type.type_id)>0)
+        return NULL;
+    return H5VL_hermes_aggregate_create(dset->rank,dset->type.native_size,dset->aggregate_bytes);
+}
+/**
+ * This method writes out the staged chunks and pending runs a selection
+ * overlaps, so that it can be read from the buffer layer and the tiers.
+ *
+ * @param o dataset
+ * @param file decoded selection, NULL for everything held
+ * @return non-negative on success
+ */
+static herr_t hermes_dataset_unstage(HermesVol *o, const HermesSelection *file){
+    HermesTransfer transfer;
+    hsize_t start[H5S_MAX_RANK],end[H5S_MAX_RANK];
+    if((o->chunks==NULL && o->aggregate==NULL) || (file && file->type==HERMES_SELECTION_NONE)) return 0;
+    if(file) H5VL_hermes_selection_bounds(file,start,end);
+    hermes_dataset_transfer(o,&transfer);
+    if(o->aggregate)
+        return H5VL_hermes_aggregate_flush(o->aggregate,file?start:NULL,file?end:NULL,hermes_buffer_write_op,
+                                           &transfer);
+    return H5VL_hermes_chunk_flush(o->chunks,file?start:NULL,file?end:NULL,hermes_buffer_read_op,
+                                   hermes_buffer_write_op,&transfer);
+}
+/**
+ * This method finds the full path of a dataset in its file, which unlike
+ * the name it was opened by does not depend on the location.
+ *
+ * @param dset
+ * @return malloc'ed path, or NULL
+ */
+static char *hermes_dataset_path(HermesVol *dset){
+    ssize_t length=H5Iget_name(dset->object_id,NULL,0);
+    char *path;
+    if(length<=0) return NULL;
+    path=(char*)malloc((size_t)length+1);
+    if(path && H5Iget_name(dset->object_id,path,(size_t)length+1)<=0){
+        free(path);
+        path=NULL;
+    }
+    return path;
+}
+/**
+ * This method keys a dataset's extents by its file and full path, so that a
+ * kept tier can hand them to the next open of the dataset.
+ *
+ * @param dset dataset with its extent set
+ * @param created whether the dataset is new
+ */
+static void hermes_dataset_persist(HermesVol *dset, bool created){
+    char *path;
+    if(dset->extents==NULL || !dset->sync) return;
+    path=hermes_dataset_path(dset);
+    if(path) H5VL_hermes_extent_set_persist(dset->extents,dset->file_name,path,created);
+    free(path);
+}
+/**
+ * This method puts a dataset of a file opened read-only under the node's
+ * shared cache, unless its elements hold pointers, which mean nothing in
+ * another process.
+ *
+ * @param dset described dataset object
+ * @return extent set, or NULL
+ */
+static HermesSharedSet *hermes_dataset_shared(HermesVol *dset){
+    HermesSharedSet *set;
+    char *path;
+    if(dset->shared==NULL || dset->rank<1) return NULL;
+    if(dset->type.type_class==H5T_VLEN || dset->type.type_class==H5T_REFERENCE ||
+       H5Tis_variable_str(dset->type.type_id)>0)
+        return NULL;
+    path=hermes_dataset_path(dset);
+    set=H5VL_hermes_shared_set_create(dset->shared,path,dset->rank,dset->dims,dset->type.native_size);
+    free(path);
+    return set;
+}
 static void  *hermes_dataset_create(void *obj, H5VL_loc_params_t loc_params, const char *name, hid_t dcpl_id, hid_t dapl_id, hid_t dxpl_id, void **req){
-    HermesVol *dset;
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *dset=NULL;
     HermesVol *o = (HermesVol *)obj;
 
-    dset= (HermesVol *)(H5VL_hermes_fapl_copy(o));
-    dset->dataset_name=(char*)malloc(strlen(name)+1);
-    strcpy(dset->dataset_name,name);
     hid_t dataspace,type_id;
     H5Pget(dcpl_id, H5VL_PROP_DSET_TYPE_ID, &type_id);
     H5Pget(dcpl_id, H5VL_PROP_DSET_SPACE_ID, &dataspace);
     hid_t dataset_id= H5Dcreate1(o->object_id, name, type_id,dataspace, dcpl_id);
+    /* As in hermes_dataset_setup, nothing is set up for a dataset HDF5 did not create. */
+    if(dataset_id>=0){
+        dset= hermes_vol_clone(o);
+        if(dset==NULL) H5Dclose(dataset_id);
+    }
+    if(dset==NULL){
+        H5VL_hermes_stats_end(HERMES_OP_DATASET_CREATE,begin);
+        return NULL;
+    }
+    H5VL_hermes_name_release(dset->dataset_name);
+    dset->dataset_name=H5VL_hermes_name_intern(name);
     dset->object_id=dataset_id;
-    //char* filename=o->file_name;
-    char* filename=basename( o->file_name );
-    char* dataset_name=dset->dataset_name;
-    hsize_t *dims,*max_dims;
-    int rank_=H5Sget_simple_extent_dims(dataspace,NULL, NULL);
-    dims= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-    max_dims= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-    H5Sget_simple_extent_dims(dataspace,dims, max_dims);
-    H5_BufferInit(filename,dataset_name,rank_,type_id,dims, max_dims,dataset_id);
-    free(dims);
-    free(max_dims);
+    dset->meta_fresh=true;
+    hermes_dataset_describe(dset,dataspace,type_id);
+    dset->prefetch=hermes_dataset_prefetcher(dset,dcpl_id);
+    dset->chunks=hermes_dataset_chunks(dset,dcpl_id);
+    dset->aggregate=hermes_dataset_aggregator(dset);
+    dset->extents=H5VL_hermes_extent_set_create(dset->placement,dset->rank,dset->dims,dset->type.native_size,
+                                                dset->async_workers);
+    hermes_dataset_persist(dset,true);
+    /* Workers must not call H5Tconvert, so such datasets are written synchronously. */
+    if(dset->async && dset->type.to_file.kind!=HERMES_CONVERT_GENERIC)
+        hermes_dataset_queue(dset);
+    if(dset->sync){
+        H5VL_hermes_flusher_register(&dset->dirty,&dset->flush_policy,hermes_dataset_flush,dset,dset->file_name);
+        hermes_dataset_track(dset);
+    }
+    hermes_buffer_init(dset);
+    H5VL_hermes_stats_end(HERMES_OP_DATASET_CREATE,begin);
+    return (void *)dset;
+}
+static void  *hermes_dataset_open(void *obj, H5VL_loc_params_t loc_params, const char *name, hid_t dapl_id, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)obj;
+    HermesVol *dset=hermes_dataset_setup(o,name,H5Dopen2(o->object_id, name, dapl_id));
+    H5VL_hermes_stats_end(HERMES_OP_DATASET_OPEN,begin);
     return (void *)dset;
 }
-static void  *hermes_dataset_open(void *obj, H5VL_loc_params_t loc_params, const char *name, hid_t dapl_id, hid_t dxpl_id, void **req){
-    HermesVol *dset;
-    HermesVol *o = (HermesVol *)obj;
-    dset= (HermesVol *)(H5VL_hermes_fapl_copy(o));
-    dset->dataset_name=(char*)malloc(strlen(name)+1);
-    strcpy(dset->dataset_name,name);
-    hid_t dataset_id= H5Dopen2(o->object_id, name, dapl_id);
-    dset->object_id=dataset_id;
-    char* filename=basename( o->file_name );//char* filename=o->file_name;
-    char* dataset_name=o->dataset_name;
-    hsize_t *dims,*max_dims;
-    hid_t file_space_id=H5Dget_space(dataset_id);
-    int rank_=H5Sget_simple_extent_dims(file_space_id,NULL, NULL);
-    dims= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-    max_dims= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-    H5Sget_simple_extent_dims(file_space_id,dims, max_dims);
-    int64_t type_=H5Dget_type(dataset_id);
-    H5_BufferInit(filename,dataset_name,rank_,type_,dims, max_dims,dataset_id);
-    return (void *)dset;
+/**
+ * This method sets up a dataset the native connector opened: geometry,
+ * read-ahead, placement, write-behind and its registration with the buffer
+ * layer.
+ *
+ * @param parent location the dataset was opened from
+ * @param name key of the dataset in the buffer layer
+ * @param dataset_id native dataset, closed if no dataset can be made
+ * @return dataset, or NULL if dataset_id is invalid or out of memory
+ */
+static HermesVol *hermes_dataset_setup(HermesVol *parent, const char *name, hid_t dataset_id){
+    HermesVol *dset;
+    if(dataset_id<0) return NULL;
+    dset= hermes_vol_clone(parent);
+    if(dset==NULL){
+        H5Dclose(dataset_id);
+        return NULL;
+    }
+    H5VL_hermes_name_release(dset->dataset_name);
+    dset->dataset_name=H5VL_hermes_name_intern(name);
+    dset->object_id=dataset_id;
+    hid_t file_space_id=H5Dget_space(dataset_id);
+    hid_t type_id=H5Dget_type(dataset_id);
+    hermes_dataset_describe(dset,file_space_id,type_id);
+    H5Sclose(file_space_id);
+    H5Tclose(type_id);
+    hid_t dcpl_id=H5Dget_create_plist(dataset_id);
+    dset->prefetch=hermes_dataset_prefetcher(dset,dcpl_id);
+    dset->chunks=hermes_dataset_chunks(dset,dcpl_id);
+    dset->aggregate=hermes_dataset_aggregator(dset);
+    H5Pclose(dcpl_id);
+    dset->extents=H5VL_hermes_extent_set_create(dset->placement,dset->rank,dset->dims,dset->type.native_size,
+                                                dset->async_workers);
+    hermes_dataset_persist(dset,false);
+    dset->shared_extents=hermes_dataset_shared(dset);
+    /* Workers must not call H5Tconvert, so such datasets are written synchronously. */
+    if(dset->async && dset->type.to_file.kind!=HERMES_CONVERT_GENERIC)
+        hermes_dataset_queue(dset);
+    if(dset->sync){
+        H5VL_hermes_flusher_register(&dset->dirty,&dset->flush_policy,hermes_dataset_flush,dset,dset->file_name);
+        hermes_dataset_track(dset);
+    }
+    hermes_buffer_init(dset);
+    return dset;
+}
+static herr_t hermes_dataset_read(void *dset, hid_t mem_type_id, hid_t mem_space_id, hid_t file_space_id, hid_t dxpl_id, void *buf, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)(dset);
+    HermesTransfer transfer;
+    HermesSelection file;
+    HermesConversion conv;
+    herr_t output=hermes_dataset_drain(o);
+    hermes_dataset_transfer(o,&transfer);
+    if(output>=0) output=hermes_dataset_plan(o,mem_type_id,false,&conv);
+    if(output>=0){
+        output=H5VL_hermes_selection_decode(file_space_id,o->rank,o->dims,&file);
+        if(output>=0) output=hermes_dataset_unstage(o,&file);
+        if(output>=0 && conv.kind!=HERMES_CONVERT_NONE)
+            output=hermes_dataset_unpack(o,&transfer,&conv,&file,mem_space_id,file_space_id,buf);
+        else if(output>=0 && !H5VL_hermes_prefetch_serve(o->prefetch,&file,mem_space_id,mem_type_id,buf,&output))
+            output=H5VL_hermes_selection_transfer(&file,mem_space_id,mem_type_id,o->type.native_size,buf,false,
+                                                  hermes_transfer_read_op(&transfer),&transfer);
+        if(output>=0) H5VL_hermes_prefetch_observe(o->prefetch,&file);
+        H5VL_hermes_selection_release(&file);
+    }
+    /* Reads complete before returning; hand back a finished token. */
+    if(o->async && req) *req=H5VL_hermes_async_completed(output);
+    H5VL_hermes_flusher_poll();
+    H5VL_hermes_stats_end(HERMES_OP_DATASET_READ,begin);
+    return output;
+}
+static herr_t hermes_dataset_write(void *dset, hid_t mem_type_id, hid_t mem_space_id, hid_t file_space_id, hid_t dxpl_id, const void *buf, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)(dset);
+    HermesTransfer transfer;
+    HermesConversion conv;
+    hermes_dataset_transfer(o,&transfer);
+    herr_t output=hermes_dataset_plan(o,mem_type_id,true,&conv);
+    H5VL_hermes_prefetch_invalidate(o->prefetch);
+    if(output<0){
+        /* nothing written */
+    }else if(o->pending){
+        output=hermes_dataset_write_async(o,&transfer,&conv,mem_space_id,file_space_id,buf,req);
+    }else{
+        if(conv.kind==HERMES_CONVERT_NONE){
+            output=H5VL_hermes_selection_iterate(file_space_id,mem_space_id,o->rank,o->dims,mem_type_id,
+                                                 o->type.native_size,(void *)(buf),true,
+                                                 hermes_transfer_write_op(&transfer),&transfer);
+        }else{
+            HermesSelection file;
+            void *staging;
+            output=hermes_dataset_pack(o,&conv,mem_space_id,file_space_id,buf,&file,&staging,true);
+            if(output>=0)
+                output=H5VL_hermes_selection_iterate_dense(&file,staging,o->type.native_size,
+                                                           hermes_transfer_write_op(&transfer),
+                                                           &transfer);
+            H5VL_hermes_selection_release(&file);
+            H5VL_hermes_arena_pop(staging);
+        }
+        if(o->sync && transfer.bytes){
+            hsize_t start[H5S_MAX_RANK],end[H5S_MAX_RANK];
+            if(file_space_id==H5S_ALL || o->rank<1 || H5Sget_select_bounds(file_space_id,start,end)<0){
+                start[0]=0;
+                end[0]=o->rank<1 || o->dims[0]==0?0:o->dims[0]-1;
+            }
+            H5VL_hermes_flusher_dirty(&o->dirty,start[0],end[0],transfer.bytes);
+        }
+        if(o->async && req) *req=H5VL_hermes_async_completed(output);
+    }
+    /* Partial chunks are only completed here: that reads the buffer layer, which workers must not. */
+    if(output>=0 && H5VL_hermes_chunk_over(o->chunks)){
+        output=hermes_dataset_drain(o);
+        if(output>=0) output=hermes_dataset_unstage(o,NULL);
+    }
+    H5VL_hermes_flusher_poll();
+    H5VL_hermes_stats_end(HERMES_OP_DATASET_WRITE,begin);
+    return output;
+}
+/**
+ * This method hands out a read-only view of a selection straight from the
+ * mapped tier, saving the copy into a user buffer. The selection must be a
+ * single block lying in one extent and contiguous in it, e.g. whole rows;
+ * the view holds its elements in the native equivalent of the dataset's
+ * type and reflects later writes. It stays valid until given back with
+ * H5Dhermes_vol_unview, which must happen before the dataset is closed.
+ *
+ * @param dataset_id dataset of a file opened with a mapped tier
+ * @param file_space_id selection to view
+ * @param token set to what H5Dhermes_vol_unview takes
+ * @return first element of the selection, or NULL when it cannot be viewed,
+ *         in which case H5Dread still works
+ */
+H5_DLL const void *H5Dhermes_vol_view(hid_t dataset_id, hid_t file_space_id, void **token){
+    HermesVol *o = (HermesVol *)(H5VLobject(dataset_id));
+    HermesTransfer transfer;
+    HermesSelection file;
+    hsize_t start[H5S_MAX_RANK],end[H5S_MAX_RANK];
+    const void *view=NULL;
+    int i;
+    if(o==NULL || o->extents==NULL || hermes_dataset_drain(o)<0) return NULL;
+    if(H5VL_hermes_selection_decode(file_space_id,o->rank,o->dims,&file)<0) return NULL;
+    bool single=file.type==HERMES_SELECTION_REGULAR;
+    for(i=0;single && i<o->rank;i++) single=file.count[i]==1;
+    if(single && hermes_dataset_unstage(o,&file)>=0){
+        H5VL_hermes_selection_bounds(&file,start,end);
+        hermes_dataset_transfer(o,&transfer);
+        view=H5VL_hermes_placement_view(o->extents,start,end,hermes_transfer_load_op(&transfer),&transfer,
+                                        (HermesExtent **)token);
+    }
+    H5VL_hermes_selection_release(&file);
+    return view;
+}
+H5_DLL void H5Dhermes_vol_unview(void *token){
+    H5VL_hermes_placement_unview((HermesExtent *)token);
+}
+/**
+ * This method fills the arguments shared by every box of a transfer.
+ *
+ * @param o dataset
+ * @param transfer
+ */
+static void hermes_dataset_transfer(HermesVol *o, HermesTransfer *transfer){
+    transfer->filename=o->file_key;
+    transfer->dataset_name=o->dataset_name;
+    transfer->rank=o->rank;
+    transfer->type=o->type.type_id;
+    transfer->elem_size=o->type.native_size;
+    transfer->to_native=&o->type.to_native;
+    transfer->to_file=&o->type.to_file;
+    transfer->dataset_id=o->object_id;
+    transfer->extents=o->extents;
+    transfer->chunks=o->chunks;
+    transfer->aggregate=o->aggregate;
+    transfer->shared=o->shared_extents;
+    transfer->deferred=NULL;
+    transfer->bytes=0;
+}
+/**
+ * This method gives an asynchronous dataset its queue of writes. Without
+ * both the queue and somewhere to leave what the workers pack, the dataset
+ * is written synchronously.
+ *
+ * @param dset
+ */
+static void hermes_dataset_queue(HermesVol *dset){
+    dset->pending=H5VL_hermes_async_group_create();
+    dset->deferred=hermes_deferred_create();
+    if(dset->pending && dset->deferred) return;
+    H5VL_hermes_async_group_free(dset->pending);
+    hermes_deferred_free(dset->deferred);
+    dset->pending=NULL;
+    dset->deferred=NULL;
+}
+/**
+ * This method waits for the queued writes of a dataset and writes what they
+ * packed to the buffer layer.
+ *
+ * @param o dataset
+ * @return the first error of a write nobody was told about, or 0
+ */
+static herr_t hermes_dataset_drain(HermesVol *o){
+    herr_t output=H5VL_hermes_async_group_drain(o->pending);
+    herr_t deferred=hermes_deferred_write(o,o->deferred,true);
+    return output<0?output:deferred;
+}
+/**
+ * This method packs the selected elements of a user buffer densely, in the
+ * order H5VL_hermes_selection_iterate_dense walks file, and converts them
+ * to the native type. The caller releases file and frees staging, also on
+ * failure.
+ *
+ * @param o dataset
+ * @param conv from the memory type to the native type
+ * @param mem_space_id memory selection of the write
+ * @param file_space_id file selection of the write
+ * @param buf user buffer
+ * @param file decoded file selection
+ * @param staging packed native elements
+ * @param scratch whether staging is taken from the calling thread's arena, to
+ *        be given back with H5VL_hermes_arena_pop, rather than malloc'ed
+ * @return non-negative on success
+ */
+static herr_t hermes_dataset_pack(HermesVol *o, const HermesConversion *conv, hid_t mem_space_id,
+                                  hid_t file_space_id, const void *buf, HermesSelection *file, void **staging,
+                                  bool scratch){
+    size_t bytes;
+    *staging=NULL;
+    if(H5VL_hermes_selection_decode(file_space_id,o->rank,o->dims,file)<0) return -1;
+    bytes=H5VL_hermes_convert_bytes(conv,(size_t)file->npoints)+1;
+    *staging=scratch?H5VL_hermes_arena_push(bytes):malloc(bytes);
+    if(*staging==NULL ||
+       H5VL_hermes_selection_gather(file_space_id,mem_space_id,conv->src_type_id,conv->src_size,file->npoints,buf,
+                                    *staging)<0)
+        return -1;
+    return H5VL_hermes_convert(conv,*staging,(size_t)file->npoints);
+}
+/**
+ * This method reads the selected elements densely in the native type,
+ * converts them to the memory type and unpacks them into the user buffer.
+ *
+ * @param o dataset
+ * @param transfer
+ * @param conv from the native type to the memory type
+ * @param file decoded file selection of the read
+ * @param mem_space_id memory selection of the read
+ * @param file_space_id file selection of the read
+ * @param buf user buffer
+ * @return non-negative on success
+ */
+static herr_t hermes_dataset_unpack(HermesVol *o, HermesTransfer *transfer, const HermesConversion *conv,
+                                    const HermesSelection *file, hid_t mem_space_id, hid_t file_space_id, void *buf){
+    void *staging=H5VL_hermes_arena_push(H5VL_hermes_convert_bytes(conv,(size_t)file->npoints)+1);
+    herr_t output=staging?0:-1;
+    if(output>=0)
+        output=H5VL_hermes_selection_iterate_dense(file,staging,o->type.native_size,
+                                                   hermes_transfer_read_op(transfer),transfer);
+    if(output>=0) output=H5VL_hermes_convert(conv,staging,(size_t)file->npoints);
+    if(output>=0)
+        output=H5VL_hermes_selection_scatter(file_space_id,mem_space_id,conv->dst_type_id,conv->dst_size,
+                                             file->npoints,staging,buf);
+    H5VL_hermes_arena_pop(staging);
+    return output;
+}
+/**
+ * This method stages a write for the worker pool: the file selection is
+ * decoded and the user buffer packed and converted on the calling thread, so
+ * the worker makes no HDF5 calls and the user may reuse buf as soon as this
+ * returns. The worker only places the boxes and packs them for the buffer
+ * layer; the caller writes them there, starting with those of earlier
+ * writes here, so they do not pile up.
+ */
+static herr_t hermes_dataset_write_async(HermesVol *o, const HermesTransfer *transfer, const HermesConversion *conv,
+                                         hid_t mem_space_id, hid_t file_space_id, const void *buf, void **req){
+    HermesWriteJob *job=hermes_write_job_create(o,transfer,conv,mem_space_id,file_space_id,buf);
+    if(job==NULL) return -1;
+    job->transfer.deferred=o->deferred;
+    /* A failure is kept for the next drain, like that of a request nobody waits on. */
+    hermes_deferred_write(o,o->deferred,false);
+    return H5VL_hermes_async_submit(o->pending,o->async_workers,hermes_write_job_run,job,hermes_write_job_free,
+                                    (HermesRequest **)req);
+}
+/**
+ * This method packs a write into a job that needs no HDF5 call to run, and
+ * records it as dirty.
+ *
+ * @return job, or NULL on failure
+ */
+static HermesWriteJob *hermes_write_job_create(HermesVol *o, const HermesTransfer *transfer,
+                                               const HermesConversion *conv, hid_t mem_space_id,
+                                               hid_t file_space_id, const void *buf){
+    HermesWriteJob *job=(HermesWriteJob *)malloc(sizeof(HermesWriteJob));
+    if(job==NULL) return NULL;
+    job->transfer=*transfer;
+    job->elem_size=o->type.native_size;
+    if(hermes_dataset_pack(o,conv,mem_space_id,file_space_id,buf,&job->file,&job->staging,false)<0){
+        hermes_write_job_free(job);
+        return NULL;
+    }
+    if(o->sync && job->file.npoints){
+        hsize_t start[H5S_MAX_RANK],end[H5S_MAX_RANK];
+        H5VL_hermes_selection_bounds(&job->file,start,end);
+        H5VL_hermes_flusher_dirty(&o->dirty,o->rank<1?0:start[0],o->rank<1?0:end[0],
+                                  (size_t)job->file.npoints*job->elem_size);
+    }
+    return job;
+}
+static herr_t hermes_write_job_run(void *arg){
+    HermesWriteJob *job=(HermesWriteJob *)arg;
+    return H5VL_hermes_selection_iterate_dense(&job->file,job->staging,job->elem_size,
+                                               hermes_transfer_write_op(&job->transfer),
+                                               &job->transfer);
+}
+static void hermes_write_job_free(void *arg){
+    HermesWriteJob *job=(HermesWriteJob *)arg;
+    H5VL_hermes_selection_release(&job->file);
+    free(job->staging);
+    free(job);
+}
+/* Largest batch groups first, so that the longest copies start earliest. */
+static int hermes_batch_compare(const void *a, const void *b){
+    const HermesBatchGroup *x=(const HermesBatchGroup *)a,*y=(const HermesBatchGroup *)b;
+    return x->bytes<y->bytes?1:x->bytes>y->bytes?-1:0;
+}
+static herr_t hermes_batch_run(void *arg, size_t index){
+    HermesBatchGroup *group=(HermesBatchGroup *)arg+index;
+    herr_t output=0;
+    size_t i;
+    for(i=0;output>=0 && i<group->count;i++) output=hermes_write_job_run(group->jobs[i]);
+    return output;
+}
+/**
+ * This method writes many selections of many datasets as one batch, like
+ * H5Dwrite_multi: element i writes mem_space_ids[i] of bufs[i], of type
+ * mem_type_ids[i], to file_space_ids[i] of dset_ids[i]. Every write is
+ * decoded, packed and converted on the calling thread; the writes of each
+ * dataset are then placed in order, while different datasets are placed in
+ * parallel on the worker pool, largest first. What they pack for the buffer
+ * layer is written by the calling thread afterwards. The batch has completed
+ * when the call returns, and the buffers may be reused.
+ *
+ * @param count number of writes
+ * @param dset_ids datasets of files opened through the VOL; one may appear more than once
+ * @param mem_type_ids
+ * @param mem_space_ids
+ * @param file_space_ids
+ * @param dxpl_id
+ * @param bufs
+ * @return non-negative if every write succeeded
+ */
+H5_DLL herr_t H5Dhermes_vol_write_multi(size_t count, const hid_t *dset_ids, const hid_t *mem_type_ids,
+                                        const hid_t *mem_space_ids, const hid_t *file_space_ids, hid_t dxpl_id,
+                                        const void **bufs){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesWriteJob **jobs=(HermesWriteJob **)calloc(count+1,sizeof(HermesWriteJob *));
+    HermesWriteJob **order=(HermesWriteJob **)calloc(count+1,sizeof(HermesWriteJob *));
+    HermesBatchGroup *groups=(HermesBatchGroup *)calloc(count+1,sizeof(HermesBatchGroup));
+    size_t *owner=(size_t *)calloc(count+1,sizeof(size_t));
+    size_t i,k,ngroups=0,nserial=0,next=0;
+    herr_t output=jobs && order && groups && owner?0:-1;
+    for(i=0;output>=0 && i<count;i++){
+        HermesVol *o = (HermesVol *)(H5VLobject(dset_ids[i]));
+        HermesTransfer transfer;
+        HermesConversion conv;
+        if(o==NULL || hermes_dataset_plan(o,mem_type_ids[i],true,&conv)<0){
+            output=-1;
+            break;
+        }
+        for(k=0;k<ngroups && groups[k].dset!=o;k++);
+        if(k==ngroups){
+            /* Writes already queued for the dataset come first. */
+            output=hermes_dataset_drain(o);
+            groups[ngroups++].dset=o;
+        }
+        H5VL_hermes_prefetch_invalidate(o->prefetch);
+        hermes_dataset_transfer(o,&transfer);
+        if(output>=0) jobs[i]=hermes_write_job_create(o,&transfer,&conv,mem_space_ids[i],file_space_ids[i],bufs[i]);
+        if(jobs[i]==NULL){
+            output=-1;
+            break;
+        }
+        owner[i]=k;
+        groups[k].count++;
+        groups[k].bytes+=(size_t)jobs[i]->file.npoints*jobs[i]->elem_size;
+    }
+    if(output>=0){
+        for(k=0;k<ngroups;k++){
+            groups[k].jobs=order+next;
+            next+=groups[k].count;
+            groups[k].count=0;
+        }
+        for(i=0;i<count;i++) groups[owner[i]].jobs[groups[owner[i]].count++]=jobs[i];
+        qsort(groups,ngroups,sizeof(HermesBatchGroup),hermes_batch_compare);
+        /* Workers must not call H5Tconvert, so such datasets are written here, before the rest. */
+        for(k=0;k<ngroups;k++){
+            if(groups[k].dset->type.to_file.kind!=HERMES_CONVERT_GENERIC) continue;
+            HermesBatchGroup group=groups[k];
+            memmove(groups+nserial+1,groups+nserial,(k-nserial)*sizeof(HermesBatchGroup));
+            groups[nserial++]=group;
+        }
+        /* Groups are in place now, so their queues can be pointed at. */
+        for(k=0;k<ngroups;k++){
+            hermes_deferred_init(&groups[k].deferred);
+            for(i=0;i<groups[k].count;i++) groups[k].jobs[i]->transfer.deferred=&groups[k].deferred;
+        }
+        for(k=0;output>=0 && k<nserial;k++) output=hermes_batch_run(groups,k);
+        if(output>=0 && ngroups>nserial)
+            output=H5VL_hermes_async_parallel(groups[nserial].dset->async_workers,ngroups-nserial,hermes_batch_run,
+                                              groups+nserial);
+        /* What the workers packed goes to the buffer layer from here, dataset by dataset. */
+        for(k=0;k<ngroups;k++){
+            herr_t written=hermes_deferred_write(groups[k].dset,&groups[k].deferred,true);
+            if(output>=0) output=written;
+            hermes_deferred_destroy(&groups[k].deferred);
+        }
+    }
+    /* Partial chunks are only completed here: that reads the buffer layer, which workers must not. */
+    for(k=0;output>=0 && k<ngroups;k++){
+        HermesVol *o=groups[k].dset;
+        if(H5VL_hermes_chunk_over(o->chunks)) output=hermes_dataset_unstage(o,NULL);
+    }
+    for(i=0;jobs && i<count;i++) if(jobs[i]) hermes_write_job_free(jobs[i]);
+    free(jobs);
+    free(order);
+    free(groups);
+    free(owner);
+    H5VL_hermes_flusher_poll();
+    H5VL_hermes_stats_end(HERMES_OP_DATASET_WRITE_MULTI,begin);
+    return output;
+}
+/**
+ * This method reads many selections of many datasets, like H5Dread_multi.
+ * The reads run in turn on the calling thread, since what the tiers miss
+ * is read from the buffer layer, which workers must not do.
+ *
+ * @param count number of reads
+ * @param dset_ids datasets of files opened through the VOL
+ * @param mem_type_ids
+ * @param mem_space_ids
+ * @param file_space_ids
+ * @param dxpl_id
+ * @param bufs
+ * @return non-negative if every read succeeded
+ */
+H5_DLL herr_t H5Dhermes_vol_read_multi(size_t count, const hid_t *dset_ids, const hid_t *mem_type_ids,
+                                       const hid_t *mem_space_ids, const hid_t *file_space_ids, hid_t dxpl_id,
+                                       void **bufs){
+    herr_t output=0;
+    size_t i;
+    for(i=0;i<count;i++){
+        void *o=H5VLobject(dset_ids[i]);
+        if(o==NULL || hermes_dataset_read(o,mem_type_ids[i],mem_space_ids[i],file_space_ids[i],dxpl_id,bufs[i],
+                                          NULL)<0)
+            output=-1;
+    }
+    return output;
+}
+/**
+ * This method sizes a dataset's dirty map, flushing chunked datasets in
+ * whole rows of chunks.
+ *
+ * @param dset
+ */
+static void hermes_dataset_track(HermesVol *dset){
+    hsize_t chunk_dims[H5S_MAX_RANK];
+    hsize_t align=1;
+    hid_t dcpl_id=H5Dget_create_plist(dset->object_id);
+    if(dset->rank>0 && dcpl_id>=0 && H5Pget_layout(dcpl_id)==H5D_CHUNKED &&
+       H5Pget_chunk(dcpl_id,dset->rank,chunk_dims)==dset->rank)
+        align=chunk_dims[0];
+    if(dcpl_id>=0) H5Pclose(dcpl_id);
+    H5VL_hermes_flusher_track(&dset->dirty,dset->rank,dset->dims,dset->type.native_size,align);
+}
+/**
+ * This method writes the dirty runs of slabs of a dataset from the tiers
+ * to the native dataset, in pieces of at most HERMES_FLUSH_RUN bytes.
+ *
+ * @param o dataset
+ * @param map what was written since the last flush
+ * @return non-negative on success
+ */
+static herr_t hermes_dataset_flush_runs(HermesVol *o, const HermesDirtyMap *map){
+    HermesTransfer transfer;
+    HermesSelectionOp read;
+    hsize_t start[H5S_MAX_RANK],end[H5S_MAX_RANK],count[H5S_MAX_RANK],zero[H5S_MAX_RANK];
+    size_t row_bytes=o->type.native_size,slab,last;
+    hsize_t limit;
+    herr_t output=0;
+    int i;
+    for(i=1;i<o->rank;i++) row_bytes*=(size_t)o->dims[i];
+    limit=row_bytes?(hsize_t)(HERMES_FLUSH_RUN/row_bytes):0;
+    if(limit<map->rows) limit=map->rows;
+    hermes_dataset_transfer(o,&transfer);
+    read=hermes_transfer_read_op(&transfer);
+    for(slab=0;output>=0 && slab<map->nslabs;slab=last+1){
+        last=slab;
+        if(!(map->bits[slab/64]&((uint64_t)1<<(slab%64)))) continue;
+        while(last+1<map->nslabs && (map->bits[(last+1)/64]&((uint64_t)1<<((last+1)%64))) &&
+              (hsize_t)(last+2-slab)*map->rows<=limit)
+            last++;
+        for(i=0;i<o->rank;i++){
+            start[i]=0;
+            end[i]=o->dims[i]-1;
+            zero[i]=0;
+        }
+        start[0]=(hsize_t)slab*map->rows;
+        end[0]=(hsize_t)(last+1)*map->rows-1;
+        if(end[0]>=o->dims[0]) end[0]=o->dims[0]-1;
+        if(start[0]>end[0]) break;
+        for(i=0;i<o->rank;i++) count[i]=end[i]-start[i]+1;
+        void *staging=H5VL_hermes_arena_push((size_t)count[0]*row_bytes);
+        if(staging==NULL) return -1;
+        output=read(&transfer,start,end,zero,count,staging);
+        if(output>=0){
+            hid_t memory_space_id=H5Screate_simple(o->rank,count,NULL);
+            hid_t file_space_id=H5Dget_space(o->object_id);
+            output=H5Sselect_hyperslab(file_space_id,H5S_SELECT_SET,start,NULL,count,NULL);
+            H5VL_hermes_buffer_lock();
+            if(output>=0)
+                output=H5Dwrite(o->object_id,o->type.native_type_id,memory_space_id,file_space_id,H5P_DEFAULT,
+                                staging);
+            H5VL_hermes_buffer_unlock();
+            H5Sclose(memory_space_id);
+            H5Sclose(file_space_id);
+        }
+        H5VL_hermes_arena_pop(staging);
+        if(output>=0) H5VL_hermes_stats_event(HERMES_EVENT_FLUSH_RUN);
+    }
+    return output;
+}
+/**
+ * This method drains a dataset's dirty data to the native file. It is the
+ * flusher's callback and the final drain at close. Only the slabs written
+ * since the last flush go down, unless most of the dataset is dirty, in
+ * which case the buffer layer syncs it whole.
+ *
+ * @param owner dataset
+ * @return non-negative on success
+ */
+static herr_t hermes_dataset_flush(void *owner){
+    HermesVol *o = (HermesVol *)(owner);
+    HermesDirtyMap taken;
+    herr_t synced=0;
+    herr_t output=hermes_dataset_drain(o);
+    if(output>=0) output=hermes_dataset_unstage(o,NULL);
+    H5VL_hermes_flusher_take(&o->dirty,&taken);
+    if(output<0){
+        /* nothing written */
+    }else if(taken.all || taken.rows==0 || taken.ndirty*2>taken.nslabs){
+        H5VL_hermes_buffer_lock();
+        uint64_t begin=H5VL_hermes_stats_begin();
+        synced=H5_BufferSync(o->file_key,o->dataset_name,o->rank,o->dims,o->max_dims,o->object_id);
+        H5VL_hermes_stats_end(HERMES_OP_BUFFER_SYNC,begin);
+        H5VL_hermes_buffer_unlock();
+    }else if(taken.ndirty){
+        synced=hermes_dataset_flush_runs(o,&taken);
+    }
+    if(output<0 || synced<0) H5VL_hermes_flusher_merge(&o->dirty,&taken);
+    free(taken.bits);
+    if(o->prefetch && output>=0 && synced>=0){
+        /* Read-ahead bypasses HDF5, so its sieve buffer must reach the file too. */
+        H5Dflush(o->object_id);
+        H5VL_hermes_prefetch_synced(o->prefetch,H5Dget_offset(o->object_id));
+    }
+    return output<0?output:synced;
+}
+/**
+ * This method registers a dataset with the buffer layer.
+ *
+ * @param dset
+ */
+static void hermes_buffer_init(HermesVol *dset){
+    H5VL_hermes_buffer_lock();
+    uint64_t begin=H5VL_hermes_stats_begin();
+    H5_BufferInit(dset->file_key,dset->dataset_name,dset->rank,dset->type.type_id,dset->dims,dset->max_dims,
+                  dset->object_id);
+    H5VL_hermes_stats_end(HERMES_OP_BUFFER_INIT,begin);
+    H5VL_hermes_buffer_unlock();
+}
+static size_t hermes_box_bytes(const HermesTransfer *t, const hsize_t *file_start, const hsize_t *file_end){
+    size_t bytes=t->elem_size;
+    int i;
+    for(i=0;i<t->rank;i++) bytes*=file_end[i]-file_start[i]+1;
+    return bytes;
 }
-static herr_t hermes_dataset_read(void *dset, hid_t mem_type_id, hid_t mem_space_id, hid_t file_space_id, hid_t dxpl_id, void *buf, void **req){
-    HermesVol *o = (HermesVol *)(dset);
-    hid_t dataset_id=o->object_id;
-    char* filename=basename( o->file_name );//char* filename=o->file_name;
-    char* dataset_name=o->dataset_name;
-    hsize_t *memory_start,*memory_dim,*file_start,*file_end;
-    int rank_;
-    if(file_space_id==0){
-        file_space_id=H5Dget_space(dataset_id);
-        rank_=H5Sget_simple_extent_dims(file_space_id,NULL, NULL);
-        file_start= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        file_end= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        rank_=H5Sget_simple_extent_dims(file_space_id,file_end,NULL );
-        int i;
-	for(i=0;i<rank_;i++){
-            file_start[i]=0;
-            file_end[i]-=1;
+/**
+ * This method tells whether a box of count elements at start in an array of
+ * extent dims is one contiguous run, and where it starts.
+ */
+static bool hermes_box_contiguous(int rank, const hsize_t *count, const hsize_t *dims, const hsize_t *start,
+                                  size_t *offset){
+    int i,k;
+    for(k=rank-1;k>0 && count[k]==dims[k];k--);
+    for(i=0;i<k;i++) if(count[i]!=1) return false;
+    *offset=0;
+    for(i=0;i<rank;i++) *offset=*offset*(size_t)dims[i]+(size_t)start[i];
+    return true;
+}
+/**
+ * Selection callbacks moving a single contiguous box through the buffer
+ * layer, which holds the dataset type, while the box is in the native type.
+ * A box needing conversion goes through a dense staging copy, except reads
+ * landing contiguously in memory, which are converted in place.
+ */
+static herr_t hermes_buffer_read_op(void *op_data, hsize_t *file_start, hsize_t *file_end,
+                                    hsize_t *memory_start, hsize_t *memory_dim, void *buf){
+    HermesTransfer *t=(HermesTransfer *)op_data;
+    const HermesConversion *conv=t->to_native;
+    hsize_t count[H5S_MAX_RANK],zero[H5S_MAX_RANK],*start=memory_start,*dims=memory_dim;
+    size_t n=1,offset;
+    void *staging=NULL,*dst=buf;
+    int i;
+    if(conv->kind!=HERMES_CONVERT_NONE){
+        for(i=0;i<t->rank;i++){
+            count[i]=file_end[i]-file_start[i]+1;
+            zero[i]=0;
+            n*=(size_t)count[i];
         }
-    }else{
-        rank_=H5Sget_simple_extent_dims(file_space_id,NULL, NULL);
-        file_start= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        file_end= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        H5Sget_select_bounds(file_space_id, file_start, file_end);
-    }
-    if(mem_space_id==0){
-        mem_space_id=H5Dget_space(dataset_id);
-        rank_=H5Sget_simple_extent_dims(mem_space_id,NULL, NULL);
-        memory_start= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        memory_dim= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        rank_=H5Sget_simple_extent_dims(mem_space_id,memory_dim, NULL);
-        int i;
-	for(i=0;i<rank_;i++){
-            memory_start[i]=0;
+        if(conv->src_size==conv->dst_size && hermes_box_contiguous(t->rank,count,memory_dim,memory_start,&offset)){
+            dst=(char *)buf+offset*t->elem_size;
+        }else{
+            staging=H5VL_hermes_arena_push(H5VL_hermes_convert_bytes(conv,n));
+            if(staging==NULL) return -1;
+            dst=staging;
         }
-    }else{
-        rank_=H5Sget_simple_extent_dims(mem_space_id,NULL, NULL);
-        memory_start= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        memory_dim= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        H5Sget_select_bounds(mem_space_id, memory_start, memory_dim);
-        H5Sget_simple_extent_dims(mem_space_id,memory_dim, NULL);
+        start=zero;
+        dims=count;
     }
-    int64_t type_=H5Dget_type(dataset_id);
-    herr_t  output=H5_BufferRead(filename,dataset_name,rank_,type_,file_start,file_end,memory_start, memory_dim,dataset_id,buf);
-    free(file_start);
-    free(file_end);
-    free(memory_start);
-    free(memory_dim);
+    H5VL_hermes_buffer_lock();
+    uint64_t begin=H5VL_hermes_stats_begin();
+    herr_t output=H5_BufferRead(t->filename,t->dataset_name,t->rank,t->type,file_start,file_end,start,dims,
+                                t->dataset_id,dst);
+    H5VL_hermes_stats_end(HERMES_OP_BUFFER_READ,begin);
+    H5VL_hermes_buffer_unlock();
+    if(output>=0) H5VL_hermes_stats_bytes(HERMES_TIER_BUFFER,false,hermes_box_bytes(t,file_start,file_end));
+    if(output>=0 && conv->kind!=HERMES_CONVERT_NONE) output=H5VL_hermes_convert(conv,dst,n);
+    if(output>=0 && staging)
+        H5VL_hermes_box_copy(t->rank,t->elem_size,count,staging,count,zero,buf,memory_dim,memory_start);
+    H5VL_hermes_arena_pop(staging);
     return output;
 }
-static herr_t hermes_dataset_write(void *dset, hid_t mem_type_id, hid_t mem_space_id, hid_t file_space_id, hid_t dxpl_id, const void *buf, void **req){
-    HermesVol *o = (HermesVol *)(dset);
-    hid_t dataset_id=o->object_id;
-    char* filename=basename( o->file_name );//char* filename=o->file_name;
-    char* dataset_name=o->dataset_name;
-    hsize_t *memory_start,*memory_dim,*file_start,*file_end;
-    int rank_;
-    if(file_space_id==0){
-        file_space_id=H5Dget_space(dataset_id);
-        rank_=H5Sget_simple_extent_dims(file_space_id,NULL, NULL);
-        file_start= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        file_end= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        rank_=H5Sget_simple_extent_dims(file_space_id,file_end,NULL );
-        int i;
-	for(i=0;i<rank_;i++){
-            file_start[i]=0;
-            file_end[i]-=1;
+static herr_t hermes_placement_read_op(void *op_data, hsize_t *file_start, hsize_t *file_end,
+                                       hsize_t *memory_start, hsize_t *memory_dim, void *buf){
+    HermesTransfer *t=(HermesTransfer *)op_data;
+    return H5VL_hermes_placement_read(t->extents,file_start,file_end,memory_start,memory_dim,buf,
+                                      hermes_transfer_load_op(t),t);
+}
+static herr_t hermes_shared_read_op(void *op_data, hsize_t *file_start, hsize_t *file_end,
+                                    hsize_t *memory_start, hsize_t *memory_dim, void *buf){
+    HermesTransfer *t=(HermesTransfer *)op_data;
+    return H5VL_hermes_shared_read(t->shared,file_start,file_end,memory_start,memory_dim,buf,hermes_buffer_read_op,
+                                   t);
+}
+/* Reads go through placement, then the node's shared cache, then the buffer layer. */
+static HermesSelectionOp hermes_transfer_read_op(const HermesTransfer *t){
+    if(t->extents) return hermes_placement_read_op;
+    return hermes_transfer_load_op(t);
+}
+/* Where placement loads the extents it does not hold from. */
+static HermesSelectionOp hermes_transfer_load_op(const HermesTransfer *t){
+    return t->shared?hermes_shared_read_op:hermes_buffer_read_op;
+}
+static herr_t hermes_buffer_write_op(void *op_data, hsize_t *file_start, hsize_t *file_end,
+                                     hsize_t *memory_start, hsize_t *memory_dim, void *buf){
+    HermesTransfer *t=(HermesTransfer *)op_data;
+    const HermesConversion *conv=t->to_file;
+    hsize_t count[H5S_MAX_RANK],zero[H5S_MAX_RANK],*start=memory_start,*dims=memory_dim;
+    size_t bytes=hermes_box_bytes(t,file_start,file_end),n=1;
+    HermesDeferredBox *box=NULL;
+    void *staging=NULL;
+    herr_t output=0;
+    int i;
+    t->bytes+=bytes;
+    if(conv->kind!=HERMES_CONVERT_NONE || t->deferred){
+        for(i=0;i<t->rank;i++){
+            count[i]=file_end[i]-file_start[i]+1;
+            zero[i]=0;
+            n*=(size_t)count[i];
         }
-    }else{
-        rank_=H5Sget_simple_extent_dims(file_space_id,NULL, NULL);
-        file_start= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        file_end= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        H5Sget_select_bounds(file_space_id, file_start, file_end);
-    }
-    if(mem_space_id==0){
-        mem_space_id=H5Dget_space(dataset_id);
-        rank_=H5Sget_simple_extent_dims(mem_space_id,NULL, NULL);
-        memory_start= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        memory_dim= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        rank_=H5Sget_simple_extent_dims(mem_space_id,memory_dim, NULL);
-        int i;
-	for(i=0;i<rank_;i++){
-            memory_start[i]=0;
+        /* A deferred box outlives the call, so it cannot come from the arena. */
+        if(t->deferred){
+            box=(HermesDeferredBox *)malloc(sizeof(HermesDeferredBox)+H5VL_hermes_convert_bytes(conv,n));
+            staging=box?box->data:NULL;
+        }else{
+            staging=H5VL_hermes_arena_push(H5VL_hermes_convert_bytes(conv,n));
         }
-    }else{
-        rank_=H5Sget_simple_extent_dims(mem_space_id,NULL, NULL);
-        memory_start= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        memory_dim= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-        H5Sget_select_bounds(mem_space_id, memory_start, memory_dim);
-        H5Sget_simple_extent_dims(mem_space_id,memory_dim, NULL);
+        if(staging==NULL) return -1;
+        H5VL_hermes_box_copy(t->rank,t->elem_size,count,buf,memory_dim,memory_start,staging,count,zero);
+        output=H5VL_hermes_convert(conv,staging,n);
+        start=zero;
+        dims=count;
+    }
+    if(box){
+        box->extents=t->extents;
+        if(output>=0 && box->extents) H5VL_hermes_placement_queue(box->extents,true);
+        if(output>=0) output=hermes_deferred_push(t->deferred,t->rank,file_start,file_end,box);
+        else free(box);
+    }else if(output>=0){
+        H5VL_hermes_buffer_lock();
+        uint64_t begin=H5VL_hermes_stats_begin();
+        output=H5_BufferWrite(t->filename,t->dataset_name,t->rank,t->type,file_start,file_end,start,dims,
+                              t->dataset_id,staging?staging:buf);
+        H5VL_hermes_stats_end(HERMES_OP_BUFFER_WRITE,begin);
+        H5VL_hermes_buffer_unlock();
+        if(output>=0) H5VL_hermes_stats_bytes(HERMES_TIER_BUFFER,true,bytes);
+    }
+    if(box==NULL) H5VL_hermes_arena_pop(staging);
+    if(output>=0 && t->extents)
+        H5VL_hermes_placement_update(t->extents,file_start,file_end,memory_start,memory_dim,buf);
+    return output;
+}
+/**
+ * This method queues a box packed by hermes_buffer_write_op for the caller.
+ *
+ * @param d queue, owned by a dataset or a batch
+ * @param rank
+ * @param file_start first element of the box
+ * @param file_end last element of the box
+ * @param box packed elements, owned by d from here on
+ * @return 0
+ */
+static herr_t hermes_deferred_push(HermesDeferred *d, int rank, const hsize_t *file_start, const hsize_t *file_end,
+                                   HermesDeferredBox *box){
+    memcpy(box->start,file_start,sizeof(hsize_t)*rank);
+    memcpy(box->end,file_end,sizeof(hsize_t)*rank);
+    box->next=NULL;
+    pthread_mutex_lock(&d->lock);
+    if(d->tail) d->tail->next=box;
+    else d->head=box;
+    d->tail=box;
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+/**
+ * This method writes the boxes the workers queued so far to the buffer
+ * layer. It runs on the thread that called into the VOL, so the buffer
+ * layer, which may call back into HDF5, is never entered from a worker while
+ * the caller holds HDF5's lock and waits for the buffer mutex.
+ *
+ * @param o dataset the boxes belong to
+ * @param d queue, may be NULL
+ * @param report whether to return, and forget, the first failure; otherwise
+ *        it is kept for the next call that reports
+ * @return non-negative on success
+ */
+static herr_t hermes_deferred_write(HermesVol *o, HermesDeferred *d, bool report){
+    HermesDeferredBox *box,*next;
+    HermesTransfer transfer;
+    hsize_t count[H5S_MAX_RANK],zero[H5S_MAX_RANK];
+    herr_t output=0;
+    int i;
+    if(d==NULL) return 0;
+    pthread_mutex_lock(&d->lock);
+    box=d->head;
+    d->head=d->tail=NULL;
+    pthread_mutex_unlock(&d->lock);
+    hermes_dataset_transfer(o,&transfer);
+    for(;box;box=next){
+        next=box->next;
+        if(output>=0){
+            for(i=0;i<o->rank;i++){
+                count[i]=box->end[i]-box->start[i]+1;
+                zero[i]=0;
+            }
+            H5VL_hermes_buffer_lock();
+            uint64_t begin=H5VL_hermes_stats_begin();
+            output=H5_BufferWrite(transfer.filename,transfer.dataset_name,transfer.rank,transfer.type,box->start,
+                                  box->end,zero,count,transfer.dataset_id,box->data);
+            H5VL_hermes_stats_end(HERMES_OP_BUFFER_WRITE,begin);
+            H5VL_hermes_buffer_unlock();
+            if(output>=0)
+                H5VL_hermes_stats_bytes(HERMES_TIER_BUFFER,true,hermes_box_bytes(&transfer,box->start,box->end));
+        }
+        if(box->extents) H5VL_hermes_placement_queue(box->extents,false);
+        free(box);
+    }
+    pthread_mutex_lock(&d->lock);
+    if(output<0 && d->error>=0) d->error=output;
+    if(report){
+        output=d->error;
+        d->error=0;
     }
-    int64_t type_=H5Dget_type(dataset_id);
-    herr_t output=H5_BufferWrite(filename, dataset_name, rank_, type_, file_start, file_end, memory_start, memory_dim, dataset_id,
-                                 (void *)(buf));
-    free(file_start);
-    free(file_end);
-    free(memory_start);
-    free(memory_dim);
+    pthread_mutex_unlock(&d->lock);
+    return output;
+}
+static void hermes_deferred_init(HermesDeferred *d){
+    pthread_mutex_init(&d->lock,NULL);
+    d->head=d->tail=NULL;
+    d->error=0;
+}
+static HermesDeferred *hermes_deferred_create(void){
+    HermesDeferred *d=(HermesDeferred *)malloc(sizeof(HermesDeferred));
+    if(d) hermes_deferred_init(d);
+    return d;
+}
+/* Boxes nobody wrote are dropped. */
+static void hermes_deferred_destroy(HermesDeferred *d){
+    HermesDeferredBox *next;
+    for(;d->head;d->head=next){
+        next=d->head->next;
+        if(d->head->extents) H5VL_hermes_placement_queue(d->head->extents,false);
+        free(d->head);
+    }
+    pthread_mutex_destroy(&d->lock);
+}
+static void hermes_deferred_free(HermesDeferred *d){
+    if(d==NULL) return;
+    hermes_deferred_destroy(d);
+    free(d);
+}
+/**
+ * Selection callback sending a box through the chunk stage to
+ * hermes_buffer_write_op. Staged bytes count as moved.
+ */
+static herr_t hermes_chunk_write_op(void *op_data, hsize_t *file_start, hsize_t *file_end,
+                                    hsize_t *memory_start, hsize_t *memory_dim, void *buf){
+    HermesTransfer *t=(HermesTransfer *)op_data;
+    size_t bytes=t->bytes;
+    herr_t output=H5VL_hermes_chunk_write(t->chunks,file_start,file_end,memory_start,memory_dim,buf,
+                                          hermes_buffer_write_op,t);
+    t->bytes=bytes+hermes_box_bytes(t,file_start,file_end);
+    return output;
+}
+/**
+ * Selection callback sending a box through the aggregator to
+ * hermes_buffer_write_op. Held bytes count as moved.
+ */
+static herr_t hermes_aggregate_write_op(void *op_data, hsize_t *file_start, hsize_t *file_end,
+                                        hsize_t *memory_start, hsize_t *memory_dim, void *buf){
+    HermesTransfer *t=(HermesTransfer *)op_data;
+    size_t bytes=t->bytes;
+    herr_t output=H5VL_hermes_aggregate_write(t->aggregate,file_start,file_end,memory_start,memory_dim,buf,
+                                              hermes_buffer_write_op,t);
+    t->bytes=bytes+hermes_box_bytes(t,file_start,file_end);
     return output;
 }
+/**
+ * This method picks the selection callback the boxes of a write go
+ * through.
+ *
+ * @param t
+ * @return callback for t as op_data
+ */
+static HermesSelectionOp hermes_transfer_write_op(const HermesTransfer *t){
+    if(t->chunks) return hermes_chunk_write_op;
+    if(t->aggregate) return hermes_aggregate_write_op;
+    return hermes_buffer_write_op;
+}
 static herr_t  hermes_dataset_get(void *dset, H5VL_dataset_get_t get_type, hid_t dxpl_id, void **req, va_list arguments){
+    uint64_t begin=H5VL_hermes_stats_begin();
     HermesVol *o = (HermesVol *)(dset);
     switch (get_type) {
         /* H5Dget_space */
@@ -271,84 +1759,871 @@ static herr_t  hermes_dataset_get(void *dset, H5VL_dataset_get_t get_type, hid_t
         }
 
     }
+    H5VL_hermes_stats_end(HERMES_OP_DATASET_GET,begin);
     return 0;
 }
+static herr_t hermes_dataset_specific(void *obj, H5VL_dataset_specific_t specific_type, hid_t dxpl_id, void **req, va_list arguments){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)(obj);
+    herr_t output=0;
+    switch (specific_type) {
+        /* H5Dset_extent */
+        case H5VL_DATASET_SET_EXTENT:
+        {
+            const hsize_t *size = va_arg(arguments, const hsize_t *);
+            output=hermes_dataset_extend(o,size);
+            break;
+        }
+            /* H5Dflush */
+        case H5VL_DATASET_FLUSH:
+        {
+            output=hermes_dataset_drain(o);
+            if(output>=0) output=o->sync?hermes_dataset_flush(o):hermes_dataset_unstage(o,NULL);
+            if(output>=0) output=H5Dflush(o->object_id);
+            break;
+        }
+            /* H5Drefresh */
+        case H5VL_DATASET_REFRESH:
+        {
+            output=hermes_dataset_drain(o);
+            if(output>=0) output=o->sync?hermes_dataset_flush(o):hermes_dataset_unstage(o,NULL);
+            if(output>=0) output=H5Drefresh(o->object_id);
+            if(output>=0) output=hermes_dataset_reload(o);
+            break;
+        }
+        default:{
+
+        }
+
+    }
+    H5VL_hermes_flusher_poll();
+    H5VL_hermes_stats_end(HERMES_OP_DATASET_SPECIFIC,begin);
+    return output;
+}
+/**
+ * This method changes the extent of a dataset. Growing keeps whatever the
+ * tiers, the chunk stage and the aggregator hold, so streaming appends cost
+ * no flush: only staged chunks the old edge cut go down, and the extent
+ * index grows by doubling. Shrinking first drains everything held to the
+ * buffer layer and syncs it, so that nothing lies outside the new extent.
+ * The buffer layer learnt the maximum extent from H5_BufferInit and is
+ * handed the current one at every sync.
+ *
+ * @param o dataset
+ * @param size new extent
+ * @return non-negative on success
+ */
+static herr_t hermes_dataset_extend(HermesVol *o, const hsize_t *size){
+    HermesTransfer transfer;
+    hsize_t old_dims[H5S_MAX_RANK];
+    bool shrink=false;
+    herr_t output;
+    int i;
+    for(i=0;i<o->rank;i++){
+        if(size[i]<o->dims[i]) shrink=true;
+        old_dims[i]=o->dims[i];
+    }
+    output=hermes_dataset_drain(o);
+    if(output>=0 && shrink) output=o->sync?hermes_dataset_flush(o):hermes_dataset_unstage(o,NULL);
+    hermes_dataset_transfer(o,&transfer);
+    if(output>=0)
+        output=H5VL_hermes_chunk_resize(o->chunks,size,hermes_buffer_read_op,hermes_buffer_write_op,&transfer);
+    if(output>=0) output=H5VL_hermes_extent_set_resize(o->extents,size);
+    if(output>=0 && H5Dset_extent(o->object_id,size)<0){
+        /* Going back only writes out or forgets more. */
+        H5VL_hermes_chunk_resize(o->chunks,old_dims,hermes_buffer_read_op,hermes_buffer_write_op,&transfer);
+        H5VL_hermes_extent_set_resize(o->extents,old_dims);
+        output=-1;
+    }
+    if(output>=0){
+        memcpy(o->dims,size,sizeof(hsize_t)*o->rank);
+        if(o->sync) hermes_dataset_track(o);
+        /* Read-ahead maps the old extent of a contiguous dataset. */
+        H5VL_hermes_prefetch_release(o->prefetch);
+        o->prefetch=NULL;
+    }
+    return output;
+}
+/**
+ * This method drops what the tiers cached of a dataset another writer may
+ * have changed, and takes its extent anew. Held writes must have been
+ * flushed and views given back.
+ *
+ * @param o dataset
+ * @return non-negative on success
+ */
+static herr_t hermes_dataset_reload(HermesVol *o){
+    HermesTransfer transfer;
+    hid_t space_id=H5Dget_space(o->object_id);
+    if(space_id<0) return -1;
+    H5Sget_simple_extent_dims(space_id,o->dims,NULL);
+    H5Sclose(space_id);
+    if(o->sync) hermes_dataset_track(o);
+    H5VL_hermes_extent_set_free(o->extents);
+    o->extents=H5VL_hermes_extent_set_create(o->placement,o->rank,o->dims,o->type.native_size,o->async_workers);
+    /* What was parked on free is as stale as what was cached. */
+    hermes_dataset_persist(o,true);
+    H5VL_hermes_shared_set_free(o->shared_extents);
+    o->shared_extents=hermes_dataset_shared(o);
+    H5VL_hermes_prefetch_invalidate(o->prefetch);
+    hermes_dataset_transfer(o,&transfer);
+    return H5VL_hermes_chunk_resize(o->chunks,o->dims,hermes_buffer_read_op,hermes_buffer_write_op,&transfer);
+}
 static herr_t hermes_dataset_close(void *dset, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
     HermesVol *o = (HermesVol *)(dset);
     hid_t dataset_id= o->object_id;
-    hsize_t *dims,*max_dims;
-    int rank_;
-    hid_t file_space_id=H5Dget_space(dataset_id);
-    rank_=H5Sget_simple_extent_dims(file_space_id,NULL, NULL);
-    dims= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-    max_dims= (hsize_t*) calloc(rank_, sizeof(hsize_t));
-    rank_=H5Sget_simple_extent_dims(file_space_id,dims,max_dims );
-    char* filename=basename( o->file_name );
-    if(o->sync)
-        H5_BufferSync(filename,o->dataset_name,rank_,dims,max_dims,dataset_id);
+    herr_t pending=H5VL_hermes_async_group_free(o->pending);
+    o->pending=NULL;
+    herr_t deferred=hermes_deferred_write(o,o->deferred,true);
+    hermes_deferred_free(o->deferred);
+    o->deferred=NULL;
+    H5VL_hermes_prefetch_release(o->prefetch);
+    o->prefetch=NULL;
+    /* Staged chunks and pending runs update the extents on their way down, so they go first. */
+    herr_t unstaged=hermes_dataset_unstage(o,NULL);
+    H5VL_hermes_chunk_free(o->chunks);
+    o->chunks=NULL;
+    H5VL_hermes_aggregate_free(o->aggregate);
+    o->aggregate=NULL;
+    herr_t drained=0;
+    if(o->sync){
+        H5VL_hermes_flusher_unregister(&o->dirty);
+        /* Whatever the flusher has not drained yet is the final drain. It reads through the extents, so it goes
+           before they are released. */
+        if(H5VL_hermes_flusher_pending(&o->dirty)) drained=hermes_dataset_flush(o);
+        H5VL_hermes_flusher_untrack(&o->dirty);
+    }
+    H5VL_hermes_extent_set_free(o->extents);
+    o->extents=NULL;
+    H5VL_hermes_placement_release(o->placement);
+    o->placement=NULL;
+    H5VL_hermes_shared_set_free(o->shared_extents);
+    o->shared_extents=NULL;
+    H5VL_hermes_shared_release(o->shared);
+    o->shared=NULL;
+    H5VL_hermes_meta_release(o->meta);
+    o->meta=NULL;
     herr_t output=H5Dclose(dataset_id);
-    free(dims);
-    free(max_dims);
-    free(o->file_name);
-    free(o->dataset_name);
-    free(o);
+    if(pending<0) output=pending;
+    if(deferred<0) output=deferred;
+    if(unstaged<0) output=unstaged;
+    if(drained<0) output=drained;
+    if(o->async && req) *req=H5VL_hermes_async_completed(output);
+    H5Tclose(o->type.type_id);
+    H5Tclose(o->type.native_type_id);
+    H5VL_hermes_name_release(o->file_name);
+    H5VL_hermes_name_release(o->file_key);
+    H5VL_hermes_name_release(o->dataset_name);
+    H5VL_hermes_pool_put(&hermes_vol_pool,o);
+    H5VL_hermes_stats_end(HERMES_OP_DATASET_CLOSE,begin);
     return output;
 }
 
 /* Hermes VOL File callbacks */
+/**
+ * This method computes the key a file's datasets are registered under in the
+ * buffer layer, once per file rather than on every read and write.
+ *
+ * @param name path of the file
+ * @return interned basename of name
+ */
+static char* hermes_file_key(const char *name){
+    char* path=(char*)malloc(strlen(name)+1);
+    if(path==NULL) return NULL;
+    strcpy(path,name);
+    char* key=H5VL_hermes_name_intern(basename(path));
+    free(path);
+    return key;
+}
 static void* hermes_file_create(const char *name, unsigned flags, hid_t fcpl_id, hid_t fapl_id, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
     HermesVol *file= (HermesVol *)(H5Pget_vol_info(fapl_id));
-    file->file_name=(char*)malloc(strlen(name)+1);
-    strcpy(file->file_name,name);
+    /* The fapl info is the file object, and may have served a file before. */
+    H5VL_hermes_name_release(file->file_name);
+    H5VL_hermes_name_release(file->file_key);
+    file->file_name=H5VL_hermes_name_intern(name);
+    file->file_key=hermes_file_key(name);
     hid_t file_id=H5Fcreate(name,H5F_ACC_TRUNC,fcpl_id,file->native_fapl);
     file->object_id=file_id;
+    H5VL_hermes_placement_validate(file->placement,name,true);
+    file->meta=H5VL_hermes_meta_create(&file->meta_policy);
+    file->meta_addr=HADDR_UNDEF;
+    file->meta_fresh=true;
+    H5VL_hermes_stats_end(HERMES_OP_FILE_CREATE,begin);
     return (void *)file;
 
 }
 static void  *hermes_file_open(const char *name, unsigned flags, hid_t fapl_id, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
     HermesVol *file= (HermesVol *)(H5Pget_vol_info(fapl_id));
-    file->file_name=(char*)malloc(strlen(name)+1);
-    strcpy(file->file_name,name);
-    hid_t file_id=H5Fopen(name,H5F_ACC_TRUNC,file->native_fapl);
+    /* The fapl info is the file object, and may have served a file before. */
+    H5VL_hermes_name_release(file->file_name);
+    H5VL_hermes_name_release(file->file_key);
+    file->file_name=H5VL_hermes_name_intern(name);
+    file->file_key=hermes_file_key(name);
+    /* Before the native open, which may touch the file. */
+    H5VL_hermes_placement_validate(file->placement,name,false);
+    hid_t file_id=H5Fopen(name,flags,file->native_fapl);
     file->object_id=file_id;
+    /* Only a file nobody writes through this connector can be shared. */
+    if(file_id>=0 && file->shared_bytes && !(flags&H5F_ACC_RDWR))
+        file->shared=H5VL_hermes_shared_attach(name,file->shared_bytes);
+    file->meta=H5VL_hermes_meta_create(&file->meta_policy);
+    file->meta_addr=HADDR_UNDEF;
+    file->meta_fresh=false;
+    H5VL_hermes_stats_end(HERMES_OP_FILE_OPEN,begin);
     return (void *)file;
 }
+/**
+ * This method takes a checkpoint of the file an object belongs to: every
+ * write made through the VOL before the call, to any of its datasets kept
+ * with H5Pset_hermes_vol_flush(sync), is on stable storage when it returns,
+ * together with the attribute cache and HDF5's own metadata. Only what
+ * changed since the last flush or checkpoint is written, in slabs of about
+ * a MiB. Writes racing the call from other threads may or may not be in it.
+ *
+ * @param object_id file, or any object in it
+ * @return non-negative once the checkpoint is durable
+ */
+H5_DLL herr_t H5Fhermes_vol_checkpoint(hid_t object_id){
+    HermesVol *o = (HermesVol *)(H5VLobject(object_id));
+    if(o==NULL) return -1;
+    uint64_t begin=H5VL_hermes_stats_begin();
+    /* HDF5's file calls want the file itself, not whatever object the checkpoint was asked on. */
+    hid_t file_id=H5Iget_file_id(o->object_id);
+    herr_t output=H5VL_hermes_flusher_flush(o->file_name);
+    if(H5VL_hermes_meta_flush(o->meta)<0) output=-1;
+    if(file_id<0 || H5Fflush(file_id,H5F_SCOPE_LOCAL)<0) output=-1;
+    if(output>=0) output=hermes_file_sync(file_id);
+    if(file_id>=0) H5Fclose(file_id);
+    H5VL_hermes_stats_end(HERMES_OP_CHECKPOINT,begin);
+    return output;
+}
+/**
+ * This method makes what HDF5 wrote of a file durable. H5Fflush only hands
+ * it to the operating system; files of the sec2 driver are also fsync'ed,
+ * while other drivers are trusted to have synced on flush.
+ *
+ * @param file_id the file
+ * @return non-negative on success
+ */
+static herr_t hermes_file_sync(hid_t file_id){
+    hid_t fapl_id=H5Fget_access_plist(file_id);
+    void *handle=NULL;
+    herr_t output=0;
+    if(fapl_id<0) return -1;
+    if(H5Pget_driver(fapl_id)==H5FD_SEC2){
+        output=H5Fget_vfd_handle(file_id,fapl_id,&handle);
+        if(output>=0 && (handle==NULL || fsync(*(int *)handle)!=0)) output=-1;
+    }
+    H5Pclose(fapl_id);
+    return output;
+}
+static herr_t hermes_file_specific(void *obj, H5VL_file_specific_t specific_type, hid_t dxpl_id, void **req, va_list arguments){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)(obj);
+    herr_t output=-1;
+    switch (specific_type) {
+        /* H5Fflush */
+        case H5VL_FILE_FLUSH:
+        {
+            (void)va_arg(arguments, int);   /* type of the object flushed through */
+            H5F_scope_t scope = (H5F_scope_t)va_arg(arguments, int);
+            output=H5VL_hermes_flusher_flush(o->file_name);
+            if(H5VL_hermes_meta_flush(o->meta)<0) output=-1;
+            if(H5Fflush(o->object_id,scope)<0) output=-1;
+            break;
+        }
+            /* H5Fis_accessible */
+        case H5VL_FILE_IS_ACCESSIBLE:
+        {
+            (void)va_arg(arguments, hid_t); /* fapl_id */
+            const char *name = va_arg(arguments, const char *);
+            htri_t *ret = va_arg(arguments, htri_t *);
+            *ret=H5Fis_hdf5(name);
+            output=*ret<0?-1:0;
+            break;
+        }
+        default:
+            break;
+    }
+    H5VL_hermes_stats_end(HERMES_OP_FILE_SPECIFIC,begin);
+    return output;
+}
 static herr_t hermes_file_close(void *file, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
     HermesVol *o = (HermesVol *)(file);
+    herr_t flushed=H5VL_hermes_meta_flush(o->meta);
+    H5VL_hermes_meta_release(o->meta);
+    o->meta=NULL;
+    H5VL_hermes_shared_release(o->shared);
+    o->shared=NULL;
     herr_t output= H5Fclose(o->object_id);
+    if(flushed<0) output=flushed;
+    H5VL_hermes_placement_stamp(o->placement,o->file_name);
+    H5VL_hermes_stats_end(HERMES_OP_FILE_CLOSE,begin);
+    return output;
+}
+
+/* Hermes VOL Group callbacks */
+static void  *hermes_group_create(void *obj, H5VL_loc_params_t loc_params, const char *name, hid_t gcpl_id, hid_t gapl_id, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)obj;
+    hid_t lcpl_id=H5P_DEFAULT;
+    H5Pget(gcpl_id, H5VL_PROP_GRP_LCPL_ID, &lcpl_id);
+    HermesVol *group=hermes_object_wrap(o,H5Gcreate2(o->object_id,name,lcpl_id,gcpl_id,gapl_id));
+    if(group) group->meta_fresh=true;
+    H5VL_hermes_stats_end(HERMES_OP_GROUP_CREATE,begin);
+    return (void *)group;
+}
+static void  *hermes_group_open(void *obj, H5VL_loc_params_t loc_params, const char *name, hid_t gapl_id, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)obj;
+    HermesVol *group=hermes_object_wrap(o,H5Gopen2(o->object_id,name,gapl_id));
+    H5VL_hermes_stats_end(HERMES_OP_GROUP_OPEN,begin);
+    return (void *)group;
+}
+static herr_t hermes_group_get(void *obj, H5VL_group_get_t get_type, hid_t dxpl_id, void **req, va_list arguments){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)(obj);
+    herr_t output=-1;
+    switch (get_type) {
+        /* H5Gget_create_plist */
+        case H5VL_GROUP_GET_GCPL:
+        {
+            hid_t *new_gcpl_id = va_arg(arguments, hid_t *);
+            *new_gcpl_id=H5Gget_create_plist(o->object_id);
+            output=*new_gcpl_id<0?-1:0;
+            break;
+        }
+            /* H5Gget_info, H5Gget_info_by_name, H5Gget_info_by_idx */
+        case H5VL_GROUP_GET_INFO:
+        {
+            H5VL_loc_params_t loc_params = va_arg(arguments, H5VL_loc_params_t);
+            H5G_info_t *group_info = va_arg(arguments, H5G_info_t *);
+            if(loc_params.type==H5VL_OBJECT_BY_SELF)
+                output=H5Gget_info(o->object_id,group_info);
+            else if(loc_params.type==H5VL_OBJECT_BY_NAME)
+                output=H5Gget_info_by_name(o->object_id,loc_params.loc_data.loc_by_name.name,group_info,
+                                           loc_params.loc_data.loc_by_name.lapl_id);
+            else if(loc_params.type==H5VL_OBJECT_BY_IDX)
+                output=H5Gget_info_by_idx(o->object_id,loc_params.loc_data.loc_by_idx.name,
+                                          loc_params.loc_data.loc_by_idx.idx_type,loc_params.loc_data.loc_by_idx.order,
+                                          loc_params.loc_data.loc_by_idx.n,group_info,
+                                          loc_params.loc_data.loc_by_idx.lapl_id);
+            break;
+        }
+        default:
+            break;
+    }
+    H5VL_hermes_stats_end(HERMES_OP_GROUP_GET,begin);
     return output;
 }
+static herr_t hermes_group_close(void *grp, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)(grp);
+    herr_t output=H5Gclose(o->object_id);
+    hermes_object_free(o);
+    H5VL_hermes_stats_end(HERMES_OP_GROUP_CLOSE,begin);
+    return output;
+}
+
+/* Hermes VOL Link callbacks */
+static herr_t hermes_link_create(H5VL_link_create_type_t create_type, void *obj, H5VL_loc_params_t loc_params, hid_t lcpl_id, hid_t lapl_id, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)(obj);
+    const char *name=loc_params.loc_data.loc_by_name.name;
+    herr_t output=-1;
+    switch (create_type) {
+        /* H5Lcreate_hard */
+        case H5VL_LINK_CREATE_HARD:
+        {
+            void *target=NULL;
+            H5VL_loc_params_t target_params;
+            H5Pget(lcpl_id, H5VL_PROP_LINK_TARGET, &target);
+            H5Pget(lcpl_id, H5VL_PROP_LINK_TARGET_LOC_PARAMS, &target_params);
+            HermesVol *t=target?(HermesVol *)target:o;
+            if(o==NULL) o=t;
+            output=H5Lcreate_hard(t->object_id,
+                                  target_params.type==H5VL_OBJECT_BY_NAME?target_params.loc_data.loc_by_name.name:".",
+                                  o->object_id,name,lcpl_id,lapl_id);
+            break;
+        }
+            /* H5Lcreate_soft */
+        case H5VL_LINK_CREATE_SOFT:
+        {
+            char *target_name=NULL;
+            H5Pget(lcpl_id, H5VL_PROP_LINK_TARGET_NAME, &target_name);
+            output=H5Lcreate_soft(target_name,o->object_id,name,lcpl_id,lapl_id);
+            break;
+        }
+            /* H5Lcreate_external, H5Lcreate_ud */
+        case H5VL_LINK_CREATE_UD:
+        {
+            H5L_type_t link_type;
+            void *udata=NULL;
+            size_t udata_size=0;
+            H5Pget(lcpl_id, H5VL_PROP_LINK_TYPE, &link_type);
+            H5Pget(lcpl_id, H5VL_PROP_LINK_UDATA, &udata);
+            H5Pget(lcpl_id, H5VL_PROP_LINK_UDATA_SIZE, &udata_size);
+            output=H5Lcreate_ud(o->object_id,name,link_type,udata,udata_size,lcpl_id,lapl_id);
+            break;
+        }
+        default:
+            break;
+    }
+    H5VL_hermes_stats_end(HERMES_OP_LINK_CREATE,begin);
+    return output;
+}
+static herr_t hermes_link_copy(void *src_obj, H5VL_loc_params_t loc_params1, void *dst_obj, H5VL_loc_params_t loc_params2, hid_t lcpl_id, hid_t lapl_id, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *src = (HermesVol *)(src_obj?src_obj:dst_obj);
+    HermesVol *dst = (HermesVol *)(dst_obj?dst_obj:src_obj);
+    herr_t output=H5Lcopy(src->object_id,loc_params1.loc_data.loc_by_name.name,dst->object_id,
+                          loc_params2.loc_data.loc_by_name.name,lcpl_id,lapl_id);
+    H5VL_hermes_stats_end(HERMES_OP_LINK_COPY,begin);
+    return output;
+}
+static herr_t hermes_link_move(void *src_obj, H5VL_loc_params_t loc_params1, void *dst_obj, H5VL_loc_params_t loc_params2, hid_t lcpl_id, hid_t lapl_id, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *src = (HermesVol *)(src_obj?src_obj:dst_obj);
+    HermesVol *dst = (HermesVol *)(dst_obj?dst_obj:src_obj);
+    /* Attributes are cached by object address, which a move leaves alone. */
+    herr_t output=H5Lmove(src->object_id,loc_params1.loc_data.loc_by_name.name,dst->object_id,
+                          loc_params2.loc_data.loc_by_name.name,lcpl_id,lapl_id);
+    H5VL_hermes_stats_end(HERMES_OP_LINK_MOVE,begin);
+    return output;
+}
+static herr_t hermes_link_get(void *obj, H5VL_loc_params_t loc_params, H5VL_link_get_t get_type, hid_t dxpl_id, void **req, va_list arguments){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)(obj);
+    herr_t output=-1;
+    switch (get_type) {
+        /* H5Lget_info, H5Lget_info_by_idx */
+        case H5VL_LINK_GET_INFO:
+        {
+            H5L_info_t *linfo = va_arg(arguments, H5L_info_t *);
+            if(loc_params.type==H5VL_OBJECT_BY_NAME)
+                output=H5Lget_info(o->object_id,loc_params.loc_data.loc_by_name.name,linfo,
+                                   loc_params.loc_data.loc_by_name.lapl_id);
+            else if(loc_params.type==H5VL_OBJECT_BY_IDX)
+                output=H5Lget_info_by_idx(o->object_id,loc_params.loc_data.loc_by_idx.name,
+                                          loc_params.loc_data.loc_by_idx.idx_type,loc_params.loc_data.loc_by_idx.order,
+                                          loc_params.loc_data.loc_by_idx.n,linfo,loc_params.loc_data.loc_by_idx.lapl_id);
+            break;
+        }
+            /* H5Lget_name_by_idx */
+        case H5VL_LINK_GET_NAME:
+        {
+            char *name = va_arg(arguments, char *);
+            size_t size = va_arg(arguments, size_t);
+            ssize_t *ret = va_arg(arguments, ssize_t *);
+            *ret=H5Lget_name_by_idx(o->object_id,loc_params.loc_data.loc_by_idx.name,
+                                    loc_params.loc_data.loc_by_idx.idx_type,loc_params.loc_data.loc_by_idx.order,
+                                    loc_params.loc_data.loc_by_idx.n,name,size,loc_params.loc_data.loc_by_idx.lapl_id);
+            output=*ret<0?-1:0;
+            break;
+        }
+            /* H5Lget_val, H5Lget_val_by_idx */
+        case H5VL_LINK_GET_VAL:
+        {
+            void *buf = va_arg(arguments, void *);
+            size_t size = va_arg(arguments, size_t);
+            if(loc_params.type==H5VL_OBJECT_BY_NAME)
+                output=H5Lget_val(o->object_id,loc_params.loc_data.loc_by_name.name,buf,size,
+                                  loc_params.loc_data.loc_by_name.lapl_id);
+            else if(loc_params.type==H5VL_OBJECT_BY_IDX)
+                output=H5Lget_val_by_idx(o->object_id,loc_params.loc_data.loc_by_idx.name,
+                                         loc_params.loc_data.loc_by_idx.idx_type,loc_params.loc_data.loc_by_idx.order,
+                                         loc_params.loc_data.loc_by_idx.n,buf,size,
+                                         loc_params.loc_data.loc_by_idx.lapl_id);
+            break;
+        }
+        default:
+            break;
+    }
+    H5VL_hermes_stats_end(HERMES_OP_LINK_GET,begin);
+    return output;
+}
+static herr_t hermes_link_specific(void *obj, H5VL_loc_params_t loc_params, H5VL_link_specific_t specific_type, hid_t dxpl_id, void **req, va_list arguments){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)(obj);
+    const char *name=loc_params.type==H5VL_OBJECT_BY_NAME?loc_params.loc_data.loc_by_name.name:".";
+    hid_t lapl_id=loc_params.type==H5VL_OBJECT_BY_NAME?loc_params.loc_data.loc_by_name.lapl_id:H5P_DEFAULT;
+    herr_t output=-1;
+    switch (specific_type) {
+        /* H5Ldelete, H5Ldelete_by_idx */
+        case H5VL_LINK_DELETE:
+        {
+            /* The object may go with its last link and its address be reused. */
+            H5VL_hermes_meta_invalidate(o->meta);
+            if(loc_params.type==H5VL_OBJECT_BY_IDX)
+                output=H5Ldelete_by_idx(o->object_id,loc_params.loc_data.loc_by_idx.name,
+                                        loc_params.loc_data.loc_by_idx.idx_type,loc_params.loc_data.loc_by_idx.order,
+                                        loc_params.loc_data.loc_by_idx.n,loc_params.loc_data.loc_by_idx.lapl_id);
+            else
+                output=H5Ldelete(o->object_id,name,lapl_id);
+            break;
+        }
+            /* H5Lexists */
+        case H5VL_LINK_EXISTS:
+        {
+            htri_t *ret = va_arg(arguments, htri_t *);
+            *ret=H5Lexists(o->object_id,name,lapl_id);
+            output=*ret<0?-1:0;
+            break;
+        }
+            /* H5Literate, H5Literate_by_name, H5Lvisit, H5Lvisit_by_name */
+        case H5VL_LINK_ITER:
+        {
+            hbool_t recursive = (hbool_t)va_arg(arguments, int);
+            H5_index_t idx_type = (H5_index_t)va_arg(arguments, int);
+            H5_iter_order_t order = (H5_iter_order_t)va_arg(arguments, int);
+            hsize_t *idx_p = va_arg(arguments, hsize_t *);
+            H5L_iterate_t op = va_arg(arguments, H5L_iterate_t);
+            void *op_data = va_arg(arguments, void *);
+            output=recursive?H5Lvisit_by_name(o->object_id,name,idx_type,order,op,op_data,lapl_id)
+                            :H5Literate_by_name(o->object_id,name,idx_type,order,idx_p,op,op_data,lapl_id);
+            break;
+        }
+        default:
+            break;
+    }
+    H5VL_hermes_stats_end(HERMES_OP_LINK_SPECIFIC,begin);
+    return output;
+}
+
+/* Hermes VOL Object callbacks */
+static void  *hermes_object_open(void *obj, H5VL_loc_params_t loc_params, H5I_type_t *opened_type, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)(obj);
+    HermesVol *output=NULL;
+    hid_t object_id=-1;
+    switch (loc_params.type) {
+        case H5VL_OBJECT_BY_NAME:
+            object_id=H5Oopen(o->object_id,loc_params.loc_data.loc_by_name.name,loc_params.loc_data.loc_by_name.lapl_id);
+            break;
+        case H5VL_OBJECT_BY_IDX:
+            object_id=H5Oopen_by_idx(o->object_id,loc_params.loc_data.loc_by_idx.name,
+                                     loc_params.loc_data.loc_by_idx.idx_type,loc_params.loc_data.loc_by_idx.order,
+                                     loc_params.loc_data.loc_by_idx.n,loc_params.loc_data.loc_by_idx.lapl_id);
+            break;
+        case H5VL_OBJECT_BY_ADDR:
+            object_id=H5Oopen_by_addr(o->object_id,loc_params.loc_data.loc_by_addr.addr);
+            break;
+        default:
+            break;
+    }
+    if(object_id>=0) *opened_type=H5Iget_type(object_id);
+    if(object_id<0){
+        /* nothing opened */
+    }else if(*opened_type!=H5I_DATASET){
+        output=hermes_object_wrap(o,object_id);
+    }else if(loc_params.type==H5VL_OBJECT_BY_NAME){
+        /* Datasets read and write through the buffer layer, so they are set up like H5Dopen ones. */
+        output=hermes_dataset_setup(o,loc_params.loc_data.loc_by_name.name,object_id);
+    }else{
+        ssize_t length=H5Iget_name(object_id,NULL,0);
+        char *name=(char*)malloc(length>0?(size_t)length+1:1);
+        if(name==NULL || H5Iget_name(object_id,name,(size_t)length+1)<0) H5Dclose(object_id);
+        else output=hermes_dataset_setup(o,name,object_id);
+        free(name);
+    }
+    H5VL_hermes_stats_end(HERMES_OP_OBJECT_OPEN,begin);
+    return (void *)output;
+}
+static herr_t hermes_object_copy(void *src_obj, H5VL_loc_params_t loc_params1, const char *src_name, void *dst_obj, H5VL_loc_params_t loc_params2, const char *dst_name, hid_t ocpypl_id, hid_t lcpl_id, hid_t dxpl_id, void **req){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *src = (HermesVol *)(src_obj);
+    HermesVol *dst = (HermesVol *)(dst_obj);
+    herr_t output=-1;
+    /* The copy takes its attributes from the native file, so they must be there first. */
+    if(H5VL_hermes_meta_flush(src->meta)>=0)
+        output=H5Ocopy(src->object_id,src_name,dst->object_id,dst_name,ocpypl_id,lcpl_id);
+    H5VL_hermes_stats_end(HERMES_OP_OBJECT_COPY,begin);
+    return output;
+}
+static herr_t hermes_object_get(void *obj, H5VL_loc_params_t loc_params, H5VL_object_get_t get_type, hid_t dxpl_id, void **req, va_list arguments){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)(obj);
+    herr_t output=-1;
+    switch (get_type) {
+        /* H5Rget_region */
+        case H5VL_REF_GET_REGION:
+        {
+            hid_t *ret = va_arg(arguments, hid_t *);
+            H5R_type_t ref_type = (H5R_type_t)va_arg(arguments, int);
+            void *ref = va_arg(arguments, void *);
+            *ret=H5Rget_region(o->object_id,ref_type,ref);
+            output=*ret<0?-1:0;
+            break;
+        }
+            /* H5Rget_obj_type2 */
+        case H5VL_REF_GET_TYPE:
+        {
+            H5O_type_t *obj_type = va_arg(arguments, H5O_type_t *);
+            H5R_type_t ref_type = (H5R_type_t)va_arg(arguments, int);
+            void *ref = va_arg(arguments, void *);
+            output=H5Rget_obj_type2(o->object_id,ref_type,ref,obj_type);
+            break;
+        }
+            /* H5Rget_name */
+        case H5VL_REF_GET_NAME:
+        {
+            ssize_t *ret = va_arg(arguments, ssize_t *);
+            char *name = va_arg(arguments, char *);
+            size_t size = va_arg(arguments, size_t);
+            H5R_type_t ref_type = (H5R_type_t)va_arg(arguments, int);
+            void *ref = va_arg(arguments, void *);
+            *ret=H5Rget_name(o->object_id,ref_type,ref,name,size);
+            output=*ret<0?-1:0;
+            break;
+        }
+        default:
+            break;
+    }
+    H5VL_hermes_stats_end(HERMES_OP_OBJECT_GET,begin);
+    return output;
+}
+static herr_t hermes_object_specific(void *obj, H5VL_loc_params_t loc_params, H5VL_object_specific_t specific_type, hid_t dxpl_id, void **req, va_list arguments){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *o = (HermesVol *)(obj);
+    const char *name=loc_params.type==H5VL_OBJECT_BY_NAME?loc_params.loc_data.loc_by_name.name:".";
+    hid_t lapl_id=loc_params.type==H5VL_OBJECT_BY_NAME?loc_params.loc_data.loc_by_name.lapl_id:H5P_DEFAULT;
+    herr_t output=-1;
+    switch (specific_type) {
+        /* H5Oincr_refcount, H5Odecr_refcount */
+        case H5VL_OBJECT_CHANGE_REF_COUNT:
+        {
+            int update_ref = va_arg(arguments, int);
+            /* Dropping the last reference frees the object and its address. */
+            if(update_ref<0) H5VL_hermes_meta_invalidate(o->meta);
+            output=update_ref>0?H5Oincr_refcount(o->object_id):H5Odecr_refcount(o->object_id);
+            break;
+        }
+            /* H5Oexists_by_name */
+        case H5VL_OBJECT_EXISTS:
+        {
+            htri_t *ret = va_arg(arguments, htri_t *);
+            *ret=H5Oexists_by_name(o->object_id,name,lapl_id);
+            output=*ret<0?-1:0;
+            break;
+        }
+            /* H5Ovisit, H5Ovisit_by_name */
+        case H5VL_OBJECT_VISIT:
+        {
+            H5_index_t idx_type = (H5_index_t)va_arg(arguments, int);
+            H5_iter_order_t order = (H5_iter_order_t)va_arg(arguments, int);
+            H5O_iterate_t op = va_arg(arguments, H5O_iterate_t);
+            void *op_data = va_arg(arguments, void *);
+            /* Visitors are shown attribute counts. */
+            if(H5VL_hermes_meta_flush(o->meta)<0) break;
+            output=H5Ovisit_by_name(o->object_id,name,idx_type,order,op,op_data,lapl_id);
+            break;
+        }
+            /* H5Rcreate */
+        case H5VL_REF_CREATE:
+        {
+            void *ref = va_arg(arguments, void *);
+            const char *ref_name = va_arg(arguments, const char *);
+            H5R_type_t ref_type = (H5R_type_t)va_arg(arguments, int);
+            hid_t space_id = va_arg(arguments, hid_t);
+            output=H5Rcreate(ref,o->object_id,ref_name,ref_type,space_id);
+            break;
+        }
+        default:
+            break;
+    }
+    H5VL_hermes_stats_end(HERMES_OP_OBJECT_SPECIFIC,begin);
+    return output;
+}
+/**
+ * This method wraps a native object opened under parent. It shares the
+ * parent's file state and is freed with hermes_object_free.
+ *
+ * @param parent
+ * @param object_id native object, released if no object can be made
+ * @return object, or NULL if object_id is invalid or out of memory
+ */
+static HermesVol *hermes_object_wrap(HermesVol *parent, hid_t object_id){
+    HermesVol *o;
+    if(object_id<0) return NULL;
+    o=hermes_vol_clone(parent);
+    if(o==NULL){
+        H5Idec_ref(object_id);
+        return NULL;
+    }
+    o->object_id=object_id;
+    return o;
+}
+static void hermes_object_free(HermesVol *o){
+    H5VL_hermes_meta_release(o->meta);
+    H5VL_hermes_placement_release(o->placement);
+    H5VL_hermes_shared_release(o->shared);
+    H5VL_hermes_name_release(o->file_name);
+    H5VL_hermes_name_release(o->file_key);
+    H5VL_hermes_name_release(o->dataset_name);
+    free(o->attr_name);
+    H5VL_hermes_pool_put(&hermes_vol_pool,o);
+}
+/**
+ * This method finds the address the attribute cache knows an object by.
+ * It is looked up once per handle.
+ *
+ * @param o
+ * @return address, or HADDR_UNDEF when the cache is off
+ */
+static haddr_t hermes_object_addr(HermesVol *o){
+    H5O_info_t info;
+    if(o->meta==NULL) return HADDR_UNDEF;
+    if(o->meta_addr==HADDR_UNDEF){
+        if(H5Oget_info(o->object_id,&info)<0) return HADDR_UNDEF;
+        o->meta_addr=info.addr;
+        if(o->meta_fresh) H5VL_hermes_meta_fresh(o->meta,o->meta_addr);
+    }
+    return o->meta_addr;
+}
+/* Tells whether loc_params name the object itself, as H5Aopen_by_name(loc, ".", ...) does. */
+static bool hermes_loc_self(const H5VL_loc_params_t *loc_params){
+    return loc_params->type==H5VL_OBJECT_BY_SELF ||
+           (loc_params->type==H5VL_OBJECT_BY_NAME && strcmp(loc_params->loc_data.loc_by_name.name,".")==0);
+}
 
 /* Hermes VOL other callbacks*/
+/**
+ * This method checks the config file and calibrates its demotion tier now,
+ * so that fapls set up later find the device measured. The config itself is
+ * applied by hermes_vol_configure, for each fapl H5Pset_fapl_hermes_vol sets.
+ *
+ * @param vipl_id
+ * @return negative if the config file cannot be read or has a bad line
+ */
 static herr_t H5VL_hermes_init(hid_t vipl_id){
+    HermesTierConfig config;
+    const char *path=getenv(HERMES_CONFIG_ENV);
+    if(path && *path && H5VL_hermes_config_read(path,&config)<0) return -1;
     return 0;
 }
 static herr_t H5VL_hermes_term(hid_t vtpl_id){
+    const char *path=getenv(HERMES_STATS_ENV);
+    H5VL_hermes_async_stop();
+    if(path && *path){
+        FILE *out=strcmp(path,"stderr")==0?stderr:fopen(path,"w");
+        if(out){
+            H5VL_hermes_stats_dump(out);
+            if(out!=stderr) fclose(out);
+        }
+    }
     return 0;
 }
-static void *H5VL_hermes_fapl_copy(const void *info){
-    HermesVol *o = (HermesVol *)info;
-    HermesVol *ret = (HermesVol *)(calloc(1, sizeof(HermesVol)));
+/**
+ * This method replaces the placement engine of a fapl info by the one a
+ * config file describes. A file with bad lines changes nothing.
+ *
+ * @param info
+ * @param path config file, NULL for the one named by HERMES_VOL_CONFIG
+ * @return non-negative on success
+ */
+static herr_t hermes_vol_configure(HermesVol *info, const char *path){
+    HermesTierConfig config;
+    HermesPlacement *engine=NULL;
+    herr_t output=0;
+    if(path==NULL) path=getenv(HERMES_CONFIG_ENV);
+    if(info==NULL || path==NULL || H5VL_hermes_config_read(path,&config)<0) return -1;
+    if(config.policy!=HERMES_PLACEMENT_NONE){
+        engine=H5VL_hermes_placement_create(H5VL_hermes_placement_class(config.policy),config.ram_bytes,
+                                            (size_t)config.extent_bytes,config.demote_dir[0]?config.demote_dir:NULL,
+                                            config.demote_bytes);
+        if(engine==NULL) return -1;
+        if(config.mapped==1 && H5VL_hermes_placement_map(engine)<0) output=-1;
+        if(config.compress==1 && H5VL_hermes_placement_compress(engine,config.shuffle)<0) output=-1;
+        /* A tier another process owns leaves this one a private tier. */
+        if(config.persist_path[0] && H5VL_hermes_placement_persist(engine,config.persist_path)<0) output=-1;
+    }
+    H5VL_hermes_placement_release(info->placement);
+    info->placement=engine;
+    return output;
+}
+/**
+ * This method copies the settings of a fapl info or of the object a new one
+ * is opened from.
+ *
+ * @param o
+ * @return new object
+ */
+static HermesVol *hermes_vol_clone(const HermesVol *o){
+    HermesVol *ret = (HermesVol *)(H5VL_hermes_pool_get(&hermes_vol_pool));
+    if(ret==NULL) return NULL;
     ret->native_driver_id=o->native_driver_id;
     ret->vol_id=o->vol_id;
     ret->native_fapl=o->native_fapl;
     ret->sync=o->sync;
-    if(o->file_name){
-        ret->file_name=(char*)malloc(strlen(o->file_name)+1);
-        strcpy(ret->file_name,o->file_name);
-    }
-    if(o->dataset_name) {
-        ret->dataset_name = (char *) malloc(strlen(o->dataset_name) + 1);
-        strcpy(ret->dataset_name, o->dataset_name);
-    }
+    ret->async=o->async;
+    ret->async_workers=o->async_workers;
+    ret->flush_policy=o->flush_policy;
+    ret->prefetch_policy=o->prefetch_policy;
+    ret->placement=H5VL_hermes_placement_ref(o->placement);
+    ret->meta_policy=o->meta_policy;
+    ret->meta=H5VL_hermes_meta_ref(o->meta);
+    ret->chunk_stage_bytes=o->chunk_stage_bytes;
+    ret->aggregate_bytes=o->aggregate_bytes;
+    ret->shared_bytes=o->shared_bytes;
+    ret->shared=H5VL_hermes_shared_ref(o->shared);
+    ret->meta_addr=HADDR_UNDEF;
+    ret->file_name=H5VL_hermes_name_ref(o->file_name);
+    ret->file_key=H5VL_hermes_name_ref(o->file_key);
+    ret->dataset_name=H5VL_hermes_name_ref(o->dataset_name);
+    return ret;
+}
+static void *H5VL_hermes_fapl_copy(const void *info){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    HermesVol *ret=hermes_vol_clone((const HermesVol *)info);
+    __atomic_add_fetch(&hermes_fapl_infos,1,__ATOMIC_RELAXED);
+    H5VL_hermes_stats_end(HERMES_OP_FAPL_COPY,begin);
     return ret;
 }
 static herr_t H5VL_hermes_fapl_free(void *info){
+    uint64_t begin=H5VL_hermes_stats_begin();
     HermesVol *o = (HermesVol *)(info);
     H5VLunregister(o->vol_id);
     herr_t output=H5Pclose(o->native_fapl);
-    free(o->file_name);
-    free(o);
-    H5_CleanBuffer();
+    H5VL_hermes_name_release(o->file_name);
+    H5VL_hermes_name_release(o->file_key);
+    H5VL_hermes_name_release(o->dataset_name);
+    H5VL_hermes_placement_release(o->placement);
+    H5VL_hermes_shared_release(o->shared);
+    H5VL_hermes_meta_release(o->meta);
+    H5VL_hermes_pool_put(&hermes_vol_pool,o);
+    /* The worker pool and the buffer are shared; other fapls may still be in use by other threads. */
+    if(__atomic_sub_fetch(&hermes_fapl_infos,1,__ATOMIC_ACQ_REL)==0){
+        H5VL_hermes_async_stop();
+        H5VL_hermes_buffer_lock();
+        uint64_t clean=H5VL_hermes_stats_begin();
+        H5_CleanBuffer();
+        H5VL_hermes_stats_end(HERMES_OP_BUFFER_CLEAN,clean);
+        H5VL_hermes_buffer_unlock();
+        H5VL_hermes_pool_trim();
+    }
+    H5VL_hermes_stats_end(HERMES_OP_FAPL_FREE,begin);
     return 0;
-}
\ No newline at end of file
+}
+/* Hermes VOL request callbacks */
+static herr_t hermes_request_cancel(void **req, H5ES_status_t *status){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    herr_t output=H5VL_hermes_request_cancel((HermesRequest *)(*req),status);
+    H5VL_hermes_stats_end(HERMES_OP_REQUEST_CANCEL,begin);
+    return output;
+}
+static herr_t hermes_request_test(void **req, H5ES_status_t *status){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    herr_t output=H5VL_hermes_request_test((HermesRequest *)(*req),status);
+    H5VL_hermes_stats_end(HERMES_OP_REQUEST_TEST,begin);
+    return output;
+}
+static herr_t hermes_request_wait(void **req, H5ES_status_t *status){
+    uint64_t begin=H5VL_hermes_stats_begin();
+    herr_t output=H5VL_hermes_request_wait((HermesRequest *)(*req),status);
+    H5VL_hermes_stats_end(HERMES_OP_REQUEST_WAIT,begin);
+    return output;
+}
@@ -29,10 +29,25 @@
 #include <hdf5.h>
 #include <H5VLpublic.h>
 #include <assert.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include "../include/hermes_vol.h"
 #include "../include/hermes.h"
 #include <memory.h>
+#include "hermes_vol_selection.h"
+#include "hermes_vol_async.h"
+#include "hermes_vol_flusher.h"
+#include "hermes_vol_prefetch.h"
+#include "hermes_vol_placement.h"
+#include "hermes_vol_stats.h"
+#include "hermes_vol_metadata.h"
+#include "hermes_vol_convert.h"
+#include "hermes_vol_chunk.h"
+#include "hermes_vol_arena.h"
+#include "hermes_vol_aggregate.h"
+#include "hermes_vol_config.h"
+#include "hermes_vol_shared.h"
+#include "hermes_vol_pool.h"
 
 typedef struct H5VL_t {
     const H5VL_class_t *vol_cls;        /* constant driver class info                           */
@@ -44,6 +59,44 @@ typedef struct H5VL_object_t {
     void               *vol_obj;        /* pointer to object created by driver                  */
     H5VL_t             *vol_info;       /* pointer to VOL info struct                           */
 } H5VL_object_t;
+/**
+ * Type of a dataset as cached at open/create time.
+ */
+typedef struct HermesTypeInfo {
+    hid_t type_id;          /* dataset type, as registered with the buffer layer */
+    hid_t native_type_id;   /* native equivalent of type_id, as held by the tiers */
+    size_t size;
+    size_t native_size;
+    H5T_class_t type_class;
+    H5T_order_t order;
+    HermesConversion to_native; /* type_id to native_type_id */
+    HermesConversion to_file;   /* and back */
+    /* Plans of the memory types of the last read and write, so repeated calls ask HDF5 nothing; not owned. */
+    hid_t read_type_id;
+    HermesConversion to_memory; /* native_type_id to read_type_id */
+    hid_t write_type_id;
+    HermesConversion from_memory; /* write_type_id to native_type_id */
+} HermesTypeInfo;
+/**
+ * A box a worker has packed for the buffer layer, in the file type. Workers
+ * must not call into the buffer layer, so the box waits for the caller.
+ */
+typedef struct HermesDeferredBox {
+    hsize_t start[H5S_MAX_RANK];
+    hsize_t end[H5S_MAX_RANK];
+    HermesExtentSet* extents;   /* told when the box is written, may be NULL */
+    struct HermesDeferredBox* next;
+    char data[];
+} HermesDeferredBox;
+/**
+ * Boxes waiting to be written by the caller, in the order workers queued them.
+ */
+typedef struct HermesDeferred {
+    pthread_mutex_t lock;
+    HermesDeferredBox* head;
+    HermesDeferredBox* tail;
+    herr_t error;           /* first failure of a write nobody was told about */
+} HermesDeferred;
 /**
  * This is the Data structure used within Hermes VOl for maintaining basic data.
  */
@@ -53,9 +106,116 @@ typedef struct HermesVol {
     hid_t vol_id;
     hid_t native_fapl;
     char* file_name;
+    char* file_key;         /* basename of file_name, the buffer layer's file key */
     char* dataset_name;
     bool sync;
+    bool async;
+    uint16_t async_workers;
+    HermesAsyncGroup* pending;  /* writes still being placed by the workers */
+    HermesDeferred* deferred;   /* what they placed, for the caller to write to the buffer layer */
+    HermesFlushPolicy flush_policy;
+    HermesDirtyState dirty;
+    HermesPrefetchPolicy prefetch_policy;
+    HermesPrefetcher* prefetch; /* read-ahead, NULL when off or not possible */
+    HermesPlacement* placement; /* tiers shared by every file of the fapl, NULL when off */
+    HermesExtentSet* extents;   /* this dataset's extents in placement */
+    size_t chunk_stage_bytes;
+    HermesChunkStage* chunks;   /* partial chunks, NULL unless the dataset is chunked */
+    size_t aggregate_bytes;
+    HermesAggregator* aggregate; /* pending small writes, NULL for chunked datasets */
+    size_t shared_bytes;
+    HermesSharedCache* shared; /* node-wide read cache of a file opened read-only, NULL when off */
+    HermesSharedSet* shared_extents; /* this dataset's extents in shared */
+    HermesMetaPolicy meta_policy;
+    HermesMetaCache* meta;      /* attribute cache of the file, NULL when off */
+    haddr_t meta_addr;          /* address of the object, HADDR_UNDEF until needed */
+    bool meta_fresh;            /* created through the VOL, so without attributes */
+    char* attr_name;            /* set on attributes served from meta */
+    /* dataset geometry, filled when the dataset is created or opened */
+    int rank;
+    hsize_t dims[H5S_MAX_RANK];
+    hsize_t max_dims[H5S_MAX_RANK];
+    HermesTypeInfo type;
 } HermesVol;
+/**
+ * Arguments shared by every box of one read or write, passed to the
+ * selection callbacks.
+ */
+typedef struct HermesTransfer {
+    char* filename;
+    char* dataset_name;
+    int rank;
+    int64_t type;
+    size_t elem_size;   /* of the native type, in which boxes reach the callbacks */
+    const HermesConversion* to_native;
+    const HermesConversion* to_file;
+    hid_t dataset_id;
+    HermesExtentSet* extents;
+    HermesChunkStage* chunks;
+    HermesAggregator* aggregate;
+    HermesSharedSet* shared;
+    HermesDeferred* deferred; /* where boxes go instead of the buffer layer, NULL on the caller */
+    size_t bytes;       /* bytes moved so far */
+} HermesTransfer;
+/**
+ * A write staged for the worker pool: the decoded file selection and a
+ * packed copy of the user's data.
+ */
+typedef struct HermesWriteJob {
+    HermesTransfer transfer;
+    HermesSelection file;
+    size_t elem_size;
+    void* staging;
+} HermesWriteJob;
+/**
+ * The writes of one dataset in a batch, run in order by one thread.
+ */
+typedef struct HermesBatchGroup {
+    HermesVol* dset;
+    HermesWriteJob** jobs;
+    size_t count;
+    size_t bytes;
+    HermesDeferred deferred;
+} HermesBatchGroup;
+
+/*
+ * Entry points applications call besides H5Pset_fapl_hermes_vol. They are
+ * declared for applications in include/hermes_vol.h, which lives outside
+ * this tree and has to carry the same prototypes.
+ */
+H5_DLL herr_t H5Pset_hermes_vol_async(hid_t fapl_id, bool async, uint16_t workers);
+H5_DLL herr_t H5Pset_hermes_vol_flush(hid_t fapl_id, bool sync, size_t dirty_bytes, double max_age,
+                                      size_t bytes_per_sec);
+H5_DLL herr_t H5Pset_hermes_vol_prefetch(hid_t fapl_id, unsigned depth, size_t max_bytes);
+H5_DLL herr_t H5Pset_hermes_vol_placement(hid_t fapl_id, HermesPlacementKind policy, size_t ram_bytes,
+                                          size_t extent_bytes, const char *demote_dir, size_t demote_bytes);
+H5_DLL herr_t H5Pset_hermes_vol_mapped_tier(hid_t fapl_id);
+H5_DLL herr_t H5Pset_hermes_vol_compression(hid_t fapl_id, bool shuffle);
+H5_DLL herr_t H5Pset_hermes_vol_persistent_tier(hid_t fapl_id, const char *path);
+H5_DLL herr_t H5Pset_hermes_vol_shared_cache(hid_t fapl_id, size_t bytes);
+H5_DLL herr_t H5Pset_hermes_vol_config(hid_t fapl_id, const char *path);
+H5_DLL herr_t H5Pset_hermes_vol_chunk_staging(hid_t fapl_id, size_t stage_bytes);
+H5_DLL herr_t H5Pset_hermes_vol_write_aggregation(hid_t fapl_id, bool aggregate, size_t flush_bytes);
+H5_DLL herr_t H5Pset_hermes_vol_metadata(hid_t fapl_id, size_t attr_bytes, size_t cache_bytes);
+H5_DLL const void *H5Dhermes_vol_view(hid_t dataset_id, hid_t file_space_id, void **token);
+H5_DLL void H5Dhermes_vol_unview(void *token);
+H5_DLL herr_t H5Dhermes_vol_write_multi(size_t count, const hid_t *dset_ids, const hid_t *mem_type_ids,
+                                        const hid_t *mem_space_ids, const hid_t *file_space_ids, hid_t dxpl_id,
+                                        const void **bufs);
+H5_DLL herr_t H5Dhermes_vol_read_multi(size_t count, const hid_t *dset_ids, const hid_t *mem_type_ids,
+                                       const hid_t *mem_space_ids, const hid_t *file_space_ids, hid_t dxpl_id,
+                                       void **bufs);
+H5_DLL herr_t H5Fhermes_vol_checkpoint(hid_t object_id);
+
+/* Hermes VOL Attribute callbacks */
+static void  *hermes_attr_create(void *obj, H5VL_loc_params_t loc_params, const char *attr_name, hid_t acpl_id, hid_t aapl_id, hid_t dxpl_id, void **req);
+static void  *hermes_attr_open(void *obj, H5VL_loc_params_t loc_params, const char *attr_name, hid_t aapl_id, hid_t dxpl_id, void **req);
+static herr_t hermes_attr_read(void *attr, hid_t mem_type_id, void *buf, hid_t dxpl_id, void **req);
+static herr_t hermes_attr_write(void *attr, hid_t mem_type_id, const void *buf, hid_t dxpl_id, void **req);
+static herr_t hermes_attr_get(void *obj, H5VL_attr_get_t get_type, hid_t dxpl_id, void **req, va_list arguments);
+static herr_t hermes_attr_specific(void *obj, H5VL_loc_params_t loc_params, H5VL_attr_specific_t specific_type, hid_t dxpl_id, void **req, va_list arguments);
+static herr_t hermes_attr_close(void *attr, hid_t dxpl_id, void **req);
+static HermesVol *hermes_attr_cached(HermesVol *loc, haddr_t addr, const char *name);
 
 /* Hermes VOL Dataset callbacks */
 static void  *hermes_dataset_create(void *obj, H5VL_loc_params_t loc_params, const char *name, hid_t dcpl_id, hid_t dapl_id, hid_t dxpl_id, void **req);
@@ -65,12 +225,97 @@ static herr_t hermes_dataset_read(void *dset, hid_t mem_type_id, hid_t mem_space
 static herr_t hermes_dataset_write(void *dset, hid_t mem_type_id, hid_t mem_space_id,
                                hid_t file_space_id, hid_t dxpl_id, const void *buf, void **req);
 static herr_t  hermes_dataset_get(void *dset, H5VL_dataset_get_t get_type, hid_t dxpl_id, void **req, va_list arguments);
+static herr_t hermes_dataset_specific(void *obj, H5VL_dataset_specific_t specific_type, hid_t dxpl_id, void **req, va_list arguments);
 static herr_t hermes_dataset_close(void *dset, hid_t dxpl_id, void **req);
+static herr_t hermes_dataset_describe(HermesVol *dset, hid_t space_id, hid_t type_id);
+static herr_t hermes_dataset_plan(HermesVol *o, hid_t mem_type_id, bool write, HermesConversion *conv);
+static HermesVol *hermes_dataset_setup(HermesVol *parent, const char *name, hid_t dataset_id);
+static herr_t hermes_dataset_write_async(HermesVol *o, const HermesTransfer *transfer, const HermesConversion *conv,
+                                         hid_t mem_space_id, hid_t file_space_id, const void *buf, void **req);
+static herr_t hermes_dataset_pack(HermesVol *o, const HermesConversion *conv, hid_t mem_space_id,
+                                  hid_t file_space_id, const void *buf, HermesSelection *file, void **staging,
+                                  bool scratch);
+static herr_t hermes_dataset_unpack(HermesVol *o, HermesTransfer *transfer, const HermesConversion *conv,
+                                    const HermesSelection *file, hid_t mem_space_id, hid_t file_space_id, void *buf);
+static herr_t hermes_dataset_flush(void *owner);
+static void hermes_dataset_track(HermesVol *dset);
+static herr_t hermes_dataset_flush_runs(HermesVol *o, const HermesDirtyMap *map);
+static void hermes_dataset_transfer(HermesVol *o, HermesTransfer *transfer);
+static HermesPrefetcher *hermes_dataset_prefetcher(HermesVol *dset, hid_t dcpl_id);
+static HermesChunkStage *hermes_dataset_chunks(HermesVol *dset, hid_t dcpl_id);
+static HermesAggregator *hermes_dataset_aggregator(HermesVol *dset);
+static char *hermes_dataset_path(HermesVol *dset);
+static void hermes_dataset_persist(HermesVol *dset, bool created);
+static HermesSharedSet *hermes_dataset_shared(HermesVol *dset);
+static herr_t hermes_dataset_unstage(HermesVol *o, const HermesSelection *file);
+static herr_t hermes_dataset_extend(HermesVol *o, const hsize_t *size);
+static herr_t hermes_dataset_reload(HermesVol *o);
+static HermesWriteJob *hermes_write_job_create(HermesVol *o, const HermesTransfer *transfer,
+                                               const HermesConversion *conv, hid_t mem_space_id,
+                                               hid_t file_space_id, const void *buf);
+static herr_t hermes_write_job_run(void *arg);
+static void hermes_write_job_free(void *arg);
+static void hermes_dataset_queue(HermesVol *dset);
+static herr_t hermes_dataset_drain(HermesVol *o);
+static HermesDeferred *hermes_deferred_create(void);
+static void hermes_deferred_init(HermesDeferred *d);
+static void hermes_deferred_free(HermesDeferred *d);
+static void hermes_deferred_destroy(HermesDeferred *d);
+static herr_t hermes_deferred_push(HermesDeferred *d, int rank, const hsize_t *file_start, const hsize_t *file_end,
+                                   HermesDeferredBox *box);
+static herr_t hermes_deferred_write(HermesVol *o, HermesDeferred *d, bool report);
+static int hermes_batch_compare(const void *a, const void *b);
+static herr_t hermes_batch_run(void *arg, size_t index);
+static void hermes_buffer_init(HermesVol *dset);
+static size_t hermes_box_bytes(const HermesTransfer *t, const hsize_t *file_start, const hsize_t *file_end);
+static bool hermes_box_contiguous(int rank, const hsize_t *count, const hsize_t *dims, const hsize_t *start,
+                                  size_t *offset);
+static herr_t hermes_buffer_read_op(void *op_data, hsize_t *file_start, hsize_t *file_end,
+                                    hsize_t *memory_start, hsize_t *memory_dim, void *buf);
+static herr_t hermes_placement_read_op(void *op_data, hsize_t *file_start, hsize_t *file_end,
+                                       hsize_t *memory_start, hsize_t *memory_dim, void *buf);
+static herr_t hermes_buffer_write_op(void *op_data, hsize_t *file_start, hsize_t *file_end,
+                                     hsize_t *memory_start, hsize_t *memory_dim, void *buf);
+static herr_t hermes_chunk_write_op(void *op_data, hsize_t *file_start, hsize_t *file_end,
+                                    hsize_t *memory_start, hsize_t *memory_dim, void *buf);
+static herr_t hermes_aggregate_write_op(void *op_data, hsize_t *file_start, hsize_t *file_end,
+                                        hsize_t *memory_start, hsize_t *memory_dim, void *buf);
+static HermesSelectionOp hermes_transfer_write_op(const HermesTransfer *t);
+static herr_t hermes_shared_read_op(void *op_data, hsize_t *file_start, hsize_t *file_end,
+                                    hsize_t *memory_start, hsize_t *memory_dim, void *buf);
+static HermesSelectionOp hermes_transfer_read_op(const HermesTransfer *t);
+static HermesSelectionOp hermes_transfer_load_op(const HermesTransfer *t);
 
 /* Hermes VOL File callbacks */
 static void  *hermes_file_create(const char *name, unsigned flags, hid_t fcpl_id, hid_t fapl_id, hid_t dxpl_id, void **req);
 static void  *hermes_file_open(const char *name, unsigned flags, hid_t fapl_id, hid_t dxpl_id, void **req);
+static herr_t hermes_file_specific(void *obj, H5VL_file_specific_t specific_type, hid_t dxpl_id, void **req, va_list arguments);
 static herr_t hermes_file_close(void *file, hid_t dxpl_id, void **req);
+static herr_t hermes_file_sync(hid_t file_id);
+static char* hermes_file_key(const char *name);
+
+/* Hermes VOL Group callbacks */
+static void  *hermes_group_create(void *obj, H5VL_loc_params_t loc_params, const char *name, hid_t gcpl_id, hid_t gapl_id, hid_t dxpl_id, void **req);
+static void  *hermes_group_open(void *obj, H5VL_loc_params_t loc_params, const char *name, hid_t gapl_id, hid_t dxpl_id, void **req);
+static herr_t hermes_group_get(void *obj, H5VL_group_get_t get_type, hid_t dxpl_id, void **req, va_list arguments);
+static herr_t hermes_group_close(void *grp, hid_t dxpl_id, void **req);
+
+/* Hermes VOL Link callbacks */
+static herr_t hermes_link_create(H5VL_link_create_type_t create_type, void *obj, H5VL_loc_params_t loc_params, hid_t lcpl_id, hid_t lapl_id, hid_t dxpl_id, void **req);
+static herr_t hermes_link_copy(void *src_obj, H5VL_loc_params_t loc_params1, void *dst_obj, H5VL_loc_params_t loc_params2, hid_t lcpl_id, hid_t lapl_id, hid_t dxpl_id, void **req);
+static herr_t hermes_link_move(void *src_obj, H5VL_loc_params_t loc_params1, void *dst_obj, H5VL_loc_params_t loc_params2, hid_t lcpl_id, hid_t lapl_id, hid_t dxpl_id, void **req);
+static herr_t hermes_link_get(void *obj, H5VL_loc_params_t loc_params, H5VL_link_get_t get_type, hid_t dxpl_id, void **req, va_list arguments);
+static herr_t hermes_link_specific(void *obj, H5VL_loc_params_t loc_params, H5VL_link_specific_t specific_type, hid_t dxpl_id, void **req, va_list arguments);
+
+/* Hermes VOL Object callbacks */
+static void  *hermes_object_open(void *obj, H5VL_loc_params_t loc_params, H5I_type_t *opened_type, hid_t dxpl_id, void **req);
+static herr_t hermes_object_copy(void *src_obj, H5VL_loc_params_t loc_params1, const char *src_name, void *dst_obj, H5VL_loc_params_t loc_params2, const char *dst_name, hid_t ocpypl_id, hid_t lcpl_id, hid_t dxpl_id, void **req);
+static herr_t hermes_object_get(void *obj, H5VL_loc_params_t loc_params, H5VL_object_get_t get_type, hid_t dxpl_id, void **req, va_list arguments);
+static herr_t hermes_object_specific(void *obj, H5VL_loc_params_t loc_params, H5VL_object_specific_t specific_type, hid_t dxpl_id, void **req, va_list arguments);
+static HermesVol *hermes_object_wrap(HermesVol *parent, hid_t object_id);
+static void hermes_object_free(HermesVol *o);
+static haddr_t hermes_object_addr(HermesVol *o);
+static bool hermes_loc_self(const H5VL_loc_params_t *loc_params);
 
 /* Hermes VOL other callbacks */
 static herr_t H5VL_hermes_init(hid_t vipl_id);
@@ -78,9 +323,21 @@ static herr_t H5VL_hermes_init(hid_t vipl_id);
 static herr_t H5VL_hermes_term(hid_t vtpl_id);
 
 static void *H5VL_hermes_fapl_copy(const void *info);
+static HermesVol *hermes_vol_clone(const HermesVol *o);
+static herr_t hermes_vol_configure(HermesVol *info, const char *path);
 
 static herr_t H5VL_hermes_fapl_free(void *info);
 
+/* Hermes VOL request callbacks */
+static herr_t hermes_request_cancel(void **req, H5ES_status_t *status);
+static herr_t hermes_request_test(void **req, H5ES_status_t *status);
+static herr_t hermes_request_wait(void **req, H5ES_status_t *status);
+
+/* fapl infos alive; the last one freed tears down the worker pool and the buffer */
+static unsigned hermes_fapl_infos=0;
+/* handles of every kind: fapl infos, files, datasets, groups and attributes */
+static HermesPool hermes_vol_pool=HERMES_POOL_INIT("vol",HermesVol);
+
 /* definition of Hermes VOL plugin. */
 static const H5VL_class_t H5VL_hermes_g = {
         1,
@@ -92,14 +349,14 @@ static const H5VL_class_t H5VL_hermes_g = {
         H5VL_hermes_fapl_copy,  /* fapl copy */
         H5VL_hermes_fapl_free,  /* fapl free */
         {
-                NULL,           /* Attribute create function      */
-                NULL,           /* Attribute open function        */
-                NULL,           /* Attribute read function        */
-                NULL,           /* Attribute write function       */
-                NULL,           /* Attribute get function         */
-                NULL,           /* Attribute specific function    */
-                NULL,           /* Attribute optional function    */
-                NULL            /* Attribute close function       */
+                hermes_attr_create,        /* Attribute create function      */
+                hermes_attr_open,          /* Attribute open function        */
+                hermes_attr_read,          /* Attribute read function        */
+                hermes_attr_write,         /* Attribute write function       */
+                hermes_attr_get,           /* Attribute get function         */
+                hermes_attr_specific,      /* Attribute specific function    */
+                NULL,                      /* Attribute optional function    */
+                hermes_attr_close          /* Attribute close function       */
         },
         {
                 hermes_dataset_create,     /* Dataset create function        */
@@ -107,7 +364,7 @@ static const H5VL_class_t H5VL_hermes_g = {
                 hermes_dataset_read,       /* Dataset read function          */
                 hermes_dataset_write,      /* Dataset write function         */
                 hermes_dataset_get,        /* Dataset get function           */
-                NULL,                      /* Dataset specific function      */
+                hermes_dataset_specific,   /* Dataset specific function      */
                 NULL,                      /* Dataset optional function      */
                 hermes_dataset_close       /* Dataset close function         */
         },
@@ -123,37 +380,37 @@ static const H5VL_class_t H5VL_hermes_g = {
                 hermes_file_create,             /* File create function           */
                 hermes_file_open,               /* File open function             */
                 NULL,                           /* File get function              */
-                NULL,                           /* File specific function         */
+                hermes_file_specific,           /* File specific function         */
                 NULL,                           /* File optional function         */
                 hermes_file_close               /* File close function            */
         },
         {
-                NULL,                           /* Group create function          */
-                NULL,                           /* Group open function            */
-                NULL,                           /* Group get function             */
+                hermes_group_create,            /* Group create function          */
+                hermes_group_open,              /* Group open function            */
+                hermes_group_get,               /* Group get function             */
                 NULL,                           /* Group specific function        */
                 NULL,                           /* Group optional function        */
-                NULL                            /* Group close function           */
+                hermes_group_close              /* Group close function           */
         },
         {
-                NULL,                           /* Link create function           */
-                NULL,                           /* Link copy function             */
-                NULL,                           /* Link move function             */
-                NULL,                           /* Link get function              */
-                NULL,                           /* Link specific function         */
+                hermes_link_create,             /* Link create function           */
+                hermes_link_copy,               /* Link copy function             */
+                hermes_link_move,               /* Link move function             */
+                hermes_link_get,                /* Link get function              */
+                hermes_link_specific,           /* Link specific function         */
                 NULL                            /* Link optional function         */
         },
         {
-                NULL,                           /* Object open function           */
-                NULL,                           /* Object copy function           */
-                NULL,                           /* Object get function            */
-                NULL,                           /* Object specific function       */
+                hermes_object_open,             /* Object open function           */
+                hermes_object_copy,             /* Object copy function           */
+                hermes_object_get,              /* Object get function            */
+                hermes_object_specific,         /* Object specific function       */
                 NULL                            /* Object optional function       */
         },
         {
-                NULL,
-                NULL,
-                NULL
+                hermes_request_cancel,          /* Request cancel function        */
+                hermes_request_test,            /* Request test function          */
+                hermes_request_wait             /* Request wait function          */
         },
         NULL
 };
@@ -0,0 +1,660 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_selection.c
+*
+* Purpose:Breaks file and memory selections into the contiguous boxes
+*         moved by H5_BufferRead/H5_BufferWrite.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "hermes_vol_arena.h"
+#include "hermes_vol_selection.h"
+
+/* Segments kept on the stack before iterate_regular falls back to the heap. */
+#define HERMES_SEGMENT_SCRATCH 256
+
+/**
+ * One stretch of a dimension which is contiguous in both the file and the
+ * memory selection.
+ */
+typedef struct HermesSegment {
+    hsize_t file;
+    hsize_t memory;
+    hsize_t length;
+} HermesSegment;
+
+typedef struct HermesScatterSource {
+    const void *buf;
+    size_t size;
+} HermesScatterSource;
+
+static hsize_t hermes_linear_offset(int rank, const hsize_t *dims, const hsize_t *coords){
+    hsize_t offset=0;
+    int i;
+    for(i=0;i<rank;i++)
+        offset=offset*dims[i]+coords[i];
+    return offset;
+}
+static void hermes_unravel(int rank, const hsize_t *dims, hsize_t offset, hsize_t *coords){
+    int i;
+    for(i=rank-1;i>=0;i--){
+        coords[i]=offset%dims[i];
+        offset/=dims[i];
+    }
+}
+static void hermes_selection_all(HermesSelection *sel, int rank, const hsize_t *dims){
+    int i;
+    sel->rank=rank;
+    sel->npoints=1;
+    for(i=0;i<rank;i++){
+        sel->dims[i]=dims[i];
+        sel->start[i]=0;
+        sel->stride[i]=dims[i];
+        sel->count[i]=1;
+        sel->block[i]=dims[i];
+        sel->npoints*=dims[i];
+    }
+    sel->type=sel->npoints?HERMES_SELECTION_REGULAR:HERMES_SELECTION_NONE;
+}
+/**
+ * Folds dimensions whose blocks touch (stride==block) into a single block so
+ * that e.g. a column subset becomes one box instead of one box per row.
+ */
+static void hermes_selection_normalize(HermesSelection *sel){
+    int i;
+    for(i=0;i<sel->rank;i++){
+        if(sel->count[i]==1 || sel->stride[i]==sel->block[i]){
+            sel->block[i]*=sel->count[i];
+            sel->count[i]=1;
+            sel->stride[i]=sel->block[i];
+        }
+    }
+}
+static int hermes_run_compare(const void *a, const void *b){
+    const HermesRun *x=(const HermesRun *)a;
+    const HermesRun *y=(const HermesRun *)b;
+    return x->offset<y->offset?-1:(x->offset>y->offset);
+}
+/**
+ * Merges runs which follow each other directly. Runs are not reordered here,
+ * so point selections keep the order HDF5 maps them in.
+ */
+static void hermes_runs_coalesce(HermesSelection *sel){
+    size_t i,last=0;
+    for(i=1;i<sel->nruns;i++){
+        if(sel->runs[last].offset+sel->runs[last].length==sel->runs[i].offset)
+            sel->runs[last].length+=sel->runs[i].length;
+        else
+            sel->runs[++last]=sel->runs[i];
+    }
+    if(sel->nruns) sel->nruns=last+1;
+}
+static herr_t hermes_decode_blocks(hid_t space_id, HermesSelection *sel){
+    int rank=sel->rank;
+    hssize_t nblocks=H5Sget_select_hyper_nblocks(space_id);
+    hsize_t *blocks,*s,*e;
+    hsize_t coords[H5S_MAX_RANK];
+    size_t total=0,b;
+    int i,k;
+    if(nblocks<0) return -1;
+    blocks=(hsize_t *)H5VL_hermes_arena_push((size_t)nblocks*2*rank*sizeof(hsize_t));
+    if(blocks==NULL) return -1;
+    if(H5Sget_select_hyper_blocklist(space_id,0,(hsize_t)nblocks,blocks)<0){
+        H5VL_hermes_arena_pop(blocks);
+        return -1;
+    }
+    /* A block yields one run per combination of its outer coordinates; the
+     * innermost dims it fully covers are part of the run. */
+    for(b=0;b<(size_t)nblocks;b++){
+        size_t runs=1;
+        s=blocks+b*2*rank;
+        e=s+rank;
+        for(k=rank-1;k>0 && s[k]==0 && e[k]==sel->dims[k]-1;k--);
+        for(i=0;i<k;i++) runs*=(size_t)(e[i]-s[i]+1);
+        total+=runs;
+    }
+    /* The runs belong to the selection, which may outlive the call and be released on another thread. */
+    sel->runs=(HermesRun *)malloc(total*sizeof(HermesRun));
+    if(sel->runs==NULL){
+        H5VL_hermes_arena_pop(blocks);
+        return -1;
+    }
+    for(b=0;b<(size_t)nblocks;b++){
+        hsize_t length=1;
+        s=blocks+b*2*rank;
+        e=s+rank;
+        for(k=rank-1;k>0 && s[k]==0 && e[k]==sel->dims[k]-1;k--);
+        for(i=k;i<rank;i++) length*=e[i]-s[i]+1;
+        memcpy(coords,s,rank*sizeof(hsize_t));
+        for(;;){
+            sel->runs[sel->nruns].offset=hermes_linear_offset(rank,sel->dims,coords);
+            sel->runs[sel->nruns].length=length;
+            sel->nruns++;
+            for(i=k-1;i>=0;i--){
+                if(++coords[i]<=e[i]) break;
+                coords[i]=s[i];
+            }
+            if(i<0) break;
+        }
+    }
+    H5VL_hermes_arena_pop(blocks);
+    qsort(sel->runs,sel->nruns,sizeof(HermesRun),hermes_run_compare);
+    hermes_runs_coalesce(sel);
+    return 0;
+}
+static herr_t hermes_decode_points(hid_t space_id, HermesSelection *sel){
+    int rank=sel->rank;
+    hsize_t *points;
+    hsize_t p;
+    points=(hsize_t *)H5VL_hermes_arena_push((size_t)sel->npoints*(rank?rank:1)*sizeof(hsize_t));
+    sel->runs=(HermesRun *)malloc((size_t)sel->npoints*sizeof(HermesRun));
+    if(points==NULL || sel->runs==NULL){
+        H5VL_hermes_arena_pop(points);
+        return -1;
+    }
+    if(H5Sget_select_elem_pointlist(space_id,0,sel->npoints,points)<0){
+        H5VL_hermes_arena_pop(points);
+        return -1;
+    }
+    for(p=0;p<sel->npoints;p++){
+        sel->runs[p].offset=hermes_linear_offset(rank,sel->dims,points+p*rank);
+        sel->runs[p].length=1;
+    }
+    sel->nruns=(size_t)sel->npoints;
+    H5VL_hermes_arena_pop(points);
+    hermes_runs_coalesce(sel);
+    return 0;
+}
+
+/**
+ * This method decodes a dataspace selection into either its regular
+ * start/stride/count/block form or a list of offset/length runs.
+ *
+ * @param space_id selection to decode; H5S_ALL selects the whole of dims
+ * @param rank rank of the dataset, used when space_id is H5S_ALL
+ * @param dims extent of the dataset, used when space_id is H5S_ALL
+ * @param sel decoded selection, released with H5VL_hermes_selection_release
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_selection_decode(hid_t space_id, int rank, const hsize_t *dims, HermesSelection *sel){
+    hssize_t npoints;
+    sel->runs=NULL;
+    sel->nruns=0;
+    if(space_id==H5S_ALL){
+        hermes_selection_all(sel,rank,dims);
+        return 0;
+    }
+    sel->rank=H5Sget_simple_extent_dims(space_id,sel->dims,NULL);
+    npoints=H5Sget_select_npoints(space_id);
+    if(sel->rank<0 || npoints<0) return -1;
+    sel->npoints=(hsize_t)npoints;
+    if(npoints==0){
+        sel->type=HERMES_SELECTION_NONE;
+        return 0;
+    }
+    switch(H5Sget_select_type(space_id)){
+        case H5S_SEL_ALL:
+            hermes_selection_all(sel,sel->rank,sel->dims);
+            return 0;
+        case H5S_SEL_HYPERSLABS:
+            if(H5Sis_regular_hyperslab(space_id)>0){
+                sel->type=HERMES_SELECTION_REGULAR;
+                if(H5Sget_regular_hyperslab(space_id,sel->start,sel->stride,sel->count,sel->block)<0) return -1;
+                hermes_selection_normalize(sel);
+                return 0;
+            }
+            sel->type=HERMES_SELECTION_IRREGULAR;
+            return hermes_decode_blocks(space_id,sel);
+        case H5S_SEL_POINTS:
+            sel->type=HERMES_SELECTION_IRREGULAR;
+            return hermes_decode_points(space_id,sel);
+        default:
+            sel->type=HERMES_SELECTION_NONE;
+            return 0;
+    }
+}
+void H5VL_hermes_selection_release(HermesSelection *sel){
+    free(sel->runs);
+    sel->runs=NULL;
+    sel->nruns=0;
+}
+
+/**
+ * Returns true when the selection is a single stretch of row-major memory,
+ * which lets it be treated as a densely packed buffer.
+ */
+static bool hermes_selection_contiguous(const HermesSelection *sel, hsize_t *offset){
+    int i,k;
+    if(sel->type==HERMES_SELECTION_IRREGULAR && sel->nruns==1){
+        *offset=sel->runs[0].offset;
+        return true;
+    }
+    if(sel->type!=HERMES_SELECTION_REGULAR) return false;
+    for(i=0;i<sel->rank;i++)
+        if(sel->count[i]!=1) return false;
+    for(k=0;k<sel->rank && sel->block[k]==1;k++);
+    for(i=k+1;i<sel->rank;i++)
+        if(sel->block[i]!=sel->dims[i]) return false;
+    *offset=hermes_linear_offset(sel->rank,sel->dims,sel->start);
+    return true;
+}
+/**
+ * Two regular selections map box-to-box when they have the same rank and
+ * select the same number of elements along every dimension.
+ */
+static bool hermes_selection_compatible(const HermesSelection *file, const HermesSelection *mem){
+    int i;
+    if(mem->type!=HERMES_SELECTION_REGULAR || file->rank!=mem->rank) return false;
+    for(i=0;i<file->rank;i++)
+        if(file->count[i]*file->block[i]!=mem->count[i]*mem->block[i]) return false;
+    return true;
+}
+/**
+ * Describes a densely packed buffer holding the elements of a regular file
+ * selection.
+ */
+static void hermes_selection_dense(const HermesSelection *file, HermesSelection *dense){
+    int i;
+    dense->type=HERMES_SELECTION_REGULAR;
+    dense->rank=file->rank;
+    dense->npoints=file->npoints;
+    dense->runs=NULL;
+    dense->nruns=0;
+    for(i=0;i<file->rank;i++){
+        dense->dims[i]=file->count[i]*file->block[i];
+        dense->start[i]=0;
+        dense->stride[i]=dense->dims[i];
+        dense->count[i]=1;
+        dense->block[i]=dense->dims[i];
+    }
+}
+/**
+ * Walks the product of the per-dimension segments of two compatible regular
+ * selections, handing each box to op.
+ */
+static herr_t hermes_iterate_regular(const HermesSelection *file, const HermesSelection *mem, void *buf,
+                                     HermesSelectionOp op, void *op_data){
+    HermesSegment scratch[HERMES_SEGMENT_SCRATCH];
+    HermesSegment *segments=scratch,*dim_segments[H5S_MAX_RANK];
+    size_t nsegments[H5S_MAX_RANK],idx[H5S_MAX_RANK],capacity=0;
+    hsize_t file_start[H5S_MAX_RANK],file_end[H5S_MAX_RANK],memory_start[H5S_MAX_RANK],memory_dim[H5S_MAX_RANK];
+    herr_t status=0;
+    int rank=file->rank,i;
+    for(i=0;i<rank;i++)
+        capacity+=(size_t)(file->count[i]+mem->count[i]);
+    if(capacity>HERMES_SEGMENT_SCRATCH){
+        segments=(HermesSegment *)malloc(capacity*sizeof(HermesSegment));
+        if(segments==NULL) return -1;
+    }
+    capacity=0;
+    for(i=0;i<rank;i++){
+        hsize_t n=0,total=file->count[i]*file->block[i];
+        dim_segments[i]=segments+capacity;
+        nsegments[i]=0;
+        while(n<total){
+            hsize_t file_off=n%file->block[i],mem_off=n%mem->block[i];
+            HermesSegment *seg=dim_segments[i]+nsegments[i]++;
+            seg->file=file->start[i]+(n/file->block[i])*file->stride[i]+file_off;
+            seg->memory=mem->start[i]+(n/mem->block[i])*mem->stride[i]+mem_off;
+            seg->length=file->block[i]-file_off;
+            if(mem->block[i]-mem_off<seg->length) seg->length=mem->block[i]-mem_off;
+            n+=seg->length;
+        }
+        capacity+=nsegments[i];
+        idx[i]=0;
+        memory_dim[i]=mem->dims[i];
+    }
+    for(;;){
+        for(i=0;i<rank;i++){
+            const HermesSegment *seg=dim_segments[i]+idx[i];
+            file_start[i]=seg->file;
+            file_end[i]=seg->file+seg->length-1;
+            memory_start[i]=seg->memory;
+        }
+        status=op(op_data,file_start,file_end,memory_start,memory_dim,buf);
+        if(status<0) break;
+        for(i=rank-1;i>=0;i--){
+            if(++idx[i]<nsegments[i]) break;
+            idx[i]=0;
+        }
+        if(i<0) break;
+    }
+    if(segments!=scratch) free(segments);
+    return status;
+}
+/**
+ * Computes the largest box starting at offset which is contiguous in
+ * row-major order and no longer than length elements.
+ *
+ * @return number of elements in the box
+ */
+static hsize_t hermes_run_box(int rank, const hsize_t *dims, hsize_t offset, hsize_t length,
+                              hsize_t *start, hsize_t *end){
+    hsize_t stride[H5S_MAX_RANK],slab=1,n=0;
+    int i,d;
+    if(rank==0) return length;
+    hermes_unravel(rank,dims,offset,start);
+    for(i=rank-1;i>=0;i--){
+        stride[i]=slab;
+        slab*=dims[i];
+    }
+    for(d=rank-1;d>0 && start[d]==0;d--);
+    for(;d<rank;d++){
+        n=dims[d]-start[d];
+        if(length/stride[d]<n) n=length/stride[d];
+        if(n>0) break;
+    }
+    for(i=0;i<rank;i++){
+        if(i<d) end[i]=start[i];
+        else if(i==d) end[i]=start[i]+n-1;
+        else end[i]=dims[i]-1;
+    }
+    return n*stride[d];
+}
+/**
+ * Hands each offset/length run of an irregular file selection to op. With
+ * identity set, memory has the file's shape and selection; otherwise memory
+ * is the densely packed buffer at buf.
+ */
+static herr_t hermes_iterate_runs(const HermesSelection *file, void *buf, size_t elem_size, bool identity,
+                                  HermesSelectionOp op, void *op_data){
+    hsize_t file_start[H5S_MAX_RANK],file_end[H5S_MAX_RANK],memory_start[H5S_MAX_RANK],memory_dim[H5S_MAX_RANK];
+    hsize_t memory_offset=0;
+    size_t r;
+    int rank=file->rank,i;
+    for(r=0;r<file->nruns;r++){
+        hsize_t offset=file->runs[r].offset,length=file->runs[r].length;
+        while(length>0){
+            hsize_t n=hermes_run_box(rank,file->dims,offset,length,file_start,file_end);
+            herr_t status;
+            if(identity){
+                for(i=0;i<rank;i++){
+                    memory_start[i]=file_start[i];
+                    memory_dim[i]=file->dims[i];
+                }
+                status=op(op_data,file_start,file_end,memory_start,memory_dim,buf);
+            }else{
+                for(i=0;i<rank;i++){
+                    memory_start[i]=0;
+                    memory_dim[i]=file_end[i]-file_start[i]+1;
+                }
+                status=op(op_data,file_start,file_end,memory_start,memory_dim,
+                          (char *)buf+memory_offset*elem_size);
+            }
+            if(status<0) return status;
+            offset+=n;
+            length-=n;
+            memory_offset+=n;
+        }
+    }
+    return 0;
+}
+/**
+ * This method iterates a decoded file selection against a densely packed
+ * buffer holding its elements in selection order. It makes no HDF5 calls, so
+ * it can run away from the thread that decoded the selection.
+ *
+ * @param file decoded file selection
+ * @param buf packed elements
+ * @param elem_size size of one element
+ * @param op called for every box
+ * @param op_data passed through to op
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_selection_iterate_dense(const HermesSelection *file, void *buf, size_t elem_size,
+                                           HermesSelectionOp op, void *op_data){
+    HermesSelection dense;
+    if(file->type==HERMES_SELECTION_NONE) return 0;
+    if(file->type==HERMES_SELECTION_REGULAR){
+        hermes_selection_dense(file,&dense);
+        return hermes_iterate_regular(file,&dense,buf,op,op_data);
+    }
+    return hermes_iterate_runs(file,buf,elem_size,false,op,op_data);
+}
+/**
+ * This method packs the memory selection of a write into dst, in the order
+ * H5VL_hermes_selection_iterate_dense expects.
+ *
+ * @param file_space_id file selection of the write
+ * @param mem_space_id memory selection of the write
+ * @param type_id type of the elements in buf
+ * @param elem_size size of type_id
+ * @param npoints number of selected elements
+ * @param buf user buffer
+ * @param dst packed copy, npoints*elem_size bytes
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_selection_gather(hid_t file_space_id, hid_t mem_space_id, hid_t type_id, size_t elem_size,
+                                    hsize_t npoints, const void *buf, void *dst){
+    /* With H5S_ALL, memory is shaped and selected like the file. */
+    hid_t space_id=mem_space_id==H5S_ALL?file_space_id:mem_space_id;
+    if(space_id==H5S_ALL){
+        memcpy(dst,buf,(size_t)npoints*elem_size);
+        return 0;
+    }
+    return H5Dgather(space_id,buf,type_id,(size_t)npoints*elem_size,dst,NULL,NULL);
+}
+static herr_t hermes_scatter_source(const void **src_buf, size_t *src_buf_bytes_used, void *op_data){
+    HermesScatterSource *source=(HermesScatterSource *)op_data;
+    *src_buf=source->buf;
+    *src_buf_bytes_used=source->size;
+    return 0;
+}
+/**
+ * This method unpacks src, in the order H5VL_hermes_selection_iterate_dense
+ * fills it, into the memory selection of a read.
+ *
+ * @param file_space_id file selection of the read
+ * @param mem_space_id memory selection of the read
+ * @param type_id type of the elements in src
+ * @param elem_size size of type_id
+ * @param npoints number of selected elements
+ * @param src packed elements, npoints*elem_size bytes
+ * @param buf user buffer
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_selection_scatter(hid_t file_space_id, hid_t mem_space_id, hid_t type_id, size_t elem_size,
+                                     hsize_t npoints, const void *src, void *buf){
+    hid_t space_id=mem_space_id==H5S_ALL?file_space_id:mem_space_id;
+    HermesScatterSource source;
+    if(space_id==H5S_ALL){
+        memcpy(buf,src,(size_t)npoints*elem_size);
+        return 0;
+    }
+    source.buf=src;
+    source.size=(size_t)npoints*elem_size;
+    return H5Dscatter(hermes_scatter_source,&source,type_id,space_id,buf);
+}
+
+/**
+ * This method walks a decoded file selection box by box, pairing every box
+ * with its place in the memory selection. Matching regular selections and
+ * contiguous memory are handed to op in place; any other memory selection
+ * is gathered into (or scattered from) a packed staging buffer.
+ *
+ * @param file decoded file selection
+ * @param mem_space_id memory selection, H5S_ALL to mirror the file selection
+ * @param type_id type of the elements in buf
+ * @param elem_size size of type_id
+ * @param buf user buffer
+ * @param is_write true when buf is the source of the transfer
+ * @param op called for every box
+ * @param op_data passed through to op
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_selection_transfer(const HermesSelection *file, hid_t mem_space_id, hid_t type_id, size_t elem_size,
+                                      void *buf, bool is_write, HermesSelectionOp op, void *op_data){
+    HermesSelection mem;
+    hsize_t offset;
+    herr_t status;
+    if(file->type==HERMES_SELECTION_NONE) return 0;
+    if(mem_space_id==H5S_ALL){
+        if(file->type==HERMES_SELECTION_REGULAR)
+            return hermes_iterate_regular(file,file,buf,op,op_data);
+        return hermes_iterate_runs(file,buf,elem_size,true,op,op_data);
+    }
+    if(H5VL_hermes_selection_decode(mem_space_id,file->rank,file->dims,&mem)<0 || mem.npoints!=file->npoints){
+        H5VL_hermes_selection_release(&mem);
+        return -1;
+    }
+    if(file->type==HERMES_SELECTION_REGULAR && hermes_selection_compatible(file,&mem)){
+        status=hermes_iterate_regular(file,&mem,buf,op,op_data);
+    }else if(hermes_selection_contiguous(&mem,&offset)){
+        status=H5VL_hermes_selection_iterate_dense(file,(char *)buf+offset*elem_size,elem_size,op,op_data);
+    }else{
+        size_t size=(size_t)file->npoints*elem_size;
+        void *staging=H5VL_hermes_arena_push(size);
+        if(staging==NULL){
+            status=-1;
+        }else if(is_write){
+            status=H5Dgather(mem_space_id,buf,type_id,size,staging,NULL,NULL);
+            if(status>=0) status=H5VL_hermes_selection_iterate_dense(file,staging,elem_size,op,op_data);
+        }else{
+            HermesScatterSource source;
+            source.buf=staging;
+            source.size=size;
+            status=H5VL_hermes_selection_iterate_dense(file,staging,elem_size,op,op_data);
+            if(status>=0) status=H5Dscatter(hermes_scatter_source,&source,type_id,mem_space_id,buf);
+        }
+        H5VL_hermes_arena_pop(staging);
+    }
+    H5VL_hermes_selection_release(&mem);
+    return status;
+}
+/**
+ * This method decodes file_space_id and transfers it with
+ * H5VL_hermes_selection_transfer.
+ *
+ * @param file_space_id file selection, H5S_ALL for the whole dataset
+ * @param mem_space_id memory selection, H5S_ALL to mirror the file selection
+ * @param rank rank of the dataset
+ * @param dims extent of the dataset
+ * @param type_id type of the elements in buf
+ * @param elem_size size of type_id
+ * @param buf user buffer
+ * @param is_write true when buf is the source of the transfer
+ * @param op called for every box
+ * @param op_data passed through to op
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_selection_iterate(hid_t file_space_id, hid_t mem_space_id, int rank, const hsize_t *dims,
+                                     hid_t type_id, size_t elem_size, void *buf, bool is_write,
+                                     HermesSelectionOp op, void *op_data){
+    HermesSelection file;
+    herr_t status;
+    if(elem_size==0 || H5VL_hermes_selection_decode(file_space_id,rank,dims,&file)<0){
+        H5VL_hermes_selection_release(&file);
+        return -1;
+    }
+    status=H5VL_hermes_selection_transfer(&file,mem_space_id,type_id,elem_size,buf,is_write,op,op_data);
+    H5VL_hermes_selection_release(&file);
+    return status;
+}
+/**
+ * This method computes the bounding box of a decoded selection.
+ *
+ * @param sel selection, not empty
+ * @param start first corner
+ * @param end last corner, inclusive
+ */
+void H5VL_hermes_selection_bounds(const HermesSelection *sel, hsize_t *start, hsize_t *end){
+    hsize_t first[H5S_MAX_RANK],last[H5S_MAX_RANK];
+    size_t r;
+    int i;
+    if(sel->type==HERMES_SELECTION_REGULAR){
+        for(i=0;i<sel->rank;i++){
+            start[i]=sel->start[i];
+            end[i]=sel->start[i]+(sel->count[i]-1)*sel->stride[i]+sel->block[i]-1;
+        }
+        return;
+    }
+    for(i=0;i<sel->rank;i++){
+        start[i]=sel->dims[i];
+        end[i]=0;
+    }
+    for(r=0;r<sel->nruns;r++){
+        hsize_t offset=sel->runs[r].offset;
+        while(offset<sel->runs[r].offset+sel->runs[r].length){
+            hsize_t n=hermes_run_box(sel->rank,sel->dims,offset,sel->runs[r].offset+sel->runs[r].length-offset,
+                                     first,last);
+            for(i=0;i<sel->rank;i++){
+                if(first[i]<start[i]) start[i]=first[i];
+                if(last[i]>end[i]) end[i]=last[i];
+            }
+            offset+=n;
+        }
+    }
+}
+/**
+ * This method copies a box of elements between two row-major arrays. Inner
+ * dimensions the box spans completely in both arrays are copied as one run.
+ *
+ * @param rank rank of both arrays
+ * @param elem_size size of one element
+ * @param count extent of the box
+ * @param src source array
+ * @param src_dims extent of src
+ * @param src_start corner of the box in src
+ * @param dst destination array
+ * @param dst_dims extent of dst
+ * @param dst_start corner of the box in dst
+ */
+void H5VL_hermes_box_copy(int rank, size_t elem_size, const hsize_t *count,
+                          const void *src, const hsize_t *src_dims, const hsize_t *src_start,
+                          void *dst, const hsize_t *dst_dims, const hsize_t *dst_start){
+    hsize_t idx[H5S_MAX_RANK],src_stride[H5S_MAX_RANK],dst_stride[H5S_MAX_RANK];
+    hsize_t src_offset=0,dst_offset=0,run;
+    int i,k;
+    if(rank==0){
+        memcpy(dst,src,elem_size);
+        return;
+    }
+    for(i=0;i<rank;i++)
+        if(count[i]==0) return;
+    src_stride[rank-1]=dst_stride[rank-1]=1;
+    for(i=rank-2;i>=0;i--){
+        src_stride[i]=src_stride[i+1]*src_dims[i+1];
+        dst_stride[i]=dst_stride[i+1]*dst_dims[i+1];
+    }
+    k=rank-1;
+    run=count[k];
+    while(k>0 && count[k]==src_dims[k] && count[k]==dst_dims[k]){
+        k--;
+        run*=count[k];
+    }
+    for(i=0;i<rank;i++){
+        idx[i]=0;
+        src_offset+=src_start[i]*src_stride[i];
+        dst_offset+=dst_start[i]*dst_stride[i];
+    }
+    for(;;){
+        memcpy((char *)dst+dst_offset*elem_size,(const char *)src+src_offset*elem_size,(size_t)run*elem_size);
+        for(i=k-1;i>=0;i--){
+            src_offset+=src_stride[i];
+            dst_offset+=dst_stride[i];
+            if(++idx[i]<count[i]) break;
+            src_offset-=count[i]*src_stride[i];
+            dst_offset-=count[i]*dst_stride[i];
+            idx[i]=0;
+        }
+        if(i<0) break;
+    }
+}
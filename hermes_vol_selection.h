@@ -0,0 +1,90 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_selection.h
+*
+* Purpose:Defines the selection engine that lowers HDF5 dataspace
+*         selections into the contiguous boxes handed to the buffer layer.
+*
+*-------------------------------------------------------------------------
+*/
+
+#ifndef HERMES_PROJECT_HERMES_VOL_SELECTION_H
+#define HERMES_PROJECT_HERMES_VOL_SELECTION_H
+#include <hdf5.h>
+#include <stdbool.h>
+
+typedef enum HermesSelectionType {
+    HERMES_SELECTION_NONE,      /* nothing selected                     */
+    HERMES_SELECTION_REGULAR,   /* start/stride/count/block per dim     */
+    HERMES_SELECTION_IRREGULAR  /* offset/length list of element runs   */
+} HermesSelectionType;
+
+/**
+ * A run of elements which are contiguous in the row-major order of a
+ * dataspace. Irregular hyperslabs and point selections are lowered to a list
+ * of these, in the order HDF5 maps them onto the other dataspace.
+ */
+typedef struct HermesRun {
+    hsize_t offset;
+    hsize_t length;
+} HermesRun;
+
+/**
+ * Decoded form of a dataspace selection. "All" selections are stored as a
+ * regular hyperslab with a single block covering the extent.
+ */
+typedef struct HermesSelection {
+    HermesSelectionType type;
+    int rank;
+    hsize_t dims[H5S_MAX_RANK];
+    hsize_t start[H5S_MAX_RANK];
+    hsize_t stride[H5S_MAX_RANK];
+    hsize_t count[H5S_MAX_RANK];
+    hsize_t block[H5S_MAX_RANK];
+    HermesRun *runs;
+    size_t nruns;
+    hsize_t npoints;
+} HermesSelection;
+
+/**
+ * Called once per contiguous box of the file selection. The box spans
+ * file_start..file_end (inclusive) and lives at memory_start inside a memory
+ * array of extent memory_dim starting at buf, i.e. exactly the arguments of
+ * H5_BufferRead/H5_BufferWrite.
+ */
+typedef herr_t (*HermesSelectionOp)(void *op_data, hsize_t *file_start, hsize_t *file_end,
+                                    hsize_t *memory_start, hsize_t *memory_dim, void *buf);
+
+herr_t H5VL_hermes_selection_decode(hid_t space_id, int rank, const hsize_t *dims, HermesSelection *sel);
+void H5VL_hermes_selection_release(HermesSelection *sel);
+herr_t H5VL_hermes_selection_transfer(const HermesSelection *file, hid_t mem_space_id, hid_t type_id, size_t elem_size,
+                                      void *buf, bool is_write, HermesSelectionOp op, void *op_data);
+herr_t H5VL_hermes_selection_iterate(hid_t file_space_id, hid_t mem_space_id, int rank, const hsize_t *dims,
+                                     hid_t type_id, size_t elem_size, void *buf, bool is_write,
+                                     HermesSelectionOp op, void *op_data);
+herr_t H5VL_hermes_selection_iterate_dense(const HermesSelection *file, void *buf, size_t elem_size,
+                                           HermesSelectionOp op, void *op_data);
+herr_t H5VL_hermes_selection_gather(hid_t file_space_id, hid_t mem_space_id, hid_t type_id, size_t elem_size,
+                                    hsize_t npoints, const void *buf, void *dst);
+herr_t H5VL_hermes_selection_scatter(hid_t file_space_id, hid_t mem_space_id, hid_t type_id, size_t elem_size,
+                                     hsize_t npoints, const void *src, void *buf);
+void H5VL_hermes_selection_bounds(const HermesSelection *sel, hsize_t *start, hsize_t *end);
+void H5VL_hermes_box_copy(int rank, size_t elem_size, const hsize_t *count,
+                          const void *src, const hsize_t *src_dims, const hsize_t *src_start,
+                          void *dst, const hsize_t *dst_dims, const hsize_t *dst_start);
+#endif //HERMES_PROJECT_HERMES_VOL_SELECTION_H
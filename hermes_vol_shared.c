@@ -0,0 +1,409 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_shared.c
+*
+* Purpose:Implements the shared read cache. The segment is named after the
+*         file's canonical path, its size, mtime and inode, the segment
+*         size and the user, so processes attach to the same one exactly
+*         when they read the same version of the file.
+*
+*         The segment starts with a header, then an open-addressing index
+*         of extents, then a data area handed out from its start. A process
+*         claims an extent by swapping its tag into a free index entry,
+*         loads it from the buffer layer straight into the data area and
+*         publishes it; others wait for it and then copy from it in place.
+*         Nothing is evicted: once the data area is full, extents that do
+*         not fit are read privately. An extent whose loader died is read
+*         privately too.
+*
+*         Two limits remain. A process that dies while attached never
+*         detaches, so the count of attached processes never drops to 0
+*         and the segment stays in /dev/shm as hermes-vol-* until it is
+*         removed by hand. And a loader is known dead through kill(pid,0),
+*         which tells nothing across PID namespaces, where the pid names
+*         another process or none, nor once the pid is reused. Waiting for
+*         a loader is therefore bounded: past HERMES_SHARED_FILL_POLLS the
+*         extent is given up on and read privately.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "hermes_vol_shared.h"
+#include "hermes_vol_stats.h"
+
+#define HERMES_SHARED_MAGIC 0x3144524853564c48ull   /* "HLVSHRD1" */
+#define HERMES_SHARED_VERSION 1
+#define HERMES_SHARED_MIN_SLOTS 1024
+#define HERMES_SHARED_ALIGN 64
+/* Polling interval while another process fills an extent or the segment. */
+#define HERMES_SHARED_POLL_NS 50000
+/* How long an attaching process waits for the segment to be set up. */
+#define HERMES_SHARED_ATTACH_POLLS 20000
+/* How long a process waits for another to load an extent, at least 2s. */
+#define HERMES_SHARED_FILL_POLLS 40000
+
+enum {
+    HERMES_SHARED_FILLING,  /* claimed; the claimer is loading it */
+    HERMES_SHARED_READY,
+    HERMES_SHARED_FAILED    /* read privately by everyone */
+};
+
+typedef struct HermesSharedEntry {
+    uint64_t tag;           /* of the extent; 0 while free */
+    uint32_t state;
+    int32_t filler;         /* pid of the claimer */
+    uint64_t offset;        /* of the extent in the segment */
+} HermesSharedEntry;
+typedef struct HermesSharedHeader {
+    uint64_t magic;         /* set last by the creator */
+    uint64_t bytes;
+    uint64_t slots;         /* index entries, a power of two */
+    uint64_t used;          /* end of the data handed out */
+    uint32_t attached;      /* processes using the segment */
+} HermesSharedHeader;
+
+struct HermesSharedCache {
+    int refs;
+    char name[64];
+    char *base;
+    size_t bytes;
+    HermesSharedHeader *header;
+    HermesSharedEntry *entries;
+};
+struct HermesSharedSet {
+    HermesSharedCache *cache;
+    uint64_t key;           /* of the dataset and its geometry */
+    int rank;
+    hsize_t dims[H5S_MAX_RANK];
+    size_t elem_size;
+    hsize_t rows;           /* rows of the slowest dimension per extent */
+};
+
+/* FNV-1a, continued from hash */
+static uint64_t hermes_shared_hash(uint64_t hash, const void *data, size_t bytes){
+    const unsigned char *p=(const unsigned char *)data;
+    size_t i;
+    for(i=0;i<bytes;i++) hash=(hash^p[i])*1099511628211ull;
+    return hash;
+}
+static void hermes_shared_pause(void){
+    struct timespec ts={0,HERMES_SHARED_POLL_NS};
+    nanosleep(&ts,NULL);
+}
+static uint64_t hermes_shared_tag(const HermesSharedSet *set, size_t index){
+    uint64_t tag=hermes_shared_hash(set->key,&index,sizeof(size_t));
+    return tag?tag:1;
+}
+/**
+ * This method finds the index entry of an extent, claiming a free one for
+ * it if no process has yet.
+ *
+ * @param claimed set when the caller now has to fill the entry
+ * @return entry, or NULL when the index is full
+ */
+static HermesSharedEntry *hermes_shared_find(HermesSharedCache *cache, uint64_t tag, bool *claimed){
+    uint64_t mask=cache->header->slots-1,i=tag&mask,n;
+    *claimed=false;
+    for(n=0;n<=mask;n++,i=(i+1)&mask){
+        HermesSharedEntry *e=&cache->entries[i];
+        uint64_t current=__atomic_load_n(&e->tag,__ATOMIC_ACQUIRE);
+        if(current==0){
+            if(__atomic_compare_exchange_n(&e->tag,&current,tag,false,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE)){
+                __atomic_store_n(&e->filler,(int32_t)getpid(),__ATOMIC_RELEASE);
+                *claimed=true;
+                return e;
+            }
+        }
+        if(current==tag) return e;
+    }
+    return NULL;
+}
+/**
+ * This method waits for another process to fill an entry. An entry whose
+ * filler is gone, or takes longer than HERMES_SHARED_FILL_POLLS, is marked
+ * failed; a filler that was only slow still publishes it for later reads.
+ *
+ * @return whether the entry is ready
+ */
+static bool hermes_shared_wait(HermesSharedEntry *e){
+    uint32_t state;
+    unsigned polls=0;
+    while((state=__atomic_load_n(&e->state,__ATOMIC_ACQUIRE))==HERMES_SHARED_FILLING){
+        int32_t filler=__atomic_load_n(&e->filler,__ATOMIC_ACQUIRE);
+        if(polls++==HERMES_SHARED_FILL_POLLS || (filler>0 && kill(filler,0)<0 && errno==ESRCH)){
+            uint32_t expected=HERMES_SHARED_FILLING;
+            __atomic_compare_exchange_n(&e->state,&expected,HERMES_SHARED_FAILED,false,__ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE);
+            continue;
+        }
+        hermes_shared_pause();
+    }
+    return state==HERMES_SHARED_READY;
+}
+/**
+ * This method computes the box of extent index and the part of the request
+ * box lying in it.
+ */
+static void hermes_shared_box(const HermesSharedSet *set, size_t index, const hsize_t *file_start,
+                              const hsize_t *file_end, const hsize_t *memory_start, hsize_t *extent_start,
+                              hsize_t *extent_dims, hsize_t *count, hsize_t *src_start, hsize_t *dst_start){
+    hsize_t first=(hsize_t)index*set->rows,lo,hi;
+    int i;
+    extent_dims[0]=set->dims[0]-first<set->rows?set->dims[0]-first:set->rows;
+    extent_start[0]=first;
+    lo=file_start[0]>first?file_start[0]:first;
+    hi=file_end[0]<first+extent_dims[0]-1?file_end[0]:first+extent_dims[0]-1;
+    count[0]=hi-lo+1;
+    src_start[0]=lo-first;
+    dst_start[0]=memory_start[0]+(lo-file_start[0]);
+    for(i=1;i<set->rank;i++){
+        extent_dims[i]=set->dims[i];
+        extent_start[i]=0;
+        count[i]=file_end[i]-file_start[i]+1;
+        src_start[i]=file_start[i];
+        dst_start[i]=memory_start[i];
+    }
+}
+
+/**
+ * This method attaches to the shared read cache of a file, creating it if
+ * this is the first process on the node to open that version of the file.
+ *
+ * @param file path of a file opened read-only
+ * @param bytes size of the segment
+ * @return cache holding one reference, or NULL
+ */
+HermesSharedCache *H5VL_hermes_shared_attach(const char *file, size_t bytes){
+    HermesSharedCache *cache;
+    struct stat st;
+    uint64_t key,slots=HERMES_SHARED_MIN_SLOTS,data;
+    uid_t uid=getuid();
+    char *path=realpath(file,NULL);
+    bool creator=false;
+    unsigned polls;
+    void *base;
+    int fd;
+    if(path==NULL) return NULL;
+    if(stat(path,&st)<0){
+        free(path);
+        return NULL;
+    }
+    key=hermes_shared_hash(14695981039346656037ull,path,strlen(path));
+    free(path);
+    key=hermes_shared_hash(key,&st.st_size,sizeof(st.st_size));
+    key=hermes_shared_hash(key,&st.st_mtim,sizeof(st.st_mtim));
+    key=hermes_shared_hash(key,&st.st_ino,sizeof(st.st_ino));
+    key=hermes_shared_hash(key,&bytes,sizeof(size_t));
+    key=hermes_shared_hash(key,&uid,sizeof(uid_t));
+    /* Twice the entries whole extents would need, as edge extents are smaller. */
+    while(slots<2*(bytes/HERMES_SHARED_EXTENT)) slots*=2;
+    data=(sizeof(HermesSharedHeader)+slots*sizeof(HermesSharedEntry)+HERMES_SHARED_ALIGN-1)&
+         ~(uint64_t)(HERMES_SHARED_ALIGN-1);
+    if(bytes<data+HERMES_SHARED_EXTENT) return NULL;
+    cache=(HermesSharedCache *)calloc(1,sizeof(HermesSharedCache));
+    if(cache==NULL) return NULL;
+    snprintf(cache->name,sizeof(cache->name),"/hermes-vol-%016llx",(unsigned long long)key);
+    fd=shm_open(cache->name,O_RDWR|O_CREAT|O_EXCL,0600);
+    if(fd>=0){
+        creator=true;
+        if(ftruncate(fd,(off_t)bytes)<0){
+            close(fd);
+            shm_unlink(cache->name);
+            fd=-1;
+        }
+    }else if(errno==EEXIST){
+        fd=shm_open(cache->name,O_RDWR,0600);
+        /* The creator sizes the segment right after creating it. */
+        for(polls=0;fd>=0 && polls<HERMES_SHARED_ATTACH_POLLS;polls++){
+            if(fstat(fd,&st)<0 || (size_t)st.st_size==bytes) break;
+            hermes_shared_pause();
+        }
+        if(fd>=0 && (fstat(fd,&st)<0 || (size_t)st.st_size!=bytes)){
+            close(fd);
+            fd=-1;
+        }
+    }
+    if(fd<0){
+        free(cache);
+        return NULL;
+    }
+    base=mmap(NULL,bytes,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    close(fd);
+    if(base==MAP_FAILED){
+        if(creator) shm_unlink(cache->name);
+        free(cache);
+        return NULL;
+    }
+    cache->refs=1;
+    cache->base=(char *)base;
+    cache->bytes=bytes;
+    cache->header=(HermesSharedHeader *)base;
+    cache->entries=(HermesSharedEntry *)(cache->base+sizeof(HermesSharedHeader));
+    if(creator){
+        /* The segment comes zeroed: every entry free and filling. */
+        cache->header->bytes=bytes;
+        cache->header->slots=slots;
+        cache->header->used=data;
+        __atomic_store_n(&cache->header->magic,HERMES_SHARED_MAGIC,__ATOMIC_RELEASE);
+    }else{
+        for(polls=0;polls<HERMES_SHARED_ATTACH_POLLS;polls++){
+            if(__atomic_load_n(&cache->header->magic,__ATOMIC_ACQUIRE)==HERMES_SHARED_MAGIC) break;
+            hermes_shared_pause();
+        }
+        if(polls==HERMES_SHARED_ATTACH_POLLS || cache->header->bytes!=bytes || cache->header->slots!=slots){
+            munmap(base,bytes);
+            free(cache);
+            return NULL;
+        }
+    }
+    __atomic_add_fetch(&cache->header->attached,1,__ATOMIC_ACQ_REL);
+    return cache;
+}
+HermesSharedCache *H5VL_hermes_shared_ref(HermesSharedCache *cache){
+    if(cache) __atomic_add_fetch(&cache->refs,1,__ATOMIC_RELAXED);
+    return cache;
+}
+/**
+ * This method drops a reference. The last process on the node to detach
+ * removes the segment; one that died attached keeps it from being removed.
+ *
+ * @param cache
+ */
+void H5VL_hermes_shared_release(HermesSharedCache *cache){
+    if(cache==NULL || __atomic_sub_fetch(&cache->refs,1,__ATOMIC_ACQ_REL)>0) return;
+    if(__atomic_sub_fetch(&cache->header->attached,1,__ATOMIC_ACQ_REL)==0) shm_unlink(cache->name);
+    munmap(cache->base,cache->bytes);
+    free(cache);
+}
+/**
+ * This method divides a dataset into the extents of the shared cache. Only
+ * for types whose elements hold no pointers.
+ *
+ * @param cache
+ * @param name full path of the dataset in the file
+ * @param rank at least 1
+ * @param dims extent of the dataset
+ * @param elem_size size of the native type
+ * @return extent set, or NULL
+ */
+HermesSharedSet *H5VL_hermes_shared_set_create(HermesSharedCache *cache, const char *name, int rank,
+                                               const hsize_t *dims, size_t elem_size){
+    HermesSharedSet *set;
+    size_t row_bytes=elem_size;
+    int i;
+    if(cache==NULL || name==NULL || rank<1 || elem_size==0) return NULL;
+    set=(HermesSharedSet *)calloc(1,sizeof(HermesSharedSet));
+    if(set==NULL) return NULL;
+    set->cache=H5VL_hermes_shared_ref(cache);
+    set->rank=rank;
+    memcpy(set->dims,dims,sizeof(hsize_t)*rank);
+    set->elem_size=elem_size;
+    for(i=1;i<rank;i++) row_bytes*=dims[i];
+    set->rows=row_bytes?HERMES_SHARED_EXTENT/row_bytes:0;
+    if(set->rows==0) set->rows=1;
+    set->key=hermes_shared_hash(14695981039346656037ull,name,strlen(name)+1);
+    set->key=hermes_shared_hash(set->key,&elem_size,sizeof(size_t));
+    set->key=hermes_shared_hash(set->key,dims,sizeof(hsize_t)*rank);
+    return set;
+}
+void H5VL_hermes_shared_set_free(HermesSharedSet *set){
+    if(set==NULL) return;
+    H5VL_hermes_shared_release(set->cache);
+    free(set);
+}
+/**
+ * This method serves one box of a read from the shared cache. Extents no
+ * process has loaded yet are loaded through load into the segment; boxes
+ * of extents that do not fit are read through load directly.
+ *
+ * @param set extents of the dataset
+ * @param file_start first corner of the box
+ * @param file_end last corner of the box
+ * @param memory_start where the box lives in buf
+ * @param memory_dim extent of the memory array
+ * @param buf memory array
+ * @param load reads from the buffer layer
+ * @param load_data passed through to load
+ * @return non-negative on success
+ */
+herr_t H5VL_hermes_shared_read(HermesSharedSet *set, hsize_t *file_start, hsize_t *file_end,
+                               hsize_t *memory_start, hsize_t *memory_dim, void *buf,
+                               HermesSelectionOp load, void *load_data){
+    HermesSharedCache *cache=set->cache;
+    hsize_t extent_start[H5S_MAX_RANK],extent_end[H5S_MAX_RANK],extent_dims[H5S_MAX_RANK];
+    hsize_t count[H5S_MAX_RANK],src_start[H5S_MAX_RANK],dst_start[H5S_MAX_RANK],zero[H5S_MAX_RANK];
+    size_t index;
+    int i;
+    for(i=0;i<set->rank;i++) zero[i]=0;
+    for(index=(size_t)(file_start[0]/set->rows);index<=(size_t)(file_end[0]/set->rows);index++){
+        HermesSharedEntry *e;
+        uint64_t bytes=set->elem_size,count_bytes=set->elem_size;
+        bool claimed,ready=false;
+        hermes_shared_box(set,index,file_start,file_end,memory_start,extent_start,extent_dims,count,src_start,
+                          dst_start);
+        for(i=0;i<set->rank;i++){
+            bytes*=extent_dims[i];
+            count_bytes*=count[i];
+            extent_end[i]=extent_start[i]+extent_dims[i]-1;
+        }
+        e=hermes_shared_find(cache,hermes_shared_tag(set,index),&claimed);
+        if(e && claimed){
+            uint64_t offset=__atomic_fetch_add(&cache->header->used,
+                                               (bytes+HERMES_SHARED_ALIGN-1)&~(uint64_t)(HERMES_SHARED_ALIGN-1),
+                                               __ATOMIC_RELAXED);
+            if(offset+bytes<=cache->bytes && load(load_data,extent_start,extent_end,zero,extent_dims,
+                                                 cache->base+offset)>=0){
+                e->offset=offset;
+                __atomic_store_n(&e->state,HERMES_SHARED_READY,__ATOMIC_RELEASE);
+                H5VL_hermes_stats_event(HERMES_EVENT_SHARED_FILL);
+                H5VL_hermes_stats_bytes(HERMES_TIER_SHARED,true,bytes);
+                ready=true;
+            }else{
+                __atomic_store_n(&e->state,HERMES_SHARED_FAILED,__ATOMIC_RELEASE);
+            }
+        }else if(e){
+            ready=hermes_shared_wait(e);
+            if(ready) H5VL_hermes_stats_event(HERMES_EVENT_SHARED_HIT);
+        }
+        if(ready){
+            H5VL_hermes_stats_bytes(HERMES_TIER_SHARED,false,count_bytes);
+            H5VL_hermes_box_copy(set->rank,set->elem_size,count,cache->base+e->offset,extent_dims,src_start,buf,
+                                 memory_dim,dst_start);
+            continue;
+        }
+        /* Read privately: just the part of the box in this extent, straight into buf. */
+        for(i=0;i<set->rank;i++){
+            extent_start[i]+=src_start[i];
+            extent_end[i]=extent_start[i]+count[i]-1;
+        }
+        if(load(load_data,extent_start,extent_end,dst_start,memory_dim,buf)<0) return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_shared.h
+*
+* Purpose:Defines the node-wide read cache of a file opened read-only: a
+*         POSIX shared memory segment every process on the node opening the
+*         same file attaches to. Each extent is loaded by one process and
+*         read in place by all of them.
+*
+*-------------------------------------------------------------------------
+*/
+
+#ifndef HERMES_PROJECT_HERMES_VOL_SHARED_H
+#define HERMES_PROJECT_HERMES_VOL_SHARED_H
+#include <hdf5.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hermes_vol_selection.h"
+
+/* Extent size of the shared cache. Every process of a node cuts datasets alike. */
+#define HERMES_SHARED_EXTENT (1024*1024)
+
+typedef struct HermesSharedCache HermesSharedCache;
+typedef struct HermesSharedSet HermesSharedSet;
+
+HermesSharedCache *H5VL_hermes_shared_attach(const char *file, size_t bytes);
+HermesSharedCache *H5VL_hermes_shared_ref(HermesSharedCache *cache);
+void H5VL_hermes_shared_release(HermesSharedCache *cache);
+HermesSharedSet *H5VL_hermes_shared_set_create(HermesSharedCache *cache, const char *name, int rank,
+                                               const hsize_t *dims, size_t elem_size);
+void H5VL_hermes_shared_set_free(HermesSharedSet *set);
+herr_t H5VL_hermes_shared_read(HermesSharedSet *set, hsize_t *file_start, hsize_t *file_end,
+                               hsize_t *memory_start, hsize_t *memory_dim, void *buf,
+                               HermesSelectionOp load, void *load_data);
+#endif //HERMES_PROJECT_HERMES_VOL_SHARED_H
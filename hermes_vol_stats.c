@@ -0,0 +1,189 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_stats.c
+*
+* Purpose:Implements the instrumentation. Counters are plain relaxed atomic
+*         adds, so recording costs two clock reads and a few uncontended
+*         adds per call and it can stay on in production.
+*
+*-------------------------------------------------------------------------
+*/
+
+#include <string.h>
+#include <time.h>
+#include "hermes_vol_stats.h"
+#include "hermes_vol_pool.h"
+
+static HermesStats hermes_stats;
+static bool hermes_stats_enabled=true;
+
+static const char *hermes_op_names[HERMES_OP_COUNT]={
+    "dataset_create","dataset_open","dataset_read","dataset_write","dataset_write_multi","dataset_get",
+    "dataset_specific","dataset_close",
+    "attr_create","attr_open","attr_read","attr_write","attr_get","attr_specific","attr_close",
+    "group_create","group_open","group_get","group_close",
+    "file_create","file_open","file_specific","file_close",
+    "link_create","link_copy","link_move","link_get","link_specific",
+    "object_open","object_copy","object_get","object_specific",
+    "fapl_copy","fapl_free",
+    "request_cancel","request_test","request_wait",
+    "H5_BufferInit","H5_BufferRead","H5_BufferWrite","H5_BufferSync","H5_CleanBuffer","metadata_flush",
+    "checkpoint"
+};
+static const char *hermes_tier_names[HERMES_TIER_COUNT]={"prefetch","ram","demote","shared","buffer"};
+static const char *hermes_event_names[HERMES_EVENT_COUNT]={
+    "prefetch_issued","prefetch_hit","prefetch_dropped","ram_hit","demote_hit","extent_miss",
+    "demotion","eviction","flush","flush_run","attr_hit","attr_load","chunk_complete","chunk_merge",
+    "aggregate_merge","aggregate_flush","shared_hit","shared_fill"
+};
+
+static void hermes_add(uint64_t *counter, uint64_t value){
+    __atomic_fetch_add(counter,value,__ATOMIC_RELAXED);
+}
+static uint64_t hermes_load(const uint64_t *counter){
+    return __atomic_load_n(counter,__ATOMIC_RELAXED);
+}
+
+/**
+ * This method starts timing a call.
+ *
+ * @return start time in nanoseconds, 0 when instrumentation is off
+ */
+uint64_t H5VL_hermes_stats_begin(void){
+    struct timespec now;
+    if(!__atomic_load_n(&hermes_stats_enabled,__ATOMIC_RELAXED)) return 0;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return (uint64_t)now.tv_sec*1000000000ull+(uint64_t)now.tv_nsec;
+}
+/**
+ * This method records a call timed from begin.
+ *
+ * @param op
+ * @param begin result of H5VL_hermes_stats_begin
+ */
+void H5VL_hermes_stats_end(HermesStatOp op, uint64_t begin){
+    HermesOpStats *stats=&hermes_stats.ops[op];
+    uint64_t elapsed,max;
+    unsigned bucket;
+    if(begin==0) return;
+    elapsed=H5VL_hermes_stats_begin();
+    if(elapsed==0) return;
+    elapsed-=begin;
+    bucket=elapsed?64-(unsigned)__builtin_clzll(elapsed):0;
+    if(bucket>=HERMES_STATS_BUCKETS) bucket=HERMES_STATS_BUCKETS-1;
+    hermes_add(&stats->count,1);
+    hermes_add(&stats->total_ns,elapsed);
+    hermes_add(&stats->histogram[bucket],1);
+    max=hermes_load(&stats->max_ns);
+    while(elapsed>max &&
+          !__atomic_compare_exchange_n(&stats->max_ns,&max,elapsed,true,__ATOMIC_RELAXED,__ATOMIC_RELAXED));
+}
+void H5VL_hermes_stats_bytes(HermesStatTier tier, bool is_write, uint64_t bytes){
+    if(!__atomic_load_n(&hermes_stats_enabled,__ATOMIC_RELAXED)) return;
+    hermes_add(is_write?&hermes_stats.bytes_written[tier]:&hermes_stats.bytes_read[tier],bytes);
+}
+void H5VL_hermes_stats_event(HermesStatEvent event){
+    if(!__atomic_load_n(&hermes_stats_enabled,__ATOMIC_RELAXED)) return;
+    hermes_add(&hermes_stats.events[event],1);
+}
+
+void H5VL_hermes_stats_enable(bool enabled){
+    __atomic_store_n(&hermes_stats_enabled,enabled,__ATOMIC_RELAXED);
+}
+/**
+ * This method takes a snapshot of the counters. Counters are read one by one
+ * while calls may still be recorded, so the snapshot is not atomic as a
+ * whole.
+ *
+ * @param stats
+ */
+void H5VL_hermes_stats_get(HermesStats *stats){
+    const uint64_t *src=(const uint64_t *)&hermes_stats;
+    uint64_t *dst=(uint64_t *)stats;
+    size_t i;
+    for(i=0;i<sizeof(HermesStats)/sizeof(uint64_t);i++) dst[i]=hermes_load(&src[i]);
+}
+void H5VL_hermes_stats_reset(void){
+    uint64_t *counter=(uint64_t *)&hermes_stats;
+    size_t i;
+    for(i=0;i<sizeof(HermesStats)/sizeof(uint64_t);i++) __atomic_store_n(&counter[i],0,__ATOMIC_RELAXED);
+}
+/**
+ * This method estimates a latency percentile from the histogram.
+ *
+ * @param op
+ * @param fraction e.g. 0.99
+ * @return upper bound of the bucket holding the percentile, in nanoseconds
+ */
+uint64_t H5VL_hermes_stats_percentile(const HermesOpStats *op, double fraction){
+    uint64_t rank=(uint64_t)((double)op->count*fraction),seen=0;
+    unsigned i;
+    if(op->count==0) return 0;
+    for(i=0;i<HERMES_STATS_BUCKETS;i++){
+        seen+=op->histogram[i];
+        if(seen>rank || seen==op->count) break;
+    }
+    if(i>=HERMES_STATS_BUCKETS) i=HERMES_STATS_BUCKETS-1;
+    return i?((uint64_t)1<<i)-1:0;
+}
+/**
+ * This method writes a snapshot of the counters as JSON, with the occupancy
+ * of the slab pools and of the name table. Only calls that happened are
+ * listed.
+ *
+ * @param out
+ */
+void H5VL_hermes_stats_dump(FILE *out){
+    HermesStats stats;
+    HermesPoolStats pools[HERMES_STATS_POOLS];
+    HermesNameStats names;
+    size_t npools,p;
+    bool first=true;
+    int i;
+    unsigned b,last;
+    H5VL_hermes_stats_get(&stats);
+    fprintf(out,"{\n  \"calls\":{");
+    for(i=0;i<HERMES_OP_COUNT;i++){
+        HermesOpStats *op=&stats.ops[i];
+        if(op->count==0) continue;
+        fprintf(out,"%s\n    \"%s\":{\"count\":%llu,\"total_ns\":%llu,\"max_ns\":%llu,\"p50_ns\":%llu,"
+                    "\"p99_ns\":%llu,\"histogram\":[",first?"":",",hermes_op_names[i],
+                (unsigned long long)op->count,(unsigned long long)op->total_ns,(unsigned long long)op->max_ns,
+                (unsigned long long)H5VL_hermes_stats_percentile(op,0.5),
+                (unsigned long long)H5VL_hermes_stats_percentile(op,0.99));
+        for(last=HERMES_STATS_BUCKETS;last>0 && op->histogram[last-1]==0;last--);
+        for(b=0;b<last;b++) fprintf(out,"%s%llu",b?",":"",(unsigned long long)op->histogram[b]);
+        fprintf(out,"]}");
+        first=false;
+    }
+    fprintf(out,"\n  },\n  \"tiers\":{");
+    for(i=0;i<HERMES_TIER_COUNT;i++)
+        fprintf(out,"%s\n    \"%s\":{\"bytes_read\":%llu,\"bytes_written\":%llu}",i?",":"",hermes_tier_names[i],
+                (unsigned long long)stats.bytes_read[i],(unsigned long long)stats.bytes_written[i]);
+    fprintf(out,"\n  },\n  \"events\":{");
+    for(i=0;i<HERMES_EVENT_COUNT;i++)
+        fprintf(out,"%s\n    \"%s\":%llu",i?",":"",hermes_event_names[i],(unsigned long long)stats.events[i]);
+    npools=H5VL_hermes_pool_stats(pools,HERMES_STATS_POOLS);
+    fprintf(out,"\n  },\n  \"pools\":{");
+    for(p=0;p<npools && p<HERMES_STATS_POOLS;p++)
+        fprintf(out,"%s\n    \"%s\":{\"object_size\":%zu,\"live\":%zu,\"idle\":%zu,\"slabs\":%zu}",p?",":"",
+                pools[p].name,pools[p].object_size,pools[p].live,pools[p].idle,pools[p].nslabs);
+    H5VL_hermes_name_stats(&names);
+    fprintf(out,"\n  },\n  \"names\":{\"count\":%zu,\"bytes\":%zu,\"refs\":%zu}\n}\n",names.names,names.bytes,
+            names.refs);
+}
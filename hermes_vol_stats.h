@@ -0,0 +1,148 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Board of Trustees of the University of Illinois.         *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5. The full HDF5 copyright notice, including      *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the files COPYING and Copyright.html. COPYING can be found at the root    *
+ * of the source code distribution tree; Copyright.html can be found at the  *
+ * root level of an installed copy of the electronic HDF5 document set and   *
+ * is linked from the top-level documents page. It can also be found at      *
+ * http://hdfgroup.org/HDF5/doc/Copyright.html. If you do not have           *
+ * access to either file, you may request a copy from help@hdfgroup.org.     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*-------------------------------------------------------------------------
+*
+* Created: hermes_vol_stats.h
+*
+* Purpose:Defines the instrumentation of the Hermes VOL Plugin: latency
+*         histograms of every callback and buffer layer call, bytes moved
+*         per tier and cache event counters.
+*
+*-------------------------------------------------------------------------
+*/
+
+#ifndef HERMES_PROJECT_HERMES_VOL_STATS_H
+#define HERMES_PROJECT_HERMES_VOL_STATS_H
+#include <hdf5.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Bucket i counts calls of [2^(i-1), 2^i) nanoseconds; bucket 0 those under 1ns. */
+#define HERMES_STATS_BUCKETS 48
+/* Most slab pools the dump reports on. */
+#define HERMES_STATS_POOLS 8
+/* Names the file the statistics are written to at termination, or "stderr". */
+#define HERMES_STATS_ENV "HERMES_VOL_STATS"
+
+typedef enum HermesStatOp {
+    HERMES_OP_DATASET_CREATE,
+    HERMES_OP_DATASET_OPEN,
+    HERMES_OP_DATASET_READ,
+    HERMES_OP_DATASET_WRITE,
+    HERMES_OP_DATASET_WRITE_MULTI,
+    HERMES_OP_DATASET_GET,
+    HERMES_OP_DATASET_SPECIFIC,
+    HERMES_OP_DATASET_CLOSE,
+    HERMES_OP_ATTR_CREATE,
+    HERMES_OP_ATTR_OPEN,
+    HERMES_OP_ATTR_READ,
+    HERMES_OP_ATTR_WRITE,
+    HERMES_OP_ATTR_GET,
+    HERMES_OP_ATTR_SPECIFIC,
+    HERMES_OP_ATTR_CLOSE,
+    HERMES_OP_GROUP_CREATE,
+    HERMES_OP_GROUP_OPEN,
+    HERMES_OP_GROUP_GET,
+    HERMES_OP_GROUP_CLOSE,
+    HERMES_OP_FILE_CREATE,
+    HERMES_OP_FILE_OPEN,
+    HERMES_OP_FILE_SPECIFIC,
+    HERMES_OP_FILE_CLOSE,
+    HERMES_OP_LINK_CREATE,
+    HERMES_OP_LINK_COPY,
+    HERMES_OP_LINK_MOVE,
+    HERMES_OP_LINK_GET,
+    HERMES_OP_LINK_SPECIFIC,
+    HERMES_OP_OBJECT_OPEN,
+    HERMES_OP_OBJECT_COPY,
+    HERMES_OP_OBJECT_GET,
+    HERMES_OP_OBJECT_SPECIFIC,
+    HERMES_OP_FAPL_COPY,
+    HERMES_OP_FAPL_FREE,
+    HERMES_OP_REQUEST_CANCEL,
+    HERMES_OP_REQUEST_TEST,
+    HERMES_OP_REQUEST_WAIT,
+    HERMES_OP_BUFFER_INIT,
+    HERMES_OP_BUFFER_READ,
+    HERMES_OP_BUFFER_WRITE,
+    HERMES_OP_BUFFER_SYNC,
+    HERMES_OP_BUFFER_CLEAN,
+    HERMES_OP_META_FLUSH,           /* attribute cache written out */
+    HERMES_OP_CHECKPOINT,
+    HERMES_OP_COUNT
+} HermesStatOp;
+
+/**
+ * Where bytes were served from or written to. The buffer layer is one tier
+ * as far as the VOL can tell; LayerInfo placement happens inside it.
+ */
+typedef enum HermesStatTier {
+    HERMES_TIER_PREFETCH,
+    HERMES_TIER_RAM,
+    HERMES_TIER_DEMOTE,
+    HERMES_TIER_SHARED,
+    HERMES_TIER_BUFFER,
+    HERMES_TIER_COUNT
+} HermesStatTier;
+
+typedef enum HermesStatEvent {
+    HERMES_EVENT_PREFETCH_ISSUED,
+    HERMES_EVENT_PREFETCH_HIT,
+    HERMES_EVENT_PREFETCH_DROPPED,  /* finished after a write made it stale */
+    HERMES_EVENT_RAM_HIT,
+    HERMES_EVENT_DEMOTE_HIT,
+    HERMES_EVENT_EXTENT_MISS,
+    HERMES_EVENT_DEMOTION,
+    HERMES_EVENT_EVICTION,
+    HERMES_EVENT_FLUSH,             /* watermark or age triggered */
+    HERMES_EVENT_FLUSH_RUN,         /* a run of dirty slabs written out instead of a full sync */
+    HERMES_EVENT_ATTR_HIT,
+    HERMES_EVENT_ATTR_LOAD,
+    HERMES_EVENT_CHUNK_COMPLETE,    /* a staged chunk was filled by writes */
+    HERMES_EVENT_CHUNK_MERGE,       /* a staged chunk was completed from the buffer layer */
+    HERMES_EVENT_AGGREGATE_MERGE,   /* a small write joined a pending run */
+    HERMES_EVENT_AGGREGATE_FLUSH,   /* a pending run went down as one box */
+    HERMES_EVENT_SHARED_HIT,        /* read in place from the node's shared cache */
+    HERMES_EVENT_SHARED_FILL,       /* loaded into the shared cache by this process */
+    HERMES_EVENT_COUNT
+} HermesStatEvent;
+
+typedef struct HermesOpStats {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t histogram[HERMES_STATS_BUCKETS];
+} HermesOpStats;
+
+typedef struct HermesStats {
+    HermesOpStats ops[HERMES_OP_COUNT];
+    uint64_t bytes_read[HERMES_TIER_COUNT];
+    uint64_t bytes_written[HERMES_TIER_COUNT];
+    uint64_t events[HERMES_EVENT_COUNT];
+} HermesStats;
+
+uint64_t H5VL_hermes_stats_begin(void);
+void H5VL_hermes_stats_end(HermesStatOp op, uint64_t begin);
+void H5VL_hermes_stats_bytes(HermesStatTier tier, bool is_write, uint64_t bytes);
+void H5VL_hermes_stats_event(HermesStatEvent event);
+
+void H5VL_hermes_stats_enable(bool enabled);
+void H5VL_hermes_stats_get(HermesStats *stats);
+void H5VL_hermes_stats_reset(void);
+uint64_t H5VL_hermes_stats_percentile(const HermesOpStats *op, double fraction);
+void H5VL_hermes_stats_dump(FILE *out);
+#endif //HERMES_PROJECT_HERMES_VOL_STATS_H
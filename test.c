@@ -14,15 +14,741 @@
 /*
  *  This example illustrates how to create a dataset that is a 4 x 6
  *  array.  It is used in the HDF5 Tutorial.
+ *
+ *  It then writes and reads the same dataset through the native connector
+ *  and through the Hermes VOL with a strided hyperslab, a point selection
+ *  and a type-converting read, and checks that both give the same elements.
+ *  Last, it reads a working set twice the size of an LFU-managed RAM tier,
+ *  so that extents are evicted and read back, and checks it the same way.
+ *  The checks after that each turn on one feature of the VOL and compare
+ *  against the native connector again: asynchronous writes completed
+ *  through their request tokens, attributes held by the attribute cache
+ *  until the file is closed, extents compressed on demotion, with and
+ *  without the byte shuffle, pieces of chunks staged until their chunk is
+ *  complete or the file is flushed, small writes merged into runs, cached
+ *  extents following H5Dset_extent, a read-only file opened twice
+ *  through one shared read cache, slabs changed since the last flush
+ *  written back by H5Fhermes_vol_checkpoint and H5Fflush, and several
+ *  datasets written and read in one H5Dhermes_vol_write_multi and
+ *  H5Dhermes_vol_read_multi call.
  */
 
+#include <stdio.h>
+#include <string.h>
 #include "../include/hermes_vol.h"
+#include "hermes_vol_placement.h"
 #include "hdf5.h"
 #define FILE "dset.h5"
+#define NATIVE_FILE "dset-native.h5"
+#define ROWS 16
+#define COLS 12
+#define NPOINTS 7
+#define LFU_FILE "dset-lfu.h5"
+#define LFU_RAM_BYTES (32*1024)
+#define LFU_EXTENT_BYTES (8*1024)
+#define LFU_ROWS 256
+#define LFU_COLS 64
+#define ASYNC_FILE "dset-async.h5"
+#define ASYNC_WRITES 24
+#define ATTR_FILE "dset-attr.h5"
+#define ATTR_CACHED_BYTES 64
+#define ATTR_SMALL 4
+#define ATTR_LARGE 100
+#define CODED_FILE "dset-coded.h5"
+#define CODED_RAM_BYTES (16*1024)
+#define CODED_TIER_BYTES (1024*1024)
+#define CODED_ROWS 256
+#define CHUNK_FILE "dset-chunk.h5"
+#define CHUNK_STAGE_BYTES (64*1024)
+#define CHUNK_SIDE 32
+#define CHUNK_EDGE 8
+#define AGG_FILE "dset-agg.h5"
+#define AGG_FLUSH_BYTES 1024
+#define AGG_ROWS 64
+#define EXTEND_FILE "dset-extend.h5"
+#define EXTEND_RAM_BYTES (1024*1024)
+#define EXTEND_EXTENT_BYTES 1024
+#define EXTEND_ROWS 64
+#define EXTEND_MAX_ROWS 128
+#define SHARED_FILE "dset-shared.h5"
+#define SHARED_CACHE_BYTES (4*1024*1024)
+#define SHARED_ROWS 512
+#define CKPT_FILE "dset-ckpt.h5"
+#define MULTI_FILE "dset-multi.h5"
+#define MULTI_DSETS 3
+#define MULTI_CALLS 4
+
+static int failures=0;
+
+#define CHECK(cond) do{ if(!(cond)){ printf("FAILED %s:%d: %s\n",__FILE__,__LINE__,#cond); failures++; } }while(0)
+
+/* Writes the same pattern to the dataset of both files. */
+static void fill(hid_t native_id, hid_t hermes_id){
+    static int data[ROWS][COLS];
+    int i,j;
+    for(i=0;i<ROWS;i++) for(j=0;j<COLS;j++) data[i][j]=i*COLS+j;
+    CHECK(H5Dwrite(native_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,data)>=0);
+    CHECK(H5Dwrite(hermes_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,data)>=0);
+}
+/* Reads the whole dataset of both files and compares them. */
+static void compare_all(hid_t native_id, hid_t hermes_id){
+    static int expected[ROWS][COLS],actual[ROWS][COLS];
+    memset(actual,0xff,sizeof(actual));
+    CHECK(H5Dread(native_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,expected)>=0);
+    CHECK(H5Dread(hermes_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,actual)>=0);
+    CHECK(memcmp(expected,actual,sizeof(expected))==0);
+}
+/* Strided hyperslab of 2x1 blocks, written and read back into a larger memory buffer. */
+static void test_strided_hyperslab(hid_t native_id, hid_t hermes_id){
+    hsize_t start[2]={1,2},stride[2]={3,2},count[2]={5,5},block[2]={2,1};
+    hsize_t mem_dims[2]={ROWS,COLS},mem_start[2]={0,1},mem_count[2]={10,5},mem_stride[2]={1,2};
+    int in[ROWS][COLS],expected[ROWS][COLS],actual[ROWS][COLS],i,j;
+    hid_t file_space_id=H5Screate_simple(2,mem_dims,NULL);
+    hid_t mem_space_id=H5Screate_simple(2,mem_dims,NULL);
+    H5Sselect_hyperslab(file_space_id,H5S_SELECT_SET,start,stride,count,block);
+    H5Sselect_hyperslab(mem_space_id,H5S_SELECT_SET,mem_start,mem_stride,mem_count,NULL);
+    for(i=0;i<ROWS;i++) for(j=0;j<COLS;j++) in[i][j]=-(i*COLS+j);
+    CHECK(H5Dwrite(native_id,H5T_NATIVE_INT,mem_space_id,file_space_id,H5P_DEFAULT,in)>=0);
+    CHECK(H5Dwrite(hermes_id,H5T_NATIVE_INT,mem_space_id,file_space_id,H5P_DEFAULT,in)>=0);
+    compare_all(native_id,hermes_id);
+    memset(expected,0,sizeof(expected));
+    memset(actual,0,sizeof(actual));
+    CHECK(H5Dread(native_id,H5T_NATIVE_INT,mem_space_id,file_space_id,H5P_DEFAULT,expected)>=0);
+    CHECK(H5Dread(hermes_id,H5T_NATIVE_INT,mem_space_id,file_space_id,H5P_DEFAULT,actual)>=0);
+    CHECK(memcmp(expected,actual,sizeof(expected))==0);
+    H5Sclose(mem_space_id);
+    H5Sclose(file_space_id);
+}
+/* Points in no particular order, written and read through a 1-D memory space. */
+static void test_points(hid_t native_id, hid_t hermes_id){
+    hsize_t dims[2]={ROWS,COLS},mem_dims[1]={NPOINTS};
+    hsize_t coords[NPOINTS][2]={{15,11},{0,0},{7,3},{7,4},{2,9},{11,0},{0,11}};
+    int in[NPOINTS]={101,102,103,104,105,106,107},expected[NPOINTS],actual[NPOINTS];
+    hid_t file_space_id=H5Screate_simple(2,dims,NULL);
+    hid_t mem_space_id=H5Screate_simple(1,mem_dims,NULL);
+    H5Sselect_elements(file_space_id,H5S_SELECT_SET,NPOINTS,&coords[0][0]);
+    CHECK(H5Dwrite(native_id,H5T_NATIVE_INT,mem_space_id,file_space_id,H5P_DEFAULT,in)>=0);
+    CHECK(H5Dwrite(hermes_id,H5T_NATIVE_INT,mem_space_id,file_space_id,H5P_DEFAULT,in)>=0);
+    compare_all(native_id,hermes_id);
+    memset(actual,0,sizeof(actual));
+    CHECK(H5Dread(native_id,H5T_NATIVE_INT,mem_space_id,file_space_id,H5P_DEFAULT,expected)>=0);
+    CHECK(H5Dread(hermes_id,H5T_NATIVE_INT,mem_space_id,file_space_id,H5P_DEFAULT,actual)>=0);
+    CHECK(memcmp(expected,actual,sizeof(expected))==0);
+    CHECK(memcmp(in,actual,sizeof(in))==0);
+    H5Sclose(mem_space_id);
+    H5Sclose(file_space_id);
+}
+/* Big-endian file elements read as native doubles and as native shorts. */
+static void test_conversion(hid_t native_id, hid_t hermes_id){
+    static double expected[ROWS][COLS],actual[ROWS][COLS];
+    static short expected_short[ROWS][COLS],actual_short[ROWS][COLS];
+    memset(actual,0,sizeof(actual));
+    memset(actual_short,0,sizeof(actual_short));
+    CHECK(H5Dread(native_id,H5T_NATIVE_DOUBLE,H5S_ALL,H5S_ALL,H5P_DEFAULT,expected)>=0);
+    CHECK(H5Dread(hermes_id,H5T_NATIVE_DOUBLE,H5S_ALL,H5S_ALL,H5P_DEFAULT,actual)>=0);
+    CHECK(memcmp(expected,actual,sizeof(expected))==0);
+    CHECK(H5Dread(native_id,H5T_NATIVE_SHORT,H5S_ALL,H5S_ALL,H5P_DEFAULT,expected_short)>=0);
+    CHECK(H5Dread(hermes_id,H5T_NATIVE_SHORT,H5S_ALL,H5S_ALL,H5P_DEFAULT,actual_short)>=0);
+    CHECK(memcmp(expected_short,actual_short,sizeof(expected_short))==0);
+}
+/*
+ * A dataset twice the RAM tier, read in passes that favour some row blocks,
+ * so that the LFU policy keeps the hot ones and evicts the rest.
+ */
+static void test_lfu_working_set(hid_t native_file_id){
+    static int data[LFU_ROWS][LFU_COLS],expected[LFU_ROWS][LFU_COLS],actual[LFU_ROWS][LFU_COLS];
+    hsize_t dims[2]={LFU_ROWS,LFU_COLS},start[2]={0,0},count[2]={16,LFU_COLS};
+    hid_t fapl=H5Pcreate(H5P_FILE_ACCESS),file_id,space_id,mem_space_id,native_id,hermes_id;
+    int i,j,pass;
+    H5Pset_fapl_hermes_vol(fapl);
+    CHECK(H5Pset_hermes_vol_placement(fapl,HERMES_PLACEMENT_LFU,LFU_RAM_BYTES,LFU_EXTENT_BYTES,NULL,0)>=0);
+    file_id=H5Fcreate(LFU_FILE,H5F_ACC_TRUNC,H5P_DEFAULT,fapl);
+    space_id=H5Screate_simple(2,dims,NULL);
+    mem_space_id=H5Screate_simple(2,count,NULL);
+    native_id=H5Dcreate2(native_file_id,"/lfu",H5T_NATIVE_INT,space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    hermes_id=H5Dcreate2(file_id,"/lfu",H5T_NATIVE_INT,space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    CHECK(file_id>=0 && native_id>=0 && hermes_id>=0);
+    for(i=0;i<LFU_ROWS;i++) for(j=0;j<LFU_COLS;j++) data[i][j]=i*LFU_COLS+j+1;
+    CHECK(H5Dwrite(native_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,data)>=0);
+    CHECK(H5Dwrite(hermes_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,data)>=0);
+    for(pass=0;pass<8;pass++){
+        /* Every block once, and the first quarter of them four more times. */
+        for(i=0;i<LFU_ROWS/16*2;i++){
+            start[0]=(hsize_t)(i<LFU_ROWS/16?i:(i*7)%(LFU_ROWS/64))*16;
+            H5Sselect_hyperslab(space_id,H5S_SELECT_SET,start,NULL,count,NULL);
+            CHECK(H5Dread(native_id,H5T_NATIVE_INT,mem_space_id,space_id,H5P_DEFAULT,expected[start[0]])>=0);
+            CHECK(H5Dread(hermes_id,H5T_NATIVE_INT,mem_space_id,space_id,H5P_DEFAULT,actual[start[0]])>=0);
+            CHECK(memcmp(expected[start[0]],actual[start[0]],sizeof(int)*16*LFU_COLS)==0);
+        }
+        /* A write in between, so that evicted extents must come back with it. */
+        start[0]=(hsize_t)(pass*37%(LFU_ROWS/16))*16;
+        H5Sselect_hyperslab(space_id,H5S_SELECT_SET,start,NULL,count,NULL);
+        for(i=0;i<16;i++) for(j=0;j<LFU_COLS;j++) data[start[0]+i][j]=-(pass*100000+i*LFU_COLS+j);
+        CHECK(H5Dwrite(native_id,H5T_NATIVE_INT,mem_space_id,space_id,H5P_DEFAULT,data[start[0]])>=0);
+        CHECK(H5Dwrite(hermes_id,H5T_NATIVE_INT,mem_space_id,space_id,H5P_DEFAULT,data[start[0]])>=0);
+    }
+    CHECK(H5Dread(hermes_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,actual)>=0);
+    CHECK(memcmp(data,actual,sizeof(data))==0);
+    H5Dclose(hermes_id);
+    H5Dclose(native_id);
+    H5Sclose(mem_space_id);
+    H5Sclose(space_id);
+    H5Fclose(file_id);
+    H5Pclose(fapl);
+}
+/*
+ * Rows written asynchronously, each through its own request token. A third
+ * of the tokens are cancelled, a third waited on and a third polled; a
+ * cancelled write must not land, so the native dataset gets only the rows
+ * whose write succeeded.
+ */
+static void test_async_requests(hid_t native_file_id){
+    static int data[ASYNC_WRITES][COLS],expected[ASYNC_WRITES][COLS],actual[ASYNC_WRITES][COLS];
+    hsize_t dims[2]={ASYNC_WRITES,COLS},start[2]={0,0},count[2]={1,COLS};
+    hid_t fapl=H5Pcreate(H5P_FILE_ACCESS),vol_id,file_id,space_id,mem_space_id,native_id,hermes_id;
+    void *requests[ASYNC_WRITES],*request=NULL;
+    H5ES_status_t status;
+    int landed[ASYNC_WRITES],i,j;
+    vol_id=H5Pset_fapl_hermes_vol(fapl);
+    CHECK(H5Pset_hermes_vol_async(fapl,true,2)>=0);
+    file_id=H5Fcreate(ASYNC_FILE,H5F_ACC_TRUNC,H5P_DEFAULT,fapl);
+    space_id=H5Screate_simple(2,dims,NULL);
+    mem_space_id=H5Screate_simple(2,count,NULL);
+    native_id=H5Dcreate2(native_file_id,"/async",H5T_NATIVE_INT,space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    hermes_id=H5Dcreate2(file_id,"/async",H5T_NATIVE_INT,space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    CHECK(file_id>=0 && native_id>=0 && hermes_id>=0);
+    memset(data,0,sizeof(data));
+    CHECK(H5Dwrite(native_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,data)>=0);
+    CHECK(H5Dwrite(hermes_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,data)>=0);
+    for(i=0;i<ASYNC_WRITES;i++){
+        for(j=0;j<COLS;j++) data[i][j]=i*COLS+j+1;
+        start[0]=(hsize_t)i;
+        H5Sselect_hyperslab(space_id,H5S_SELECT_SET,start,NULL,count,NULL);
+        requests[i]=NULL;
+        CHECK(H5VLdataset_write(H5VLobject(hermes_id),vol_id,H5T_NATIVE_INT,mem_space_id,space_id,H5P_DEFAULT,
+                                data[i],&requests[i])>=0);
+        CHECK(requests[i]!=NULL);
+    }
+    /* The user buffer was copied; changing it must not change what is written. */
+    memset(data,0xff,sizeof(data));
+    /* Cancel first, while later writes may still be queued. A token reporting a final status is gone. */
+    for(i=2;i<ASYNC_WRITES;i+=3){
+        CHECK(H5VLrequest_cancel(&requests[i],vol_id,&status)>=0);
+        if(status==H5ES_STATUS_IN_PROGRESS) CHECK(H5VLrequest_wait(&requests[i],vol_id,&status)>=0);
+        CHECK(status==H5ES_STATUS_CANCEL || status==H5ES_STATUS_SUCCEED);
+        landed[i]=status==H5ES_STATUS_SUCCEED;
+    }
+    for(i=0;i<ASYNC_WRITES;i++){
+        if(i%3==0){
+            CHECK(H5VLrequest_wait(&requests[i],vol_id,&status)>=0);
+            landed[i]=status==H5ES_STATUS_SUCCEED;
+        }else if(i%3==1){
+            status=H5ES_STATUS_IN_PROGRESS;
+            while(status==H5ES_STATUS_IN_PROGRESS) CHECK(H5VLrequest_test(&requests[i],vol_id,&status)>=0);
+            landed[i]=status==H5ES_STATUS_SUCCEED;
+        }
+        CHECK(landed[i] || i%3==2);
+        if(!landed[i]) continue;
+        for(j=0;j<COLS;j++) data[i][j]=i*COLS+j+1;
+        start[0]=(hsize_t)i;
+        H5Sselect_hyperslab(space_id,H5S_SELECT_SET,start,NULL,count,NULL);
+        CHECK(H5Dwrite(native_id,H5T_NATIVE_INT,mem_space_id,space_id,H5P_DEFAULT,data[i])>=0);
+    }
+    /* Reads finish on the caller and hand back a completed token. */
+    memset(actual,0,sizeof(actual));
+    CHECK(H5Dread(native_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,expected)>=0);
+    CHECK(H5VLdataset_read(H5VLobject(hermes_id),vol_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,actual,
+                           &request)>=0);
+    CHECK(request!=NULL && H5VLrequest_test(&request,vol_id,&status)>=0 && status==H5ES_STATUS_SUCCEED);
+    CHECK(memcmp(expected,actual,sizeof(expected))==0);
+    H5Dclose(hermes_id);
+    H5Dclose(native_id);
+    H5Sclose(mem_space_id);
+    H5Sclose(space_id);
+    H5Fclose(file_id);
+    H5Pclose(fapl);
+}
+/* Creates and writes an attribute of ints. */
+static void write_attr(hid_t object_id, const char *name, hsize_t n, const int *data){
+    hid_t space_id=H5Screate_simple(1,&n,NULL);
+    hid_t attr_id=H5Acreate2(object_id,name,H5T_NATIVE_INT,space_id,H5P_DEFAULT,H5P_DEFAULT);
+    CHECK(attr_id>=0);
+    CHECK(H5Awrite(attr_id,H5T_NATIVE_INT,data)>=0);
+    H5Aclose(attr_id);
+    H5Sclose(space_id);
+}
+/* Reads an attribute of n ints of both objects and compares them. */
+static void compare_attr(hid_t native_id, hid_t hermes_id, const char *name, hsize_t n){
+    int expected[ATTR_LARGE],actual[ATTR_LARGE];
+    hid_t native_attr_id=H5Aopen(native_id,name,H5P_DEFAULT),hermes_attr_id=H5Aopen(hermes_id,name,H5P_DEFAULT);
+    CHECK(native_attr_id>=0 && hermes_attr_id>=0);
+    memset(expected,0,sizeof(expected));
+    memset(actual,0xff,sizeof(actual));
+    CHECK(H5Aread(native_attr_id,H5T_NATIVE_INT,expected)>=0);
+    CHECK(H5Aread(hermes_attr_id,H5T_NATIVE_INT,actual)>=0);
+    CHECK(memcmp(expected,actual,sizeof(int)*n)==0);
+    H5Aclose(hermes_attr_id);
+    H5Aclose(native_attr_id);
+}
+/*
+ * Attributes small enough for the attribute cache are created, rewritten
+ * and read back in memory, and reach the file when it is closed; a larger
+ * one goes straight to the file. The file is then reopened with the native
+ * connector and its attributes compared again.
+ */
+static void test_attribute_cache(hid_t native_file_id){
+    int small[ATTR_SMALL],large[ATTR_LARGE],version=3,i;
+    hsize_t dims[2]={ROWS,COLS};
+    hid_t fapl=H5Pcreate(H5P_FILE_ACCESS),file_id,space_id,attr_id,native_id,hermes_id;
+    H5Pset_fapl_hermes_vol(fapl);
+    CHECK(H5Pset_hermes_vol_metadata(fapl,ATTR_CACHED_BYTES,0)>=0);
+    file_id=H5Fcreate(ATTR_FILE,H5F_ACC_TRUNC,H5P_DEFAULT,fapl);
+    space_id=H5Screate_simple(2,dims,NULL);
+    native_id=H5Dcreate2(native_file_id,"/attrs",H5T_NATIVE_INT,space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    hermes_id=H5Dcreate2(file_id,"/attrs",H5T_NATIVE_INT,space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    CHECK(file_id>=0 && native_id>=0 && hermes_id>=0);
+    for(i=0;i<ATTR_SMALL;i++) small[i]=i*7;
+    for(i=0;i<ATTR_LARGE;i++) large[i]=-i;
+    write_attr(native_id,"small",ATTR_SMALL,small);
+    write_attr(hermes_id,"small",ATTR_SMALL,small);
+    write_attr(native_id,"large",ATTR_LARGE,large);
+    write_attr(hermes_id,"large",ATTR_LARGE,large);
+    write_attr(native_file_id,"version",1,&version);
+    write_attr(file_id,"version",1,&version);
+    compare_attr(native_id,hermes_id,"small",ATTR_SMALL);
+    /* Rewritten through an opened attribute; the cache must keep the last value. */
+    for(i=0;i<ATTR_SMALL;i++) small[i]=100-i;
+    attr_id=H5Aopen(native_id,"small",H5P_DEFAULT);
+    CHECK(H5Awrite(attr_id,H5T_NATIVE_INT,small)>=0);
+    H5Aclose(attr_id);
+    attr_id=H5Aopen(hermes_id,"small",H5P_DEFAULT);
+    CHECK(H5Awrite(attr_id,H5T_NATIVE_INT,small)>=0);
+    H5Aclose(attr_id);
+    compare_attr(native_id,hermes_id,"small",ATTR_SMALL);
+    compare_attr(native_id,hermes_id,"large",ATTR_LARGE);
+    compare_attr(native_file_id,file_id,"version",1);
+    H5Dclose(hermes_id);
+    H5Fclose(file_id);
+    /* Closing the file wrote the cache out. */
+    file_id=H5Fopen(ATTR_FILE,H5F_ACC_RDONLY,H5P_DEFAULT);
+    hermes_id=H5Dopen2(file_id,"/attrs",H5P_DEFAULT);
+    CHECK(file_id>=0 && hermes_id>=0);
+    compare_attr(native_id,hermes_id,"small",ATTR_SMALL);
+    compare_attr(native_id,hermes_id,"large",ATTR_LARGE);
+    compare_attr(native_file_id,file_id,"version",1);
+    H5Dclose(hermes_id);
+    H5Dclose(native_id);
+    H5Sclose(space_id);
+    H5Fclose(file_id);
+    H5Pclose(fapl);
+}
+/*
+ * A working set four times the RAM tier, whose demotion tier is coded with
+ * and without the byte shuffle: extents pushed out are compressed on their
+ * way down and decoded when read back or written over.
+ */
+static void test_compressed_demotion(hid_t native_file_id){
+    static float data[CODED_ROWS][LFU_COLS],expected[CODED_ROWS][LFU_COLS],actual[CODED_ROWS][LFU_COLS];
+    hsize_t dims[2]={CODED_ROWS,LFU_COLS},start[2]={0,0},count[2]={16,LFU_COLS};
+    hid_t fapl,file_id,space_id,mem_space_id,native_id,hermes_id;
+    int shuffle,pass,i,j;
+    for(shuffle=0;shuffle<2;shuffle++){
+        fapl=H5Pcreate(H5P_FILE_ACCESS);
+        H5Pset_fapl_hermes_vol(fapl);
+        CHECK(H5Pset_hermes_vol_placement(fapl,HERMES_PLACEMENT_LRU,CODED_RAM_BYTES,LFU_EXTENT_BYTES,".",
+                                          CODED_TIER_BYTES)>=0);
+        CHECK(H5Pset_hermes_vol_compression(fapl,shuffle)>=0);
+        file_id=H5Fcreate(CODED_FILE,H5F_ACC_TRUNC,H5P_DEFAULT,fapl);
+        space_id=H5Screate_simple(2,dims,NULL);
+        mem_space_id=H5Screate_simple(2,count,NULL);
+        native_id=H5Dcreate2(native_file_id,shuffle?"/coded_shuffle":"/coded",H5T_NATIVE_FLOAT,space_id,
+                             H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+        hermes_id=H5Dcreate2(file_id,"/coded",H5T_NATIVE_FLOAT,space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+        CHECK(file_id>=0 && native_id>=0 && hermes_id>=0);
+        /* Smooth values, which the shuffle turns into long runs of equal bytes. */
+        for(i=0;i<CODED_ROWS;i++) for(j=0;j<LFU_COLS;j++) data[i][j]=(float)(i*LFU_COLS+j)*0.25f;
+        CHECK(H5Dwrite(native_id,H5T_NATIVE_FLOAT,H5S_ALL,H5S_ALL,H5P_DEFAULT,data)>=0);
+        CHECK(H5Dwrite(hermes_id,H5T_NATIVE_FLOAT,H5S_ALL,H5S_ALL,H5P_DEFAULT,data)>=0);
+        for(pass=0;pass<3;pass++){
+            for(i=0;i<CODED_ROWS/16;i++){
+                start[0]=(hsize_t)i*16;
+                H5Sselect_hyperslab(space_id,H5S_SELECT_SET,start,NULL,count,NULL);
+                CHECK(H5Dread(native_id,H5T_NATIVE_FLOAT,mem_space_id,space_id,H5P_DEFAULT,expected[start[0]])>=0);
+                CHECK(H5Dread(hermes_id,H5T_NATIVE_FLOAT,mem_space_id,space_id,H5P_DEFAULT,actual[start[0]])>=0);
+                CHECK(memcmp(expected[start[0]],actual[start[0]],sizeof(float)*16*LFU_COLS)==0);
+            }
+            /* Over a block that was demoted by the pass. */
+            start[0]=(hsize_t)(pass*5%(CODED_ROWS/16))*16;
+            H5Sselect_hyperslab(space_id,H5S_SELECT_SET,start,NULL,count,NULL);
+            for(i=0;i<16;i++) for(j=0;j<LFU_COLS;j++) data[start[0]+i][j]=-(float)(pass*1000+i*LFU_COLS+j);
+            CHECK(H5Dwrite(native_id,H5T_NATIVE_FLOAT,mem_space_id,space_id,H5P_DEFAULT,data[start[0]])>=0);
+            CHECK(H5Dwrite(hermes_id,H5T_NATIVE_FLOAT,mem_space_id,space_id,H5P_DEFAULT,data[start[0]])>=0);
+        }
+        CHECK(H5Dread(native_id,H5T_NATIVE_FLOAT,H5S_ALL,H5S_ALL,H5P_DEFAULT,expected)>=0);
+        CHECK(H5Dread(hermes_id,H5T_NATIVE_FLOAT,H5S_ALL,H5S_ALL,H5P_DEFAULT,actual)>=0);
+        CHECK(memcmp(expected,actual,sizeof(expected))==0);
+        H5Dclose(hermes_id);
+        H5Dclose(native_id);
+        H5Sclose(mem_space_id);
+        H5Sclose(space_id);
+        H5Fclose(file_id);
+        H5Pclose(fapl);
+    }
+}
+/* Writes the same selection of the same pattern to both datasets. */
+static void write_chunk_pieces(hid_t native_id, hid_t hermes_id, hsize_t *start, hsize_t *stride, hsize_t *count,
+                               hsize_t *block, int salt){
+    static int data[CHUNK_SIDE][CHUNK_SIDE];
+    hsize_t dims[2]={CHUNK_SIDE,CHUNK_SIDE};
+    hid_t space_id=H5Screate_simple(2,dims,NULL);
+    int i,j;
+    for(i=0;i<CHUNK_SIDE;i++) for(j=0;j<CHUNK_SIDE;j++) data[i][j]=salt*10000+i*CHUNK_SIDE+j;
+    H5Sselect_hyperslab(space_id,H5S_SELECT_SET,start,stride,count,block);
+    CHECK(H5Dwrite(native_id,H5T_NATIVE_INT,space_id,space_id,H5P_DEFAULT,data)>=0);
+    CHECK(H5Dwrite(hermes_id,H5T_NATIVE_INT,space_id,space_id,H5P_DEFAULT,data)>=0);
+    H5Sclose(space_id);
+}
+/* Reads the whole of both datasets and compares them. */
+static void compare_chunked(hid_t native_id, hid_t hermes_id){
+    static int expected[CHUNK_SIDE][CHUNK_SIDE],actual[CHUNK_SIDE][CHUNK_SIDE];
+    memset(actual,0xff,sizeof(actual));
+    CHECK(H5Dread(native_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,expected)>=0);
+    CHECK(H5Dread(hermes_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,actual)>=0);
+    CHECK(memcmp(expected,actual,sizeof(expected))==0);
+}
+/*
+ * A chunked dataset written a half chunk at a time: the left halves wait in
+ * the stage until they are read, the right halves complete their chunks,
+ * and a piece of one chunk written last goes down when the file is flushed. The file is
+ * then reopened with the native connector and compared again.
+ */
+static void test_chunk_staging(hid_t native_file_id){
+    hsize_t dims[2]={CHUNK_SIDE,CHUNK_SIDE},chunk[2]={CHUNK_EDGE,CHUNK_EDGE};
+    hsize_t start[2]={0,0},stride[2]={CHUNK_EDGE,CHUNK_EDGE},count[2]={CHUNK_SIDE/CHUNK_EDGE,CHUNK_SIDE/CHUNK_EDGE};
+    hsize_t half[2]={CHUNK_EDGE,CHUNK_EDGE/2},corner[2]={3,3},one[2]={1,1};
+    hid_t fapl=H5Pcreate(H5P_FILE_ACCESS),dcpl=H5Pcreate(H5P_DATASET_CREATE),file_id,space_id,native_id,hermes_id;
+    H5Pset_fapl_hermes_vol(fapl);
+    CHECK(H5Pset_hermes_vol_chunk_staging(fapl,CHUNK_STAGE_BYTES)>=0);
+    H5Pset_chunk(dcpl,2,chunk);
+    file_id=H5Fcreate(CHUNK_FILE,H5F_ACC_TRUNC,H5P_DEFAULT,fapl);
+    space_id=H5Screate_simple(2,dims,NULL);
+    native_id=H5Dcreate2(native_file_id,"/chunked",H5T_NATIVE_INT,space_id,H5P_DEFAULT,dcpl,H5P_DEFAULT);
+    hermes_id=H5Dcreate2(file_id,"/chunked",H5T_NATIVE_INT,space_id,H5P_DEFAULT,dcpl,H5P_DEFAULT);
+    CHECK(file_id>=0 && native_id>=0 && hermes_id>=0);
+    write_chunk_pieces(native_id,hermes_id,start,stride,count,half,1);
+    compare_chunked(native_id,hermes_id);
+    start[1]=CHUNK_EDGE/2;
+    write_chunk_pieces(native_id,hermes_id,start,stride,count,half,2);
+    compare_chunked(native_id,hermes_id);
+    /* Still staged when the file is flushed. */
+    start[0]=CHUNK_SIDE-CHUNK_EDGE+1;
+    start[1]=CHUNK_SIDE-CHUNK_EDGE+2;
+    write_chunk_pieces(native_id,hermes_id,start,NULL,one,corner,3);
+    CHECK(H5Fflush(file_id,H5F_SCOPE_LOCAL)>=0);
+    compare_chunked(native_id,hermes_id);
+    H5Dclose(hermes_id);
+    H5Fclose(file_id);
+    file_id=H5Fopen(CHUNK_FILE,H5F_ACC_RDONLY,H5P_DEFAULT);
+    hermes_id=H5Dopen2(file_id,"/chunked",H5P_DEFAULT);
+    CHECK(file_id>=0 && hermes_id>=0);
+    compare_chunked(native_id,hermes_id);
+    H5Dclose(hermes_id);
+    H5Dclose(native_id);
+    H5Sclose(space_id);
+    H5Fclose(file_id);
+    H5Pclose(dcpl);
+    H5Pclose(fapl);
+}
+/* Writes the same box of the same values to both datasets. */
+static void write_box(hid_t native_id, hid_t hermes_id, hsize_t row, hsize_t col, hsize_t rows, hsize_t cols,
+                      int value){
+    static int data[AGG_ROWS*COLS];
+    hsize_t dims[2]={AGG_ROWS,COLS},start[2],count[2],mem_dims[1];
+    hid_t space_id=H5Screate_simple(2,dims,NULL),mem_space_id;
+    hsize_t i;
+    start[0]=row;
+    start[1]=col;
+    count[0]=rows;
+    count[1]=cols;
+    mem_dims[0]=rows*cols;
+    mem_space_id=H5Screate_simple(1,mem_dims,NULL);
+    for(i=0;i<rows*cols;i++) data[i]=value+(int)i;
+    H5Sselect_hyperslab(space_id,H5S_SELECT_SET,start,NULL,count,NULL);
+    CHECK(H5Dwrite(native_id,H5T_NATIVE_INT,mem_space_id,space_id,H5P_DEFAULT,data)>=0);
+    CHECK(H5Dwrite(hermes_id,H5T_NATIVE_INT,mem_space_id,space_id,H5P_DEFAULT,data)>=0);
+    H5Sclose(mem_space_id);
+    H5Sclose(space_id);
+}
+/* Reads the whole of both datasets and compares them. */
+static void compare_aggregated(hid_t native_id, hid_t hermes_id){
+    static int expected[AGG_ROWS][COLS],actual[AGG_ROWS][COLS];
+    memset(actual,0xff,sizeof(actual));
+    CHECK(H5Dread(native_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,expected)>=0);
+    CHECK(H5Dread(hermes_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,actual)>=0);
+    CHECK(memcmp(expected,actual,sizeof(expected))==0);
+}
+/*
+ * Rows appended one at a time join into runs that go down once they hold
+ * AGG_FLUSH_BYTES. Writes over a held run that cannot join it, small or
+ * large, send the run down before them. The file is then reopened with the
+ * native connector and compared again.
+ */
+static void test_write_aggregation(hid_t native_file_id){
+    hsize_t dims[2]={AGG_ROWS,COLS},row;
+    hid_t fapl=H5Pcreate(H5P_FILE_ACCESS),file_id,space_id,native_id,hermes_id;
+    H5Pset_fapl_hermes_vol(fapl);
+    CHECK(H5Pset_hermes_vol_write_aggregation(fapl,true,AGG_FLUSH_BYTES)>=0);
+    file_id=H5Fcreate(AGG_FILE,H5F_ACC_TRUNC,H5P_DEFAULT,fapl);
+    space_id=H5Screate_simple(2,dims,NULL);
+    native_id=H5Dcreate2(native_file_id,"/aggregated",H5T_NATIVE_INT,space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    hermes_id=H5Dcreate2(file_id,"/aggregated",H5T_NATIVE_INT,space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    CHECK(file_id>=0 && native_id>=0 && hermes_id>=0);
+    write_box(native_id,hermes_id,0,0,AGG_ROWS,COLS,0);
+    for(row=0;row<AGG_ROWS/2;row++) write_box(native_id,hermes_id,row,0,1,COLS,(int)row*1000);
+    compare_aggregated(native_id,hermes_id);
+    for(row=AGG_ROWS/2;row<AGG_ROWS/2+8;row++) write_box(native_id,hermes_id,row,0,1,COLS,(int)row*1000);
+    /* A small column strip over the held rows. */
+    write_box(native_id,hermes_id,AGG_ROWS/2+2,3,4,2,-1000);
+    for(row=AGG_ROWS/2+8;row<AGG_ROWS/2+12;row++) write_box(native_id,hermes_id,row,0,1,COLS,(int)row*1000);
+    /* A block larger than a run, over the held rows and past them. */
+    write_box(native_id,hermes_id,AGG_ROWS/2+6,0,AGG_ROWS/2-6,COLS,-2000);
+    compare_aggregated(native_id,hermes_id);
+    for(row=4;row<12;row++) write_box(native_id,hermes_id,row,0,1,COLS,(int)row*-3000);
+    CHECK(H5Fflush(file_id,H5F_SCOPE_LOCAL)>=0);
+    H5Dclose(hermes_id);
+    H5Fclose(file_id);
+    file_id=H5Fopen(AGG_FILE,H5F_ACC_RDONLY,H5P_DEFAULT);
+    hermes_id=H5Dopen2(file_id,"/aggregated",H5P_DEFAULT);
+    CHECK(file_id>=0 && hermes_id>=0);
+    compare_aggregated(native_id,hermes_id);
+    H5Dclose(hermes_id);
+    H5Dclose(native_id);
+    H5Sclose(space_id);
+    H5Fclose(file_id);
+    H5Pclose(fapl);
+}
+/* Reads the first rows of both datasets and compares them. */
+static void compare_extended(hid_t native_id, hid_t hermes_id, hsize_t rows){
+    static int expected[EXTEND_MAX_ROWS][COLS],actual[EXTEND_MAX_ROWS][COLS];
+    memset(expected,0,sizeof(expected));
+    memset(actual,0xff,sizeof(actual));
+    CHECK(H5Dread(native_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,expected)>=0);
+    CHECK(H5Dread(hermes_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,actual)>=0);
+    CHECK(memcmp(expected,actual,sizeof(int)*rows*COLS)==0);
+}
+/* Resizes both datasets. */
+static void set_extent(hid_t native_id, hid_t hermes_id, hsize_t rows){
+    hsize_t dims[2]={rows,COLS};
+    CHECK(H5Dset_extent(native_id,dims)>=0);
+    CHECK(H5Dset_extent(hermes_id,dims)>=0);
+}
+/*
+ * An extendible dataset whose extents sit in the RAM tier, grown with new
+ * rows written past the old end, shrunk, and grown again: the rows dropped
+ * by shrinking must read back as fill values, not as what was cached.
+ */
+static void test_set_extent(hid_t native_file_id){
+    static int data[EXTEND_MAX_ROWS][COLS];
+    hsize_t dims[2]={EXTEND_ROWS,COLS},max_dims[2]={H5S_UNLIMITED,COLS},chunk[2]={16,COLS};
+    hsize_t start[2]={EXTEND_ROWS,0},count[2]={EXTEND_MAX_ROWS-EXTEND_ROWS,COLS};
+    hid_t fapl=H5Pcreate(H5P_FILE_ACCESS),dcpl=H5Pcreate(H5P_DATASET_CREATE),file_id,space_id,mem_space_id;
+    hid_t native_id,hermes_id;
+    int i,j;
+    H5Pset_fapl_hermes_vol(fapl);
+    CHECK(H5Pset_hermes_vol_placement(fapl,HERMES_PLACEMENT_LRU,EXTEND_RAM_BYTES,EXTEND_EXTENT_BYTES,NULL,0)>=0);
+    H5Pset_chunk(dcpl,2,chunk);
+    file_id=H5Fcreate(EXTEND_FILE,H5F_ACC_TRUNC,H5P_DEFAULT,fapl);
+    space_id=H5Screate_simple(2,dims,max_dims);
+    native_id=H5Dcreate2(native_file_id,"/extended",H5T_NATIVE_INT,space_id,H5P_DEFAULT,dcpl,H5P_DEFAULT);
+    hermes_id=H5Dcreate2(file_id,"/extended",H5T_NATIVE_INT,space_id,H5P_DEFAULT,dcpl,H5P_DEFAULT);
+    CHECK(file_id>=0 && native_id>=0 && hermes_id>=0);
+    H5Sclose(space_id);
+    for(i=0;i<EXTEND_MAX_ROWS;i++) for(j=0;j<COLS;j++) data[i][j]=i*COLS+j+1;
+    CHECK(H5Dwrite(native_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,data)>=0);
+    CHECK(H5Dwrite(hermes_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,data)>=0);
+    compare_extended(native_id,hermes_id,EXTEND_ROWS);
+    set_extent(native_id,hermes_id,EXTEND_MAX_ROWS);
+    space_id=H5Dget_space(hermes_id);
+    mem_space_id=H5Screate_simple(2,count,NULL);
+    H5Sselect_hyperslab(space_id,H5S_SELECT_SET,start,NULL,count,NULL);
+    CHECK(H5Dwrite(native_id,H5T_NATIVE_INT,mem_space_id,space_id,H5P_DEFAULT,data[EXTEND_ROWS])>=0);
+    CHECK(H5Dwrite(hermes_id,H5T_NATIVE_INT,mem_space_id,space_id,H5P_DEFAULT,data[EXTEND_ROWS])>=0);
+    compare_extended(native_id,hermes_id,EXTEND_MAX_ROWS);
+    set_extent(native_id,hermes_id,EXTEND_ROWS-24);
+    compare_extended(native_id,hermes_id,EXTEND_ROWS-24);
+    set_extent(native_id,hermes_id,EXTEND_ROWS+32);
+    compare_extended(native_id,hermes_id,EXTEND_ROWS+32);
+    H5Sclose(mem_space_id);
+    H5Sclose(space_id);
+    H5Dclose(hermes_id);
+    H5Dclose(native_id);
+    H5Fclose(file_id);
+    H5Pclose(dcpl);
+    H5Pclose(fapl);
+}
+/*
+ * A file opened read-only twice with a shared read cache: the first open
+ * loads the extents it reads into the segment and the second copies them
+ * from there, whole and through a strided selection.
+ */
+static void test_shared_cache(hid_t native_file_id){
+    static int data[SHARED_ROWS][LFU_COLS],expected[SHARED_ROWS][LFU_COLS],actual[SHARED_ROWS][LFU_COLS];
+    hsize_t dims[2]={SHARED_ROWS,LFU_COLS},start[2]={3,5},stride[2]={7,3},count[2]={SHARED_ROWS/8,LFU_COLS/4};
+    hid_t fapl=H5Pcreate(H5P_FILE_ACCESS),file_id,first_file_id,second_file_id,space_id,native_id,first_id,second_id;
+    int i,j;
+    for(i=0;i<SHARED_ROWS;i++) for(j=0;j<LFU_COLS;j++) data[i][j]=i*LFU_COLS+j+7;
+    space_id=H5Screate_simple(2,dims,NULL);
+    file_id=H5Fcreate(SHARED_FILE,H5F_ACC_TRUNC,H5P_DEFAULT,H5P_DEFAULT);
+    first_id=H5Dcreate2(file_id,"/shared",H5T_NATIVE_INT,space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    native_id=H5Dcreate2(native_file_id,"/shared",H5T_NATIVE_INT,space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    CHECK(file_id>=0 && first_id>=0 && native_id>=0);
+    CHECK(H5Dwrite(first_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,data)>=0);
+    CHECK(H5Dwrite(native_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,data)>=0);
+    H5Dclose(first_id);
+    H5Fclose(file_id);
+    H5Pset_fapl_hermes_vol(fapl);
+    CHECK(H5Pset_hermes_vol_shared_cache(fapl,SHARED_CACHE_BYTES)>=0);
+    first_file_id=H5Fopen(SHARED_FILE,H5F_ACC_RDONLY,fapl);
+    second_file_id=H5Fopen(SHARED_FILE,H5F_ACC_RDONLY,fapl);
+    first_id=H5Dopen2(first_file_id,"/shared",H5P_DEFAULT);
+    second_id=H5Dopen2(second_file_id,"/shared",H5P_DEFAULT);
+    CHECK(first_file_id>=0 && second_file_id>=0 && first_id>=0 && second_id>=0);
+    CHECK(H5Dread(native_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,expected)>=0);
+    memset(actual,0,sizeof(actual));
+    CHECK(H5Dread(first_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,actual)>=0);
+    CHECK(memcmp(expected,actual,sizeof(expected))==0);
+    memset(actual,0,sizeof(actual));
+    CHECK(H5Dread(second_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,actual)>=0);
+    CHECK(memcmp(expected,actual,sizeof(expected))==0);
+    H5Sselect_hyperslab(space_id,H5S_SELECT_SET,start,stride,count,NULL);
+    memset(expected,0,sizeof(expected));
+    memset(actual,0,sizeof(actual));
+    CHECK(H5Dread(native_id,H5T_NATIVE_INT,space_id,space_id,H5P_DEFAULT,expected)>=0);
+    CHECK(H5Dread(second_id,H5T_NATIVE_INT,space_id,space_id,H5P_DEFAULT,actual)>=0);
+    CHECK(memcmp(expected,actual,sizeof(expected))==0);
+    H5Dclose(second_id);
+    H5Dclose(first_id);
+    H5Dclose(native_id);
+    H5Fclose(second_file_id);
+    H5Fclose(first_file_id);
+    H5Sclose(space_id);
+    H5Pclose(fapl);
+}
+/* Opens the checkpointed file with the native connector and compares it with the native dataset. */
+static void compare_checkpoint(hid_t native_id){
+    static int expected[AGG_ROWS][COLS],actual[AGG_ROWS][COLS];
+    hid_t file_id=H5Fopen(CKPT_FILE,H5F_ACC_RDONLY,H5P_DEFAULT),dataset_id;
+    dataset_id=H5Dopen2(file_id,"/checkpointed",H5P_DEFAULT);
+    CHECK(file_id>=0 && dataset_id>=0);
+    memset(actual,0xff,sizeof(actual));
+    CHECK(H5Dread(native_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,expected)>=0);
+    CHECK(H5Dread(dataset_id,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,H5P_DEFAULT,actual)>=0);
+    CHECK(memcmp(expected,actual,sizeof(expected))==0);
+    H5Dclose(dataset_id);
+    H5Fclose(file_id);
+}
+/*
+ * A dataset kept dirty until flushed: after a full flush a few slabs are
+ * changed and a checkpoint taken, then changed again and the file flushed.
+ * Each time the file, still open through the VOL, is read natively.
+ */
+static void test_checkpoint(hid_t native_file_id){
+    hsize_t dims[2]={AGG_ROWS,COLS};
+    hid_t fapl=H5Pcreate(H5P_FILE_ACCESS),file_id,space_id,native_id,hermes_id;
+    H5Pset_fapl_hermes_vol(fapl);
+    CHECK(H5Pset_hermes_vol_flush(fapl,true,0,0,0)>=0);
+    file_id=H5Fcreate(CKPT_FILE,H5F_ACC_TRUNC,H5P_DEFAULT,fapl);
+    space_id=H5Screate_simple(2,dims,NULL);
+    native_id=H5Dcreate2(native_file_id,"/checkpointed",H5T_NATIVE_INT,space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    hermes_id=H5Dcreate2(file_id,"/checkpointed",H5T_NATIVE_INT,space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+    CHECK(file_id>=0 && native_id>=0 && hermes_id>=0);
+    write_box(native_id,hermes_id,0,0,AGG_ROWS,COLS,0);
+    CHECK(H5Fflush(file_id,H5F_SCOPE_LOCAL)>=0);
+    compare_checkpoint(native_id);
+    write_box(native_id,hermes_id,5,0,3,COLS,-1000);
+    write_box(native_id,hermes_id,40,2,6,4,-2000);
+    CHECK(H5Fhermes_vol_checkpoint(hermes_id)>=0);
+    compare_checkpoint(native_id);
+    write_box(native_id,hermes_id,6,3,1,5,-3000);
+    write_box(native_id,hermes_id,AGG_ROWS-2,0,2,COLS,-4000);
+    CHECK(H5Fflush(file_id,H5F_SCOPE_LOCAL)>=0);
+    compare_checkpoint(native_id);
+    H5Dclose(hermes_id);
+    H5Dclose(native_id);
+    H5Sclose(space_id);
+    H5Fclose(file_id);
+    H5Pclose(fapl);
+}
+/*
+ * Three datasets, one of them twice with two selections, written in one
+ * multi-dataset call and mirrored dataset by dataset on the native file.
+ * They are read back in one call; the short dataset is converted from int
+ * and back.
+ */
+static void test_write_multi(hid_t native_file_id){
+    static int data[MULTI_CALLS][ROWS*COLS],expected[MULTI_CALLS][ROWS*COLS],actual[MULTI_CALLS][ROWS*COLS];
+    const char *names[MULTI_DSETS]={"/multi0","/multi1","/multi2"};
+    hid_t types[MULTI_DSETS]={H5T_NATIVE_INT,H5T_NATIVE_INT,H5T_NATIVE_SHORT};
+    hsize_t dims[2]={ROWS,COLS},start[2]={1,2},stride[2]={2,3},count[2]={ROWS/2-1,COLS/3-1};
+    hsize_t block_start[2]={ROWS/2,0},block_count[2]={ROWS/2,COLS};
+    hid_t fapl=H5Pcreate(H5P_FILE_ACCESS),file_id,space_id,native_ids[MULTI_DSETS],hermes_ids[MULTI_DSETS];
+    hid_t dset_ids[MULTI_CALLS],mem_type_ids[MULTI_CALLS],mem_space_ids[MULTI_CALLS],file_space_ids[MULTI_CALLS];
+    const void *write_bufs[MULTI_CALLS];
+    void *read_bufs[MULTI_CALLS];
+    int i,j,dset[MULTI_CALLS]={0,1,2,1};
+    H5Pset_fapl_hermes_vol(fapl);
+    file_id=H5Fcreate(MULTI_FILE,H5F_ACC_TRUNC,H5P_DEFAULT,fapl);
+    space_id=H5Screate_simple(2,dims,NULL);
+    CHECK(file_id>=0);
+    for(i=0;i<MULTI_DSETS;i++){
+        native_ids[i]=H5Dcreate2(native_file_id,names[i],types[i],space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+        hermes_ids[i]=H5Dcreate2(file_id,names[i],types[i],space_id,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+        CHECK(native_ids[i]>=0 && hermes_ids[i]>=0);
+    }
+    for(i=0;i<MULTI_CALLS;i++){
+        for(j=0;j<ROWS*COLS;j++) data[i][j]=(i+1)*1000+j;
+        dset_ids[i]=hermes_ids[dset[i]];
+        mem_type_ids[i]=H5T_NATIVE_INT;
+        mem_space_ids[i]=H5Screate_simple(2,dims,NULL);
+        file_space_ids[i]=H5Screate_simple(2,dims,NULL);
+        write_bufs[i]=data[i];
+        read_bufs[i]=actual[i];
+    }
+    /* The second dataset is written through a strided selection and then a block below it. */
+    H5Sselect_hyperslab(mem_space_ids[1],H5S_SELECT_SET,start,stride,count,NULL);
+    H5Sselect_hyperslab(file_space_ids[1],H5S_SELECT_SET,start,stride,count,NULL);
+    H5Sselect_hyperslab(mem_space_ids[3],H5S_SELECT_SET,block_start,NULL,block_count,NULL);
+    H5Sselect_hyperslab(file_space_ids[3],H5S_SELECT_SET,block_start,NULL,block_count,NULL);
+    for(i=0;i<MULTI_CALLS;i++)
+        CHECK(H5Dwrite(native_ids[dset[i]],mem_type_ids[i],mem_space_ids[i],file_space_ids[i],H5P_DEFAULT,
+                       data[i])>=0);
+    CHECK(H5Dhermes_vol_write_multi(MULTI_CALLS,dset_ids,mem_type_ids,mem_space_ids,file_space_ids,H5P_DEFAULT,
+                                    write_bufs)>=0);
+    memset(expected,0,sizeof(expected));
+    memset(actual,0,sizeof(actual));
+    for(i=0;i<MULTI_CALLS;i++)
+        CHECK(H5Dread(native_ids[dset[i]],mem_type_ids[i],mem_space_ids[i],file_space_ids[i],H5P_DEFAULT,
+                      expected[i])>=0);
+    CHECK(H5Dhermes_vol_read_multi(MULTI_CALLS,dset_ids,mem_type_ids,mem_space_ids,file_space_ids,H5P_DEFAULT,
+                                   read_bufs)>=0);
+    CHECK(memcmp(expected,actual,sizeof(expected))==0);
+    for(i=0;i<MULTI_CALLS;i++){
+        H5Sclose(file_space_ids[i]);
+        H5Sclose(mem_space_ids[i]);
+    }
+    for(i=0;i<MULTI_DSETS;i++){
+        H5Dclose(hermes_ids[i]);
+        H5Dclose(native_ids[i]);
+    }
+    H5Sclose(space_id);
+    H5Fclose(file_id);
+    H5Pclose(fapl);
+}
 
 int main() {
 
     hid_t       file_id, dataset_id, dataspace_id;  /* identifiers */
+    hid_t       native_file_id, native_dataset_id;
     hsize_t     dims[2];
     herr_t      status;
     hid_t vol_fapl = H5Pcreate(H5P_FILE_ACCESS);
@@ -45,6 +771,38 @@ int main() {
     /* Terminate access to the data space. */
     status = H5Sclose(dataspace_id);
 
+    /* A larger dataset in both files, compared element for element. */
+    native_file_id = H5Fcreate(NATIVE_FILE, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    dims[0] = ROWS;
+    dims[1] = COLS;
+    dataspace_id = H5Screate_simple(2, dims, NULL);
+    native_dataset_id = H5Dcreate2(native_file_id, "/round_trip", H5T_STD_I32BE, dataspace_id,
+                                   H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    dataset_id = H5Dcreate2(file_id, "/round_trip", H5T_STD_I32BE, dataspace_id,
+                            H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    CHECK(native_dataset_id >= 0 && dataset_id >= 0);
+    fill(native_dataset_id, dataset_id);
+    compare_all(native_dataset_id, dataset_id);
+    test_strided_hyperslab(native_dataset_id, dataset_id);
+    test_points(native_dataset_id, dataset_id);
+    test_conversion(native_dataset_id, dataset_id);
+    test_lfu_working_set(native_file_id);
+    test_async_requests(native_file_id);
+    test_attribute_cache(native_file_id);
+    test_compressed_demotion(native_file_id);
+    test_chunk_staging(native_file_id);
+    test_write_aggregation(native_file_id);
+    test_set_extent(native_file_id);
+    test_shared_cache(native_file_id);
+    test_checkpoint(native_file_id);
+    test_write_multi(native_file_id);
+    status = H5Dclose(native_dataset_id);
+    status = H5Dclose(dataset_id);
+    status = H5Sclose(dataspace_id);
+    status = H5Fclose(native_file_id);
+
     /* Close the file. */
     status = H5Fclose(file_id);
+    printf("%s\n", failures ? "round trip checks failed" : "round trip checks passed");
+    return failures != 0;
 }